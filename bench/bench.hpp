@@ -0,0 +1,134 @@
+/**
+ * @file bench.hpp
+ * @author Qirui Wang (qirui.wang@moegi.waseda.jp)
+ * @brief A minimal micro-benchmark harness reporting JSON
+ * @version 0.1
+ * @date 2023-03-04
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace simple_http::bench {
+
+// Keeps the compiler from dropping the computation of value.
+template <typename T>
+inline void DoNotOptimize(T const& value) {
+  asm volatile("" : : "r,m"(value) : "memory");
+}
+
+struct Options {
+  std::string               filter;  // only benchmarks whose name contains it
+  std::chrono::milliseconds min_time{200};
+  int                       repetitions{5};
+};
+
+struct Result {
+  std::string name;
+  uint64_t    iterations{0};  // per repetition
+  std::size_t bytes_per_op{0};
+  double      ns_per_op_median{0};
+  double      ns_per_op_min{0};
+  double      ns_per_op_stddev{0};
+};
+
+/**
+ * @brief Runs benchmark bodies and collects their timings. A body runs the given number of
+ * operations. The count is doubled until one run takes min_time, then that count is run for
+ * every repetition. Median and minimum across repetitions are the figures to compare between
+ * commits.
+ *
+ */
+struct Runner {
+ public:
+  using Body = std::function<void(uint64_t iterations)>;
+
+  explicit Runner(Options options) : options_(std::move(options)) {}
+
+  void Run(std::string const& name, Body const& body, std::size_t bytes_per_op = 0) {
+    if (!options_.filter.empty() && name.find(options_.filter) == std::string::npos) {
+      return;
+    }
+
+    uint64_t iterations = 1;
+    while (Time(body, iterations) < options_.min_time && iterations < (uint64_t{1} << 40)) {
+      iterations *= 2;
+    }
+
+    std::vector<double> samples;
+    for (int i = 0; i < options_.repetitions; ++i) {
+      auto elapsed = Time(body, iterations);
+      samples.push_back(std::chrono::duration<double, std::nano>(elapsed).count() / static_cast<double>(iterations));
+    }
+    std::sort(samples.begin(), samples.end());
+
+    double mean = 0;
+    for (auto sample : samples) {
+      mean += sample / static_cast<double>(samples.size());
+    }
+    double variance = 0;
+    for (auto sample : samples) {
+      variance += (sample - mean) * (sample - mean) / static_cast<double>(samples.size());
+    }
+
+    results_.push_back({.name             = name,
+                        .iterations       = iterations,
+                        .bytes_per_op     = bytes_per_op,
+                        .ns_per_op_median = samples[samples.size() / 2],
+                        .ns_per_op_min    = samples.front(),
+                        .ns_per_op_stddev = std::sqrt(variance)});
+    std::fprintf(stderr, "%-48s %12.1f ns/op\n", name.c_str(), results_.back().ns_per_op_median);
+  }
+
+  // Print every result as one JSON document, one benchmark per line so that results diff well.
+  void Report(std::FILE* out) const {
+    char        date[32];
+    auto        now = std::time(nullptr);
+    std::tm     tm{};
+    std::size_t size = std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", gmtime_r(&now, &tm));
+
+    std::fprintf(out, "{\n  \"context\": {\"date\": \"%.*s\", \"compiler\": \"%s\", \"cpus\": %u, ",
+                 static_cast<int>(size), date, __VERSION__, std::thread::hardware_concurrency());
+    std::fprintf(out, "\"min_time_ms\": %lld, \"repetitions\": %d},\n  \"benchmarks\": [\n",
+                 static_cast<long long>(options_.min_time.count()), options_.repetitions);
+    for (std::size_t i = 0; i < results_.size(); ++i) {
+      auto const& result = results_[i];
+      std::fprintf(out,
+                   "    {\"name\": \"%s\", \"iterations\": %llu, \"ns_per_op\": %.2f, \"ns_per_op_min\": %.2f, "
+                   "\"ns_per_op_stddev\": %.2f",
+                   result.name.c_str(), static_cast<unsigned long long>(result.iterations), result.ns_per_op_median,
+                   result.ns_per_op_min, result.ns_per_op_stddev);
+      if (result.bytes_per_op > 0) {
+        std::fprintf(out, ", \"bytes_per_second\": %.0f",
+                     static_cast<double>(result.bytes_per_op) * 1e9 / result.ns_per_op_median);
+      }
+      std::fprintf(out, "}%s\n", i + 1 < results_.size() ? "," : "");
+    }
+    std::fprintf(out, "  ]\n}\n");
+  }
+
+ private:
+  Options             options_;
+  std::vector<Result> results_;
+
+  static std::chrono::steady_clock::duration Time(Body const& body, uint64_t iterations) {
+    auto start = std::chrono::steady_clock::now();
+    body(iterations);
+    return std::chrono::steady_clock::now() - start;
+  }
+};
+}  // namespace simple_http::bench
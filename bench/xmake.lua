@@ -0,0 +1,6 @@
+set_kind("binary")
+add_syslinks("pthread")
+
+target("bench")
+  add_deps("simple_http_static")
+  add_files("bench.cpp")
@@ -0,0 +1,125 @@
+/**
+ * @file echo_latency.cpp
+ * @author Qirui Wang (qirui.wang@moegi.waseda.jp)
+ * @brief Loopback ping-pong latency of the echo TcpServer, with blocking and busy polling loops
+ * @version 0.1
+ * @date 2023-02-08
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <net/event_loop_thread.hpp>
+#include <net/tcp_server.hpp>
+
+using namespace std;
+using namespace simple_http::net;
+
+namespace {
+constexpr int kWarmupRounds = 1000;
+constexpr int kMessageSize  = 64;
+
+struct Result {
+  double p50_us;
+  double p99_us;
+};
+
+int Connect(uint16_t port) {
+  sockaddr_in addr{};
+  addr.sin_family      = AF_INET;
+  addr.sin_port        = htons(port);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  // The server starts listening asynchronously, retry for a while.
+  for (int i = 0; i < 100; ++i) {
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    if (::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0) {
+      int one = 1;
+      ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+      return fd;
+    }
+    ::close(fd);
+    this_thread::sleep_for(chrono::milliseconds(20));
+  }
+  return -1;
+}
+
+bool RoundTrip(int fd, char* buf) {
+  if (::write(fd, buf, kMessageSize) != kMessageSize) {
+    return false;
+  }
+  int received = 0;
+  while (received < kMessageSize) {
+    auto n = ::read(fd, buf + received, kMessageSize - received);
+    if (n <= 0) {
+      return false;
+    }
+    received += static_cast<int>(n);
+  }
+  return true;
+}
+
+Result Measure(uint16_t port, bool busy_poll, int rounds) {
+  EventLoopThread thread;
+  thread.Run();
+
+  TcpServer server{thread.GetLoop(), InetAddr{port, true}};
+  server.SetEventLoopGroupNum(1);
+  if (busy_poll) {
+    server.SetBusyPoll(chrono::milliseconds(200), 50);
+  }
+  server.Start();
+
+  int fd = Connect(port);
+  if (fd < 0) {
+    perror("connect");
+    exit(1);
+  }
+
+  char           buf[kMessageSize] = {};  // NOLINT
+  vector<double> samples;
+  samples.reserve(rounds);
+  for (int i = 0; i < kWarmupRounds + rounds; ++i) {
+    auto start = chrono::steady_clock::now();
+    if (!RoundTrip(fd, buf)) {
+      perror("round trip");
+      exit(1);
+    }
+    if (i >= kWarmupRounds) {
+      samples.push_back(chrono::duration<double, micro>(chrono::steady_clock::now() - start).count());
+    }
+  }
+  ::close(fd);
+  // Let the server observe the close before tearing it down.
+  this_thread::sleep_for(chrono::milliseconds(100));
+  server.Stop();
+
+  sort(samples.begin(), samples.end());
+  return {samples[samples.size() / 2], samples[samples.size() * 99 / 100]};
+}
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  int rounds = argc > 1 ? atoi(argv[1]) : 20000;
+
+  auto blocking = Measure(12350, false, rounds);
+  auto spinning = Measure(12351, true, rounds);
+
+  printf("%-10s %10s %10s\n", "mode", "p50 (us)", "p99 (us)");
+  printf("%-10s %10.2f %10.2f\n", "blocking", blocking.p50_us, blocking.p99_us);
+  printf("%-10s %10.2f %10.2f\n", "busy-poll", spinning.p50_us, spinning.p99_us);
+  printf("improvement: p50 %.1f%%, p99 %.1f%%\n", 100.0 * (1.0 - spinning.p50_us / blocking.p50_us),
+         100.0 * (1.0 - spinning.p99_us / blocking.p99_us));
+  return 0;
+}
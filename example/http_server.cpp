@@ -9,6 +9,9 @@
  *
  */
 
+#include <chrono>
+
+#include <net/hot_restart.hpp>
 #include <net/http/http_server.hpp>
 
 using namespace std;
@@ -19,11 +22,24 @@ int main(int argc, char* argv[]) {
   EventLoopThread thread;
   thread.Run();
 
+  // Starting a second instance takes the port over from the running one, which then drains and exits.
+  // The socket lives in a directory only this user may enter.
+  HotRestart restart{thread.GetLoop(), "/tmp/simple_http_example/restart.sock"};
+  auto       inherited = restart.TakeOver();
+
   http::HttpServer server{thread.GetLoop(), false, 12345};
+  if (!inherited.empty()) {
+    server.AdoptListenSocket(inherited.front());
+  }
 
   server.SetEventLoopGroupNum(2);  // Set the number of worker event loops
+  server.EnableCompression();      // gzip text files for clients that accept it
+  server.EnableHttp2();            // h2c by prior knowledge or Upgrade
 
   server.Start();
+  restart.Serve({server.GetListenFd()}, [&] {
+    server.Drain(std::chrono::seconds(30), [&] { thread.GetLoop()->Stop(); });
+  });
 
   thread.Wait();
   return 0;
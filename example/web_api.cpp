@@ -27,6 +27,21 @@ int main(int argc, char* argv[]) {
     resp.SetBody("Hello World!\n");
   });
 
+  // Lines are produced as the client reads them, the response is never held in memory.
+  server.Get("count", [](HttpRequest const& req, HttpResponse& resp) {
+    resp.SetStatusCode(200);
+    resp.SetStatusMessage("OK");
+    resp.SetContentType("text/plain");
+    resp.SetBodyProvider([i = 0](std::string& out) mutable {
+      out += std::to_string(i) + "\n";
+      return ++i < 1000000;
+    });
+  });
+
+  server.WebSocket("echo", {.on_message = [](WebSocketSessionPtr const& ws, std::string_view message, bool binary) {
+                              binary ? ws->SendBinary(message) : ws->SendText(message);
+                            }});
+
   server.Start();
 
   thread.Wait();
@@ -11,4 +11,8 @@ target("example_http_server")
 
 target("example_web_api")
   add_deps("simple_http_static")
-  add_files("web_api.cpp")
\ No newline at end of file
+  add_files("web_api.cpp")
+
+target("example_echo_latency")
+  add_deps("simple_http_static")
+  add_files("echo_latency.cpp")
\ No newline at end of file
@@ -1,10 +1,15 @@
-#include <iostream>
 #include <memory>
 
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
 #include <unistd.h>
 
 #include "net/channel.hpp"
+#include "net/net_metrics.hpp"
 #include "net/socket.hpp"
+#include "utils/logger.hpp"
 
 #include "acceptor.hpp"
 namespace simple_http::net {
@@ -18,25 +23,24 @@ Acceptor::Acceptor(EventLoop *loop, InetAddr const &addr, bool reuse_addr, bool
   socket_.SetReusePort(reuse_port);
   socket_.Bind(addr);
 
-  channel_->SetReadEventHandler([this] {
-    InetAddr peer;
-    int      newsock = socket_.Accept(peer);
-    if (newsock >= 0) {
-      if (new_connection_handler_) {
-        new_connection_handler_(newsock, peer);
-        std::cout << "New connection from " << peer.ToIpPort() << std::endl;
-      } else {
-        ::close(newsock);
-      }
-    }
-    // TODO: handle error
-  });
+  channel_->SetReadEventHandler([this] { HandleRead(); });
 
   if (addr_.GetPort() == 0) {
     addr_ = InetAddr{Socket::GetLocalAddr(socket_.GetFd())};
   }
 }
 
+Acceptor::Acceptor(EventLoop *loop, int listen_fd)
+    : socket_(listen_fd),
+      addr_(Socket::GetLocalAddr(listen_fd)),
+      loop_(loop),
+      channel_(std::make_unique<Channel>(loop, listen_fd)) {
+  // Descriptor flags are not passed along with the socket, the status flags are shared with the sender.
+  ::fcntl(listen_fd, F_SETFD, FD_CLOEXEC);
+  ::fcntl(listen_fd, F_SETFL, ::fcntl(listen_fd, F_GETFL) | O_NONBLOCK);
+  channel_->SetReadEventHandler([this] { HandleRead(); });
+}
+
 Acceptor::~Acceptor() {
   channel_->DisableAll();
   channel_->Remove();
@@ -46,8 +50,34 @@ InetAddr const &Acceptor::GetAddr() const { return addr_; }
 
 void Acceptor::OnNewConnection(NewConnectionHandler handler) { new_connection_handler_ = std::move(handler); }
 
+void Acceptor::HandleRead() {
+  // Events are edge triggered, take everything that is waiting in the backlog.
+  while (true) {
+    InetAddr peer;
+    int      newsock = socket_.Accept(peer);
+    if (newsock < 0) {
+      if (errno == ECONNABORTED || errno == EINTR) {
+        continue;
+      }
+      if (errno != EAGAIN) {
+        NetMetrics::Get().accept_errors.Increment();
+        LOG_ERROR << "accept failed: " << std::strerror(errno);
+      }
+      // TODO: handle error
+      break;
+    }
+    NetMetrics::Get().accepted_connections.Increment();
+    if (new_connection_handler_) {
+      new_connection_handler_(newsock, peer);
+      LOG_DEBUG << "New connection from " << peer.ToIpPort();
+    } else {
+      ::close(newsock);
+    }
+  }
+}
+
 void Acceptor::Listen() {
-  std::cout << "Listning on " << socket_.GetLocalAddr().ToIpPort() << std::endl;
+  LOG_INFO << "Listening on " << socket_.GetLocalAddr().ToIpPort();
   socket_.Listen();
   channel_->EnableReading();
 }
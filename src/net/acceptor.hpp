@@ -15,6 +15,8 @@ using NewConnectionHandler = std::function<void(int fd, InetAddr const &)>;
 struct Acceptor : public simple_http::util::NonCopyable {
  public:
   Acceptor(EventLoop *loop, InetAddr const &addr, bool reuse_addr = true, bool reuse_port = true);
+  // Take over a socket that is bound already and possibly listening, e.g. one handed over by another process.
+  Acceptor(EventLoop *loop, int listen_fd);
   ~Acceptor();
 
   [[nodiscard]] InetAddr const &GetAddr() const;
@@ -23,11 +25,15 @@ struct Acceptor : public simple_http::util::NonCopyable {
 
   void Listen();
 
+  [[nodiscard]] int GetFd() const { return socket_.GetFd(); }
+
  private:
   Socket                   socket_;
   InetAddr                 addr_;
   EventLoop               *loop_;
   std::unique_ptr<Channel> channel_;
   NewConnectionHandler     new_connection_handler_;
+
+  void HandleRead();
 };
 }  // namespace simple_http::net
\ No newline at end of file
@@ -0,0 +1,80 @@
+#include <cmath>
+
+#include "admission_controller.hpp"
+
+namespace simple_http::net {
+
+namespace {
+// Requests queue on their loop, so every server on that loop shares one drop state.
+thread_local CoDel t_request_codel;
+
+Clock::time_point ControlLaw(Clock::time_point t, Clock::duration interval, uint32_t count) {
+  return t + std::chrono::duration_cast<Clock::duration>(interval / std::sqrt(static_cast<double>(count)));
+}
+}  // namespace
+
+bool CoDel::ShouldDrop(Clock::time_point now, Clock::duration sojourn, Clock::duration target,
+                       Clock::duration interval) {
+  if (sojourn < target) {
+    first_above_time_ = {};
+    dropping_         = false;
+    return false;
+  }
+
+  if (first_above_time_ == Clock::time_point{}) {
+    first_above_time_ = now + interval;
+    return false;
+  }
+  if (now < first_above_time_) {
+    return false;
+  }
+
+  if (!dropping_) {
+    dropping_ = true;
+    // Resume close to the previous drop rate if we were dropping recently.
+    count_     = (count_ > 2 && now - drop_next_ < 16 * interval) ? count_ - 2 : 1;
+    drop_next_ = ControlLaw(now, interval, count_);
+    return true;
+  }
+
+  if (now >= drop_next_) {
+    ++count_;
+    drop_next_ = ControlLaw(drop_next_, interval, count_);
+    return true;
+  }
+  return false;
+}
+
+bool AdmissionController::AdmitConnection(std::size_t total, std::size_t on_loop, Clock::duration loop_lag) {
+  bool admit = true;
+  if (options_.max_connections != 0 && total >= options_.max_connections) {
+    admit = false;
+  } else if (options_.max_connections_per_loop != 0 && on_loop >= options_.max_connections_per_loop) {
+    admit = false;
+  } else if (options_.codel_enabled) {
+    admit = !accept_codel_.ShouldDrop(Clock::now(), loop_lag, options_.codel_target, options_.codel_interval);
+  }
+
+  if (!admit) {
+    shed_connections_.fetch_add(1, std::memory_order_relaxed);
+  }
+  return admit;
+}
+
+bool AdmissionController::TryAcquireRequest(Clock::duration sojourn) {
+  if (options_.codel_enabled &&
+      t_request_codel.ShouldDrop(Clock::now(), sojourn, options_.codel_target, options_.codel_interval)) {
+    shed_requests_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+
+  auto inflight = inflight_requests_.fetch_add(1, std::memory_order_relaxed);
+  if (options_.max_inflight_requests != 0 && inflight >= options_.max_inflight_requests) {
+    inflight_requests_.fetch_sub(1, std::memory_order_relaxed);
+    shed_requests_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  return true;
+}
+
+}  // namespace simple_http::net
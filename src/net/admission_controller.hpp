@@ -0,0 +1,102 @@
+/**
+ * @file admission_controller.hpp
+ * @author Qirui Wang (qirui.wang@moegi.waseda.jp)
+ * @brief Connection and request admission limits used to shed load
+ * @version 0.1
+ * @date 2023-02-06
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+#include "utils/non_copyable.hpp"
+
+namespace simple_http::net {
+using Clock = std::chrono::steady_clock;
+
+/**
+ * @brief Limits enforced by TcpServer and HttpServer. A value of 0 means unlimited.
+ *
+ */
+struct AdmissionOptions {
+  std::size_t max_connections{0};
+  std::size_t max_connections_per_loop{0};
+  std::size_t max_inflight_requests{0};
+  std::size_t max_queued_write_bytes{0};
+
+  // Adaptive shedding driven by loop lag, see CoDel.
+  bool                      codel_enabled{false};
+  std::chrono::microseconds codel_target{5000};
+  std::chrono::microseconds codel_interval{100000};
+};
+
+/**
+ * @brief Controlled-delay (CoDel) drop policy.
+ *
+ * Starts dropping once the sojourn time stayed above target for a whole interval,
+ * then drops at an increasing rate (interval / sqrt(count)) until the delay recovers.
+ * Not thread safe, each instance must be driven by a single thread.
+ */
+struct CoDel {
+ public:
+  bool ShouldDrop(Clock::time_point now, Clock::duration sojourn, Clock::duration target, Clock::duration interval);
+
+  [[nodiscard]] bool IsDropping() const { return dropping_; }
+
+ private:
+  Clock::time_point first_above_time_{};
+  Clock::time_point drop_next_{};
+  uint32_t          count_{0};
+  bool              dropping_{false};
+};
+
+struct AdmissionController : public simple_http::util::NonCopyable {
+ public:
+  explicit AdmissionController(AdmissionOptions const& options = {}) : options_(options) {}
+
+  [[nodiscard]] AdmissionOptions const& GetOptions() const { return options_; }
+  void                                  SetOptions(AdmissionOptions const& options) { options_ = options; }
+
+  /**
+   * @brief Decide whether a newly accepted connection may be served. Called on the acceptor loop only.
+   *
+   * @param total connections currently served
+   * @param on_loop connections on the loop picked for the new one
+   * @param loop_lag last observed lag of the picked loop
+   */
+  bool AdmitConnection(std::size_t total, std::size_t on_loop, Clock::duration loop_lag);
+
+  /**
+   * @brief Reserve an in-flight request slot. Called on the loop handling the request.
+   * Every successful call must be paired with ReleaseRequest().
+   *
+   * @param sojourn time the request waited in the loop before being handled
+   */
+  bool TryAcquireRequest(Clock::duration sojourn);
+  void ReleaseRequest() { inflight_requests_.fetch_sub(1, std::memory_order_relaxed); }
+
+  [[nodiscard]] bool ExceedsWriteQueue(std::size_t queued_bytes) const {
+    return options_.max_queued_write_bytes != 0 && queued_bytes > options_.max_queued_write_bytes;
+  }
+
+  [[nodiscard]] std::size_t GetInflightRequests() const { return inflight_requests_.load(std::memory_order_relaxed); }
+  [[nodiscard]] uint64_t    GetShedConnections() const { return shed_connections_.load(std::memory_order_relaxed); }
+  [[nodiscard]] uint64_t    GetShedRequests() const { return shed_requests_.load(std::memory_order_relaxed); }
+
+ private:
+  AdmissionOptions options_;
+
+  std::atomic_size_t   inflight_requests_{0};
+  std::atomic_uint64_t shed_connections_{0};
+  std::atomic_uint64_t shed_requests_{0};
+
+  CoDel accept_codel_;
+};
+}  // namespace simple_http::net
@@ -0,0 +1,90 @@
+#include <cerrno>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "connector.hpp"
+
+namespace simple_http::net {
+
+Connector::Connector(EventLoop *loop, InetAddr const &addr) : loop_(loop), addr_(addr) {}
+
+Connector::~Connector() {
+  handler_ = nullptr;
+  Release();
+}
+
+void Connector::Start(std::chrono::milliseconds timeout, ConnectHandler handler) {
+  handler_ = std::move(handler);
+  fd_      = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, IPPROTO_TCP);
+  if (fd_ < 0) {
+    loop_->QueueInLoop([self = shared_from_this(), error = errno] { self->Finish(error); });
+    return;
+  }
+
+  int ret   = ::connect(fd_, addr_.GetSockAddr(), static_cast<socklen_t>(sizeof(struct sockaddr_in)));
+  int error = ret == 0 ? 0 : errno;
+  if (error != 0 && error != EINPROGRESS && error != EINTR) {
+    loop_->QueueInLoop([self = shared_from_this(), error] { self->Finish(error); });
+    return;
+  }
+
+  // Writable once connected or failed, also when connect(2) succeeded right away on loopback.
+  channel_ = std::make_unique<Channel>(loop_, fd_);
+  channel_->SetWriteEventHandler([this] { HandleWrite(); });
+  channel_->EnableWriting();
+  if (timeout.count() > 0) {
+    std::weak_ptr<Connector> weak = shared_from_this();
+    timer_                        = loop_->RunAfter(timeout, [weak] {
+      if (auto self = weak.lock(); self) {
+        self->timer_ = 0;
+        self->Finish(ETIMEDOUT);
+      }
+    });
+  }
+}
+
+void Connector::Stop() {
+  handler_ = nullptr;
+  Release();
+}
+
+void Connector::HandleWrite() {
+  int  error  = 0;
+  auto optlen = static_cast<socklen_t>(sizeof error);
+  if (::getsockopt(fd_, SOL_SOCKET, SO_ERROR, &error, &optlen) < 0) {
+    error = errno;
+  }
+  Finish(error);
+}
+
+void Connector::Finish(int error) {
+  int fd = -1;
+  if (error == 0) {
+    fd  = fd_;
+    fd_ = -1;  // handed over
+  }
+  Release();
+  if (auto handler = std::move(handler_); handler) {
+    handler(fd, error);
+  }
+}
+
+void Connector::Release() {
+  if (timer_ != 0) {
+    loop_->Cancel(timer_);
+    timer_ = 0;
+  }
+  if (channel_) {
+    channel_->DisableAll();
+    channel_->Remove();
+    // The channel may be the one whose event is being handled, free it after this iteration.
+    loop_->QueueInLoop([channel = std::shared_ptr<Channel>(std::move(channel_))] {});
+  }
+  if (fd_ >= 0) {
+    ::close(fd_);
+    fd_ = -1;
+  }
+}
+
+}  // namespace simple_http::net
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <memory>
+
+#include "net/channel.hpp"
+#include "net/event_loop.hpp"
+#include "net/inet_addr.hpp"
+#include "utils/non_copyable.hpp"
+
+namespace simple_http::net {
+
+// fd is the connected socket, owned by the handler now, or -1 with the errno of the failure.
+using ConnectHandler = std::function<void(int fd, int error)>;
+
+/**
+ * @brief One non-blocking connect(2) on a loop. The socket is watched for writability, and the
+ * attempt fails with ETIMEDOUT if it is not connected within the timeout.
+ *
+ */
+struct Connector : public simple_http::util::NonCopyable, public std::enable_shared_from_this<Connector> {
+ public:
+  Connector(EventLoop *loop, InetAddr const &addr);
+  ~Connector();
+
+  // Start connecting, in the loop thread. The handler is always called from a later loop iteration.
+  void Start(std::chrono::milliseconds timeout, ConnectHandler handler);
+  // Give up on the attempt, the handler is not called anymore.
+  void Stop();
+
+  [[nodiscard]] InetAddr const &GetAddr() const { return addr_; }
+
+ private:
+  EventLoop               *loop_;
+  InetAddr                 addr_;
+  int                      fd_{-1};
+  std::unique_ptr<Channel> channel_;
+  TimerId                  timer_{0};
+  ConnectHandler           handler_;
+
+  void HandleWrite();
+  void Finish(int error);
+  void Release();
+};
+}  // namespace simple_http::net
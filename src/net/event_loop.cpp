@@ -1,6 +1,9 @@
+#include <algorithm>
 #include <atomic>
+#include <cmath>
 #include <ctime>
 #include <memory>
+#include <mutex>
 
 #include <cstdlib>
 #include <utility>
@@ -10,6 +13,7 @@
 
 #include "net/channel.hpp"
 #include "net/epoll.hpp"
+#include "net/net_metrics.hpp"
 
 #include "event_loop.hpp"
 
@@ -30,7 +34,8 @@ EventLoop::EventLoop()
       thread_id_(std::this_thread::get_id()),
       epoller_(std::make_unique<Epoll>(this)),
       wakeup_fd_(CreateEventfd()),
-      wakeup_channel_(std::make_unique<Channel>(this, wakeup_fd_)) {
+      wakeup_channel_(std::make_unique<Channel>(this, wakeup_fd_)),
+      timer_queue_(std::make_unique<TimerQueue>(this)) {
   if (t_loop_in_this_thread != nullptr) {
     // TODO: Handle error
   } else {
@@ -38,8 +43,8 @@ EventLoop::EventLoop()
   }
 
   wakeup_channel_->SetReadEventHandler([this]() {
-    auto one = 1;
-    auto n   = ::read(wakeup_fd_, &one, sizeof(one));
+    uint64_t one = 1;
+    auto     n   = ::read(wakeup_fd_, &one, sizeof(one));
   });
   wakeup_channel_->EnableReading();
 }
@@ -56,21 +61,39 @@ EventLoop* EventLoop::GetEventLoopOfCurrentThread() { return t_loop_in_this_thre
 bool EventLoop::IsInLoopThread() const { return thread_id_ == std::this_thread::get_id(); }
 
 void EventLoop::Start() {
-  running_ = true;
-  quit_    = false;
+  running_      = true;
+  quit_         = false;
+  window_start_ = std::chrono::steady_clock::now();
 
   while (!quit_.load(std::memory_order_acquire)) {
     active_channels_.clear();
-    epoller_->Select(500, active_channels_);
+    epoller_->Select(NextPollTimeout(), active_channels_);
+    poll_time_ = std::chrono::steady_clock::now();
     for (auto const& channel : active_channels_) {
       current_active_channel_ = channel;
       current_active_channel_->HandleEvent();
     }
     current_active_channel_ = nullptr;
-    InvokeRunInLoopFuncs();
+    if (InvokeRunInLoopFuncs() || !active_channels_.empty()) {
+      last_active_ = poll_time_;
+    }
+    auto now  = std::chrono::steady_clock::now();
+    auto busy = now - poll_time_;
+    lag_.store(busy.count(), std::memory_order_relaxed);
+    UpdateUtilization(now, busy);
   }
 
-  running_ = false;
+  spinning_ = false;
+  running_  = false;
+
+  std::vector<Func> quit_funcs;
+  {
+    std::lock_guard lock(quit_mutex_);
+    quit_funcs.swap(quit_funcs_);
+  }
+  for (auto const& func : quit_funcs) {
+    func();
+  }
 }
 
 void EventLoop::Stop() {
@@ -80,9 +103,59 @@ void EventLoop::Stop() {
   }
 }
 
+void EventLoop::RunOnQuit(Func func) {
+  std::lock_guard lock(quit_mutex_);
+  quit_funcs_.push_back(std::move(func));
+}
+
 void EventLoop::WakeUp() const {
-  auto one = 1;
-  auto n   = ::write(wakeup_fd_, &one, sizeof(one));
+  uint64_t one = 1;
+  auto     n   = ::write(wakeup_fd_, &one, sizeof(one));
+}
+
+void EventLoop::UpdateUtilization(std::chrono::steady_clock::time_point now, std::chrono::steady_clock::duration busy) {
+  constexpr auto kWindow = std::chrono::milliseconds(100);
+  constexpr auto kSmooth = std::chrono::seconds(1);
+
+  window_busy_ += busy;
+  auto elapsed  = now - window_start_;
+  if (elapsed < kWindow) {
+    return;
+  }
+  // Exponential moving average, windows are longer while the loop blocks without events.
+  using Seconds = std::chrono::duration<double>;
+  auto sample   = std::min(Seconds(window_busy_) / Seconds(elapsed), 1.0);
+  auto weight   = 1.0 - std::exp(-Seconds(elapsed) / Seconds(kSmooth));
+  auto previous = utilization_.load(std::memory_order_relaxed);
+  utilization_.store(previous + (sample - previous) * weight, std::memory_order_relaxed);
+  window_start_ = now;
+  window_busy_  = {};
+}
+
+void EventLoop::SetBusyPoll(std::chrono::microseconds idle_timeout) {
+  busy_poll_idle_.store(std::chrono::duration_cast<std::chrono::steady_clock::duration>(idle_timeout).count(),
+                        std::memory_order_relaxed);
+}
+
+int EventLoop::NextPollTimeout() {
+  constexpr int kBlockingTimeoutMs = 500;
+
+  auto idle = std::chrono::steady_clock::duration{busy_poll_idle_.load(std::memory_order_relaxed)};
+  if (idle.count() != 0 && std::chrono::steady_clock::now() - last_active_ < idle) {
+    spinning_.store(true, std::memory_order_relaxed);
+    return 0;
+  }
+
+  if (spinning_.load(std::memory_order_relaxed)) {
+    spinning_.store(false, std::memory_order_relaxed);
+    // Pairs with the fence in QueueInLoop: a producer that still saw us spinning skipped its
+    // wakeup, so its function must be visible here before we block.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!pending_func_queue_.Empty()) {
+      return 0;
+    }
+  }
+  return kBlockingTimeoutMs;
 }
 
 void EventLoop::RunInLoop(Func func) {
@@ -95,21 +168,59 @@ void EventLoop::RunInLoop(Func func) {
 
 void EventLoop::QueueInLoop(Func func) {
   pending_func_queue_.Enqueue(std::move(func));
+  NetMetrics::Get().pending_loop_tasks.Increment();
   if (!IsInLoopThread() or !running_.load(std::memory_order_acquire)) {
-    WakeUp();
+    // A spinning loop drains the queue on its next iteration, no need for the eventfd round trip.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!spinning_.load(std::memory_order_relaxed)) {
+      WakeUp();
+    }
   }
 }
 
+TimerId EventLoop::RunAt(std::chrono::steady_clock::time_point when, Func func) {
+  return AddTimer(when, {}, std::move(func));
+}
+
+TimerId EventLoop::RunAfter(std::chrono::steady_clock::duration delay, Func func) {
+  return AddTimer(std::chrono::steady_clock::now() + delay, {}, std::move(func));
+}
+
+TimerId EventLoop::RunEvery(std::chrono::steady_clock::duration interval, Func func) {
+  return AddTimer(std::chrono::steady_clock::now() + interval, interval, std::move(func));
+}
+
+void EventLoop::Cancel(TimerId id) {
+  RunInLoop([this, id]() { timer_queue_->Cancel(id); });
+}
+
+TimerId EventLoop::AddTimer(std::chrono::steady_clock::time_point when, std::chrono::steady_clock::duration interval,
+                            Func func) {
+  auto id = timer_queue_->NextId();
+  RunInLoop([this, id, when, interval, func = std::move(func)]() mutable {
+    timer_queue_->Add(id, when, interval, std::move(func));
+  });
+  return id;
+}
+
 void EventLoop::UpdateChannel(Channel* channel) { epoller_->UpdateChannel(channel); }
 void EventLoop::RemoveChannel(Channel* channel) { epoller_->RemoveChannel(channel); }
 
-void EventLoop::InvokeRunInLoopFuncs() {
+bool EventLoop::InvokeRunInLoopFuncs() {
+  auto&    metrics = NetMetrics::Get();
+  uint64_t invoked = 0;
   while (!pending_func_queue_.Empty()) {
     Func func;
     while (pending_func_queue_.TryDequeue(func)) {
       func();
+      ++invoked;
     }
   }
+  if (invoked != 0) {
+    metrics.loop_tasks.Increment(invoked);
+    metrics.pending_loop_tasks.Sub(static_cast<int64_t>(invoked));
+  }
+  return invoked != 0;
 }
 
 }  // namespace simple_http::net
\ No newline at end of file
@@ -1,16 +1,18 @@
 #pragma once
 
 #include <atomic>
+#include <chrono>
+#include <cstdint>
 #include <functional>
 #include <memory>
+#include <mutex>
 #include <thread>
 #include <vector>
 
+#include "net/timer_queue.hpp"
 #include "utils/concurrent_queue.hpp"
 #include "utils/non_copyable.hpp"
 
-// TODO: support schedule task
-
 namespace simple_http::net {
 struct Epoll;
 struct Channel;
@@ -38,14 +40,77 @@ struct EventLoop : public simple_http::util::NonCopyable {
   void RunInLoop(Func func);
   void QueueInLoop(Func func);
 
+  // Run func in the loop thread once Start() returns, to forget about a loop that is going away.
+  void RunOnQuit(Func func);
+
+  /**
+   * @brief Run func in the loop thread at a point in time, after a delay, or every interval until
+   * cancelled. Can be called from any thread, the returned id cancels the timer.
+   *
+   */
+  TimerId RunAt(std::chrono::steady_clock::time_point when, Func func);
+  TimerId RunAfter(std::chrono::steady_clock::duration delay, Func func);
+  TimerId RunEvery(std::chrono::steady_clock::duration interval, Func func);
+  void    Cancel(TimerId id);
+
+  /**
+   * @brief Opt-in low latency mode. The loop polls epoll without blocking and picks up queued
+   * functions without eventfd wakeups, and falls back to blocking after being idle for idle_timeout.
+   * A zero idle_timeout turns busy polling off. Can be called from any thread.
+   *
+   */
+  void SetBusyPoll(std::chrono::microseconds idle_timeout);
+  [[nodiscard]] bool IsBusyPolling() const { return spinning_.load(std::memory_order_relaxed); }
+
   void UpdateChannel(Channel* channel);
   void RemoveChannel(Channel* channel);
 
+  /**
+   * @brief Time the current batch of events was returned by epoll. Only valid in the loop thread.
+   *
+   */
+  [[nodiscard]] std::chrono::steady_clock::time_point GetPollTime() const { return poll_time_; }
+
+  /**
+   * @brief How long the last iteration spent handling events and queued functions,
+   * i.e. how long a newly ready event had to wait. Readable from any thread.
+   *
+   */
+  [[nodiscard]] std::chrono::steady_clock::duration GetLag() const {
+    return std::chrono::steady_clock::duration{lag_.load(std::memory_order_relaxed)};
+  }
+
+  /**
+   * @brief Load gauges, readable from any thread to spread connections over loops: the connections
+   * the loop serves and the bytes they queued for sending, kept up by TcpConnection, and the share
+   * of time spent handling events and queued functions, from 0 to 1 and smoothed over about a second.
+   *
+   */
+  [[nodiscard]] int64_t GetConnectionCount() const { return connections_.load(std::memory_order_relaxed); }
+  [[nodiscard]] int64_t GetQueuedBytes() const { return queued_bytes_.load(std::memory_order_relaxed); }
+  [[nodiscard]] double  GetUtilization() const { return utilization_.load(std::memory_order_relaxed); }
+
+  void AddConnections(int64_t n) { connections_.fetch_add(n, std::memory_order_relaxed); }
+  void AddQueuedBytes(int64_t n) { queued_bytes_.fetch_add(n, std::memory_order_relaxed); }
+
  private:
   std::atomic_bool running_{false};
   std::atomic_bool quit_{false};
   std::thread::id  thread_id_;
 
+  std::chrono::steady_clock::time_point        poll_time_{};
+  std::atomic<std::chrono::steady_clock::rep> lag_{0};
+
+  std::atomic_int64_t                   connections_{0};
+  std::atomic_int64_t                   queued_bytes_{0};
+  std::atomic<double>                   utilization_{0};
+  std::chrono::steady_clock::time_point window_start_{};
+  std::chrono::steady_clock::duration   window_busy_{};
+
+  std::atomic<std::chrono::steady_clock::rep> busy_poll_idle_{0};
+  std::atomic_bool                            spinning_{false};
+  std::chrono::steady_clock::time_point        last_active_{};
+
   std::unique_ptr<Epoll> epoller_;
 
   ChannelList active_channels_;
@@ -54,8 +119,16 @@ struct EventLoop : public simple_http::util::NonCopyable {
   int                      wakeup_fd_;
   std::unique_ptr<Channel> wakeup_channel_;
 
+  std::unique_ptr<TimerQueue> timer_queue_;
+
   util::ConcurrentQueue<Func> pending_func_queue_;
 
-  void InvokeRunInLoopFuncs();
+  std::mutex        quit_mutex_;
+  std::vector<Func> quit_funcs_;
+
+  bool    InvokeRunInLoopFuncs();
+  int     NextPollTimeout();
+  void    UpdateUtilization(std::chrono::steady_clock::time_point now, std::chrono::steady_clock::duration busy);
+  TimerId AddTimer(std::chrono::steady_clock::time_point when, std::chrono::steady_clock::duration interval, Func func);
 };
 }  // namespace simple_http::net
\ No newline at end of file
@@ -0,0 +1,303 @@
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <random>
+#include <stdexcept>
+#include <string>
+
+#include <sched.h>
+
+#include "event_loop_group.hpp"
+
+namespace simple_http::net {
+
+namespace {
+// Cores worth of CPU time the cgroup of this process may use per period, 0 if unlimited.
+double ReadCpuQuota() {
+  // cgroup v2: "<quota> <period>", quota is "max" if unlimited.
+  if (std::ifstream max{"/sys/fs/cgroup/cpu.max"}; max) {
+    std::string quota;
+    double      period{0};
+    if (max >> quota >> period && quota != "max" && period > 0) {
+      return std::stod(quota) / period;
+    }
+    return 0;
+  }
+  // cgroup v1: a quota of -1 is unlimited.
+  std::ifstream quota_file{"/sys/fs/cgroup/cpu/cpu.cfs_quota_us"};
+  std::ifstream period_file{"/sys/fs/cgroup/cpu/cpu.cfs_period_us"};
+  double        quota{0};
+  double        period{0};
+  if (quota_file >> quota && period_file >> period && quota > 0 && period > 0) {
+    return quota / period;
+  }
+  return 0;
+}
+}  // namespace
+
+EventLoopGroup::EventLoopGroup(size_t num_event_loops, EventLoopGroupOptions options) : options_(std::move(options)) {
+  for (auto const& cpus : options_.cpu_sets) {
+    if (std::any_of(cpus.begin(), cpus.end(), [](int cpu) { return cpu < 0 || cpu >= CPU_SETSIZE; })) {
+      throw std::invalid_argument("EventLoopGroup: cpu_sets has a core outside [0, CPU_SETSIZE)");
+    }
+  }
+  if (IsElastic()) {
+    options_.min_loops = std::max<size_t>(options_.min_loops, 1);
+    options_.max_loops = std::max(options_.max_loops, options_.min_loops);
+    num_event_loops    = std::clamp(num_event_loops, options_.min_loops, options_.max_loops);
+  }
+  for (size_t i = 0; i < num_event_loops; ++i) {
+    Spawn();
+  }
+  Publish();
+}
+
+EventLoopGroup::~EventLoopGroup() = default;
+
+void EventLoopGroup::Start() {
+  std::lock_guard lock(mutex_);
+  started_ = true;
+  for (auto& member : members_) {
+    member.thread->Run();
+  }
+}
+
+void EventLoopGroup::Stop() {
+  std::lock_guard lock(mutex_);
+  for (auto& member : members_) {
+    member.thread->Wait();
+  }
+}
+
+EventLoop* EventLoopGroup::GetNextEventLoop() {
+  auto loops = GetLoops();
+  if (loops->loops.empty()) {
+    return nullptr;
+  }
+  auto const& all = loops->loops;
+  // Scans start at the next loop round-robin, so that ties are spread too.
+  auto next = next_event_loop_.fetch_add(1) % all.size();
+  switch (options_.balancing) {
+    case LoopBalancing::kRoundRobin:
+      return all[next];
+    case LoopBalancing::kLeastConnections:
+      return PickLeast(all, next, [](EventLoop* a, EventLoop* b) {
+        return a->GetConnectionCount() < b->GetConnectionCount();
+      });
+    case LoopBalancing::kLeastQueuedBytes:
+      return PickLeast(all, next, [](EventLoop* a, EventLoop* b) {
+        return std::pair{a->GetQueuedBytes(), a->GetConnectionCount()} <
+               std::pair{b->GetQueuedBytes(), b->GetConnectionCount()};
+      });
+    case LoopBalancing::kPowerOfTwoChoices: {
+      thread_local std::minstd_rand random{std::random_device{}()};
+      auto  size   = all.size();
+      auto  second = size > 1 ? (next + 1 + random() % (size - 1)) % size : next;
+      auto* a      = all[next];
+      auto* b      = all[second];
+      return LessLoaded(b, a) ? b : a;
+    }
+  }
+  return nullptr;
+}
+
+EventLoop* EventLoopGroup::GetEventLoop(size_t index) {
+  auto loops = GetLoops();
+  if (index < loops->loops.size()) {
+    return loops->loops[index];
+  }
+  return nullptr;
+}
+
+EventLoop* EventLoopGroup::GetEventLoopForCpu(int cpu) {
+  auto loops = GetLoops();
+  if (cpu < 0) {
+    return GetNextEventLoop();
+  }
+  auto core = static_cast<size_t>(cpu);
+  if (core < loops->cpu_to_loop.size() && loops->cpu_to_loop[core] >= 0) {
+    return loops->loops[loops->cpu_to_loop[core]];
+  }
+  return GetNextEventLoop();
+}
+
+EventLoop* EventLoopGroup::GetMigrationTarget(EventLoop* from) {
+  constexpr auto kMigrationInterval = std::chrono::milliseconds(250);
+
+  auto        loops = GetLoops();
+  auto const& all   = loops->loops;
+  if (all.empty()) {
+    return nullptr;
+  }
+  if (std::find(all.begin(), all.end(), from) == all.end()) {
+    return PickLeast(all, 0, LessLoaded);
+  }
+
+  auto gap = options_.migrate_utilization_gap;
+  if (gap <= 0 || all.size() < 2 || from->GetUtilization() <= gap) {
+    return nullptr;
+  }
+  auto now  = std::chrono::steady_clock::now().time_since_epoch().count();
+  auto last = last_migration_.load(std::memory_order_relaxed);
+  if (now - last < std::chrono::steady_clock::duration(kMigrationInterval).count()) {
+    return nullptr;
+  }
+  auto* to = PickLeast(all, 0, LessLoaded);
+  if (to == from || from->GetUtilization() - to->GetUtilization() <= gap ||
+      !last_migration_.compare_exchange_strong(last, now, std::memory_order_relaxed)) {
+    return nullptr;
+  }
+  return to;
+}
+
+int EventLoopGroup::GetResizeStep() const {
+  if (!IsElastic()) {
+    return 0;
+  }
+  auto        loops = GetLoops();
+  auto const& all   = loops->loops;
+  auto        size  = all.size();
+  auto        most  = std::max(std::min(options_.max_loops, GetAvailableCpus()), options_.min_loops);
+  if (size > most) {
+    return -1;
+  }
+  if (size < options_.min_loops) {
+    return 1;
+  }
+
+  double total{0};
+  for (auto* loop : all) {
+    total += loop->GetUtilization();
+  }
+  if (total / static_cast<double>(size) > options_.grow_utilization) {
+    return size < most ? 1 : 0;
+  }
+  // Only if the remaining loops stay below grow_utilization, or the loop comes right back.
+  if (size > options_.min_loops && total / static_cast<double>(size) < options_.shrink_utilization &&
+      total / static_cast<double>(size - 1) < options_.grow_utilization) {
+    return -1;
+  }
+  return 0;
+}
+
+EventLoop* EventLoopGroup::AddLoop() {
+  EventLoop* loop;
+  {
+    std::lock_guard lock(mutex_);
+    Spawn();
+    if (started_) {
+      members_.back().thread->Run();
+    }
+    loop = members_.back().thread->GetLoop();
+  }
+  Publish();
+  return loop;
+}
+
+EventLoop* EventLoopGroup::RetireLoop() {
+  EventLoop* loop;
+  {
+    std::lock_guard lock(mutex_);
+    auto            active = GetLoops()->loops;
+    if (active.size() < 2) {
+      return nullptr;
+    }
+    // The fewest connections to move, the newest loop among equals.
+    std::reverse(active.begin(), active.end());
+    loop = PickLeast(active, 0, [](EventLoop* a, EventLoop* b) {
+      return a->GetConnectionCount() < b->GetConnectionCount();
+    });
+    for (auto& member : members_) {
+      if (member.thread->GetLoop() == loop) {
+        member.retiring = true;
+        ++retiring_;
+      }
+    }
+  }
+  Publish();
+  return loop;
+}
+
+std::vector<EventLoop*> EventLoopGroup::GetRetiringLoops() const {
+  std::lock_guard         lock(mutex_);
+  std::vector<EventLoop*> retiring;
+  for (auto const& member : members_) {
+    if (member.retiring) {
+      retiring.push_back(member.thread->GetLoop());
+    }
+  }
+  return retiring;
+}
+
+void EventLoopGroup::ReleaseLoop(EventLoop* loop) {
+  std::unique_ptr<EventLoopThread> thread;
+  {
+    std::lock_guard lock(mutex_);
+    auto            it = std::find_if(members_.begin(), members_.end(), [loop](Member const& member) {
+      return member.retiring && member.thread->GetLoop() == loop;
+    });
+    if (it == members_.end()) {
+      return;
+    }
+    thread = std::move(it->thread);
+    members_.erase(it);
+    --retiring_;
+  }
+  // Stops the loop and joins it outside the lock.
+  thread.reset();
+}
+
+size_t EventLoopGroup::GetAvailableCpus() {
+  size_t    cpus = std::max(std::thread::hardware_concurrency(), 1U);
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  if (::sched_getaffinity(0, sizeof(set), &set) == 0) {
+    cpus = CPU_COUNT(&set);
+  }
+  if (auto quota = ReadCpuQuota(); quota > 0) {
+    cpus = std::min(cpus, static_cast<size_t>(std::ceil(quota)));
+  }
+  return std::max<size_t>(cpus, 1);
+}
+
+void EventLoopGroup::Spawn() {
+  // The lowest slot free, so a loop added after one retired takes over its name and cores.
+  size_t slot = 0;
+  while (std::any_of(members_.begin(), members_.end(), [slot](Member const& member) { return member.slot == slot; })) {
+    ++slot;
+  }
+  auto             cores = std::max(std::thread::hardware_concurrency(), 1U);
+  std::vector<int> cpus;
+  if (slot < options_.cpu_sets.size()) {
+    cpus = options_.cpu_sets[slot];
+  } else if (options_.pin_threads) {
+    cpus = {static_cast<int>(slot % cores)};
+  }
+  members_.push_back({std::make_unique<EventLoopThread>("EventLoop-" + std::to_string(slot), cpus), slot});
+}
+
+void EventLoopGroup::Publish() {
+  auto loops = std::make_shared<Loops>();
+  {
+    std::lock_guard lock(mutex_);
+    for (auto const& member : members_) {
+      if (member.retiring) {
+        continue;
+      }
+      int index = static_cast<int>(loops->loops.size());
+      loops->loops.push_back(member.thread->GetLoop());
+      // Cores are checked by the constructor, or are below hardware_concurrency().
+      for (auto cpu : member.thread->GetCpus()) {
+        auto core = static_cast<size_t>(cpu);
+        if (core >= loops->cpu_to_loop.size()) {
+          loops->cpu_to_loop.resize(core + 1, -1);
+        }
+        if (loops->cpu_to_loop[core] < 0) {
+          loops->cpu_to_loop[core] = index;
+        }
+      }
+    }
+    loops_.store(std::move(loops), std::memory_order_release);
+  }
+}
+}  // namespace simple_http::net
@@ -1,8 +1,13 @@
 #pragma once
 
+#include <algorithm>
 #include <atomic>
+#include <chrono>
+#include <cmath>
 #include <cstddef>
 #include <memory>
+#include <mutex>
+#include <thread>
 #include <vector>
 
 #include "net/event_loop.hpp"
@@ -10,48 +15,154 @@
 #include "utils/non_copyable.hpp"
 
 namespace simple_http::net {
+
+// How EventLoopGroup::GetNextEventLoop spreads new connections over the loops.
+enum class LoopBalancing {
+  kRoundRobin,
+  kLeastConnections,
+  kLeastQueuedBytes,   // fewest bytes waiting to be sent, then fewest connections
+  kPowerOfTwoChoices,  // the less utilized of two loops picked at random, then fewer connections
+};
+
+struct EventLoopGroupOptions {
+  // cpu_sets[i] is the set of cores loop i is pinned to. Loops without an entry are not pinned,
+  // unless pin_threads is set, which pins loop i to core i % hardware_concurrency(). Cores outside
+  // [0, CPU_SETSIZE) make the constructor throw std::invalid_argument.
+  std::vector<std::vector<int>> cpu_sets;
+  bool                          pin_threads{false};
+
+  // Hand accepted sockets to the loop pinned to the core that received their packets (SO_INCOMING_CPU).
+  bool steer_by_incoming_cpu{false};
+
+  // Allocate connection buffers on their loop thread, so that pinned loops get NUMA-local memory.
+  bool numa_local_buffers{false};
+
+  LoopBalancing balancing{LoopBalancing::kRoundRobin};
+
+  // Move keep-alive connections idle between two requests to the least utilized loop while their
+  // own is busier by more than this share of time, see GetMigrationTarget(). 0 never moves them.
+  double migrate_utilization_gap{0};
+
+  // Elastic groups add a loop while their loops are busier than grow_utilization on average and
+  // retire one while they idle below shrink_utilization, checked by TcpServer every resize_interval.
+  // The count stays within min_loops and max_loops, and within the cores the process may use as the
+  // CPU quota of its container changes, see EventLoopGroup::GetAvailableCpus(). 0 max_loops keeps it fixed.
+  size_t                    min_loops{1};
+  size_t                    max_loops{0};
+  double                    grow_utilization{0.75};
+  double                    shrink_utilization{0.25};
+  std::chrono::milliseconds resize_interval{2000};
+};
+
 struct EventLoopGroup : public simple_http::util::NonCopyable {
  public:
-  EventLoopGroup(size_t num_event_loops = std::thread::hardware_concurrency()) {
-    for (int i = 0; i < num_event_loops; ++i) {
-      event_loops_.emplace_back(std::make_unique<EventLoopThread>("EventLoop-" + std::to_string(i)));
-    }
-  }
+  EventLoopGroup(size_t num_event_loops = std::thread::hardware_concurrency(), EventLoopGroupOptions options = {});
+  ~EventLoopGroup();
 
-  ~EventLoopGroup() = default;
+  // The loops new connections are handed to, retiring ones aside.
+  [[nodiscard]] size_t GetSize() const { return GetLoops()->loops.size(); }
 
-  [[nodiscard]] size_t GetSize() const { return event_loops_.size(); }
+  [[nodiscard]] EventLoopGroupOptions const& GetOptions() const { return options_; }
 
-  void Start() {
-    for (auto& event_loop : event_loops_) {
-      event_loop->Run();
-    }
-  }
+  [[nodiscard]] bool IsElastic() const { return options_.max_loops > 0; }
 
-  void Stop() {
-    for (auto& event_loop : event_loops_) {
-      event_loop->Wait();
-    }
-  }
+  void Start();
+  void Stop();
+
+  EventLoop* GetNextEventLoop();
+  EventLoop* GetEventLoop(size_t index);
+
+  /**
+   * @brief Get the loop pinned to the given core, or the next loop round-robin if none is.
+   *
+   */
+  EventLoop* GetEventLoopForCpu(int cpu);
 
-  EventLoop* GetNextEventLoop() {
-    if (!event_loops_.empty()) {
-      auto  next = next_event_loop_.fetch_add(1) % event_loops_.size();
-      auto* loop = event_loops_[next]->GetLoop();
-      return loop;
+  /**
+   * @brief The loop to move an idle connection served by from to, nullptr to keep it where it is:
+   * the least utilized loop, if from is busier by more than migrate_utilization_gap. Utilization
+   * catches up slowly, so a connection moves at most every kMigrationInterval across the group.
+   * Connections of a retiring loop always move, to the least loaded loop.
+   *
+   */
+  EventLoop* GetMigrationTarget(EventLoop* from);
+
+  /**
+   * @brief Loops to add, if positive, or to retire, if negative, for the utilization of the loops
+   * and the bounds of an elastic group. Always 0 for a fixed one.
+   *
+   */
+  [[nodiscard]] int GetResizeStep() const;
+
+  // Start one more loop, handed new connections right away.
+  EventLoop* AddLoop();
+
+  /**
+   * @brief Stop handing new connections to the loop with the fewest, and return it. Its connections
+   * should move away or close, then ReleaseLoop() stops it. nullptr if it is the last loop.
+   *
+   */
+  EventLoop* RetireLoop();
+
+  [[nodiscard]] std::vector<EventLoop*> GetRetiringLoops() const;
+  [[nodiscard]] bool HasRetiringLoops() const { return retiring_.load(std::memory_order_relaxed) > 0; }
+
+  // Stop a retiring loop and join its thread. Nothing may use the loop any more.
+  void ReleaseLoop(EventLoop* loop);
+
+  // The cores this process may run on, capped by the CPU quota of its cgroup.
+  [[nodiscard]] static size_t GetAvailableCpus();
+
+ private:
+  // What the group hands connections to, replaced as a whole when loops come and go.
+  struct Loops {
+    std::vector<EventLoop*> loops;
+    std::vector<int>        cpu_to_loop;  // index into loops
+  };
+
+  struct Member {
+    std::unique_ptr<EventLoopThread> thread;
+    size_t                           slot;  // its cpu_sets entry and name
+    bool                             retiring{false};
+  };
+
+  EventLoopGroupOptions                     options_;
+  std::atomic_size_t                        next_event_loop_{0};
+  std::atomic<std::shared_ptr<Loops const>> loops_;
+
+  mutable std::mutex  mutex_;  // guards members_ and started_
+  std::vector<Member> members_;
+  bool                started_{false};
+  std::atomic_size_t  retiring_{0};
+
+  std::atomic<std::chrono::steady_clock::rep> last_migration_{0};
+
+  // Utilizations within this of each other count as even.
+  static constexpr double kEvenUtilization = 0.05;
+
+  [[nodiscard]] std::shared_ptr<Loops const> GetLoops() const { return loops_.load(std::memory_order_acquire); }
+
+  void Spawn();
+  void Publish();
+
+  static bool LessLoaded(EventLoop* a, EventLoop* b) {
+    auto difference = a->GetUtilization() - b->GetUtilization();
+    if (std::abs(difference) > kEvenUtilization) {
+      return difference < 0;
     }
-    return nullptr;
+    return a->GetConnectionCount() < b->GetConnectionCount();
   }
 
-  EventLoop* GetEventLoop(size_t index) {
-    if (index < event_loops_.size()) {
-      return event_loops_[index]->GetLoop();
+  template <typename Less>
+  static EventLoop* PickLeast(std::vector<EventLoop*> const& loops, size_t start, Less less) {
+    auto* best = loops[start % loops.size()];
+    for (size_t i = 1; i < loops.size(); ++i) {
+      auto* loop = loops[(start + i) % loops.size()];
+      if (less(loop, best)) {
+        best = loop;
+      }
     }
-    return nullptr;
+    return best;
   }
-
- private:
-  std::atomic_size_t                            next_event_loop_{0};
-  std::vector<std::unique_ptr<EventLoopThread>> event_loops_;
 };
-}  // namespace simple_http::net
\ No newline at end of file
+}  // namespace simple_http::net
@@ -1,14 +1,16 @@
 #include <string_view>
 #include <thread>
 
+#include <pthread.h>
+#include <sched.h>
 #include <sys/prctl.h>
 
 #include "event_loop_thread.hpp"
 
 namespace simple_http::net {
 
-EventLoopThread::EventLoopThread(std::string_view thread_name)
-    : loopThreadName_(thread_name), thread_([this] { Loop(); }) {
+EventLoopThread::EventLoopThread(std::string_view thread_name, std::vector<int> cpus)
+    : loopThreadName_(thread_name), cpus_(std::move(cpus)), thread_([this] { Loop(); }) {
   auto f = promiseForLoopPointer_.get_future();
   loop_  = f.get();
 }
@@ -42,6 +44,17 @@ void EventLoopThread::Run() {
 void EventLoopThread::Loop() {
   ::prctl(PR_SET_NAME, loopThreadName_.c_str());
 
+  if (!cpus_.empty()) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (auto cpu : cpus_) {
+      CPU_SET(cpu, &set);
+    }
+    if (::pthread_setaffinity_np(::pthread_self(), sizeof(set), &set) != 0) {
+      cpus_.clear();
+    }
+  }
+
   thread_local static auto loop = std::make_shared<EventLoop>();
 
   loop->QueueInLoop([this]() { promiseForLoop_.set_value(1); });
@@ -18,6 +18,7 @@
 #include <mutex>
 #include <string_view>
 #include <thread>
+#include <vector>
 
 #include "net/event_loop.hpp"
 #include "utils/non_copyable.hpp"
@@ -26,7 +27,14 @@ namespace simple_http::net {
 
 struct EventLoopThread : public simple_http::util::NonCopyable {
  public:
-  explicit EventLoopThread(std::string_view thread_name = "EventLoopThread");
+  /**
+   * @brief Construct a new Event Loop Thread object
+   *
+   * @param thread_name name of the thread
+   * @param cpus cores the thread is pinned to before its loop is created, so that everything the
+   * loop allocates is first touched on that core's NUMA node. Empty means no affinity.
+   */
+  explicit EventLoopThread(std::string_view thread_name = "EventLoopThread", std::vector<int> cpus = {});
   ~EventLoopThread();
 
   void Run();
@@ -34,11 +42,14 @@ struct EventLoopThread : public simple_http::util::NonCopyable {
 
   [[nodiscard]] EventLoop *GetLoop() const { return loop_.get(); }
 
+  [[nodiscard]] std::vector<int> const &GetCpus() const { return cpus_; }
+
  private:
   std::shared_ptr<EventLoop> loop_{nullptr};
   std::mutex                 loopMutex_;
 
   std::string                              loopThreadName_;
+  std::vector<int>                         cpus_;
   std::promise<std::shared_ptr<EventLoop>> promiseForLoopPointer_;
   std::promise<int>                        promiseForRun_;
   std::promise<int>                        promiseForLoop_;
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstddef>
+#include <ctime>
+#include <memory>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "utils/non_copyable.hpp"
+
+namespace simple_http::net {
+/**
+ * @brief An open file and the part of it to send. The descriptor is closed with the last owner.
+ *
+ */
+struct FileRange : public simple_http::util::NonCopyable {
+ public:
+  FileRange(int fd, off_t offset, std::size_t length, std::time_t modified_time = 0)
+      : fd_(fd), offset_(offset), length_(length), modified_time_(modified_time) {}
+
+  ~FileRange() {
+    if (fd_ >= 0 && !owner_) {
+      ::close(fd_);
+    }
+  }
+
+  /**
+   * @brief Open a regular file for sending as a whole.
+   *
+   * @return nullptr if path is not a readable regular file
+   */
+  static std::shared_ptr<FileRange> Open(std::string const& path) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+      return nullptr;
+    }
+    struct stat st {};
+    if (::fstat(fd, &st) < 0 || !S_ISREG(st.st_mode)) {
+      ::close(fd);
+      return nullptr;
+    }
+    return std::make_shared<FileRange>(fd, 0, static_cast<std::size_t>(st.st_size), st.st_mtime);
+  }
+
+  /**
+   * @brief A part of file, offset counts from the start of file. It shares the descriptor, which
+   * stays open while any part is in use.
+   *
+   */
+  static std::shared_ptr<FileRange> Slice(std::shared_ptr<FileRange> const& file, std::size_t offset,
+                                          std::size_t length) {
+    auto part    = std::make_shared<FileRange>(file->fd_, file->offset_ + static_cast<off_t>(offset), length,
+                                            file->modified_time_);
+    part->owner_ = file;
+    return part;
+  }
+
+  [[nodiscard]] int         GetFd() const { return fd_; }
+  [[nodiscard]] off_t       GetOffset() const { return offset_; }
+  [[nodiscard]] std::size_t GetLength() const { return length_; }
+  [[nodiscard]] std::time_t GetModifiedTime() const { return modified_time_; }
+
+ private:
+  int         fd_;
+  off_t       offset_;
+  std::size_t length_;
+  std::time_t modified_time_;
+
+  std::shared_ptr<FileRange const> owner_;  // of the descriptor, set for slices
+};
+}  // namespace simple_http::net
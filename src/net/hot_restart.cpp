@@ -0,0 +1,289 @@
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "net/channel.hpp"
+#include "net/socket.hpp"
+#include "utils/logger.hpp"
+
+#include "hot_restart.hpp"
+
+namespace simple_http::net {
+
+namespace {
+constexpr std::size_t kMaxListenFds = 16;
+
+sockaddr_un UnixAddr(std::string const& path) {
+  sockaddr_un addr{};
+  addr.sun_family = AF_UNIX;
+  if (path.size() >= sizeof(addr.sun_path)) {
+    throw std::runtime_error("Hot restart path too long: " + path);
+  }
+  std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+  return addr;
+}
+
+std::string ParentDir(std::string const& path) {
+  auto slash = path.find_last_of('/');
+  if (slash == std::string::npos) {
+    return ".";
+  }
+  return slash == 0 ? "/" : path.substr(0, slash);
+}
+
+// Empty if dir is a directory of this user that nobody else may enter, so no other user can put a
+// socket of its own at the path or replace ours.
+std::string CheckPrivateDir(std::string const& dir) {
+  struct stat st {};
+  if (::lstat(dir.c_str(), &st) < 0) {
+    return dir + ": " + std::strerror(errno);
+  }
+  if (!S_ISDIR(st.st_mode)) {
+    return dir + " is not a directory";
+  }
+  if (st.st_uid != ::geteuid() || (st.st_mode & (S_IRWXG | S_IRWXO)) != 0) {
+    return dir + " has to belong to this user with mode 0700";
+  }
+  return {};
+}
+
+// Whether the process at the other end of fd runs as this user.
+bool IsSameUser(int fd, pid_t& pid) {
+  ucred     cred{};
+  socklen_t length = sizeof(cred);
+  if (::getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &length) < 0 || length != sizeof(cred)) {
+    return false;
+  }
+  pid = cred.pid;
+  // A peer outside our pid namespace has pid 0.
+  return cred.uid == ::geteuid() && cred.pid > 0;
+}
+
+// The number of sockets, followed by the sockets themselves as ancillary data.
+bool SendFds(int fd, std::vector<int> const& fds) {
+  auto   count = static_cast<uint32_t>(fds.size());
+  iovec  iov{&count, sizeof(count)};
+  char   control[CMSG_SPACE(sizeof(int) * kMaxListenFds)]{};
+  msghdr msg{};
+  msg.msg_iov        = &iov;
+  msg.msg_iovlen     = 1;
+  msg.msg_control    = control;
+  msg.msg_controllen = CMSG_SPACE(sizeof(int) * fds.size());
+
+  auto* cmsg       = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type  = SCM_RIGHTS;
+  cmsg->cmsg_len   = CMSG_LEN(sizeof(int) * fds.size());
+  std::memcpy(CMSG_DATA(cmsg), fds.data(), sizeof(int) * fds.size());
+  return ::sendmsg(fd, &msg, MSG_NOSIGNAL) == static_cast<ssize_t>(sizeof(count));
+}
+
+std::vector<int> ReceiveFds(int fd) {
+  uint32_t count{0};
+  iovec    iov{&count, sizeof(count)};
+  char     control[CMSG_SPACE(sizeof(int) * kMaxListenFds)]{};
+  msghdr   msg{};
+  msg.msg_iov        = &iov;
+  msg.msg_iovlen     = 1;
+  msg.msg_control    = control;
+  msg.msg_controllen = sizeof(control);
+
+  if (::recvmsg(fd, &msg, MSG_CMSG_CLOEXEC) != static_cast<ssize_t>(sizeof(count))) {
+    return {};
+  }
+  std::vector<int> fds;
+  for (auto* cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+    if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+      fds.resize((cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int));
+      std::memcpy(fds.data(), CMSG_DATA(cmsg), sizeof(int) * fds.size());
+    }
+  }
+  if (fds.size() != count) {
+    for (auto listen_fd : fds) {
+      ::close(listen_fd);
+    }
+    return {};
+  }
+  return fds;
+}
+}  // namespace
+
+HotRestart::HotRestart(EventLoop* loop, std::string path) : loop_(loop), path_(std::move(path)) {}
+
+HotRestart::~HotRestart() {
+  if (successor_channel_) {
+    successor_channel_->DisableAll();
+    successor_channel_->Remove();
+  }
+  if (channel_) {
+    channel_->DisableAll();
+    channel_->Remove();
+  }
+  if (predecessor_fd_ >= 0) {
+    ::close(predecessor_fd_);
+  }
+}
+
+std::vector<int> HotRestart::TakeOver(std::chrono::milliseconds timeout) {
+  auto addr = UnixAddr(path_);
+  auto dir  = ParentDir(path_);
+  if (::access(dir.c_str(), F_OK) < 0) {
+    return {};  // no server ever ran
+  }
+  if (auto error = CheckPrivateDir(dir); !error.empty()) {
+    LOG_WARNING << "Not taking over, " << error;
+    return {};
+  }
+  int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    return {};
+  }
+  // Nobody serving at path: a stale socket file refuses, a missing one doesn't exist.
+  if (::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+    ::close(fd);
+    return {};
+  }
+  if (pid_t pid{0}; !IsSameUser(fd, pid)) {
+    LOG_WARNING << "Not taking over from process " << pid << " at " << path_ << ", it runs as another user";
+    ::close(fd);
+    return {};
+  }
+
+  auto seconds = std::chrono::duration_cast<std::chrono::seconds>(timeout);
+  auto micros  = std::chrono::duration_cast<std::chrono::microseconds>(timeout - seconds);
+  timeval tv{seconds.count(), micros.count()};
+  ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+  auto fds = ReceiveFds(fd);
+  if (fds.empty()) {
+    LOG_WARNING << "No listening sockets received from " << path_;
+    ::close(fd);
+    return {};
+  }
+  predecessor_fd_ = fd;
+  LOG_INFO << "Took over " << fds.size() << " listening sockets from " << path_;
+  return fds;
+}
+
+void HotRestart::Serve(std::vector<int> listen_fds, std::function<void()> handed_over) {
+  auto addr = UnixAddr(path_);
+  int  fd   = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    throw std::runtime_error(std::string("Failed to create socket: ") + std::strerror(errno));
+  }
+  socket_ = std::make_unique<Socket>(fd);
+
+  auto dir = ParentDir(path_);
+  if (::mkdir(dir.c_str(), 0700) < 0 && errno != EEXIST) {
+    socket_.reset();
+    throw std::runtime_error("Failed to create " + dir + ": " + std::strerror(errno));
+  }
+  if (auto error = CheckPrivateDir(dir); !error.empty()) {
+    socket_.reset();
+    throw std::runtime_error("Refusing to listen on " + path_ + ", " + error);
+  }
+
+  // The predecessor keeps accepting successors on its socket until acknowledged, replace its file.
+  // Only a socket, whatever else is at path is not ours to remove.
+  if (struct stat st {}; ::lstat(path_.c_str(), &st) == 0) {
+    if (!S_ISSOCK(st.st_mode)) {
+      socket_.reset();
+      throw std::runtime_error("Refusing to replace " + path_ + ", it is not a socket");
+    }
+    ::unlink(path_.c_str());
+  }
+  if (::bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 || ::listen(fd, 1) < 0) {
+    socket_.reset();
+    throw std::runtime_error("Failed to listen on " + path_ + ": " + std::strerror(errno));
+  }
+
+  std::erase(listen_fds, -1);
+  if (listen_fds.size() > kMaxListenFds) {
+    listen_fds.resize(kMaxListenFds);
+  }
+  listen_fds_  = std::move(listen_fds);
+  handed_over_ = std::move(handed_over);
+
+  loop_->RunInLoop([this] {
+    channel_ = std::make_unique<Channel>(loop_, socket_->GetFd());
+    channel_->SetReadEventHandler([this] { HandleAccept(); });
+    channel_->EnableReading();
+
+    if (predecessor_fd_ >= 0) {
+      char ready = 1;
+      (void)::write(predecessor_fd_, &ready, sizeof(ready));
+      ::close(predecessor_fd_);
+      predecessor_fd_ = -1;
+    }
+  });
+}
+
+void HotRestart::HandleAccept() {
+  while (true) {
+    int fd = ::accept4(socket_->GetFd(), nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd < 0) {
+      return;
+    }
+    pid_t pid{0};
+    if (!IsSameUser(fd, pid)) {
+      LOG_WARNING << "Refused to hand the listening sockets over to process " << pid << " of another user";
+      ::close(fd);
+      continue;
+    }
+    // One successor at a time, another one retries after this one failed.
+    if (successor_ || !SendFds(fd, listen_fds_)) {
+      ::close(fd);
+      continue;
+    }
+    LOG_INFO << "Handing " << listen_fds_.size() << " listening sockets over to process " << pid;
+    successor_         = std::make_unique<Socket>(fd);
+    successor_channel_ = std::make_unique<Channel>(loop_, fd);
+    successor_channel_->SetReadEventHandler([this] { HandleSuccessor(); });
+    successor_channel_->SetCloseEventHandler([this] { HandleSuccessor(); });
+    successor_channel_->EnableReading();
+  }
+}
+
+void HotRestart::HandleSuccessor() {
+  if (!successor_) {
+    return;
+  }
+  char ready{0};
+  auto n = ::read(successor_->GetFd(), &ready, sizeof(ready));
+  if (n < 0 && (errno == EAGAIN || errno == EINTR)) {
+    return;
+  }
+  CloseSuccessor();
+  if (n != 1) {
+    LOG_WARNING << "New process exited before serving, keep serving";
+    return;
+  }
+
+  // The path belongs to the successor now, so the socket closes without unlinking it.
+  channel_->DisableAll();
+  channel_->Remove();
+  loop_->QueueInLoop([channel = std::shared_ptr<Channel>(std::move(channel_)),
+                      socket  = std::shared_ptr<Socket>(std::move(socket_))] {});
+  LOG_INFO << "Handed over to the new process";
+  if (handed_over_) {
+    handed_over_();
+  }
+}
+
+void HotRestart::CloseSuccessor() {
+  if (!successor_channel_) {
+    return;
+  }
+  successor_channel_->DisableAll();
+  successor_channel_->Remove();
+  // The channel is dispatching this event, release it after.
+  loop_->QueueInLoop([channel = std::shared_ptr<Channel>(std::move(successor_channel_)),
+                      socket  = std::shared_ptr<Socket>(std::move(successor_))] {});
+}
+}  // namespace simple_http::net
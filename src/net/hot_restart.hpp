@@ -0,0 +1,77 @@
+/**
+ * @file hot_restart.hpp
+ * @author Qirui Wang (qirui.wang@moegi.waseda.jp)
+ * @brief Handing the listening sockets of a server over to the process that replaces it
+ * @version 0.1
+ * @date 2023-03-07
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "net/channel.hpp"
+#include "net/event_loop.hpp"
+#include "net/socket.hpp"
+#include "utils/non_copyable.hpp"
+
+namespace simple_http::net {
+
+/**
+ * @brief Passes listening sockets from a running process to the one replacing it over the Unix
+ * socket at path, so the port never stops accepting:
+ *
+ *   1. The new process calls TakeOver(), which receives the sockets of the old one, adopts them
+ *      and starts its server. Both processes accept on the same sockets now.
+ *   2. It calls Serve(), which tells the old process it is serving and waits at path for its own
+ *      successor.
+ *   3. The old process runs its handed over handler, which drains its connections and exits.
+ *
+ * If the new process dies before calling Serve() the old one keeps serving.
+ *
+ * The directory of path is created with mode 0700 if missing, and has to belong to the user with
+ * no access for anyone else. Both processes refuse peers running as another user.
+ *
+ */
+struct HotRestart : public util::NonCopyable {
+ public:
+  HotRestart(EventLoop* loop, std::string path);
+  ~HotRestart();
+
+  // The listening sockets of the process serving at path, empty if there is none. Blocks for at most timeout.
+  std::vector<int> TakeOver(std::chrono::milliseconds timeout = std::chrono::seconds(5));
+
+  /**
+   * @brief Hand listen_fds to the next process taking over at path, and acknowledge the process
+   * taken over from. Call it once the server accepts. handed_over runs on the loop after a
+   * successor acknowledged in turn. Throws std::runtime_error if path can't be listened on.
+   *
+   */
+  void Serve(std::vector<int> listen_fds, std::function<void()> handed_over);
+
+ private:
+  EventLoop*  loop_;
+  std::string path_;
+  int         predecessor_fd_{-1};  // kept open until Serve() acknowledges
+
+  std::vector<int>         listen_fds_;
+  std::function<void()>    handed_over_;
+  std::unique_ptr<Socket>  socket_;
+  std::unique_ptr<Channel> channel_;
+
+  // The process being handed the sockets, waiting for its acknowledgement.
+  std::unique_ptr<Socket>  successor_;
+  std::unique_ptr<Channel> successor_channel_;
+
+  void HandleAccept();
+  void HandleSuccessor();
+  void CloseSuccessor();
+};
+}  // namespace simple_http::net
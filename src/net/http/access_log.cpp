@@ -0,0 +1,290 @@
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <charconv>
+#include <cstring>
+#include <ctime>
+
+#include <arpa/inet.h>
+
+#include "access_log.hpp"
+#include "utils/date_time.hpp"
+#include "utils/metrics.hpp"
+
+namespace simple_http::net::http {
+
+namespace {
+std::atomic_uint64_t next_access_log_id{0};
+
+constexpr std::array<char const*, 12> kMonths{"Jan", "Feb", "Mar", "Apr", "May", "Jun",
+                                              "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"};
+
+template <typename T>
+void AppendNumber(std::string& out, T value) {
+  char buf[24];
+  auto [end, ec] = std::to_chars(buf, buf + sizeof(buf), value);
+  out.append(buf, end);
+}
+
+// Escaped like Apache's mod_log_config does, so a field can't break out of its quotes or line.
+void AppendEscaped(std::string& out, std::string_view value) {
+  for (auto c : value) {
+    auto uc = static_cast<unsigned char>(c);
+    if (c == '"' || c == '\\') {
+      out += '\\';
+      out += c;
+    } else if (uc < 0x20 || uc >= 0x7f) {
+      constexpr std::string_view kHex = "0123456789abcdef";
+      out += "\\x";
+      out += kHex[uc >> 4];
+      out += kHex[uc & 0xf];
+    } else {
+      out += c;
+    }
+  }
+}
+
+void AppendQuoted(std::string& out, std::string_view value) {
+  out += '"';
+  if (value.empty()) {
+    out += '-';
+  }
+  AppendEscaped(out, value);
+  out += '"';
+}
+}  // namespace
+
+struct AccessLog::Entry {
+  static constexpr std::size_t kTextSize = 472;
+
+  int64_t                     time_us;  // wall clock time the request was received
+  uint64_t                    bytes;
+  uint32_t                    duration_us;
+  uint32_t                    peer_ip;  // network byte order
+  uint16_t                    status;
+  Method                      method;
+  Version                     version;
+  uint16_t                    target_len;
+  uint16_t                    referer_len;
+  uint16_t                    agent_len;
+  std::array<char, kTextSize> text;  // target, referer and user agent, each truncated to fit
+};
+
+struct AccessLog::Ring {
+  explicit Ring(std::size_t slots) : capacity(std::bit_ceil(std::max<std::size_t>(slots, 2))), entries(capacity) {}
+
+  std::size_t const  capacity;
+  std::vector<Entry> entries;
+
+  alignas(util::kCacheLineSize) std::atomic_size_t head{0};  // written by the loop thread
+  uint32_t                                          sample_counter{0};
+  alignas(util::kCacheLineSize) std::atomic_size_t tail{0};  // written by the backend
+
+  std::atomic_bool retired{false};
+  std::atomic_bool orphaned{false};
+};
+
+AccessLog::AccessLog(std::unique_ptr<util::LogSink> sink, AccessLogOptions options)
+    : id_(next_access_log_id.fetch_add(1, std::memory_order_relaxed)),
+      sink_(std::move(sink)),
+      options_(options) {
+  batch_.reserve(kBatchSize + 4096);
+}
+
+AccessLog::~AccessLog() {
+  Stop();
+  Drain();
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto& ring : rings_) {
+    ring->orphaned.store(true, std::memory_order_release);
+  }
+}
+
+void AccessLog::Start() {
+  if (running_.exchange(true)) {
+    return;
+  }
+  thread_ = std::thread([this] { Run(); });
+}
+
+void AccessLog::Stop() {
+  if (!running_.exchange(false)) {
+    return;
+  }
+  cv_.notify_one();
+  thread_.join();
+}
+
+void AccessLog::Record(InetAddr const& peer, HttpRequest const& req, StatusCode status, std::size_t bytes,
+                       std::chrono::nanoseconds duration) {
+  auto& ring = GetRing();
+  auto  head = ring.head.load(std::memory_order_relaxed);
+  auto  used = head - ring.tail.load(std::memory_order_acquire);
+  if (used == ring.capacity) {
+    dropped_.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  if (options_.sample_under_load > 1 && used >= ring.capacity / 2 &&
+      ring.sample_counter++ % options_.sample_under_load != 0) {
+    sampled_out_.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+
+  auto  duration_us = std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+  auto& entry       = ring.entries[head & (ring.capacity - 1)];
+  entry.time_us     = util::DateTime::Now().GetMicroSecondsSinceEpoch() - duration_us;
+  entry.bytes       = bytes;
+  entry.duration_us = static_cast<uint32_t>(std::clamp<int64_t>(duration_us, 0, UINT32_MAX));
+  entry.peer_ip     = peer.GetIpInNetEndian();
+  entry.status      = static_cast<uint16_t>(status);
+  entry.method      = req.GetMethod();
+  entry.version     = req.GetVersion();
+
+  auto* text  = entry.text.data();
+  auto  left  = entry.text.size();
+  auto  write = [&text, &left](std::string_view value) {
+    auto len = std::min(value.size(), left);
+    std::memcpy(text, value.data(), len);
+    text += len;
+    left -= len;
+    return static_cast<uint16_t>(len);
+  };
+  entry.target_len = write(req.GetPath());
+  entry.target_len += write(req.GetQuery());
+  if (options_.format == AccessLogFormat::kCombined) {
+    entry.referer_len = write(req.GetHeaderView(HeaderId::kReferer));
+    entry.agent_len   = write(req.GetHeaderView(HeaderId::kUserAgent));
+  } else {
+    entry.referer_len = 0;
+    entry.agent_len   = 0;
+  }
+
+  ring.head.store(head + 1, std::memory_order_release);
+  if (used + 1 == ring.capacity / 2) {
+    cv_.notify_one();
+  }
+}
+
+AccessLog::Ring& AccessLog::GetRing() {
+  struct Registry {
+    std::vector<std::pair<uint64_t, std::shared_ptr<Ring>>> rings;
+
+    ~Registry() {
+      for (auto& [id, ring] : rings) {
+        ring->retired.store(true, std::memory_order_release);
+      }
+    }
+  };
+  thread_local Registry registry;
+
+  for (auto& [id, ring] : registry.rings) {
+    if (id == id_) {
+      return *ring;
+    }
+  }
+
+  std::erase_if(registry.rings,
+                [](auto const& entry) { return entry.second->orphaned.load(std::memory_order_acquire); });
+  auto ring = std::make_shared<Ring>(options_.ring_slots);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    rings_.push_back(ring);
+  }
+  registry.rings.emplace_back(id_, ring);
+  return *ring;
+}
+
+void AccessLog::Run() {
+  while (running_.load(std::memory_order_acquire)) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cv_.wait_for(lock, options_.flush_interval);
+    }
+    Drain();
+  }
+  Drain();
+}
+
+void AccessLog::Drain() {
+  std::vector<std::shared_ptr<Ring>> rings;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    rings = rings_;
+  }
+
+  bool wrote = false;
+  for (auto& ring : rings) {
+    auto tail = ring->tail.load(std::memory_order_relaxed);
+    auto head = ring->head.load(std::memory_order_acquire);
+    for (; tail != head; ++tail) {
+      Format(ring->entries[tail & (ring->capacity - 1)]);
+      if (batch_.size() >= kBatchSize) {
+        sink_->Write(batch_);
+        batch_.clear();
+        wrote = true;
+      }
+    }
+    ring->tail.store(tail, std::memory_order_release);
+  }
+  if (!batch_.empty()) {
+    sink_->Write(batch_);
+    batch_.clear();
+    wrote = true;
+  }
+  if (wrote) {
+    sink_->Flush();
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::erase_if(rings_, [](auto const& ring) {
+    return ring->retired.load(std::memory_order_acquire) &&
+           ring->head.load(std::memory_order_acquire) == ring->tail.load(std::memory_order_relaxed);
+  });
+}
+
+void AccessLog::Format(Entry const& entry) {
+  char ip[INET_ADDRSTRLEN];
+  ::inet_ntop(AF_INET, &entry.peer_ip, ip, sizeof(ip));
+  batch_ += ip;
+  batch_ += " - - [";
+
+  auto second = entry.time_us / 1000000;
+  if (second != cached_second_) {
+    cached_second_ = second;
+    auto    time   = static_cast<std::time_t>(second);
+    std::tm tm{};
+    ::gmtime_r(&time, &tm);
+    char buf[32];
+    auto len = std::snprintf(buf, sizeof(buf), "%02d/%s/%04d:%02d:%02d:%02d +0000", tm.tm_mday, kMonths[tm.tm_mon],
+                             tm.tm_year + 1900, tm.tm_hour, tm.tm_min, tm.tm_sec);
+    cached_time_.assign(buf, len);
+  }
+  batch_ += cached_time_;
+  batch_ += "] \"";
+
+  std::string_view text{entry.text.data(), entry.text.size()};
+  batch_ += MethodName(entry.method);
+  batch_ += ' ';
+  AppendEscaped(batch_, text.substr(0, entry.target_len));
+  batch_ += ' ';
+  batch_ += VersionName(entry.version);
+  batch_ += "\" ";
+  AppendNumber(batch_, entry.status);
+  batch_ += ' ';
+  if (entry.bytes == 0) {
+    batch_ += '-';
+  } else {
+    AppendNumber(batch_, entry.bytes);
+  }
+  if (options_.format == AccessLogFormat::kCombined) {
+    batch_ += ' ';
+    AppendQuoted(batch_, text.substr(entry.target_len, entry.referer_len));
+    batch_ += ' ';
+    AppendQuoted(batch_, text.substr(entry.target_len + entry.referer_len, entry.agent_len));
+  }
+  batch_ += ' ';
+  AppendNumber(batch_, entry.duration_us);
+  batch_ += '\n';
+}
+
+}  // namespace simple_http::net::http
@@ -0,0 +1,96 @@
+/**
+ * @file access_log.hpp
+ * @author Qirui Wang (qirui.wang@moegi.waseda.jp)
+ * @brief Request log in Common or Combined Log Format, batched on a background thread
+ * @version 0.1
+ * @date 2023-02-15
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "net/http/http.hpp"
+#include "net/http/http_request.hpp"
+#include "net/inet_addr.hpp"
+#include "utils/log_sink.hpp"
+#include "utils/non_copyable.hpp"
+
+namespace simple_http::net::http {
+
+enum class AccessLogFormat {
+  kCommon,    // host - - [time] "request" status bytes duration_us
+  kCombined,  // kCommon followed by "referer" "user-agent", before the duration
+};
+
+struct AccessLogOptions {
+  AccessLogFormat           format{AccessLogFormat::kCombined};
+  std::size_t               ring_slots{4096};  // per loop thread, rounded up to a power of two
+  std::chrono::milliseconds flush_interval{std::chrono::seconds(1)};
+
+  // Once a loop's ring is half full only every n-th request is logged, 1 logs all until it is full.
+  uint32_t sample_under_load{1};
+};
+
+/**
+ * @brief Each loop thread copies the fields of a request into a fixed size slot of its own ring,
+ * which costs no lock, allocation or formatting. A background thread turns the slots into text
+ * and hands it to the sink in large batches.
+ *
+ */
+struct AccessLog : public util::NonCopyable {
+ public:
+  explicit AccessLog(std::unique_ptr<util::LogSink> sink, AccessLogOptions options = {});
+  ~AccessLog();
+
+  void Start();
+  void Stop();
+
+  void Record(InetAddr const& peer, HttpRequest const& req, StatusCode status, std::size_t bytes,
+              std::chrono::nanoseconds duration);
+
+  // Requests not logged because a ring was full, or skipped by sampling.
+  [[nodiscard]] uint64_t GetDropped() const { return dropped_.load(std::memory_order_relaxed); }
+  [[nodiscard]] uint64_t GetSampledOut() const { return sampled_out_.load(std::memory_order_relaxed); }
+
+ private:
+  struct Entry;
+  struct Ring;
+
+  static constexpr std::size_t kBatchSize = 256 * 1024;
+
+  uint64_t const                     id_;
+  std::unique_ptr<util::LogSink>     sink_;
+  AccessLogOptions                   options_;
+  std::atomic_uint64_t               dropped_{0};
+  std::atomic_uint64_t               sampled_out_{0};
+  std::atomic_bool                   running_{false};
+  std::thread                        thread_;
+  std::mutex                         mutex_;
+  std::condition_variable            cv_;
+  std::vector<std::shared_ptr<Ring>> rings_;
+
+  // Only used by the thread draining the rings.
+  std::string batch_;
+  int64_t     cached_second_{-1};
+  std::string cached_time_;
+
+  Ring& GetRing();
+  void  Run();
+  void  Drain();
+  void  Format(Entry const& entry);
+};
+
+}  // namespace simple_http::net::http
@@ -0,0 +1,109 @@
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <limits>
+
+#include "byte_range.hpp"
+
+namespace simple_http::net::http {
+
+namespace {
+std::string_view Trim(std::string_view s) {
+  while (!s.empty() && (s.front() == ' ' || s.front() == '\t')) {
+    s.remove_prefix(1);
+  }
+  while (!s.empty() && (s.back() == ' ' || s.back() == '\t')) {
+    s.remove_suffix(1);
+  }
+  return s;
+}
+
+// Digits only, values too large for size_t saturate.
+bool ParsePosition(std::string_view s, std::size_t& value) {
+  if (s.empty() || !std::all_of(s.begin(), s.end(), [](char c) { return c >= '0' && c <= '9'; })) {
+    return false;
+  }
+  if (std::from_chars(s.data(), s.data() + s.size(), value).ec != std::errc{}) {
+    value = std::numeric_limits<std::size_t>::max();
+  }
+  return true;
+}
+
+bool StartsWithBytesUnit(std::string_view field) {
+  constexpr std::string_view kUnit = "bytes=";
+  return field.size() >= kUnit.size() &&
+         std::equal(kUnit.begin(), kUnit.end(), field.begin(), [](char a, char b) { return a == ::tolower(b); });
+}
+}  // namespace
+
+RangeResult ParseRange(std::string_view field, std::size_t size, std::vector<ByteRange>& ranges,
+                       std::size_t max_ranges) {
+  ranges.clear();
+  field = Trim(field);
+  if (!StartsWithBytesUnit(field)) {
+    return RangeResult::kIgnored;
+  }
+  field.remove_prefix(6);
+
+  std::size_t count = 0;
+  while (!field.empty()) {
+    auto comma = field.find(',');
+    auto spec  = Trim(field.substr(0, comma));
+    field      = comma == std::string_view::npos ? std::string_view{} : field.substr(comma + 1);
+    if (spec.empty()) {
+      continue;  // empty list elements are allowed
+    }
+    if (++count > max_ranges) {
+      ranges.clear();
+      return RangeResult::kIgnored;
+    }
+
+    auto dash = spec.find('-');
+    if (dash == std::string_view::npos) {
+      ranges.clear();
+      return RangeResult::kIgnored;
+    }
+    auto        first_text = spec.substr(0, dash);
+    auto        last_text  = spec.substr(dash + 1);
+    std::size_t first      = 0;
+    std::size_t last       = 0;
+    if (first_text.empty()) {
+      // The final bytes, "-500" asks for the last 500.
+      if (!ParsePosition(last_text, last)) {
+        ranges.clear();
+        return RangeResult::kIgnored;
+      }
+      if (last > 0 && size > 0) {
+        ranges.push_back({size - std::min(last, size), size - 1});
+      }
+      continue;
+    }
+    if (!ParsePosition(first_text, first) || (!last_text.empty() && !ParsePosition(last_text, last)) ||
+        (!last_text.empty() && last < first)) {
+      ranges.clear();
+      return RangeResult::kIgnored;
+    }
+    if (first < size) {
+      ranges.push_back({first, last_text.empty() ? size - 1 : std::min(last, size - 1)});
+    }
+  }
+  if (count == 0) {
+    return RangeResult::kIgnored;
+  }
+  if (ranges.empty()) {
+    return RangeResult::kUnsatisfiable;
+  }
+
+  std::sort(ranges.begin(), ranges.end(), [](auto const& a, auto const& b) { return a.first < b.first; });
+  std::size_t merged = 0;
+  for (std::size_t i = 1; i < ranges.size(); ++i) {
+    if (ranges[i].first <= ranges[merged].last + 1) {
+      ranges[merged].last = std::max(ranges[merged].last, ranges[i].last);
+    } else {
+      ranges[++merged] = ranges[i];
+    }
+  }
+  ranges.resize(merged + 1);
+  return RangeResult::kSatisfiable;
+}
+}  // namespace simple_http::net::http
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+#include <vector>
+
+namespace simple_http::net::http {
+
+// Bytes first to last of a representation, both included as in the Range field.
+struct ByteRange {
+  std::size_t first{0};
+  std::size_t last{0};
+
+  [[nodiscard]] std::size_t GetLength() const { return last - first + 1; }
+
+  bool operator==(ByteRange const&) const = default;
+};
+
+enum class RangeResult {
+  kIgnored,        // no valid bytes range, the whole representation is sent
+  kSatisfiable,
+  kUnsatisfiable,  // answered with 416
+};
+
+// Requests for more ranges than this are answered with the whole representation.
+inline constexpr std::size_t kMaxRanges = 16;
+
+/**
+ * @brief Parse the Range field of a request for a representation of size bytes. The satisfiable
+ * ranges are clipped to the representation, sorted, and merged where they overlap or touch, so
+ * that no byte is sent twice.
+ *
+ */
+[[nodiscard]] RangeResult ParseRange(std::string_view field, std::size_t size, std::vector<ByteRange>& ranges,
+                                     std::size_t max_ranges = kMaxRanges);
+}  // namespace simple_http::net::http
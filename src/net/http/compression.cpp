@@ -0,0 +1,278 @@
+#include <array>
+#include <charconv>
+
+#include <unistd.h>
+#include <zlib.h>
+
+#include "compression.hpp"
+#include "utils/perfect_hash.hpp"
+
+namespace simple_http::net::http {
+
+namespace {
+constexpr int kGzipWindowBits    = 15 + 16;
+constexpr int kDeflateWindowBits = 15;
+
+std::string_view Trim(std::string_view s) {
+  auto begin = s.find_first_not_of(" \t");
+  if (begin == std::string_view::npos) {
+    return {};
+  }
+  return s.substr(begin, s.find_last_not_of(" \t") - begin + 1);
+}
+
+// The q-value of one element of Accept-Encoding, 1 if it has none.
+double Quality(std::string_view params) {
+  while (!params.empty()) {
+    auto end   = params.find(';');
+    auto param = Trim(params.substr(0, end));
+    params     = end == std::string_view::npos ? std::string_view{} : params.substr(end + 1);
+    if (param.size() > 2 && (param[0] == 'q' || param[0] == 'Q') && param[1] == '=') {
+      double q       = 0;
+      auto   value   = param.substr(2);
+      auto [ptr, ec] = std::from_chars(value.data(), value.data() + value.size(), q);
+      return ec == std::errc{} ? q : 0;
+    }
+  }
+  return 1;
+}
+
+constexpr std::array<std::string_view, 9> kCompressedApplicationTypes{
+    "application/zip",         "application/gzip",         "application/pdf",
+    "application/ogg",         "application/font-woff",    "application/font-woff2",
+    "application/x-font-woff", "application/octet-stream", "application/x-7z-compressed",
+};
+}  // namespace
+
+std::string_view EncodingName(ContentCoding coding) {
+  switch (coding) {
+    case ContentCoding::kGzip:
+      return "gzip";
+    case ContentCoding::kDeflate:
+      return "deflate";
+    default:
+      return "identity";
+  }
+}
+
+ContentCoding NegotiateEncoding(std::string_view accept_encoding) {
+  double gzip     = -1;
+  double deflate  = -1;
+  double wildcard = -1;
+  while (!accept_encoding.empty()) {
+    auto end        = accept_encoding.find(',');
+    auto element    = accept_encoding.substr(0, end);
+    accept_encoding = end == std::string_view::npos ? std::string_view{} : accept_encoding.substr(end + 1);
+
+    auto semicolon = element.find(';');
+    auto coding    = Trim(element.substr(0, semicolon));
+    auto q         = semicolon == std::string_view::npos ? 1.0 : Quality(element.substr(semicolon + 1));
+    if (util::EqualsIgnoreCase(coding, "gzip") || util::EqualsIgnoreCase(coding, "x-gzip")) {
+      gzip = q;
+    } else if (util::EqualsIgnoreCase(coding, "deflate")) {
+      deflate = q;
+    } else if (coding == "*") {
+      wildcard = q;
+    }
+  }
+  // Codings not listed are acceptable with the q-value of "*", if present.
+  if (gzip < 0) {
+    gzip = wildcard;
+  }
+  if (deflate < 0) {
+    deflate = wildcard;
+  }
+
+  if (gzip > 0 && gzip >= deflate) {
+    return ContentCoding::kGzip;
+  }
+  if (deflate > 0) {
+    return ContentCoding::kDeflate;
+  }
+  return ContentCoding::kIdentity;
+}
+
+bool IsCompressible(std::string_view content_type) {
+  auto type = Trim(content_type.substr(0, content_type.find(';')));
+  if (type.empty()) {
+    return false;
+  }
+  if (type.starts_with("text/") || type == "image/svg+xml") {
+    return true;
+  }
+  if (type.starts_with("image/") || type.starts_with("audio/") || type.starts_with("video/")) {
+    return false;
+  }
+  for (auto compressed : kCompressedApplicationTypes) {
+    if (util::EqualsIgnoreCase(type, compressed)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+struct Compressor::State {
+  explicit State(int window_bits) : window_bits(window_bits) {}
+  ~State() {
+    if (initialized) {
+      ::deflateEnd(&stream);
+    }
+  }
+
+  z_stream stream{};
+  int      window_bits;
+  int      level{Z_DEFAULT_COMPRESSION};
+  bool     initialized{false};
+
+  bool Begin(int new_level) {
+    if (!initialized) {
+      if (::deflateInit2(&stream, new_level, Z_DEFLATED, window_bits, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return false;
+      }
+      initialized = true;
+      level       = new_level;
+      return true;
+    }
+    if (::deflateReset(&stream) != Z_OK) {
+      return false;
+    }
+    if (new_level != level) {
+      if (::deflateParams(&stream, new_level, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return false;
+      }
+      level = new_level;
+    }
+    return true;
+  }
+};
+
+Compressor::~Compressor() = default;
+
+Compressor& Compressor::ForThisThread() {
+  thread_local Compressor compressor;
+  return compressor;
+}
+
+bool Compressor::Compress(ContentCoding coding, int level, std::string_view input, std::string& output) {
+  if (coding == ContentCoding::kIdentity) {
+    output.assign(input);
+    return true;
+  }
+  auto& state = coding == ContentCoding::kGzip ? gzip_ : deflate_;
+  if (!state) {
+    state = std::make_unique<State>(coding == ContentCoding::kGzip ? kGzipWindowBits : kDeflateWindowBits);
+  }
+  if (!state->Begin(level)) {
+    return false;
+  }
+
+  auto& stream = state->stream;
+  output.resize(::deflateBound(&stream, input.size()));
+  stream.next_in   = reinterpret_cast<Bytef*>(const_cast<char*>(input.data()));  // NOLINT
+  stream.avail_in  = static_cast<uInt>(input.size());
+  stream.next_out  = reinterpret_cast<Bytef*>(output.data());  // NOLINT
+  stream.avail_out = static_cast<uInt>(output.size());
+
+  // Feed the body in one go, the bound guarantees the output fits.
+  auto ret = ::deflate(&stream, Z_FINISH);
+  if (ret != Z_STREAM_END) {
+    return false;
+  }
+  output.resize(stream.total_out);
+  return true;
+}
+
+std::shared_ptr<std::string const> CompressedFileCache::Get(std::string const& path, std::time_t modified_time,
+                                                            std::size_t size) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto                        it = entries_.find(path);
+  if (it == entries_.end() || it->second.modified_time != modified_time || it->second.size != size) {
+    return nullptr;
+  }
+  return it->second.body;
+}
+
+void CompressedFileCache::Put(std::string const& path, std::time_t modified_time, std::size_t size,
+                              std::shared_ptr<std::string const> body) {
+  if (body->size() > capacity_) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (auto it = entries_.find(path); it != entries_.end()) {
+    used_ -= it->second.body->size();
+    entries_.erase(it);
+    std::erase(order_, path);
+  }
+  while (used_ + body->size() > capacity_ && !order_.empty()) {
+    auto it = entries_.find(order_.front());
+    used_   -= it->second.body->size();
+    entries_.erase(it);
+    order_.pop_front();
+  }
+  used_ += body->size();
+  order_.push_back(path);
+  entries_.emplace(path, Entry{modified_time, size, std::move(body)});
+}
+
+CompressedFileCache::~CompressedFileCache() {
+  {
+    std::lock_guard<std::mutex> lock(jobs_mutex_);
+    stopping_ = true;
+  }
+  jobs_cv_.notify_one();
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+}
+
+void CompressedFileCache::Fill(std::string const& path, std::shared_ptr<FileRange> file, int level) {
+  {
+    std::lock_guard<std::mutex> lock(jobs_mutex_);
+    if (stopping_ || !queued_.insert(path).second) {
+      return;
+    }
+    jobs_.push_back({path, std::move(file), level});
+    if (!thread_.joinable()) {
+      thread_ = std::thread([this] { Run(); });
+    }
+  }
+  jobs_cv_.notify_one();
+}
+
+void CompressedFileCache::Run() {
+  std::string content;
+  for (;;) {
+    Job job;
+    {
+      std::unique_lock<std::mutex> lock(jobs_mutex_);
+      jobs_cv_.wait(lock, [this] { return stopping_ || !jobs_.empty(); });
+      if (stopping_) {
+        return;
+      }
+      job = std::move(jobs_.front());
+      jobs_.pop_front();
+    }
+
+    auto const& file = *job.file;
+    content.resize(file.GetLength());
+    std::size_t done = 0;
+    while (done < content.size()) {
+      auto n = ::pread(file.GetFd(), content.data() + done, content.size() - done,
+                       file.GetOffset() + static_cast<off_t>(done));
+      if (n <= 0) {
+        break;
+      }
+      done += n;
+    }
+    std::string body;
+    if (done == content.size() &&
+        Compressor::ForThisThread().Compress(ContentCoding::kGzip, job.level, content, body)) {
+      Put(job.path, file.GetModifiedTime(), file.GetLength(), std::make_shared<std::string const>(std::move(body)));
+    }
+
+    std::lock_guard<std::mutex> lock(jobs_mutex_);
+    queued_.erase(job.path);
+  }
+}
+
+}  // namespace simple_http::net::http
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <ctime>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "net/file_range.hpp"
+#include "utils/non_copyable.hpp"
+
+namespace simple_http::net::http {
+
+enum class ContentCoding {
+  kIdentity,
+  kGzip,
+  kDeflate,
+};
+
+[[nodiscard]] std::string_view EncodingName(ContentCoding coding);
+
+/**
+ * @brief Pick the coding to answer a request with from its Accept-Encoding header, honouring
+ * q-values. gzip is preferred over deflate when both are equally acceptable.
+ *
+ */
+[[nodiscard]] ContentCoding NegotiateEncoding(std::string_view accept_encoding);
+
+// False for media types that are compressed already, such as images, audio, video and archives.
+[[nodiscard]] bool IsCompressible(std::string_view content_type);
+
+struct CompressionOptions {
+  std::size_t min_size{1024};  // smaller bodies are sent as they are
+  int         level{6};        // zlib level, 1 is fastest and 9 smallest
+
+  // Static files without a .gz sidecar are compressed once and kept, up to this many bytes in total.
+  std::size_t file_cache_bytes{32 * 1024 * 1024};
+  std::size_t max_cached_file{4 * 1024 * 1024};  // larger files are sent uncompressed
+};
+
+/**
+ * @brief zlib compressor for whole bodies, each is deflated in a single call. The deflate state is
+ * allocated once per thread and reset between bodies, so loops compress without setting up zlib for
+ * every response.
+ *
+ */
+struct Compressor : public util::NonCopyable {
+ public:
+  ~Compressor();
+
+  // The compressor of the calling thread.
+  static Compressor& ForThisThread();
+
+  /**
+   * @brief Compress input into output, replacing its contents.
+   *
+   * @return false if zlib failed, output is unspecified then
+   */
+  bool Compress(ContentCoding coding, int level, std::string_view input, std::string& output);
+
+ private:
+  struct State;
+
+  Compressor() = default;
+
+  std::unique_ptr<State> gzip_;
+  std::unique_ptr<State> deflate_;
+};
+
+/**
+ * @brief Gzip variants of static files, keyed by path and invalidated when the file changes.
+ * Shared by all loops, the oldest entries are evicted first once the cache is full. Files are
+ * compressed on a thread of the cache, a loop that misses sends the file uncompressed meanwhile.
+ *
+ */
+struct CompressedFileCache : public util::NonCopyable {
+ public:
+  explicit CompressedFileCache(std::size_t capacity) : capacity_(capacity) {}
+  ~CompressedFileCache();
+
+  // The cached body for the file as it is now, or nullptr.
+  [[nodiscard]] std::shared_ptr<std::string const> Get(std::string const& path, std::time_t modified_time,
+                                                       std::size_t size);
+  void Put(std::string const& path, std::time_t modified_time, std::size_t size,
+           std::shared_ptr<std::string const> body);
+
+  /**
+   * @brief Read and gzip the file on the cache's thread, then Put it under path. A path already
+   * waiting is not queued again.
+   *
+   */
+  void Fill(std::string const& path, std::shared_ptr<FileRange> file, int level);
+
+ private:
+  struct Entry {
+    std::time_t                        modified_time;
+    std::size_t                        size;
+    std::shared_ptr<std::string const> body;
+  };
+  struct Job {
+    std::string                path;
+    std::shared_ptr<FileRange> file;
+    int                        level;
+  };
+
+  void Run();
+
+  std::size_t const                      capacity_;
+  std::size_t                            used_{0};
+  std::mutex                             mutex_;
+  std::unordered_map<std::string, Entry> entries_;
+  std::deque<std::string>                order_;  // insertion order, for eviction
+
+  // Guarded by jobs_mutex_, the thread is started by the first Fill.
+  std::mutex                      jobs_mutex_;
+  std::condition_variable         jobs_cv_;
+  std::deque<Job>                 jobs_;
+  std::unordered_set<std::string> queued_;
+  bool                            stopping_{false};
+  std::thread                     thread_;
+};
+
+}  // namespace simple_http::net::http
@@ -0,0 +1,125 @@
+#include <array>
+
+#include "net/http/http_date.hpp"
+
+#include "conditional.hpp"
+
+namespace simple_http::net::http {
+
+namespace {
+// The fields a 304 repeats from the 200 it stands for.
+constexpr std::array<HeaderId, 7> kNotModifiedFields{
+    HeaderId::kCacheControl, HeaderId::kContentLocation, HeaderId::kDate,         HeaderId::kETag,
+    HeaderId::kExpires,      HeaderId::kLastModified,    HeaderId::kVary,
+};
+
+std::string_view Trim(std::string_view s) {
+  while (!s.empty() && (s.front() == ' ' || s.front() == '\t')) {
+    s.remove_prefix(1);
+  }
+  while (!s.empty() && (s.back() == ' ' || s.back() == '\t')) {
+    s.remove_suffix(1);
+  }
+  return s;
+}
+
+std::string_view Opaque(std::string_view etag) {
+  if (etag.starts_with("W/")) {
+    etag.remove_prefix(2);
+  }
+  return etag;
+}
+
+// Weak comparison of etag against the comma separated list of If-None-Match.
+bool ListMatches(std::string_view list, std::string_view etag) {
+  list = Trim(list);
+  if (list == "*") {
+    return true;
+  }
+  auto opaque = Opaque(etag);
+  while (!list.empty()) {
+    // Commas can only appear inside the quotes of an entity tag.
+    auto quote = list.find('"');
+    if (quote == std::string_view::npos) {
+      return false;
+    }
+    auto close = list.find('"', quote + 1);
+    if (close == std::string_view::npos) {
+      return false;
+    }
+    if (list.substr(quote, close - quote + 1) == opaque) {
+      return true;
+    }
+    list.remove_prefix(close + 1);
+  }
+  return false;
+}
+
+std::time_t LastModifiedOf(HttpResponse const& resp) {
+  auto field = resp.GetHeader(HeaderId::kLastModified);
+  return field.empty() ? 0 : ParseHttpDate(field).value_or(0);
+}
+}  // namespace
+
+std::string MakeETag(std::string_view token, bool weak) {
+  std::string etag = weak ? "W/\"" : "\"";
+  etag             += token;
+  etag             += '"';
+  return etag;
+}
+
+bool IsNotModified(HttpRequest const& req, std::string_view etag, std::time_t last_modified) {
+  if (req.GetMethod() != Method::kGet && req.GetMethod() != Method::kHead) {
+    return false;
+  }
+  if (auto if_none_match = req.GetHeaderView(HeaderId::kIfNoneMatch); !if_none_match.empty()) {
+    return !etag.empty() && ListMatches(if_none_match, etag);
+  }
+  auto if_modified_since = req.GetHeaderView(HeaderId::kIfModifiedSince);
+  if (if_modified_since.empty() || last_modified == 0) {
+    return false;
+  }
+  auto since = ParseHttpDate(if_modified_since);
+  return since && last_modified <= *since;
+}
+
+bool IsNotModified(HttpRequest const& req, HttpResponse const& resp) {
+  if (!req.HasHeader(HeaderId::kIfNoneMatch) && !req.HasHeader(HeaderId::kIfModifiedSince)) {
+    return false;
+  }
+  return IsNotModified(req, resp.GetHeader(HeaderId::kETag), LastModifiedOf(resp));
+}
+
+bool IfRangeMatches(HttpRequest const& req, std::string_view etag, std::time_t last_modified) {
+  auto if_range = Trim(req.GetHeaderView(HeaderId::kIfRange));
+  if (if_range.empty()) {
+    return true;
+  }
+  if (if_range.starts_with('"') || if_range.starts_with("W/")) {
+    return !etag.empty() && !etag.starts_with("W/") && if_range == etag;
+  }
+  auto date = ParseHttpDate(if_range);
+  return date && last_modified != 0 && *date == last_modified;
+}
+
+void SetNotModified(HttpResponse const& from, HttpResponse& to) {
+  to.SetStatusCode(StatusCode::k304NotModified);
+  to.SetStatusMessage("Not Modified");
+  to.SetBody("");
+  for (auto id : kNotModifiedFields) {
+    if (auto value = from.GetHeader(id); !value.empty()) {
+      to.SetHeader(id, value);
+    }
+  }
+}
+
+bool AnswerNotModified(HttpRequest const& req, HttpResponse& resp) {
+  if (resp.GetStatusCode() != StatusCode::k200Ok || !IsNotModified(req, resp)) {
+    return false;
+  }
+  HttpResponse head(resp.IsCloseConnection());
+  SetNotModified(resp, head);
+  resp = std::move(head);
+  return true;
+}
+}  // namespace simple_http::net::http
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <ctime>
+#include <string>
+#include <string_view>
+
+#include "net/http/http_request.hpp"
+#include "net/http/http_response.hpp"
+
+namespace simple_http::net::http {
+
+// The entity tag of a version token, "token" in quotes, prefixed with W/ if weak.
+[[nodiscard]] std::string MakeETag(std::string_view token, bool weak = false);
+
+/**
+ * @brief Whether a conditional GET asks for a representation the client holds already, judged by
+ * If-None-Match with weak comparison, or by If-Modified-Since if there is no If-None-Match. An
+ * empty etag or a zero last_modified means the representation has no such validator.
+ *
+ */
+[[nodiscard]] bool IsNotModified(HttpRequest const& req, std::string_view etag, std::time_t last_modified);
+// Like above, with the ETag and Last-Modified fields of resp.
+[[nodiscard]] bool IsNotModified(HttpRequest const& req, HttpResponse const& resp);
+
+// Whether the If-Range field of req, if any, still names the representation. Entity tags are
+// compared strongly, a date has to match Last-Modified exactly.
+[[nodiscard]] bool IfRangeMatches(HttpRequest const& req, std::string_view etag, std::time_t last_modified);
+
+// Make to the 304 revalidating from, it keeps only the fields a 304 carries and no body.
+void SetNotModified(HttpResponse const& from, HttpResponse& to);
+
+/**
+ * @brief Turn the 200 response to a GET into 304 Not Modified if its validators show the client's
+ * copy is current. A handler that sets its ETag or Last-Modified field first can skip building
+ * the body when this returns true, the server otherwise checks after the handler returned.
+ *
+ */
+bool AnswerNotModified(HttpRequest const& req, HttpResponse& resp);
+}  // namespace simple_http::net::http
@@ -0,0 +1,149 @@
+#include <algorithm>
+
+#include "event_stream.hpp"
+
+namespace simple_http::net::http {
+
+namespace {
+// Field values other than data end at the first line break.
+std::string_view FirstLine(std::string_view value) { return value.substr(0, value.find_first_of("\r\n")); }
+
+EventHub::Payload const& HeartbeatPayload() {
+  static EventHub::Payload const kHeartbeat = std::make_shared<std::string const>(":\n\n");
+  return kHeartbeat;
+}
+}  // namespace
+
+namespace sse {
+void AppendEvent(ServerSentEvent const& event, std::string& out) {
+  if (!event.event.empty()) {
+    out += "event: ";
+    out += FirstLine(event.event);
+    out += '\n';
+  }
+  if (!event.id.empty()) {
+    out += "id: ";
+    out += FirstLine(event.id);
+    out += '\n';
+  }
+  if (event.retry.count() > 0) {
+    out += "retry: ";
+    out += std::to_string(event.retry.count());
+    out += '\n';
+  }
+  auto data = event.data;
+  while (true) {
+    auto end  = data.find_first_of("\r\n");
+    out      += "data: ";
+    out      += data.substr(0, end);
+    out      += '\n';
+    if (end == std::string_view::npos) {
+      break;
+    }
+    // CRLF, a lone CR and LF all end a line for the client.
+    data.remove_prefix(end + (data.substr(end, 2) == "\r\n" ? 2 : 1));
+  }
+  out += '\n';
+}
+
+void Send(TcpConnection& conn, ServerSentEvent const& event) {
+  std::string out;
+  AppendEvent(event, out);
+  conn.Send(std::make_shared<std::string const>(std::move(out)));
+}
+}  // namespace sse
+
+void EventHub::Shard::Deliver(Payload const& payload) {
+  for (std::size_t i = 0; i < subscribers.size();) {
+    auto conn = subscribers[i].lock();
+    if (!conn || !conn->IsConnected()) {
+      subscribers[i] = std::move(subscribers.back());
+      subscribers.pop_back();
+      continue;
+    }
+    conn->Send(payload);
+    ++i;
+  }
+  count.store(subscribers.size(), std::memory_order_relaxed);
+}
+
+void EventHub::Publish(ServerSentEvent const& event) {
+  std::string out;
+  sse::AppendEvent(event, out);
+  Publish(std::make_shared<std::string const>(std::move(out)));
+}
+
+void EventHub::Publish(Payload payload) {
+  std::lock_guard lock(mutex_);
+  for (auto const& shard : shards_) {
+    if (shard->count.load(std::memory_order_relaxed) == 0) {
+      continue;
+    }
+    std::lock_guard shard_lock(shard->mutex);
+    if (shard->loop != nullptr) {
+      shard->loop->QueueInLoop([shard, payload] { shard->Deliver(payload); });
+    }
+  }
+}
+
+void EventHub::Subscribe(std::shared_ptr<TcpConnection> const& conn) {
+  auto shard = GetShard(conn->GetEventLoop());
+  shard->subscribers.push_back(conn);
+  shard->count.store(shard->subscribers.size(), std::memory_order_relaxed);
+}
+
+std::size_t EventHub::GetSubscriberCount() const {
+  std::lock_guard lock(mutex_);
+  std::size_t     count = 0;
+  for (auto const& shard : shards_) {
+    count += shard->count.load(std::memory_order_relaxed);
+  }
+  return count;
+}
+
+std::shared_ptr<EventHub::Shard> EventHub::GetShard(EventLoop* loop) {
+  std::lock_guard lock(mutex_);
+  auto it = std::find_if(shards_.begin(), shards_.end(), [loop](auto const& shard) {
+    std::lock_guard shard_lock(shard->mutex);
+    return shard->loop == loop;
+  });
+  if (it != shards_.end()) {
+    return *it;
+  }
+  // Shards of loops that quit, a new loop may have the address of an old one.
+  std::erase_if(shards_, [](auto const& shard) {
+    std::lock_guard shard_lock(shard->mutex);
+    return shard->loop == nullptr;
+  });
+  auto shard = std::make_shared<Shard>(loop);
+  shards_.push_back(shard);
+  // A retired loop is destroyed once it quits, events published later must not be queued to it.
+  loop->RunOnQuit([weak = std::weak_ptr<Shard>(shard)] {
+    if (auto shard = weak.lock(); shard) {
+      std::lock_guard shard_lock(shard->mutex);
+      shard->loop = nullptr;
+      shard->subscribers.clear();
+      shard->count.store(0, std::memory_order_relaxed);
+    }
+  });
+  if (options_.heartbeat.count() > 0) {
+    ScheduleHeartbeat(shard, options_.heartbeat);
+  }
+  return shard;
+}
+
+void EventHub::ScheduleHeartbeat(std::weak_ptr<Shard> const& shard, std::chrono::seconds interval) {
+  auto locked = shard.lock();
+  if (!locked) {
+    return;
+  }
+  // The timer only holds on to the shard weakly, it ends with the hub.
+  locked->loop->RunAfter(interval, [shard, interval] {
+    if (auto locked = shard.lock(); locked) {
+      locked->Deliver(HeartbeatPayload());
+      ScheduleHeartbeat(shard, interval);
+    }
+  });
+}
+
+}  // namespace simple_http::net::http
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "net/event_loop.hpp"
+#include "net/http/http_request.hpp"
+#include "net/tcp_connection.hpp"
+#include "utils/non_copyable.hpp"
+
+namespace simple_http::net::http {
+
+// An event of a text/event-stream, fields left empty are not sent.
+struct ServerSentEvent {
+  std::string_view          data;
+  std::string_view          event;
+  std::string_view          id;
+  std::chrono::milliseconds retry{0};  // reconnection delay asked of the client, zero leaves it
+};
+
+namespace sse {
+// Append the event in wire format, every line of data becomes a data field.
+void AppendEvent(ServerSentEvent const& event, std::string& out);
+
+// Send one event to a single subscriber, e.g. to catch it up after a reconnect.
+void Send(TcpConnection& conn, ServerSentEvent const& event);
+}  // namespace sse
+
+struct EventHubOptions {
+  // A comment is sent to subscribers this often so that proxies keep them open, zero turns it off.
+  std::chrono::seconds heartbeat{15};
+};
+
+/**
+ * @brief Fans events out to event stream subscribers. An event is serialized once into a buffer
+ * shared by all of them, and every loop with subscribers gets one task per event that queues the
+ * buffer to each of its connections without copying it.
+ *
+ * Publish can be called from any thread, Subscribe from the loop of the connection.
+ *
+ */
+struct EventHub : public util::NonCopyable {
+ public:
+  using Payload = std::shared_ptr<std::string const>;
+
+  explicit EventHub(EventHubOptions options = {}) : options_(options) {}
+
+  void Publish(ServerSentEvent const& event);
+  // Publish bytes that are in event stream format already.
+  void Publish(Payload payload);
+
+  void Subscribe(std::shared_ptr<TcpConnection> const& conn);
+
+  // Connections that were subscribed, closed ones leave with the next event sent to their loop.
+  [[nodiscard]] std::size_t GetSubscriberCount() const;
+
+ private:
+  // The subscribers on one loop, only touched in that loop.
+  struct Shard {
+    std::mutex                                mutex;
+    EventLoop*                                loop;  // guarded by mutex, reset by the loop when it quits
+    std::vector<std::weak_ptr<TcpConnection>> subscribers;
+    std::atomic<std::size_t>                  count{0};
+
+    explicit Shard(EventLoop* loop) : loop(loop) {}
+
+    void Deliver(Payload const& payload);
+  };
+
+  EventHubOptions                     options_;
+  mutable std::mutex                  mutex_;
+  std::vector<std::shared_ptr<Shard>> shards_;
+
+  std::shared_ptr<Shard> GetShard(EventLoop* loop);
+  static void            ScheduleHeartbeat(std::weak_ptr<Shard> const& shard, std::chrono::seconds interval);
+};
+
+using EventStreamOpenHandler = std::function<void(std::shared_ptr<TcpConnection> const&, HttpRequest const&)>;
+}  // namespace simple_http::net::http
@@ -0,0 +1,487 @@
+#include <algorithm>
+#include <array>
+#include <tuple>
+
+#include "hpack.hpp"
+
+namespace simple_http::net::http {
+
+namespace {
+constexpr std::size_t kEntryOverhead = 32;
+
+constexpr std::array<std::pair<std::string_view, std::string_view>, 61> kStaticTable{{
+    {":authority", ""},
+    {":method", "GET"},
+    {":method", "POST"},
+    {":path", "/"},
+    {":path", "/index.html"},
+    {":scheme", "http"},
+    {":scheme", "https"},
+    {":status", "200"},
+    {":status", "204"},
+    {":status", "206"},
+    {":status", "304"},
+    {":status", "400"},
+    {":status", "404"},
+    {":status", "500"},
+    {"accept-charset", ""},
+    {"accept-encoding", "gzip, deflate"},
+    {"accept-language", ""},
+    {"accept-ranges", ""},
+    {"accept", ""},
+    {"access-control-allow-origin", ""},
+    {"age", ""},
+    {"allow", ""},
+    {"authorization", ""},
+    {"cache-control", ""},
+    {"content-disposition", ""},
+    {"content-encoding", ""},
+    {"content-language", ""},
+    {"content-length", ""},
+    {"content-location", ""},
+    {"content-range", ""},
+    {"content-type", ""},
+    {"cookie", ""},
+    {"date", ""},
+    {"etag", ""},
+    {"expect", ""},
+    {"expires", ""},
+    {"from", ""},
+    {"host", ""},
+    {"if-match", ""},
+    {"if-modified-since", ""},
+    {"if-none-match", ""},
+    {"if-range", ""},
+    {"if-unmodified-since", ""},
+    {"last-modified", ""},
+    {"link", ""},
+    {"location", ""},
+    {"max-forwards", ""},
+    {"proxy-authenticate", ""},
+    {"proxy-authorization", ""},
+    {"range", ""},
+    {"referer", ""},
+    {"refresh", ""},
+    {"retry-after", ""},
+    {"server", ""},
+    {"set-cookie", ""},
+    {"strict-transport-security", ""},
+    {"transfer-encoding", ""},
+    {"user-agent", ""},
+    {"vary", ""},
+    {"via", ""},
+    {"www-authenticate", ""},
+}};
+
+struct HuffmanCode {
+  uint32_t code;
+  uint8_t  bits;
+};
+
+// Indexed by symbol, 256 is EOS.
+constexpr std::array<HuffmanCode, 257> kHuffmanCodes{{
+    {0x1ff8, 13}, {0x7fffd8, 23}, {0xfffffe2, 28}, {0xfffffe3, 28},
+    {0xfffffe4, 28}, {0xfffffe5, 28}, {0xfffffe6, 28}, {0xfffffe7, 28},
+    {0xfffffe8, 28}, {0xffffea, 24}, {0x3ffffffc, 30}, {0xfffffe9, 28},
+    {0xfffffea, 28}, {0x3ffffffd, 30}, {0xfffffeb, 28}, {0xfffffec, 28},
+    {0xfffffed, 28}, {0xfffffee, 28}, {0xfffffef, 28}, {0xffffff0, 28},
+    {0xffffff1, 28}, {0xffffff2, 28}, {0x3ffffffe, 30}, {0xffffff3, 28},
+    {0xffffff4, 28}, {0xffffff5, 28}, {0xffffff6, 28}, {0xffffff7, 28},
+    {0xffffff8, 28}, {0xffffff9, 28}, {0xffffffa, 28}, {0xffffffb, 28},
+    {0x14, 6}, {0x3f8, 10}, {0x3f9, 10}, {0xffa, 12},
+    {0x1ff9, 13}, {0x15, 6}, {0xf8, 8}, {0x7fa, 11},
+    {0x3fa, 10}, {0x3fb, 10}, {0xf9, 8}, {0x7fb, 11},
+    {0xfa, 8}, {0x16, 6}, {0x17, 6}, {0x18, 6},
+    {0x0, 5}, {0x1, 5}, {0x2, 5}, {0x19, 6},
+    {0x1a, 6}, {0x1b, 6}, {0x1c, 6}, {0x1d, 6},
+    {0x1e, 6}, {0x1f, 6}, {0x5c, 7}, {0xfb, 8},
+    {0x7ffc, 15}, {0x20, 6}, {0xffb, 12}, {0x3fc, 10},
+    {0x1ffa, 13}, {0x21, 6}, {0x5d, 7}, {0x5e, 7},
+    {0x5f, 7}, {0x60, 7}, {0x61, 7}, {0x62, 7},
+    {0x63, 7}, {0x64, 7}, {0x65, 7}, {0x66, 7},
+    {0x67, 7}, {0x68, 7}, {0x69, 7}, {0x6a, 7},
+    {0x6b, 7}, {0x6c, 7}, {0x6d, 7}, {0x6e, 7},
+    {0x6f, 7}, {0x70, 7}, {0x71, 7}, {0x72, 7},
+    {0xfc, 8}, {0x73, 7}, {0xfd, 8}, {0x1ffb, 13},
+    {0x7fff0, 19}, {0x1ffc, 13}, {0x3ffc, 14}, {0x22, 6},
+    {0x7ffd, 15}, {0x3, 5}, {0x23, 6}, {0x4, 5},
+    {0x24, 6}, {0x5, 5}, {0x25, 6}, {0x26, 6},
+    {0x27, 6}, {0x6, 5}, {0x74, 7}, {0x75, 7},
+    {0x28, 6}, {0x29, 6}, {0x2a, 6}, {0x7, 5},
+    {0x2b, 6}, {0x76, 7}, {0x2c, 6}, {0x8, 5},
+    {0x9, 5}, {0x2d, 6}, {0x77, 7}, {0x78, 7},
+    {0x79, 7}, {0x7a, 7}, {0x7b, 7}, {0x7ffe, 15},
+    {0x7fc, 11}, {0x3ffd, 14}, {0x1ffd, 13}, {0xffffffc, 28},
+    {0xfffe6, 20}, {0x3fffd2, 22}, {0xfffe7, 20}, {0xfffe8, 20},
+    {0x3fffd3, 22}, {0x3fffd4, 22}, {0x3fffd5, 22}, {0x7fffd9, 23},
+    {0x3fffd6, 22}, {0x7fffda, 23}, {0x7fffdb, 23}, {0x7fffdc, 23},
+    {0x7fffdd, 23}, {0x7fffde, 23}, {0xffffeb, 24}, {0x7fffdf, 23},
+    {0xffffec, 24}, {0xffffed, 24}, {0x3fffd7, 22}, {0x7fffe0, 23},
+    {0xffffee, 24}, {0x7fffe1, 23}, {0x7fffe2, 23}, {0x7fffe3, 23},
+    {0x7fffe4, 23}, {0x1fffdc, 21}, {0x3fffd8, 22}, {0x7fffe5, 23},
+    {0x3fffd9, 22}, {0x7fffe6, 23}, {0x7fffe7, 23}, {0xffffef, 24},
+    {0x3fffda, 22}, {0x1fffdd, 21}, {0xfffe9, 20}, {0x3fffdb, 22},
+    {0x3fffdc, 22}, {0x7fffe8, 23}, {0x7fffe9, 23}, {0x1fffde, 21},
+    {0x7fffea, 23}, {0x3fffdd, 22}, {0x3fffde, 22}, {0xfffff0, 24},
+    {0x1fffdf, 21}, {0x3fffdf, 22}, {0x7fffeb, 23}, {0x7fffec, 23},
+    {0x1fffe0, 21}, {0x1fffe1, 21}, {0x3fffe0, 22}, {0x1fffe2, 21},
+    {0x7fffed, 23}, {0x3fffe1, 22}, {0x7fffee, 23}, {0x7fffef, 23},
+    {0xfffea, 20}, {0x3fffe2, 22}, {0x3fffe3, 22}, {0x3fffe4, 22},
+    {0x7ffff0, 23}, {0x3fffe5, 22}, {0x3fffe6, 22}, {0x7ffff1, 23},
+    {0x3ffffe0, 26}, {0x3ffffe1, 26}, {0xfffeb, 20}, {0x7fff1, 19},
+    {0x3fffe7, 22}, {0x7ffff2, 23}, {0x3fffe8, 22}, {0x1ffffec, 25},
+    {0x3ffffe2, 26}, {0x3ffffe3, 26}, {0x3ffffe4, 26}, {0x7ffffde, 27},
+    {0x7ffffdf, 27}, {0x3ffffe5, 26}, {0xfffff1, 24}, {0x1ffffed, 25},
+    {0x7fff2, 19}, {0x1fffe3, 21}, {0x3ffffe6, 26}, {0x7ffffe0, 27},
+    {0x7ffffe1, 27}, {0x3ffffe7, 26}, {0x7ffffe2, 27}, {0xfffff2, 24},
+    {0x1fffe4, 21}, {0x1fffe5, 21}, {0x3ffffe8, 26}, {0x3ffffe9, 26},
+    {0xffffffd, 28}, {0x7ffffe3, 27}, {0x7ffffe4, 27}, {0x7ffffe5, 27},
+    {0xfffec, 20}, {0xfffff3, 24}, {0xfffed, 20}, {0x1fffe6, 21},
+    {0x3fffe9, 22}, {0x1fffe7, 21}, {0x1fffe8, 21}, {0x7ffff3, 23},
+    {0x3fffea, 22}, {0x3fffeb, 22}, {0x1ffffee, 25}, {0x1ffffef, 25},
+    {0xfffff4, 24}, {0xfffff5, 24}, {0x3ffffea, 26}, {0x7ffff4, 23},
+    {0x3ffffeb, 26}, {0x7ffffe6, 27}, {0x3ffffec, 26}, {0x3ffffed, 26},
+    {0x7ffffe7, 27}, {0x7ffffe8, 27}, {0x7ffffe9, 27}, {0x7ffffea, 27},
+    {0x7ffffeb, 27}, {0xffffffe, 28}, {0x7ffffec, 27}, {0x7ffffed, 27},
+    {0x7ffffee, 27}, {0x7ffffef, 27}, {0x7fffff0, 27}, {0x3ffffee, 26},
+    {0x3fffffff, 30},
+}};
+
+constexpr uint16_t kEos = 256;
+
+// Binary tree over the codes, leaves hold a symbol. Built once, walked a bit at a time.
+struct HuffmanTree {
+  struct Node {
+    std::array<int16_t, 2> children{-1, -1};
+    int16_t                symbol{-1};
+  };
+  std::vector<Node> nodes{1};
+
+  HuffmanTree() {
+    for (uint16_t symbol = 0; symbol < kHuffmanCodes.size(); ++symbol) {
+      auto [code, bits] = kHuffmanCodes[symbol];
+      std::size_t node  = 0;
+      for (int i = bits - 1; i >= 0; --i) {
+        auto bit = (code >> i) & 1;
+        if (nodes[node].children[bit] < 0) {
+          nodes[node].children[bit] = static_cast<int16_t>(nodes.size());
+          nodes.emplace_back();
+        }
+        node = nodes[node].children[bit];
+      }
+      nodes[node].symbol = static_cast<int16_t>(symbol);
+    }
+  }
+
+  static HuffmanTree const& Get() {
+    static HuffmanTree const tree;
+    return tree;
+  }
+};
+
+// Headers that differ between responses only pollute the dynamic table.
+bool ShouldIndex(std::string_view name, std::string_view value, std::size_t max_table_size) {
+  constexpr std::array<std::string_view, 7> kVolatile{"content-length", "date", "etag",         "last-modified",
+                                                      "set-cookie",     "age",  "content-range"};
+  if ((name.size() + value.size() + kEntryOverhead) * 4 > max_table_size) {
+    return false;
+  }
+  for (auto skip : kVolatile) {
+    if (name == skip) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool DecodeInteger(std::string_view& in, int prefix_bits, uint64_t& value) {
+  if (in.empty()) {
+    return false;
+  }
+  uint64_t const max = (1U << prefix_bits) - 1;
+  value              = static_cast<uint8_t>(in[0]) & max;
+  in.remove_prefix(1);
+  if (value < max) {
+    return true;
+  }
+  for (int shift = 0; shift <= 28; shift += 7) {
+    if (in.empty()) {
+      return false;
+    }
+    auto byte = static_cast<uint8_t>(in[0]);
+    in.remove_prefix(1);
+    value += static_cast<uint64_t>(byte & 0x7f) << shift;
+    if ((byte & 0x80) == 0) {
+      return true;
+    }
+  }
+  return false;  // longer than any size we accept
+}
+
+bool DecodeString(std::string_view& in, std::string& out) {
+  if (in.empty()) {
+    return false;
+  }
+  bool     huffman = (static_cast<uint8_t>(in[0]) & 0x80) != 0;
+  uint64_t length  = 0;
+  if (!DecodeInteger(in, 7, length) || length > in.size()) {
+    return false;
+  }
+  auto value = in.substr(0, length);
+  in.remove_prefix(length);
+  out.clear();
+  if (huffman) {
+    return hpack::HuffmanDecode(value, out);
+  }
+  out.assign(value);
+  return true;
+}
+}  // namespace
+
+namespace hpack {
+void EncodeInteger(uint64_t value, int prefix_bits, uint8_t first_byte, std::string& out) {
+  uint64_t const max = (1U << prefix_bits) - 1;
+  if (value < max) {
+    out += static_cast<char>(first_byte | value);
+    return;
+  }
+  out += static_cast<char>(first_byte | max);
+  value -= max;
+  while (value >= 0x80) {
+    out += static_cast<char>((value & 0x7f) | 0x80);
+    value >>= 7;
+  }
+  out += static_cast<char>(value);
+}
+
+void EncodeString(std::string_view value, std::string& out) {
+  auto huffman_size = HuffmanEncodedSize(value);
+  if (huffman_size < value.size()) {
+    EncodeInteger(huffman_size, 7, 0x80, out);
+    HuffmanEncode(value, out);
+  } else {
+    EncodeInteger(value.size(), 7, 0, out);
+    out += value;
+  }
+}
+
+std::size_t HuffmanEncodedSize(std::string_view value) {
+  std::size_t bits = 0;
+  for (auto c : value) {
+    bits += kHuffmanCodes[static_cast<uint8_t>(c)].bits;
+  }
+  return (bits + 7) / 8;
+}
+
+void HuffmanEncode(std::string_view value, std::string& out) {
+  uint64_t buffer = 0;
+  int      count  = 0;
+  for (auto c : value) {
+    auto [code, bits] = kHuffmanCodes[static_cast<uint8_t>(c)];
+    buffer            = (buffer << bits) | code;
+    count             += bits;
+    while (count >= 8) {
+      count -= 8;
+      out   += static_cast<char>(buffer >> count);
+    }
+  }
+  if (count > 0) {
+    // Pad with the most significant bits of EOS, which are all ones.
+    out += static_cast<char>((buffer << (8 - count)) | (0xff >> count));
+  }
+}
+
+bool HuffmanDecode(std::string_view value, std::string& out) {
+  auto const& nodes    = HuffmanTree::Get().nodes;
+  std::size_t node     = 0;
+  int         pending  = 0;  // bits read since the last symbol
+  bool        all_ones = true;
+  for (auto c : value) {
+    auto byte = static_cast<uint8_t>(c);
+    for (int i = 7; i >= 0; --i) {
+      auto bit = (byte >> i) & 1;
+      auto next = nodes[node].children[bit];
+      if (next < 0) {
+        return false;
+      }
+      node = next;
+      ++pending;
+      all_ones = all_ones && bit == 1;
+      if (auto symbol = nodes[node].symbol; symbol >= 0) {
+        if (symbol == kEos) {
+          return false;
+        }
+        out      += static_cast<char>(symbol);
+        node     = 0;
+        pending  = 0;
+        all_ones = true;
+      }
+    }
+  }
+  // Only a prefix of EOS shorter than a byte may be left over.
+  return pending < 8 && all_ones;
+}
+}  // namespace hpack
+
+void HpackDynamicTable::SetMaxSize(std::size_t max_size) {
+  max_size_ = max_size;
+  Evict(0);
+}
+
+void HpackDynamicTable::Add(std::string_view name, std::string_view value) {
+  auto size = name.size() + value.size() + kEntryOverhead;
+  if (size > max_size_) {
+    // An entry larger than the table empties it and is not added.
+    entries_.clear();
+    size_ = 0;
+    return;
+  }
+  Evict(size);
+  entries_.push_front({std::string{name}, std::string{value}});
+  size_ += size;
+}
+
+void HpackDynamicTable::Evict(std::size_t needed) {
+  while (!entries_.empty() && size_ + needed > max_size_) {
+    auto const& oldest = entries_.back();
+    size_              -= oldest.name.size() + oldest.value.size() + kEntryOverhead;
+    entries_.pop_back();
+  }
+}
+
+bool HpackDecoder::Lookup(uint64_t index, std::string_view& name, std::string_view& value) const {
+  if (index == 0) {
+    return false;
+  }
+  if (index <= kStaticTable.size()) {
+    std::tie(name, value) = kStaticTable[index - 1];
+    return true;
+  }
+  index -= kStaticTable.size() + 1;
+  if (index >= table_.GetCount()) {
+    return false;
+  }
+  name  = table_.Get(index).name;
+  value = table_.Get(index).value;
+  return true;
+}
+
+bool HpackDecoder::Decode(std::string_view block, std::vector<HeaderField>& headers) {
+  bool             field_seen = false;
+  std::string      name;
+  std::string      value;
+  std::string_view indexed_name;
+  std::string_view indexed_value;
+  while (!block.empty()) {
+    auto     first = static_cast<uint8_t>(block[0]);
+    uint64_t index = 0;
+
+    if ((first & 0x80) != 0) {
+      // Indexed header field
+      if (!DecodeInteger(block, 7, index) || !Lookup(index, indexed_name, indexed_value)) {
+        return false;
+      }
+      headers.push_back({std::string{indexed_name}, std::string{indexed_value}});
+      field_seen = true;
+      continue;
+    }
+
+    if ((first & 0xe0) == 0x20) {
+      // Dynamic table size update, only allowed before the first field of a block
+      uint64_t size = 0;
+      if (field_seen || !DecodeInteger(block, 5, size) || size > max_table_size_) {
+        return false;
+      }
+      table_.SetMaxSize(size);
+      continue;
+    }
+
+    // Literal header field, with incremental indexing, without indexing or never indexed
+    bool incremental = (first & 0xc0) == 0x40;
+    if (!DecodeInteger(block, incremental ? 6 : 4, index)) {
+      return false;
+    }
+    if (index == 0) {
+      if (!DecodeString(block, name)) {
+        return false;
+      }
+    } else if (Lookup(index, indexed_name, indexed_value)) {
+      name.assign(indexed_name);
+    } else {
+      return false;
+    }
+    if (!DecodeString(block, value)) {
+      return false;
+    }
+    if (incremental) {
+      table_.Add(name, value);
+    }
+    headers.push_back({std::move(name), std::move(value)});
+    field_seen = true;
+  }
+  return true;
+}
+
+void HpackEncoder::SetMaxTableSize(std::size_t max_size) {
+  // Never use more than the default, a larger table only costs us memory.
+  max_size              = std::min(max_size, kDefaultTableSize);
+  smallest_size_update_ = std::min(smallest_size_update_, max_size);
+  table_.SetMaxSize(max_size);
+}
+
+void HpackEncoder::Encode(std::vector<HeaderField> const& headers, std::string& out) {
+  if (smallest_size_update_ != SIZE_MAX) {
+    // If the size was lowered and raised again both have to be signalled (RFC 7541 4.2).
+    if (smallest_size_update_ < table_.GetMaxSize()) {
+      hpack::EncodeInteger(smallest_size_update_, 5, 0x20, out);
+    }
+    hpack::EncodeInteger(table_.GetMaxSize(), 5, 0x20, out);
+    smallest_size_update_ = SIZE_MAX;
+  }
+  for (auto const& field : headers) {
+    EncodeField(field.name, field.value, out);
+  }
+}
+
+void HpackEncoder::EncodeField(std::string_view name, std::string_view value, std::string& out) {
+  std::size_t name_index = 0;
+  for (std::size_t i = 0; i < kStaticTable.size(); ++i) {
+    if (kStaticTable[i].first == name) {
+      if (kStaticTable[i].second == value) {
+        hpack::EncodeInteger(i + 1, 7, 0x80, out);
+        return;
+      }
+      if (name_index == 0) {
+        name_index = i + 1;
+      }
+    }
+  }
+  for (std::size_t i = 0; i < table_.GetCount(); ++i) {
+    auto const& entry = table_.Get(i);
+    if (entry.name == name) {
+      if (entry.value == value) {
+        hpack::EncodeInteger(kStaticTable.size() + 1 + i, 7, 0x80, out);
+        return;
+      }
+      if (name_index == 0) {
+        name_index = kStaticTable.size() + 1 + i;
+      }
+    }
+  }
+
+  bool index = ShouldIndex(name, value, table_.GetMaxSize());
+  if (index) {
+    hpack::EncodeInteger(name_index, 6, 0x40, out);
+  } else {
+    hpack::EncodeInteger(name_index, 4, 0x00, out);
+  }
+  if (name_index == 0) {
+    hpack::EncodeString(name, out);
+  }
+  hpack::EncodeString(value, out);
+  if (index) {
+    table_.Add(name, value);
+  }
+}
+
+}  // namespace simple_http::net::http
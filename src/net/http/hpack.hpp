@@ -0,0 +1,103 @@
+/**
+ * @file hpack.hpp
+ * @author Qirui Wang (qirui.wang@moegi.waseda.jp)
+ * @brief HPACK header compression for HTTP/2 (RFC 7541)
+ * @version 0.1
+ * @date 2023-02-17
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "utils/non_copyable.hpp"
+
+namespace simple_http::net::http {
+
+struct HeaderField {
+  std::string name;
+  std::string value;
+};
+
+/**
+ * @brief Entries added by header blocks, newest first. An entry costs its name and value plus 32
+ * bytes, the oldest entries are evicted to stay within the maximum size.
+ *
+ */
+struct HpackDynamicTable {
+ public:
+  explicit HpackDynamicTable(std::size_t max_size) : max_size_(max_size) {}
+
+  [[nodiscard]] std::size_t GetMaxSize() const { return max_size_; }
+  [[nodiscard]] std::size_t GetSize() const { return size_; }
+  [[nodiscard]] std::size_t GetCount() const { return entries_.size(); }
+
+  // index 0 is the newest entry
+  [[nodiscard]] HeaderField const& Get(std::size_t index) const { return entries_[index]; }
+
+  void SetMaxSize(std::size_t max_size);
+  void Add(std::string_view name, std::string_view value);
+
+ private:
+  std::size_t             max_size_;
+  std::size_t             size_{0};
+  std::deque<HeaderField> entries_;
+
+  void Evict(std::size_t needed);
+};
+
+struct HpackDecoder : public util::NonCopyable {
+ public:
+  explicit HpackDecoder(std::size_t max_table_size = 4096) : table_(max_table_size), max_table_size_(max_table_size) {}
+
+  /**
+   * @brief Decode a complete header block and append its fields to headers.
+   *
+   * @return false on a compression error, the connection can't be used after that
+   */
+  [[nodiscard]] bool Decode(std::string_view block, std::vector<HeaderField>& headers);
+
+ private:
+  HpackDynamicTable table_;
+  std::size_t       max_table_size_;  // the limit we announced, size updates may not exceed it
+
+  [[nodiscard]] bool Lookup(uint64_t index, std::string_view& name, std::string_view& value) const;
+};
+
+struct HpackEncoder : public util::NonCopyable {
+ public:
+  static constexpr std::size_t kDefaultTableSize = 4096;
+
+  HpackEncoder() = default;
+
+  // The limit the peer announced. Takes effect with a size update at the start of the next block.
+  void SetMaxTableSize(std::size_t max_size);
+
+  void Encode(std::vector<HeaderField> const& headers, std::string& out);
+
+ private:
+  HpackDynamicTable table_{kDefaultTableSize};
+  std::size_t       smallest_size_update_{SIZE_MAX};  // since the last block, SIZE_MAX if unchanged
+
+  void EncodeField(std::string_view name, std::string_view value, std::string& out);
+};
+
+namespace hpack {
+void EncodeInteger(uint64_t value, int prefix_bits, uint8_t first_byte, std::string& out);
+void EncodeString(std::string_view value, std::string& out);
+
+// Huffman code of RFC 7541 Appendix B.
+[[nodiscard]] std::size_t HuffmanEncodedSize(std::string_view value);
+void                      HuffmanEncode(std::string_view value, std::string& out);
+[[nodiscard]] bool        HuffmanDecode(std::string_view value, std::string& out);
+}  // namespace hpack
+
+}  // namespace simple_http::net::http
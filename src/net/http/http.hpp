@@ -1,13 +1,18 @@
 #pragma once
 
 #include <algorithm>
+#include <array>
 #include <chrono>
+#include <cstdint>
 #include <map>
 #include <sstream>
+#include <string>
 #include <string_view>
 
 #include <cctype>
 
+#include "utils/perfect_hash.hpp"
+
 namespace simple_http::net::http {
 using Timepoint = std::chrono::steady_clock::time_point;
 
@@ -30,26 +35,21 @@ inline static constexpr auto MethodName(Method method) {
   }
 }
 
+inline constexpr auto kMethods = util::MakePerfectHashMap<Method>({
+    {"GET", Method::kGet},
+    {"POST", Method::kPost},
+    {"HEAD", Method::kHead},
+    {"PUT", Method::kPut},
+    {"DELETE", Method::kDelete},
+});
+
+// Method tokens are case-sensitive.
 inline static constexpr Method ParseMethod(std::string_view method) {
-  if (method == "GET") {
-    return Method::kGet;
-  }
-  if (method == "POST") {
-    return Method::kPost;
-  }
-  if (method == "HEAD") {
-    return Method::kHead;
-  }
-  if (method == "PUT") {
-    return Method::kPut;
-  }
-  if (method == "DELETE") {
-    return Method::kDelete;
-  }
-  return Method::kInvalid;
+  auto const* found = kMethods.Find(method);
+  return found != nullptr ? *found : Method::kInvalid;
 }
 
-enum class Version { kUnknown, kHttp10, kHttp11 };
+enum class Version { kUnknown, kHttp10, kHttp11, kHttp2 };
 
 inline static constexpr auto VersionName(Version version) {
   switch (version) {
@@ -57,6 +57,8 @@ inline static constexpr auto VersionName(Version version) {
       return "HTTP/1.0";
     case Version::kHttp11:
       return "HTTP/1.1";
+    case Version::kHttp2:
+      return "HTTP/2.0";
     default:
       return "UNKNOWN";
   }
@@ -73,34 +75,385 @@ inline static constexpr Version ParseVersion(std::string_view version) {
 }
 
 enum class StatusCode {
-  kUnknown             = 0,
-  k200Ok               = 200,
-  k301MovedPermanently = 301,
-  k400BadRequest       = 400,
-  k404NotFound         = 404,
-  k501NotImplemented   = 501
+  kUnknown                = 0,
+  k101SwitchingProtocols  = 101,
+  k200Ok                  = 200,
+  k206PartialContent      = 206,
+  k301MovedPermanently    = 301,
+  k304NotModified         = 304,
+  k400BadRequest          = 400,
+  k404NotFound            = 404,
+  k411LengthRequired      = 411,
+  k416RangeNotSatisfiable = 416,
+  k426UpgradeRequired     = 426,
+  k500InternalError       = 500,
+  k501NotImplemented      = 501,
+  k502BadGateway          = 502,
+  k503ServiceUnavailable  = 503,
+  k504GatewayTimeout      = 504
 };
 
+namespace detail {
+// Reason phrases of the status codes of RFC 9110 and a few widespread ones.
+inline constexpr std::pair<int, std::string_view> kReasonPhrases[]{
+    {100, "Continue"},
+    {101, "Switching Protocols"},
+    {200, "OK"},
+    {201, "Created"},
+    {202, "Accepted"},
+    {203, "Non-Authoritative Information"},
+    {204, "No Content"},
+    {205, "Reset Content"},
+    {206, "Partial Content"},
+    {300, "Multiple Choices"},
+    {301, "Moved Permanently"},
+    {302, "Found"},
+    {303, "See Other"},
+    {304, "Not Modified"},
+    {307, "Temporary Redirect"},
+    {308, "Permanent Redirect"},
+    {400, "Bad Request"},
+    {401, "Unauthorized"},
+    {402, "Payment Required"},
+    {403, "Forbidden"},
+    {404, "Not Found"},
+    {405, "Method Not Allowed"},
+    {406, "Not Acceptable"},
+    {407, "Proxy Authentication Required"},
+    {408, "Request Timeout"},
+    {409, "Conflict"},
+    {410, "Gone"},
+    {411, "Length Required"},
+    {412, "Precondition Failed"},
+    {413, "Content Too Large"},
+    {414, "URI Too Long"},
+    {415, "Unsupported Media Type"},
+    {416, "Range Not Satisfiable"},
+    {417, "Expectation Failed"},
+    {421, "Misdirected Request"},
+    {422, "Unprocessable Content"},
+    {426, "Upgrade Required"},
+    {428, "Precondition Required"},
+    {429, "Too Many Requests"},
+    {431, "Request Header Fields Too Large"},
+    {500, "Internal Server Error"},
+    {501, "Not Implemented"},
+    {502, "Bad Gateway"},
+    {503, "Service Unavailable"},
+    {504, "Gateway Timeout"},
+    {505, "HTTP Version Not Supported"},
+};
+
+inline constexpr int         kFirstStatus = 100;
+inline constexpr std::size_t kStatusCount = 500;
+
+// Every HTTP/1.1 status line of the phrases in one buffer, and where each code's begins. Codes are
+// their own perfect hash, the index is the code less 100.
+struct StatusLines {
+  static constexpr std::size_t kSize = [] {
+    std::size_t size = 0;
+    for (auto const& [code, phrase] : kReasonPhrases) {
+      size += std::string_view{"HTTP/1.1 200 \r\n"}.size() + phrase.size();
+    }
+    return size;
+  }();
+
+  std::array<char, kSize>               text{};
+  std::array<uint16_t, kStatusCount>    begin{};
+  std::array<uint8_t, kStatusCount>     line_size{};
+  std::array<uint8_t, kStatusCount>     phrase_size{};
+
+  consteval StatusLines() {
+    std::size_t at     = 0;
+    auto        append = [&](std::string_view part) {
+      for (auto c : part) {
+        text[at++] = c;
+      }
+    };
+    for (auto const& [code, phrase] : kReasonPhrases) {
+      auto index   = static_cast<std::size_t>(code - kFirstStatus);
+      begin[index] = static_cast<uint16_t>(at);
+      append("HTTP/1.1 ");
+      char digits[] = {static_cast<char>('0' + code / 100), static_cast<char>('0' + code / 10 % 10),
+                       static_cast<char>('0' + code % 10), ' '};
+      append({digits, sizeof(digits)});
+      append(phrase);
+      append("\r\n");
+      line_size[index]   = static_cast<uint8_t>(at - begin[index]);
+      phrase_size[index] = static_cast<uint8_t>(phrase.size());
+    }
+  }
+};
+
+inline constexpr StatusLines kStatusLines;
+}  // namespace detail
+
+// The reason phrase of a status code, empty for codes without one.
+inline constexpr std::string_view ReasonPhrase(StatusCode code) {
+  auto index = static_cast<std::size_t>(static_cast<int>(code) - detail::kFirstStatus);
+  if (index >= detail::kStatusCount) {
+    return {};
+  }
+  auto const& lines = detail::kStatusLines;
+  // The phrase ends the line, before the CRLF.
+  return {lines.text.data() + lines.begin[index] + lines.line_size[index] - 2 - lines.phrase_size[index],
+          lines.phrase_size[index]};
+}
+
+// "HTTP/1.1 <code> <phrase>\r\n" of a status code, empty for codes without a phrase.
+inline constexpr std::string_view StatusLine(StatusCode code) {
+  auto index = static_cast<std::size_t>(static_cast<int>(code) - detail::kFirstStatus);
+  if (index >= detail::kStatusCount) {
+    return {};
+  }
+  auto const& lines = detail::kStatusLines;
+  return {lines.text.data() + lines.begin[index], lines.line_size[index]};
+}
+
+// Header fields known by the server, each has a slot in the fields of requests and responses.
+enum class HeaderId : uint8_t {
+  kAccept,
+  kAcceptEncoding,
+  kAcceptLanguage,
+  kAcceptRanges,
+  kAuthorization,
+  kCacheControl,
+  kConnection,
+  kContentEncoding,
+  kContentLength,
+  kContentLocation,
+  kContentRange,
+  kContentType,
+  kCookie,
+  kDate,
+  kETag,
+  kExpect,
+  kExpires,
+  kHost,
+  kHttp2Settings,
+  kIfMatch,
+  kIfModifiedSince,
+  kIfNoneMatch,
+  kIfRange,
+  kIfUnmodifiedSince,
+  kKeepAlive,
+  kLastEventId,
+  kLastModified,
+  kLocation,
+  kOrigin,
+  kPragma,
+  kProxyConnection,
+  kRange,
+  kReferer,
+  kSecWebSocketAccept,
+  kSecWebSocketExtensions,
+  kSecWebSocketKey,
+  kSecWebSocketProtocol,
+  kSecWebSocketVersion,
+  kServer,
+  kSetCookie,
+  kTe,
+  kTrailer,
+  kTransferEncoding,
+  kUpgrade,
+  kUserAgent,
+  kVary,
+  kXForwardedFor,
+  kXForwardedProto,
+  kXRequestId,
+  kUnknown,  // not one of the above, also their count
+};
+
+inline constexpr auto kHeaderIdCount = static_cast<std::size_t>(HeaderId::kUnknown);
+
+// Canonical names, in the order of HeaderId.
+inline constexpr std::array<std::string_view, kHeaderIdCount> kHeaderNames{
+    "Accept",
+    "Accept-Encoding",
+    "Accept-Language",
+    "Accept-Ranges",
+    "Authorization",
+    "Cache-Control",
+    "Connection",
+    "Content-Encoding",
+    "Content-Length",
+    "Content-Location",
+    "Content-Range",
+    "Content-Type",
+    "Cookie",
+    "Date",
+    "ETag",
+    "Expect",
+    "Expires",
+    "Host",
+    "HTTP2-Settings",
+    "If-Match",
+    "If-Modified-Since",
+    "If-None-Match",
+    "If-Range",
+    "If-Unmodified-Since",
+    "Keep-Alive",
+    "Last-Event-ID",
+    "Last-Modified",
+    "Location",
+    "Origin",
+    "Pragma",
+    "Proxy-Connection",
+    "Range",
+    "Referer",
+    "Sec-WebSocket-Accept",
+    "Sec-WebSocket-Extensions",
+    "Sec-WebSocket-Key",
+    "Sec-WebSocket-Protocol",
+    "Sec-WebSocket-Version",
+    "Server",
+    "Set-Cookie",
+    "TE",
+    "Trailer",
+    "Transfer-Encoding",
+    "Upgrade",
+    "User-Agent",
+    "Vary",
+    "X-Forwarded-For",
+    "X-Forwarded-Proto",
+    "X-Request-ID",
+};
+
+inline constexpr auto kHeaderIds = util::PerfectHashMap<HeaderId, kHeaderIdCount, true>([] {
+  std::array<std::pair<std::string_view, HeaderId>, kHeaderIdCount> entries{};
+  for (std::size_t i = 0; i < kHeaderIdCount; ++i) {
+    entries[i] = {kHeaderNames[i], static_cast<HeaderId>(i)};
+  }
+  return entries;
+}());
+
+inline constexpr std::string_view HeaderName(HeaderId id) { return kHeaderNames[static_cast<std::size_t>(id)]; }
+
+// The id of a field name in any case, kUnknown if the server does not know it.
+inline constexpr HeaderId FindHeaderId(std::string_view name) {
+  auto const* found = kHeaderIds.Find(name);
+  return found != nullptr ? *found : HeaderId::kUnknown;
+}
+
 struct Ci {
+  using is_transparent = void;
+
   bool operator()(std::string_view s1, std::string_view s2) const {
-    return std::lexicographical_compare(
-        s1.begin(), s1.end(), s2.begin(), s2.end(),
-        [](unsigned char c1, unsigned char c2) { return ::tolower(c1) < ::tolower(c2); });
+    return std::lexicographical_compare(s1.begin(), s1.end(), s2.begin(), s2.end(), [](char c1, char c2) {
+      return static_cast<unsigned char>(util::AsciiLower(c1)) < static_cast<unsigned char>(util::AsciiLower(c2));
+    });
   }
 };
 
 using Headers = std::map<std::string, std::string, Ci>;
 
-inline constexpr bool HasCrlf(std::string_view s) {
-  // return s.find('\r') != std::string_view::npos || s.find('\n') != std::string_view::npos;
-  auto const* p = s.data();
-  while (*p != 0) {
-    if (*p == '\r' || *p == '\n') {
-      return true;
+/**
+ * @brief Header fields by name in any case. The values of well-known fields are also kept in a
+ * slot per HeaderId, so looking them up by id, or by a name the perfect hash resolves, skips the
+ * map.
+ *
+ */
+struct HeaderFields {
+ public:
+  HeaderFields() = default;
+  explicit HeaderFields(Headers fields) : fields_(std::move(fields)) { Reindex(); }
+
+  // Slots point into the nodes of the map, a copy has to point into its own.
+  HeaderFields(HeaderFields const& that) : fields_(that.fields_) { Reindex(); }
+  HeaderFields(HeaderFields&& that) noexcept : fields_(std::move(that.fields_)), known_(that.known_) {
+    that.fields_.clear();
+    that.known_.fill(nullptr);
+  }
+  HeaderFields& operator=(HeaderFields const& that) {
+    if (this != &that) {
+      fields_ = that.fields_;
+      Reindex();
+    }
+    return *this;
+  }
+  HeaderFields& operator=(HeaderFields&& that) noexcept {
+    if (this != &that) {
+      fields_ = std::move(that.fields_);
+      known_  = that.known_;
+      that.fields_.clear();
+      that.known_.fill(nullptr);
+    }
+    return *this;
+  }
+
+  [[nodiscard]] Headers const& GetMap() const { return fields_; }
+
+  [[nodiscard]] std::string const* Find(HeaderId id) const { return known_[static_cast<std::size_t>(id)]; }
+  [[nodiscard]] std::string const* Find(std::string_view name) const {
+    if (auto id = FindHeaderId(name); id != HeaderId::kUnknown) {
+      return Find(id);
+    }
+    auto it = fields_.find(name);
+    return it != fields_.end() ? &it->second : nullptr;
+  }
+
+  // Add a field unless there is one of the name already.
+  void Add(std::string_view name, std::string_view value) {
+    auto [it, added] = fields_.emplace(name, value);
+    if (added) {
+      Index(it);
     }
-    p++;
   }
-  return false;
+
+  void Set(std::string_view name, std::string_view value) {
+    auto [it, added] = fields_.insert_or_assign(std::string{name}, std::string{value});
+    if (added) {
+      Index(it);
+    }
+  }
+  void Set(HeaderId id, std::string_view value) {
+    if (auto* slot = known_[static_cast<std::size_t>(id)]; slot != nullptr) {
+      *slot = value;
+      return;
+    }
+    Set(HeaderName(id), value);
+  }
+
+  void Remove(std::string_view name) {
+    if (auto it = fields_.find(name); it != fields_.end()) {
+      if (auto id = FindHeaderId(name); id != HeaderId::kUnknown) {
+        known_[static_cast<std::size_t>(id)] = nullptr;
+      }
+      fields_.erase(it);
+    }
+  }
+  void Remove(HeaderId id) {
+    if (known_[static_cast<std::size_t>(id)] != nullptr) {
+      Remove(HeaderName(id));
+    }
+  }
+
+  void Swap(HeaderFields& that) {
+    fields_.swap(that.fields_);
+    known_.swap(that.known_);
+  }
+
+ private:
+  Headers                                   fields_;
+  std::array<std::string*, kHeaderIdCount> known_{};
+
+  void Index(Headers::iterator it) {
+    if (auto id = FindHeaderId(it->first); id != HeaderId::kUnknown) {
+      known_[static_cast<std::size_t>(id)] = &it->second;
+    }
+  }
+
+  void Reindex() {
+    known_.fill(nullptr);
+    for (auto it = fields_.begin(); it != fields_.end(); ++it) {
+      Index(it);
+    }
+  }
+};
+
+inline constexpr bool HasCrlf(std::string_view s) {
+  // Only look inside the view, header views point into the middle of the read buffer.
+  return s.find_first_of("\r\n") != std::string_view::npos;
 }
 
 inline static constexpr auto kCrlf = "\r\n";
@@ -109,15 +462,14 @@ inline constexpr bool EnsureHeadingSlash(std::string_view& s) {
   if (s.empty()) {
     return false;
   }
-  int i = 0;
-  while (s[i] == '/') {
+  size_t i = 0;
+  while (i < s.size() && s[i] == '/') {
     i++;
   }
   if (i > 1) {
     s.remove_prefix(i - 1);
-    return true;
   }
-  return false;
+  return i > 0;
 }
 
 inline constexpr void RemoveTrailingSlash(std::string_view& s) {
@@ -139,7 +491,7 @@ inline auto NormalizePath(std::string_view path) {
   return ss.str();
 }
 
-const std::map<std::string, std::string> kMimeTypes{
+inline constexpr auto kMimeTypes = util::MakePerfectHashMap<std::string_view, true>({
     {".txt", "text/plain"},
     {".html", "text/html"},
     {".css", "text/css"},
@@ -193,9 +545,12 @@ const std::map<std::string, std::string> kMimeTypes{
     {".ogm", "video/ogg"},
     {".oga", "audio/ogg"},
     {".ogg", "audio/ogg"},
-    {".ogx", "application/ogg"},
-    {".ogm", "video/ogg"},
-    {".oga", "audio/oga"},
-};
+});
+
+// The media type of a file extension with its dot in any case, empty for unknown extensions.
+inline constexpr std::string_view FindMimeType(std::string_view extension) {
+  auto const* found = kMimeTypes.Find(extension);
+  return found != nullptr ? *found : std::string_view{};
+}
 
 }  // namespace simple_http::net::http
\ No newline at end of file
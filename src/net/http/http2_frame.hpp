@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace simple_http::net::http {
+
+// Sent by a client first on every HTTP/2 connection.
+constexpr std::string_view kHttp2Preface = "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
+
+enum class Http2FrameType : uint8_t {
+  kData         = 0x0,
+  kHeaders      = 0x1,
+  kPriority     = 0x2,
+  kRstStream    = 0x3,
+  kSettings     = 0x4,
+  kPushPromise  = 0x5,
+  kPing         = 0x6,
+  kGoaway       = 0x7,
+  kWindowUpdate = 0x8,
+  kContinuation = 0x9,
+};
+
+enum class Http2Error : uint32_t {
+  kNoError            = 0x0,
+  kProtocolError      = 0x1,
+  kInternalError      = 0x2,
+  kFlowControlError   = 0x3,
+  kSettingsTimeout    = 0x4,
+  kStreamClosed       = 0x5,
+  kFrameSizeError     = 0x6,
+  kRefusedStream      = 0x7,
+  kCancel             = 0x8,
+  kCompressionError   = 0x9,
+  kConnectError       = 0xa,
+  kEnhanceYourCalm    = 0xb,
+  kInadequateSecurity = 0xc,
+  kHttp11Required     = 0xd,
+};
+
+enum class Http2Setting : uint16_t {
+  kHeaderTableSize      = 0x1,
+  kEnablePush           = 0x2,
+  kMaxConcurrentStreams = 0x3,
+  kInitialWindowSize    = 0x4,
+  kMaxFrameSize         = 0x5,
+  kMaxHeaderListSize    = 0x6,
+};
+
+namespace http2 {
+constexpr uint8_t kFlagEndStream  = 0x1;
+constexpr uint8_t kFlagAck        = 0x1;
+constexpr uint8_t kFlagEndHeaders = 0x4;
+constexpr uint8_t kFlagPadded     = 0x8;
+constexpr uint8_t kFlagPriority   = 0x20;
+
+constexpr uint32_t kDefaultWindowSize   = 65535;
+constexpr uint32_t kMaxWindowSize       = 0x7fffffff;
+constexpr uint32_t kDefaultMaxFrameSize = 16384;
+constexpr uint32_t kMaxMaxFrameSize     = (1U << 24) - 1;
+constexpr uint16_t kDefaultWeight       = 16;
+
+inline uint32_t ReadUint32(char const* p) {
+  return (static_cast<uint32_t>(static_cast<uint8_t>(p[0])) << 24) |
+         (static_cast<uint32_t>(static_cast<uint8_t>(p[1])) << 16) |
+         (static_cast<uint32_t>(static_cast<uint8_t>(p[2])) << 8) | static_cast<uint32_t>(static_cast<uint8_t>(p[3]));
+}
+
+inline void AppendUint32(uint32_t value, std::string& out) {
+  out += static_cast<char>(value >> 24);
+  out += static_cast<char>(value >> 16);
+  out += static_cast<char>(value >> 8);
+  out += static_cast<char>(value);
+}
+}  // namespace http2
+
+struct Http2FrameHeader {
+  static constexpr std::size_t kSize = 9;
+
+  uint32_t       length{0};
+  Http2FrameType type{Http2FrameType::kData};
+  uint8_t        flags{0};
+  uint32_t       stream_id{0};
+
+  // p must point to kSize bytes.
+  static Http2FrameHeader Parse(char const* p) {
+    return {
+        .length    = http2::ReadUint32(p) >> 8,
+        .type      = static_cast<Http2FrameType>(p[3]),
+        .flags     = static_cast<uint8_t>(p[4]),
+        .stream_id = http2::ReadUint32(p + 5) & 0x7fffffff,
+    };
+  }
+
+  [[nodiscard]] bool HasFlag(uint8_t flag) const { return (flags & flag) != 0; }
+
+  void AppendTo(std::string& out) const {
+    out += static_cast<char>(length >> 16);
+    out += static_cast<char>(length >> 8);
+    out += static_cast<char>(length);
+    out += static_cast<char>(type);
+    out += static_cast<char>(flags);
+    http2::AppendUint32(stream_id, out);
+  }
+};
+
+}  // namespace simple_http::net::http
@@ -0,0 +1,957 @@
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cstring>
+#include <deque>
+#include <optional>
+
+#include <unistd.h>
+
+#include "http2_session.hpp"
+#include "utils/base64.hpp"
+#include "utils/logger.hpp"
+
+namespace simple_http::net::http {
+
+namespace {
+// Pass added per byte at weight 1, a stream of weight w advances by kStride / w per byte.
+constexpr uint64_t kStride = 256;
+
+constexpr std::array<std::string_view, 5> kConnectionHeaders{"connection", "keep-alive", "proxy-connection",
+                                                             "transfer-encoding", "upgrade"};
+
+bool IsConnectionHeader(std::string_view name) {
+  return std::find(kConnectionHeaders.begin(), kConnectionHeaders.end(), name) != kConnectionHeaders.end();
+}
+
+void AppendSetting(Http2Setting id, uint32_t value, std::string& out) {
+  out += static_cast<char>(static_cast<uint16_t>(id) >> 8);
+  out += static_cast<char>(static_cast<uint16_t>(id));
+  http2::AppendUint32(value, out);
+}
+
+void AppendWindowUpdate(uint32_t stream_id, uint32_t increment, std::string& out) {
+  Http2FrameHeader{.length = 4, .type = Http2FrameType::kWindowUpdate, .stream_id = stream_id}.AppendTo(out);
+  http2::AppendUint32(increment, out);
+}
+
+// Strip the pad length and padding of a DATA or HEADERS frame.
+bool RemovePadding(Http2FrameHeader const& header, std::string_view& payload) {
+  if (!header.HasFlag(http2::kFlagPadded)) {
+    return true;
+  }
+  if (payload.empty()) {
+    return false;
+  }
+  auto pad = static_cast<uint8_t>(payload[0]);
+  if (pad >= payload.size()) {
+    return false;
+  }
+  payload = payload.substr(1, payload.size() - 1 - pad);
+  return true;
+}
+}  // namespace
+
+struct Http2Session::Stream {
+  enum class State { kIdle, kOpen, kHalfClosedRemote, kClosed };
+
+  explicit Stream(uint32_t id) : id(id) {}
+
+  uint32_t id;
+  State    state{State::kIdle};
+  int64_t  send_window{0};
+  int64_t  recv_window{0};
+  int64_t  consumed{0};  // received but not yet returned by WINDOW_UPDATE
+
+  HttpRequest request;
+  std::string body;
+  bool        head{false};  // no body is sent in the response
+
+  // The part of the response body not sent yet.
+  std::string                data;
+  std::size_t                data_offset{0};
+  std::shared_ptr<FileRange> file;
+  off_t                      file_offset{0};
+  std::size_t                file_remaining{0};
+  std::deque<BodyPart>       parts;  // taken into data and file once both are sent
+  std::size_t                parts_remaining{0};
+  HttpResponse::BodyProvider provider;  // refills data as it is sent, until it returned its last part
+  std::optional<std::size_t> content_length;  // announced for a provided body, what is sent has to match
+  std::size_t                sent{0};         // body bytes sent in DATA frames
+
+  Stream*              parent{nullptr};
+  std::vector<Stream*> children;
+  uint16_t             weight{http2::kDefaultWeight};
+  uint64_t             pass{0};  // virtual time of the stride scheduler among siblings
+
+  [[nodiscard]] bool        IsActive() const { return state == State::kOpen || state == State::kHalfClosedRemote; }
+  [[nodiscard]] std::size_t Pending() const {
+    return data.size() - data_offset + file_remaining + parts_remaining;
+  }
+  [[nodiscard]] bool        CanSend() const { return Pending() > 0 && send_window > 0; }
+  [[nodiscard]] bool        IsLastData() const { return Pending() == 0 && !provider; }
+
+  // Pull from the provider until a frame's worth is buffered.
+  void Refill(std::size_t size) {
+    while (provider && data.size() - data_offset < size) {
+      if (!provider(data)) {
+        provider = nullptr;
+      }
+    }
+  }
+
+  // Move on to the next body part once data and file are sent.
+  void NextPart() {
+    while (data_offset == data.size() && file_remaining == 0 && !parts.empty()) {
+      auto& part      = parts.front();
+      auto  length    = part.file ? part.file->GetLength() : 0;
+      parts_remaining -= part.data.size() + length;
+      data            = std::move(part.data);
+      data_offset     = 0;
+      file            = std::move(part.file);
+      file_offset     = file ? file->GetOffset() : 0;
+      file_remaining  = length;
+      parts.pop_front();
+    }
+  }
+};
+
+Http2Session::Http2Session(Handler handler, Http2Options options)
+    : handler_(std::move(handler)), options_(options) {
+  streams_.emplace(0, std::make_unique<Stream>(0));
+}
+
+Http2Session::~Http2Session() = default;
+
+void Http2Session::Start(std::string& out) {
+  std::string settings;
+  AppendSetting(Http2Setting::kMaxConcurrentStreams, options_.max_concurrent_streams, settings);
+  AppendSetting(Http2Setting::kInitialWindowSize, options_.initial_window_size, settings);
+  AppendSetting(Http2Setting::kMaxFrameSize, options_.max_frame_size, settings);
+  AppendSetting(Http2Setting::kMaxHeaderListSize, options_.max_header_list_size, settings);
+  Http2FrameHeader{.length = static_cast<uint32_t>(settings.size()), .type = Http2FrameType::kSettings}.AppendTo(out);
+  out += settings;
+
+  if (options_.connection_window_size > http2::kDefaultWindowSize) {
+    AppendWindowUpdate(0, options_.connection_window_size - http2::kDefaultWindowSize, out);
+    connection_recv_window_ = options_.connection_window_size;
+  }
+}
+
+bool Http2Session::StartUpgrade(std::string_view http2_settings, HttpRequest request, std::string& out) {
+  auto settings = util::Base64Decode(http2_settings);
+  if (!settings || settings->size() % 6 != 0) {
+    return false;
+  }
+  std::string ignored;
+  if (!ApplySettings(*settings, ignored)) {
+    return false;
+  }
+  Start(out);
+
+  // The 101 response acknowledges the settings, the client still sends the preface.
+  auto& stream       = CreateStream(1);
+  stream.state       = Stream::State::kHalfClosedRemote;
+  stream.send_window = peer_initial_window_size_;
+  stream.request     = std::move(request);
+  last_stream_id_    = 1;
+  active_streams_    += 1;
+  Dispatch(stream, out);
+  return true;
+}
+
+bool Http2Session::Receive(util::MsgBuffer& input, Timepoint receive_time, std::string& out) {
+  receive_time_ = receive_time;
+  if (goaway_sent_) {
+    input.RetrieveAll();
+    return false;
+  }
+  if (!preface_received_) {
+    auto size = std::min(input.ReadableSize(), kHttp2Preface.size());
+    if (std::memcmp(input.Peek(), kHttp2Preface.data(), size) != 0) {
+      return ConnectionError(Http2Error::kProtocolError, out);
+    }
+    if (size < kHttp2Preface.size()) {
+      return true;
+    }
+    input.Retrieve(size);
+    preface_received_ = true;
+  }
+
+  while (input.ReadableSize() >= Http2FrameHeader::kSize) {
+    auto header = Http2FrameHeader::Parse(input.Peek());
+    if (header.length > options_.max_frame_size) {
+      return ConnectionError(Http2Error::kFrameSizeError, out);
+    }
+    if (input.ReadableSize() < Http2FrameHeader::kSize + header.length) {
+      break;
+    }
+    if (!settings_received_ && header.type != Http2FrameType::kSettings) {
+      // The preface ends with a SETTINGS frame.
+      return ConnectionError(Http2Error::kProtocolError, out);
+    }
+    std::string_view payload{input.Peek() + Http2FrameHeader::kSize, header.length};
+    bool             ok = HandleFrame(header, payload, out);
+    input.Retrieve(Http2FrameHeader::kSize + header.length);
+    if (!ok) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool Http2Session::HandleFrame(Http2FrameHeader const& header, std::string_view payload, std::string& out) {
+  if (continuation_stream_ != 0 &&
+      (header.type != Http2FrameType::kContinuation || header.stream_id != continuation_stream_)) {
+    return ConnectionError(Http2Error::kProtocolError, out);
+  }
+  switch (header.type) {
+    case Http2FrameType::kData:
+      return HandleData(header, payload, out);
+    case Http2FrameType::kHeaders:
+      return HandleHeaders(header, payload, out);
+    case Http2FrameType::kPriority:
+      return HandlePriority(header, payload, out);
+    case Http2FrameType::kRstStream:
+      return HandleRstStream(header, payload, out);
+    case Http2FrameType::kSettings:
+      return HandleSettings(header, payload, out);
+    case Http2FrameType::kPushPromise:
+      // Clients can't push.
+      return ConnectionError(Http2Error::kProtocolError, out);
+    case Http2FrameType::kPing:
+      return HandlePing(header, payload, out);
+    case Http2FrameType::kGoaway:
+      return HandleGoaway(header, payload, out);
+    case Http2FrameType::kWindowUpdate:
+      return HandleWindowUpdate(header, payload, out);
+    case Http2FrameType::kContinuation:
+      return HandleContinuation(header, payload, out);
+    default:
+      // Unknown frame types are ignored (RFC 7540 4.1).
+      return true;
+  }
+}
+
+bool Http2Session::HandleData(Http2FrameHeader const& header, std::string_view payload, std::string& out) {
+  if (header.stream_id == 0) {
+    return ConnectionError(Http2Error::kProtocolError, out);
+  }
+  // Padding counts against flow control as well.
+  if (header.length > connection_recv_window_) {
+    return ConnectionError(Http2Error::kFlowControlError, out);
+  }
+  connection_recv_window_ -= header.length;
+  connection_consumed_    += header.length;
+  if (connection_consumed_ >= options_.connection_window_size / 2 ||
+      connection_recv_window_ < static_cast<int64_t>(options_.max_frame_size)) {
+    AppendWindowUpdate(0, static_cast<uint32_t>(connection_consumed_), out);
+    connection_recv_window_ += connection_consumed_;
+    connection_consumed_    = 0;
+  }
+
+  if (!RemovePadding(header, payload)) {
+    return ConnectionError(Http2Error::kProtocolError, out);
+  }
+  auto* stream = FindStream(header.stream_id);
+  if (stream == nullptr || stream->state != Stream::State::kOpen) {
+    if (header.stream_id > last_stream_id_) {
+      return ConnectionError(Http2Error::kProtocolError, out);  // idle stream
+    }
+    StreamError(header.stream_id, Http2Error::kStreamClosed, out);
+    return true;
+  }
+  if (header.length > stream->recv_window) {
+    StreamError(header.stream_id, Http2Error::kFlowControlError, out);
+    return true;
+  }
+  if (stream->body.size() + payload.size() > options_.max_request_body) {
+    StreamError(header.stream_id, Http2Error::kCancel, out);
+    return true;
+  }
+  stream->recv_window -= header.length;
+  stream->body.append(payload);
+
+  if (header.HasFlag(http2::kFlagEndStream)) {
+    stream->state = Stream::State::kHalfClosedRemote;
+    Dispatch(*stream, out);
+    return true;
+  }
+  // The body is buffered until the request is complete, give the window back right away.
+  stream->consumed += header.length;
+  if (stream->consumed >= options_.initial_window_size / 2) {
+    AppendWindowUpdate(stream->id, static_cast<uint32_t>(stream->consumed), out);
+    stream->recv_window += stream->consumed;
+    stream->consumed    = 0;
+  }
+  return true;
+}
+
+bool Http2Session::HandleHeaders(Http2FrameHeader const& header, std::string_view payload, std::string& out) {
+  auto id = header.stream_id;
+  if (id == 0 || id % 2 == 0) {
+    return ConnectionError(Http2Error::kProtocolError, out);
+  }
+  if (!RemovePadding(header, payload)) {
+    return ConnectionError(Http2Error::kProtocolError, out);
+  }
+
+  bool     has_priority = header.HasFlag(http2::kFlagPriority);
+  uint32_t dependency   = 0;
+  bool     exclusive    = false;
+  uint16_t weight       = http2::kDefaultWeight;
+  if (has_priority) {
+    if (payload.size() < 5) {
+      return ConnectionError(Http2Error::kFrameSizeError, out);
+    }
+    auto value = http2::ReadUint32(payload.data());
+    exclusive  = (value & 0x80000000) != 0;
+    dependency = value & 0x7fffffff;
+    weight     = static_cast<uint16_t>(static_cast<uint8_t>(payload[4]) + 1);
+    payload.remove_prefix(5);
+  }
+
+  auto* stream = FindStream(id);
+  if (stream != nullptr && stream->state == Stream::State::kOpen) {
+    // Trailers, they have to end the stream.
+    if (!header.HasFlag(http2::kFlagEndStream)) {
+      return ConnectionError(Http2Error::kProtocolError, out);
+    }
+  } else if (stream != nullptr && stream->state != Stream::State::kIdle) {
+    return ConnectionError(Http2Error::kStreamClosed, out);
+  } else {
+    if (id <= last_stream_id_) {
+      return ConnectionError(Http2Error::kProtocolError, out);
+    }
+    last_stream_id_ = id;
+    if (stream == nullptr) {
+      stream = &CreateStream(id);
+    }
+    if (has_priority) {
+      if (dependency == id) {
+        StreamError(id, Http2Error::kProtocolError, out);
+        // The header block still has to be decoded to keep HPACK in sync.
+      } else {
+        SetPriority(*stream, dependency, weight, exclusive);
+      }
+    }
+  }
+
+  continuation_stream_     = id;
+  continuation_end_stream_ = header.HasFlag(http2::kFlagEndStream);
+  header_block_.assign(payload);
+  if (header.HasFlag(http2::kFlagEndHeaders)) {
+    return EndHeaderBlock(out);
+  }
+  return true;
+}
+
+bool Http2Session::HandleContinuation(Http2FrameHeader const& header, std::string_view payload, std::string& out) {
+  if (continuation_stream_ == 0) {
+    return ConnectionError(Http2Error::kProtocolError, out);
+  }
+  if (header_block_.size() + payload.size() > options_.max_header_list_size * 2) {
+    return ConnectionError(Http2Error::kEnhanceYourCalm, out);
+  }
+  header_block_.append(payload);
+  if (header.HasFlag(http2::kFlagEndHeaders)) {
+    return EndHeaderBlock(out);
+  }
+  return true;
+}
+
+bool Http2Session::EndHeaderBlock(std::string& out) {
+  auto id              = continuation_stream_;
+  continuation_stream_ = 0;
+
+  std::vector<HeaderField> fields;
+  if (!decoder_.Decode(header_block_, fields)) {
+    return ConnectionError(Http2Error::kCompressionError, out);
+  }
+  header_block_.clear();
+
+  auto* stream = FindStream(id);
+  if (stream == nullptr) {
+    return true;  // reset while the block was read
+  }
+  if (stream->state == Stream::State::kOpen) {
+    // Trailers are not passed on to handlers.
+    stream->state = Stream::State::kHalfClosedRemote;
+    Dispatch(*stream, out);
+    return true;
+  }
+
+  if (active_streams_ >= options_.max_concurrent_streams || goaway_received_ || (draining_ && id > drain_stream_id_)) {
+    StreamError(id, Http2Error::kRefusedStream, out);
+    return true;
+  }
+
+  auto&            request = stream->request;
+  std::size_t      list_size{0};
+  bool             regular_seen{false};
+  bool             malformed{false};
+  std::string_view method;
+  std::string_view scheme;
+  std::string_view path;
+  std::string_view authority;
+  std::string      cookie;
+  for (auto const& field : fields) {
+    list_size += field.name.size() + field.value.size() + 32;
+    if (field.name.starts_with(':')) {
+      std::string_view* target = nullptr;
+      if (field.name == ":method") {
+        target = &method;
+      } else if (field.name == ":scheme") {
+        target = &scheme;
+      } else if (field.name == ":path") {
+        target = &path;
+      } else if (field.name == ":authority") {
+        target = &authority;
+      }
+      // Pseudo headers come first, each once.
+      if (target == nullptr || regular_seen || !target->empty()) {
+        malformed = true;
+        break;
+      }
+      *target = field.value;
+      continue;
+    }
+    regular_seen = true;
+    if (std::any_of(field.name.begin(), field.name.end(), [](char c) { return std::isupper(c) != 0; }) ||
+        IsConnectionHeader(field.name) || (field.name == "te" && field.value != "trailers")) {
+      malformed = true;
+      break;
+    }
+    if (field.name == "cookie") {
+      // Split into several fields for compression, joined again for HTTP/1.1 handlers (RFC 7540 8.1.2.5).
+      cookie += cookie.empty() ? "" : "; ";
+      cookie += field.value;
+      continue;
+    }
+    request.SetHeader(field.name, field.value);
+  }
+  if (malformed || method.empty() || scheme.empty() || path.empty()) {
+    StreamError(id, Http2Error::kProtocolError, out);
+    return true;
+  }
+
+  stream->state       = continuation_end_stream_ ? Stream::State::kHalfClosedRemote : Stream::State::kOpen;
+  stream->send_window = peer_initial_window_size_;
+  stream->recv_window = options_.initial_window_size;
+  active_streams_     += 1;
+
+  if (list_size > options_.max_header_list_size) {
+    stream->state = Stream::State::kHalfClosedRemote;
+    WriteHeaders(id, {{":status", "431"}}, true, out);
+    CloseStream(*stream);
+    return true;
+  }
+
+  if (!cookie.empty()) {
+    request.SetHeader(HeaderId::kCookie, cookie);
+  }
+  if (!authority.empty() && !request.HasHeader(HeaderId::kHost)) {
+    request.SetHeader(HeaderId::kHost, authority);
+  }
+  request.SetMethod(ParseMethod(method));
+  auto question = path.find('?');
+  request.SetPath(path.substr(0, question));
+  if (question != std::string_view::npos) {
+    request.SetQuery(path.substr(question));
+  }
+  request.SetVersion(Version::kHttp2);
+  request.SetReceiveTime(receive_time_);
+
+  if (continuation_end_stream_) {
+    Dispatch(*stream, out);
+  }
+  return true;
+}
+
+bool Http2Session::HandlePriority(Http2FrameHeader const& header, std::string_view payload, std::string& out) {
+  if (header.stream_id == 0) {
+    return ConnectionError(Http2Error::kProtocolError, out);
+  }
+  if (payload.size() != 5) {
+    StreamError(header.stream_id, Http2Error::kFrameSizeError, out);
+    return true;
+  }
+  auto value      = http2::ReadUint32(payload.data());
+  auto dependency = value & 0x7fffffff;
+  if (dependency == header.stream_id) {
+    StreamError(header.stream_id, Http2Error::kProtocolError, out);
+    return true;
+  }
+
+  auto* stream = FindStream(header.stream_id);
+  if (stream == nullptr) {
+    // Priorities may be set before a stream opens, keep a bounded number of such placeholders.
+    if (header.stream_id <= last_stream_id_ || streams_.size() > 2 * options_.max_concurrent_streams) {
+      return true;
+    }
+    stream = &CreateStream(header.stream_id);
+  }
+  SetPriority(*stream, dependency, static_cast<uint16_t>(static_cast<uint8_t>(payload[4]) + 1),
+              (value & 0x80000000) != 0);
+  return true;
+}
+
+bool Http2Session::HandleRstStream(Http2FrameHeader const& header, std::string_view payload, std::string& out) {
+  if (header.stream_id == 0) {
+    return ConnectionError(Http2Error::kProtocolError, out);
+  }
+  if (payload.size() != 4) {
+    return ConnectionError(Http2Error::kFrameSizeError, out);
+  }
+  auto* stream = FindStream(header.stream_id);
+  if (header.stream_id > last_stream_id_ && (stream == nullptr || stream->state == Stream::State::kIdle)) {
+    return ConnectionError(Http2Error::kProtocolError, out);
+  }
+  if (stream != nullptr) {
+    CloseStream(*stream);
+  }
+  return true;
+}
+
+bool Http2Session::HandleSettings(Http2FrameHeader const& header, std::string_view payload, std::string& out) {
+  if (header.stream_id != 0) {
+    return ConnectionError(Http2Error::kProtocolError, out);
+  }
+  if (header.HasFlag(http2::kFlagAck)) {
+    return payload.empty() || ConnectionError(Http2Error::kFrameSizeError, out);
+  }
+  if (payload.size() % 6 != 0) {
+    return ConnectionError(Http2Error::kFrameSizeError, out);
+  }
+  if (!ApplySettings(payload, out)) {
+    return false;
+  }
+  settings_received_ = true;
+  Http2FrameHeader{.type = Http2FrameType::kSettings, .flags = http2::kFlagAck}.AppendTo(out);
+  return true;
+}
+
+bool Http2Session::ApplySettings(std::string_view payload, std::string& out) {
+  for (; payload.size() >= 6; payload.remove_prefix(6)) {
+    auto id    = static_cast<Http2Setting>((static_cast<uint8_t>(payload[0]) << 8) | static_cast<uint8_t>(payload[1]));
+    auto value = http2::ReadUint32(payload.data() + 2);
+    switch (id) {
+      case Http2Setting::kHeaderTableSize:
+        encoder_.SetMaxTableSize(value);
+        break;
+      case Http2Setting::kEnablePush:
+        if (value > 1) {
+          return ConnectionError(Http2Error::kProtocolError, out);
+        }
+        break;
+      case Http2Setting::kInitialWindowSize: {
+        if (value > http2::kMaxWindowSize) {
+          return ConnectionError(Http2Error::kFlowControlError, out);
+        }
+        // Applies to the windows of all open streams (RFC 7540 6.9.2).
+        auto delta = static_cast<int64_t>(value) - peer_initial_window_size_;
+        for (auto& [stream_id, stream] : streams_) {
+          if (stream_id != 0 && stream->IsActive()) {
+            stream->send_window += delta;
+            if (stream->send_window > http2::kMaxWindowSize) {
+              return ConnectionError(Http2Error::kFlowControlError, out);
+            }
+          }
+        }
+        peer_initial_window_size_ = value;
+        break;
+      }
+      case Http2Setting::kMaxFrameSize:
+        if (value < http2::kDefaultMaxFrameSize || value > http2::kMaxMaxFrameSize) {
+          return ConnectionError(Http2Error::kProtocolError, out);
+        }
+        peer_max_frame_size_ = value;
+        break;
+      default:
+        // We never push and don't limit our header lists, unknown settings are ignored.
+        break;
+    }
+  }
+  return true;
+}
+
+bool Http2Session::HandlePing(Http2FrameHeader const& header, std::string_view payload, std::string& out) {
+  if (header.stream_id != 0) {
+    return ConnectionError(Http2Error::kProtocolError, out);
+  }
+  if (payload.size() != 8) {
+    return ConnectionError(Http2Error::kFrameSizeError, out);
+  }
+  if (!header.HasFlag(http2::kFlagAck)) {
+    Http2FrameHeader{.length = 8, .type = Http2FrameType::kPing, .flags = http2::kFlagAck}.AppendTo(out);
+    out += payload;
+  }
+  return true;
+}
+
+bool Http2Session::HandleGoaway(Http2FrameHeader const& header, std::string_view payload, std::string& out) {
+  if (header.stream_id != 0) {
+    return ConnectionError(Http2Error::kProtocolError, out);
+  }
+  if (payload.size() < 8) {
+    return ConnectionError(Http2Error::kFrameSizeError, out);
+  }
+  // Streams already open are still answered, no new ones are accepted.
+  goaway_received_ = true;
+  return true;
+}
+
+bool Http2Session::HandleWindowUpdate(Http2FrameHeader const& header, std::string_view payload, std::string& out) {
+  if (payload.size() != 4) {
+    return ConnectionError(Http2Error::kFrameSizeError, out);
+  }
+  auto increment = http2::ReadUint32(payload.data()) & 0x7fffffff;
+  if (header.stream_id == 0) {
+    if (increment == 0) {
+      return ConnectionError(Http2Error::kProtocolError, out);
+    }
+    connection_send_window_ += increment;
+    if (connection_send_window_ > http2::kMaxWindowSize) {
+      return ConnectionError(Http2Error::kFlowControlError, out);
+    }
+    return true;
+  }
+
+  auto* stream = FindStream(header.stream_id);
+  if (stream == nullptr || stream->state == Stream::State::kIdle) {
+    if (header.stream_id > last_stream_id_) {
+      return ConnectionError(Http2Error::kProtocolError, out);
+    }
+    return true;  // closed already
+  }
+  if (increment == 0) {
+    StreamError(header.stream_id, Http2Error::kProtocolError, out);
+    return true;
+  }
+  stream->send_window += increment;
+  if (stream->send_window > http2::kMaxWindowSize) {
+    StreamError(header.stream_id, Http2Error::kFlowControlError, out);
+  }
+  return true;
+}
+
+void Http2Session::Dispatch(Stream& stream, std::string& out) {
+  stream.request.SetBody(std::move(stream.body));
+  stream.head = stream.request.GetMethod() == Method::kHead;
+  HttpResponse response(false);
+  bool         ready = handler_(stream.id, stream.request, response);
+  stream.request     = {};
+  if (ready) {
+    WriteResponse(stream, response, out);
+  }
+}
+
+void Http2Session::Respond(uint32_t stream_id, HttpResponse& response, std::string& out) {
+  if (auto* stream = FindStream(stream_id); stream != nullptr && stream->IsActive()) {
+    WriteResponse(*stream, response, out);
+  }
+}
+
+void Http2Session::WriteResponse(Stream& stream, HttpResponse& response, std::string& out) {
+  std::vector<HeaderField> fields;
+  fields.push_back({":status", std::to_string(static_cast<int>(response.GetStatusCode()))});
+  for (auto const& [name, value] : response.GetHeaders()) {
+    std::string lower(name);
+    std::transform(lower.begin(), lower.end(), lower.begin(), [](unsigned char c) { return std::tolower(c); });
+    if (!IsConnectionHeader(lower) && lower != "content-length") {
+      fields.push_back({std::move(lower), value});
+    }
+  }
+  auto length    = response.GetBodySize();
+  bool streaming = response.IsStreaming();
+  if (streaming) {
+    // DATA frames delimit the body, its length only needs to be sent if it is known.
+    stream.provider = response.TakeBodyProvider();
+    stream.Refill(peer_max_frame_size_);
+    length = stream.Pending();
+    if (auto const& stream_length = response.GetStreamLength(); stream_length) {
+      fields.push_back({"content-length", std::to_string(*stream_length)});
+      stream.content_length = stream_length;
+    }
+    if (!stream.head && !stream.provider && stream.content_length && length != *stream.content_length) {
+      // The provider is done already, without the announced length.
+      LOG_WARNING << "Body of stream " << stream.id << " is not the " << *stream.content_length
+                  << " bytes of its content-length, resetting the stream";
+      StreamError(stream.id, Http2Error::kInternalError, out);
+      return;
+    }
+  } else if (response.GetStatusCode() != StatusCode::k304NotModified) {
+    fields.push_back({"content-length", std::to_string(length)});
+  }
+
+  bool no_body = (length == 0 && !stream.provider) || stream.head;
+  WriteHeaders(stream.id, fields, no_body, out);
+  if (no_body) {
+    CloseStream(stream);
+    return;
+  }
+  if (!streaming) {
+    stream.data = response.GetBody();
+  }
+  if (auto const& file = response.GetFileBody(); file) {
+    stream.file           = file;
+    stream.file_offset    = file->GetOffset();
+    stream.file_remaining = file->GetLength();
+  }
+  if (auto const& parts = response.GetBodyParts(); !parts.empty()) {
+    stream.parts.assign(parts.begin(), parts.end());
+    stream.parts_remaining = length;
+    stream.NextPart();
+  }
+}
+
+void Http2Session::WriteHeaders(uint32_t stream_id, std::vector<HeaderField> const& headers, bool end_stream,
+                                std::string& out) {
+  std::string block;
+  encoder_.Encode(headers, block);
+
+  // Blocks larger than a frame continue in CONTINUATION frames.
+  std::string_view rest  = block;
+  bool             first = true;
+  do {
+    auto             chunk = rest.substr(0, peer_max_frame_size_);
+    Http2FrameHeader header{
+        .length    = static_cast<uint32_t>(chunk.size()),
+        .type      = first ? Http2FrameType::kHeaders : Http2FrameType::kContinuation,
+        .stream_id = stream_id,
+    };
+    rest.remove_prefix(chunk.size());
+    if (first && end_stream) {
+      header.flags |= http2::kFlagEndStream;
+    }
+    if (rest.empty()) {
+      header.flags |= http2::kFlagEndHeaders;
+    }
+    header.AppendTo(out);
+    out   += chunk;
+    first = false;
+  } while (!rest.empty());
+}
+
+void Http2Session::Flush(std::string& out, std::size_t budget) {
+  auto& root = *streams_.at(0);
+  while (out.size() < budget && connection_send_window_ > 0) {
+    auto* stream = NextToSend(root);
+    if (stream == nullptr) {
+      break;
+    }
+    auto size = std::min({static_cast<std::size_t>(peer_max_frame_size_), static_cast<std::size_t>(stream->send_window),
+                          static_cast<std::size_t>(connection_send_window_), stream->Pending()});
+    WriteData(*stream, size, out);
+  }
+}
+
+bool Http2Session::WriteData(Stream& stream, std::size_t max_size, std::string& out) {
+  auto begin = out.size();
+  out.resize(begin + Http2FrameHeader::kSize);
+
+  auto from_data = std::min(max_size, stream.data.size() - stream.data_offset);
+  out.append(stream.data, stream.data_offset, from_data);
+  stream.data_offset += from_data;
+  if (stream.data_offset == stream.data.size()) {
+    stream.data.clear();
+    stream.data_offset = 0;
+  }
+
+  auto from_file = std::min(max_size - from_data, stream.file_remaining);
+  if (from_file > 0) {
+    auto offset = out.size();
+    out.resize(offset + from_file);
+    std::size_t done = 0;
+    while (done < from_file) {
+      auto n = ::pread(stream.file->GetFd(), out.data() + offset + done, from_file - done, stream.file_offset);
+      if (n <= 0) {
+        out.resize(begin);
+        StreamError(stream.id, Http2Error::kInternalError, out);
+        return false;
+      }
+      done               += n;
+      stream.file_offset += n;
+    }
+    stream.file_remaining -= from_file;
+    if (stream.file_remaining == 0) {
+      stream.file.reset();
+    }
+  }
+
+  stream.NextPart();
+  stream.Refill(peer_max_frame_size_);
+  auto size    = from_data + from_file;
+  bool end     = stream.IsLastData();
+  stream.sent += size;
+  if (stream.content_length &&
+      (stream.sent > *stream.content_length || (end && stream.sent != *stream.content_length))) {
+    // Only a reset tells the client the body is not what the head announced (RFC 9113 8.1.1).
+    LOG_WARNING << "Body of stream " << stream.id << " is not the " << *stream.content_length
+                << " bytes of its content-length, resetting the stream";
+    out.resize(begin);
+    StreamError(stream.id, Http2Error::kInternalError, out);
+    return false;
+  }
+  std::string header_bytes;
+  Http2FrameHeader{.length    = static_cast<uint32_t>(size),
+                   .type      = Http2FrameType::kData,
+                   .flags     = end ? http2::kFlagEndStream : uint8_t{0},
+                   .stream_id = stream.id}
+      .AppendTo(header_bytes);
+  std::memcpy(out.data() + begin, header_bytes.data(), Http2FrameHeader::kSize);
+
+  stream.send_window      -= static_cast<int64_t>(size);
+  connection_send_window_ -= static_cast<int64_t>(size);
+  Charge(stream, size);
+  if (end) {
+    CloseStream(stream);
+  }
+  return true;
+}
+
+void Http2Session::Drain(std::string& out) {
+  if (goaway_sent_ || draining_) {
+    return;
+  }
+  Http2FrameHeader{.length = 8, .type = Http2FrameType::kGoaway}.AppendTo(out);
+  http2::AppendUint32(last_stream_id_, out);
+  http2::AppendUint32(static_cast<uint32_t>(Http2Error::kNoError), out);
+  draining_        = true;
+  drain_stream_id_ = last_stream_id_;
+}
+
+bool Http2Session::IsFinished() const {
+  return (goaway_sent_ || goaway_received_ || draining_) && active_streams_ == 0;
+}
+
+bool Http2Session::ConnectionError(Http2Error error, std::string& out) {
+  if (!goaway_sent_) {
+    Http2FrameHeader{.length = 8, .type = Http2FrameType::kGoaway}.AppendTo(out);
+    http2::AppendUint32(last_stream_id_, out);
+    http2::AppendUint32(static_cast<uint32_t>(error), out);
+    goaway_sent_ = true;
+  }
+  return false;
+}
+
+void Http2Session::StreamError(uint32_t stream_id, Http2Error error, std::string& out) {
+  Http2FrameHeader{.length = 4, .type = Http2FrameType::kRstStream, .stream_id = stream_id}.AppendTo(out);
+  http2::AppendUint32(static_cast<uint32_t>(error), out);
+  if (auto* stream = FindStream(stream_id); stream != nullptr) {
+    CloseStream(*stream);
+  }
+}
+
+Http2Session::Stream* Http2Session::FindStream(uint32_t stream_id) {
+  auto it = streams_.find(stream_id);
+  return it == streams_.end() ? nullptr : it->second.get();
+}
+
+Http2Session::Stream& Http2Session::CreateStream(uint32_t stream_id) {
+  auto& stream = *streams_.emplace(stream_id, std::make_unique<Stream>(stream_id)).first->second;
+  Attach(stream, *streams_.at(0));
+  return stream;
+}
+
+void Http2Session::CloseStream(Stream& stream) {
+  if (stream.IsActive()) {
+    active_streams_ -= 1;
+  }
+  stream.state = Stream::State::kClosed;
+  RemoveStream(stream.id);
+}
+
+void Http2Session::RemoveStream(uint32_t stream_id) {
+  auto it = streams_.find(stream_id);
+  if (it == streams_.end() || stream_id == 0) {
+    return;
+  }
+  auto& stream = *it->second;
+  auto& parent = *stream.parent;
+  Detach(stream);
+  // Dependents move up to the parent of the removed stream.
+  for (auto* child : std::vector<Stream*>(stream.children)) {
+    Detach(*child);
+    Attach(*child, parent);
+  }
+  streams_.erase(it);
+}
+
+void Http2Session::SetPriority(Stream& stream, uint32_t parent_id, uint16_t weight, bool exclusive) {
+  auto* parent = FindStream(parent_id);
+  if (parent == nullptr) {
+    // Depending on a stream that is gone gives the default priority (RFC 7540 5.3.1).
+    parent = streams_.at(0).get();
+    weight = http2::kDefaultWeight;
+  }
+  if (IsDescendant(*parent, stream.id)) {
+    // The new parent moves into the place of the stream first (RFC 7540 5.3.3).
+    auto* old_parent = stream.parent;
+    Detach(*parent);
+    Attach(*parent, *old_parent);
+  }
+  Detach(stream);
+  stream.weight = weight;
+  if (exclusive) {
+    for (auto* child : std::vector<Stream*>(parent->children)) {
+      Detach(*child);
+      Attach(*child, stream);
+    }
+  }
+  Attach(stream, *parent);
+}
+
+void Http2Session::Detach(Stream& stream) {
+  if (stream.parent != nullptr) {
+    std::erase(stream.parent->children, &stream);
+    stream.parent = nullptr;
+  }
+}
+
+void Http2Session::Attach(Stream& stream, Stream& parent) {
+  // Start at the front of the siblings, a stream that was idle gets no credit for it.
+  uint64_t pass = UINT64_MAX;
+  for (auto const* sibling : parent.children) {
+    pass = std::min(pass, sibling->pass);
+  }
+  stream.pass   = pass == UINT64_MAX ? 0 : pass;
+  stream.parent = &parent;
+  parent.children.push_back(&stream);
+}
+
+bool Http2Session::IsDescendant(Stream const& stream, uint32_t ancestor_id) {
+  for (auto const* node = stream.parent; node != nullptr; node = node->parent) {
+    if (node->id == ancestor_id) {
+      return true;
+    }
+  }
+  return false;
+}
+
+Http2Session::Stream* Http2Session::NextToSend(Stream& node) {
+  // A stream goes before its dependents, which only get what it can't use (RFC 7540 5.3.1).
+  if (node.id != 0 && node.CanSend()) {
+    return &node;
+  }
+  if (node.children.empty()) {
+    return nullptr;
+  }
+  // Siblings share by weight: the one that has been charged least so far goes next.
+  auto children = node.children;
+  std::sort(children.begin(), children.end(), [](auto const* a, auto const* b) { return a->pass < b->pass; });
+  for (auto* child : children) {
+    if (auto* stream = NextToSend(*child); stream != nullptr) {
+      return stream;
+    }
+  }
+  return nullptr;
+}
+
+void Http2Session::Charge(Stream& stream, std::size_t bytes) {
+  for (auto* node = &stream; node->parent != nullptr; node = node->parent) {
+    node->pass += (bytes + 1) * kStride / node->weight;
+  }
+}
+
+}  // namespace simple_http::net::http
@@ -0,0 +1,177 @@
+/**
+ * @file http2_session.hpp
+ * @author Qirui Wang (qirui.wang@moegi.waseda.jp)
+ * @brief Server side of an HTTP/2 connection over cleartext TCP (RFC 7540)
+ * @version 0.1
+ * @date 2023-02-17
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "net/file_range.hpp"
+#include "net/http/hpack.hpp"
+#include "net/http/http.hpp"
+#include "net/http/http2_frame.hpp"
+#include "net/http/http_request.hpp"
+#include "net/http/http_response.hpp"
+#include "utils/msg_buffer.hpp"
+#include "utils/non_copyable.hpp"
+
+namespace simple_http::net::http {
+
+struct Http2Options {
+  uint32_t    max_concurrent_streams{100};
+  uint32_t    initial_window_size{1024 * 1024};       // receive window of each stream
+  uint32_t    connection_window_size{16 * 1024 * 1024};  // receive window of the connection
+  uint32_t    max_frame_size{http2::kDefaultMaxFrameSize};
+  uint32_t    max_header_list_size{64 * 1024};
+  std::size_t max_request_body{16 * 1024 * 1024};
+};
+
+/**
+ * @brief Frames, flow control and stream priorities of one connection. It does no I/O: the
+ * connection feeds what it reads to Receive and sends what Receive and Flush append to out.
+ *
+ * Requests are handed to the handler once their END_STREAM arrived. Their responses are
+ * queued and sent as DATA frames by Flush, as far as the flow control windows allow, choosing
+ * between streams by the dependency tree and weights the client sent.
+ *
+ */
+struct Http2Session : public util::NonCopyable {
+ public:
+  // Returns false if the response is not ready yet, it is passed to Respond later then.
+  using Handler = std::function<bool(uint32_t stream_id, HttpRequest const&, HttpResponse&)>;
+
+  explicit Http2Session(Handler handler, Http2Options options = {});
+  ~Http2Session();
+
+  /**
+   * @brief Start a connection the client opened with the preface, HTTP/2 with prior knowledge.
+   *
+   */
+  void Start(std::string& out);
+
+  /**
+   * @brief Start a connection upgraded from HTTP/1.1 after the 101 response was sent. The
+   * request that asked for the upgrade becomes stream 1 and is answered over HTTP/2.
+   *
+   * @return false if the HTTP2-Settings header was invalid
+   */
+  bool StartUpgrade(std::string_view http2_settings, HttpRequest request, std::string& out);
+
+  /**
+   * @brief Consume the complete frames in input, appending replies to out.
+   *
+   * @return false if the connection has to be closed once out is sent
+   */
+  bool Receive(util::MsgBuffer& input, Timepoint receive_time, std::string& out);
+
+  /**
+   * @brief Append DATA frames of queued responses until out holds about budget bytes or flow
+   * control stops all streams.
+   *
+   */
+  void Flush(std::string& out, std::size_t budget);
+
+  /**
+   * @brief Answer a request whose handler returned false. Does nothing if the client reset the
+   * stream meanwhile.
+   *
+   */
+  void Respond(uint32_t stream_id, HttpResponse& response, std::string& out);
+
+  /**
+   * @brief Send a GOAWAY without error, e.g. before the server restarts. The streams the client
+   * opened so far are still served, newer ones are refused so that the client retries them on
+   * another connection.
+   *
+   */
+  void Drain(std::string& out);
+
+  // True once a GOAWAY was exchanged and all streams are done, the connection can be closed.
+  [[nodiscard]] bool IsFinished() const;
+
+  [[nodiscard]] std::size_t GetActiveStreams() const { return active_streams_; }
+
+ private:
+  struct Stream;
+
+  Handler      handler_;
+  Http2Options options_;
+  HpackDecoder decoder_;
+  HpackEncoder encoder_;
+
+  bool     preface_received_{false};
+  bool     settings_received_{false};
+  bool     goaway_sent_{false};
+  bool     goaway_received_{false};
+  bool     draining_{false};
+  uint32_t last_stream_id_{0};   // highest stream the client opened
+  uint32_t drain_stream_id_{0};  // highest stream served after Drain
+
+  // Peer settings
+  uint32_t peer_initial_window_size_{http2::kDefaultWindowSize};
+  uint32_t peer_max_frame_size_{http2::kDefaultMaxFrameSize};
+
+  int64_t connection_send_window_{http2::kDefaultWindowSize};
+  int64_t connection_recv_window_{http2::kDefaultWindowSize};
+  int64_t connection_consumed_{0};  // received but not yet returned by WINDOW_UPDATE
+
+  // A header block spread over HEADERS and CONTINUATION frames.
+  uint32_t    continuation_stream_{0};
+  bool        continuation_end_stream_{false};
+  std::string header_block_;
+
+  std::unordered_map<uint32_t, std::unique_ptr<Stream>> streams_;  // 0 is the root of the tree
+  std::size_t                                           active_streams_{0};
+  Timepoint                                             receive_time_;
+
+  bool HandleFrame(Http2FrameHeader const& header, std::string_view payload, std::string& out);
+  bool HandleData(Http2FrameHeader const& header, std::string_view payload, std::string& out);
+  bool HandleHeaders(Http2FrameHeader const& header, std::string_view payload, std::string& out);
+  bool HandleContinuation(Http2FrameHeader const& header, std::string_view payload, std::string& out);
+  bool HandlePriority(Http2FrameHeader const& header, std::string_view payload, std::string& out);
+  bool HandleRstStream(Http2FrameHeader const& header, std::string_view payload, std::string& out);
+  bool HandleSettings(Http2FrameHeader const& header, std::string_view payload, std::string& out);
+  bool HandlePing(Http2FrameHeader const& header, std::string_view payload, std::string& out);
+  bool HandleGoaway(Http2FrameHeader const& header, std::string_view payload, std::string& out);
+  bool HandleWindowUpdate(Http2FrameHeader const& header, std::string_view payload, std::string& out);
+
+  bool ApplySettings(std::string_view payload, std::string& out);
+  bool EndHeaderBlock(std::string& out);
+  void Dispatch(Stream& stream, std::string& out);
+  void WriteResponse(Stream& stream, HttpResponse& response, std::string& out);
+  void WriteHeaders(uint32_t stream_id, std::vector<HeaderField> const& headers, bool end_stream, std::string& out);
+  bool WriteData(Stream& stream, std::size_t max_size, std::string& out);
+
+  // Errors that end the connection or only one stream (RFC 7540 5.4).
+  bool ConnectionError(Http2Error error, std::string& out);
+  void StreamError(uint32_t stream_id, Http2Error error, std::string& out);
+
+  Stream* FindStream(uint32_t stream_id);
+  Stream& CreateStream(uint32_t stream_id);
+  void    CloseStream(Stream& stream);
+  void    RemoveStream(uint32_t stream_id);
+
+  // Priority tree
+  void    SetPriority(Stream& stream, uint32_t parent_id, uint16_t weight, bool exclusive);
+  void    Detach(Stream& stream);
+  void    Attach(Stream& stream, Stream& parent);
+  bool    IsDescendant(Stream const& stream, uint32_t ancestor_id);
+  Stream* NextToSend(Stream& node);
+  void    Charge(Stream& stream, std::size_t bytes);
+};
+
+}  // namespace simple_http::net::http
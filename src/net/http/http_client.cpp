@@ -0,0 +1,419 @@
+#include <algorithm>
+#include <charconv>
+#include <deque>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "net/http/response_parser.hpp"
+#include "net/tcp_client.hpp"
+#include "utils/msg_buffer.hpp"
+#include "utils/perfect_hash.hpp"
+
+#include "http_client.hpp"
+
+namespace simple_http::net::http {
+
+namespace {
+bool IsIdempotent(Method method) {
+  return method == Method::kGet || method == Method::kHead || method == Method::kPut || method == Method::kDelete;
+}
+}  // namespace
+
+std::string_view HttpClientErrorName(HttpClientError error) {
+  switch (error) {
+    case HttpClientError::kNone:
+      return "none";
+    case HttpClientError::kConnectFailed:
+      return "connect failed";
+    case HttpClientError::kTimeout:
+      return "timeout";
+    case HttpClientError::kConnectionClosed:
+      return "connection closed";
+    case HttpClientError::kBadResponse:
+      return "bad response";
+  }
+  return "unknown";
+}
+
+/**
+ * @brief The connections of one loop to the upstream, only used in that loop.
+ *
+ */
+struct HttpClient::Pool : public std::enable_shared_from_this<Pool> {
+ public:
+  struct Exchange {
+    HttpRequest        request;
+    HttpClientCallback callback;
+    HttpClientSplice   splice;
+    bool               retried{false};
+  };
+
+  struct Link {
+    std::unique_ptr<TcpClient> client;
+    ResponseParser             parser;
+    std::optional<Exchange>    exchange;  // the request in flight
+    uint64_t                   serial{0};  // of the exchange, a relay that ends late checks it
+    TimerId                    timer{0};   // of the request, or of the idle timeout
+    bool                       reused{false};
+    bool                       relaying_request{false};
+  };
+
+  Pool(EventLoop* loop, InetAddr const& upstream, HttpClientOptions const& options)
+      : loop_(loop), upstream_(upstream), options_(options), host_(upstream.ToIpPort()) {}
+
+  void Send(Exchange exchange);
+  // Drop all connections and the requests still waiting, without calling back.
+  void Shutdown();
+
+ private:
+  EventLoop*        loop_;
+  InetAddr          upstream_;
+  HttpClientOptions options_;
+  std::string       host_;
+
+  std::unordered_map<Link*, std::shared_ptr<Link>> links_;
+  std::vector<Link*>                               idle_;  // the most recently used last
+  std::deque<Exchange>                             waiting_;
+  std::size_t                                      connecting_{0};
+
+  void Open();
+  void Connected(Link& link);
+  void ConnectFailed(Link& link);
+  void Dispatch(Link& link, Exchange exchange);
+  void Receive(Link& link, util::MsgBuffer& buf);
+  // Relay the response body of the exchange to its peer.
+  void RelayResponse(Link& link);
+  // Called when a relay of the exchange with the given serial ended.
+  void RelayEnded(Link& link, uint64_t serial, bool complete, bool response);
+  void Closed(Link& link);
+  // Finish the request in flight, the connection goes back to the pool if it can be reused.
+  void Complete(Link& link, HttpClientError error, bool reusable = true);
+  void Release(Link& link);
+  void Remove(Link& link);
+  void SetTimer(Link& link, std::chrono::steady_clock::duration delay, HttpClientError error);
+};
+
+void HttpClient::Pool::Send(Exchange exchange) {
+  if (!idle_.empty()) {
+    auto* link = idle_.back();
+    idle_.pop_back();
+    Dispatch(*link, std::move(exchange));
+    return;
+  }
+  waiting_.push_back(std::move(exchange));
+  if (links_.size() < options_.max_connections && connecting_ < waiting_.size()) {
+    Open();
+  }
+}
+
+void HttpClient::Pool::Shutdown() {
+  waiting_.clear();
+  idle_.clear();
+  for (auto& [raw, link] : links_) {
+    if (link->timer != 0) {
+      loop_->Cancel(link->timer);
+    }
+  }
+  links_.clear();
+}
+
+void HttpClient::Pool::Open() {
+  auto  link   = std::make_shared<Link>();
+  auto* raw    = link.get();
+  link->client = std::make_unique<TcpClient>(loop_, upstream_);
+  link->client->SetConnectTimeout(options_.connect_timeout);
+  // The handlers end with the client, which is owned by the link.
+  link->client->OnConnection([this, raw](std::shared_ptr<TcpConnection> const& conn) {
+    if (conn->IsConnected()) {
+      Connected(*raw);
+    } else {
+      Closed(*raw);
+    }
+  });
+  link->client->OnReceiveMessage(
+      [this, raw](std::shared_ptr<TcpConnection> const& /*unused*/, util::MsgBuffer& buf) { Receive(*raw, buf); });
+  link->client->OnConnectError([this, raw](int /*unused*/) { ConnectFailed(*raw); });
+  links_.emplace(raw, std::move(link));
+  ++connecting_;
+  raw->client->Connect();
+}
+
+void HttpClient::Pool::Connected(Link& link) {
+  --connecting_;
+  Release(link);
+}
+
+void HttpClient::Pool::ConnectFailed(Link& link) {
+  --connecting_;
+  Remove(link);
+  if (waiting_.empty()) {
+    return;
+  }
+  auto exchange = std::move(waiting_.front());
+  waiting_.pop_front();
+  if (!waiting_.empty() && connecting_ < waiting_.size() && links_.size() < options_.max_connections) {
+    Open();
+  }
+  HttpResponse response(true);
+  exchange.callback(HttpClientError::kConnectFailed, response);
+}
+
+void HttpClient::Pool::Dispatch(Link& link, Exchange exchange) {
+  auto const& req = exchange.request;
+  link.parser.Reset(req.GetMethod() == Method::kHead, options_.max_response_size, exchange.splice.response_threshold);
+
+  std::string out;
+  out += MethodName(req.GetMethod());
+  out += ' ';
+  out += req.GetPath().empty() ? "/" : req.GetPath();
+  if (!req.GetQuery().empty()) {
+    if (req.GetQuery().front() != '?') {
+      out += '?';
+    }
+    out += req.GetQuery();
+  }
+  out += " HTTP/1.1\r\n";
+  if (!req.HasHeader(HeaderId::kHost)) {
+    out += "Host: " + host_ + "\r\n";
+  }
+  for (auto const& [name, value] : req.GetHeaders()) {
+    if (util::EqualsIgnoreCase(name, HeaderName(HeaderId::kContentLength)) ||
+        util::EqualsIgnoreCase(name, HeaderName(HeaderId::kTransferEncoding))) {
+      continue;
+    }
+    out += name + ": " + value + "\r\n";
+  }
+  auto body_size = req.GetBody().size() + exchange.splice.request_body;
+  if (body_size > 0 || req.GetMethod() == Method::kPost || req.GetMethod() == Method::kPut) {
+    out += "Content-Length: " + std::to_string(body_size) + "\r\n";
+  }
+  out += "\r\n";
+  out += req.GetBody();
+
+  auto const& conn = link.client->GetConnection();
+  link.exchange    = std::move(exchange);
+  link.serial     += 1;
+  SetTimer(link, options_.request_timeout, HttpClientError::kTimeout);
+  conn->Send(out);
+  if (auto const& splice = link.exchange->splice; splice.request_body > 0) {
+    link.relaying_request = true;
+    conn->Splice(splice.peer, splice.request_body,
+                 [weak = weak_from_this(), target = std::weak_ptr<Link>(links_.at(&link)), serial = link.serial,
+                  on_request_body = splice.on_request_body](bool complete) {
+                   if (on_request_body) {
+                     on_request_body(complete);
+                   }
+                   auto pool = weak.lock();
+                   auto link = target.lock();
+                   if (pool && link) {
+                     pool->RelayEnded(*link, serial, complete, false);
+                   }
+                 });
+  }
+}
+
+void HttpClient::Pool::Receive(Link& link, util::MsgBuffer& buf) {
+  if (!link.exchange) {
+    // Nothing was asked on this connection.
+    Remove(link);
+    return;
+  }
+  if (!link.parser.Parse(buf)) {
+    Complete(link, HttpClientError::kBadResponse);
+    return;
+  }
+  if (link.parser.Relayed()) {
+    RelayResponse(link);
+    return;
+  }
+  if (link.parser.Complete()) {
+    // Whatever follows the response was not asked for, the connection can't be reused then.
+    bool reusable = buf.ReadableSize() == 0;
+    buf.RetrieveAll();
+    Complete(link, HttpClientError::kNone, reusable);
+  }
+}
+
+void HttpClient::Pool::RelayResponse(Link& link) {
+  auto const& splice = link.exchange->splice;
+  auto        length = link.parser.GetRelayLength();
+  // The body goes at the pace of the peer, a slow one must not time the exchange out.
+  if (link.timer != 0) {
+    loop_->Cancel(link.timer);
+    link.timer = 0;
+  }
+  splice.on_head(link.parser.GetResponse(), length);
+  // The upstream's bytes read already are taken from the buffer being parsed.
+  splice.peer->Splice(link.client->GetConnection(), length,
+                      [weak = weak_from_this(), target = std::weak_ptr<Link>(links_.at(&link)), serial = link.serial](
+                          bool complete) {
+                        auto pool = weak.lock();
+                        auto link = target.lock();
+                        if (pool && link) {
+                          pool->RelayEnded(*link, serial, complete, true);
+                        }
+                      });
+}
+
+void HttpClient::Pool::RelayEnded(Link& link, uint64_t serial, bool complete, bool response) {
+  if (!response) {
+    link.relaying_request = false;
+  }
+  if (!link.exchange || link.serial != serial) {
+    return;
+  }
+  if (!complete) {
+    Complete(link, HttpClientError::kConnectionClosed, false);
+  } else if (response) {
+    link.parser.FinishRelay();
+    Complete(link, HttpClientError::kNone);
+  }
+}
+
+void HttpClient::Pool::Closed(Link& link) {
+  if (!link.exchange) {
+    Remove(link);
+    return;
+  }
+  if (link.parser.FinishAtClose()) {
+    Complete(link, HttpClientError::kNone);
+    return;
+  }
+  // The upstream may have timed the idle connection out just as the request was sent.
+  auto& exchange = *link.exchange;
+  if (link.reused && !link.parser.Started() && !exchange.retried && exchange.splice.request_body == 0 &&
+      IsIdempotent(exchange.request.GetMethod())) {
+    auto retry    = std::move(exchange);
+    retry.retried = true;
+    link.exchange.reset();
+    Remove(link);
+    Send(std::move(retry));
+    return;
+  }
+  Complete(link, HttpClientError::kConnectionClosed);
+}
+
+void HttpClient::Pool::Complete(Link& link, HttpClientError error, bool reusable) {
+  if (link.timer != 0) {
+    loop_->Cancel(link.timer);
+    link.timer = 0;
+  }
+  auto exchange = std::move(*link.exchange);
+  link.exchange.reset();
+  // Taken before the connection serves the next waiting request.
+  auto response = std::move(link.parser.GetResponse());
+  // A request body still being relayed would be taken for the next request.
+  reusable = reusable && !link.relaying_request;
+  if (error == HttpClientError::kNone && reusable && link.parser.KeepAlive() && link.client->GetConnection()) {
+    link.reused = true;
+    Release(link);
+  } else {
+    Remove(link);
+  }
+  exchange.callback(error, response);
+}
+
+void HttpClient::Pool::Release(Link& link) {
+  if (!waiting_.empty()) {
+    auto exchange = std::move(waiting_.front());
+    waiting_.pop_front();
+    Dispatch(link, std::move(exchange));
+    return;
+  }
+  idle_.push_back(&link);
+  SetTimer(link, options_.idle_timeout, HttpClientError::kNone);
+}
+
+void HttpClient::Pool::Remove(Link& link) {
+  auto it = links_.find(&link);
+  if (it == links_.end()) {
+    return;
+  }
+  if (link.timer != 0) {
+    loop_->Cancel(link.timer);
+    link.timer = 0;
+  }
+  if (auto idle = std::find(idle_.begin(), idle_.end(), &link); idle != idle_.end()) {
+    idle_.erase(idle);
+  }
+  // This may run in a handler of the link's client, free it after the loop iteration.
+  loop_->QueueInLoop([link = std::move(it->second)] {});
+  links_.erase(it);
+}
+
+void HttpClient::Pool::SetTimer(Link& link, std::chrono::steady_clock::duration delay, HttpClientError error) {
+  if (link.timer != 0) {
+    loop_->Cancel(link.timer);
+  }
+  std::weak_ptr<Pool> weak   = shared_from_this();
+  std::weak_ptr<Link> target = links_.at(&link);
+  link.timer                 = loop_->RunAfter(delay, [weak, target, error] {
+    auto pool = weak.lock();
+    auto link = target.lock();
+    if (!pool || !link) {
+      return;
+    }
+    link->timer = 0;
+    if (link->exchange) {
+      pool->Complete(*link, error);
+    } else {
+      pool->Remove(*link);
+    }
+  });
+}
+
+HttpClient::HttpClient(InetAddr const& upstream, HttpClientOptions options)
+    : upstream_(upstream), options_(options) {}
+
+HttpClient::~HttpClient() {
+  std::lock_guard lock(pools_->mutex);
+  for (auto& [loop, pool] : pools_->pools) {
+    loop->RunInLoop([pool = std::move(pool)] { pool->Shutdown(); });
+  }
+}
+
+void HttpClient::Send(HttpRequest req, HttpClientCallback callback) {
+  auto* loop = EventLoop::GetEventLoopOfCurrentThread();
+  if (loop == nullptr) {
+    throw std::runtime_error("HttpClient::Send called outside of a loop thread");
+  }
+  GetPool(loop)->Send({.request = std::move(req), .callback = std::move(callback)});
+}
+
+void HttpClient::Send(HttpRequest req, HttpClientCallback callback, HttpClientSplice splice) {
+  auto* loop = splice.peer->GetEventLoop();
+  if (!loop->IsInLoopThread()) {
+    throw std::runtime_error("HttpClient::Send with a splice called outside of the peer's loop");
+  }
+  GetPool(loop)->Send({.request = std::move(req), .callback = std::move(callback), .splice = std::move(splice)});
+}
+
+void HttpClient::Send(EventLoop* loop, HttpRequest req, HttpClientCallback callback) {
+  if (loop->IsInLoopThread()) {
+    GetPool(loop)->Send({.request = std::move(req), .callback = std::move(callback)});
+    return;
+  }
+  loop->QueueInLoop([pool = GetPool(loop), req = std::move(req), callback = std::move(callback)]() mutable {
+    pool->Send({.request = std::move(req), .callback = std::move(callback)});
+  });
+}
+
+std::shared_ptr<HttpClient::Pool> HttpClient::GetPool(EventLoop* loop) {
+  std::lock_guard lock(pools_->mutex);
+  auto&           pool = pools_->pools[loop];
+  if (!pool) {
+    pool = std::make_shared<Pool>(loop, upstream_, options_);
+    // Loops of an elastic group stop while the client lives on.
+    loop->RunOnQuit([pools = std::weak_ptr(pools_), loop] {
+      if (auto alive = pools.lock()) {
+        std::lock_guard lock(alive->mutex);
+        alive->pools.erase(loop);
+      }
+    });
+  }
+  return pool;
+}
+
+}  // namespace simple_http::net::http
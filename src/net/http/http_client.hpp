@@ -0,0 +1,97 @@
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <unordered_map>
+
+#include "net/event_loop.hpp"
+#include "net/http/http_request.hpp"
+#include "net/http/http_response.hpp"
+#include "net/inet_addr.hpp"
+#include "net/tcp_connection.hpp"
+#include "utils/non_copyable.hpp"
+
+namespace simple_http::net::http {
+
+enum class HttpClientError {
+  kNone,
+  kConnectFailed,
+  kTimeout,           // no complete response within the request timeout
+  kConnectionClosed,  // the upstream closed before the response was complete
+  kBadResponse,       // malformed or larger than max_response_size
+};
+
+[[nodiscard]] std::string_view HttpClientErrorName(HttpClientError error);
+
+struct HttpClientOptions {
+  std::chrono::milliseconds connect_timeout{3000};
+  std::chrono::milliseconds request_timeout{30000};
+  std::chrono::seconds      idle_timeout{60};  // pooled connections unused this long are closed
+  std::size_t               max_connections{64};  // per loop, further requests wait for a free one
+  std::size_t               max_response_size{64 * 1024 * 1024};
+};
+
+// The response is only meaningful without an error.
+using HttpClientCallback = std::function<void(HttpClientError error, HttpResponse& response)>;
+
+/**
+ * @brief Relays the bodies of an exchange between the upstream and another connection of the same
+ * loop with TcpConnection::Splice, without buffering them, e.g. for a proxy.
+ *
+ */
+struct HttpClientSplice {
+  std::shared_ptr<TcpConnection> peer;
+  // Request body bytes still to come from peer, relayed behind the request.
+  std::size_t request_body{0};
+  // Told whether the request body got through once its relay ends, never if the request was not written.
+  std::function<void(bool complete)> on_request_body;
+  // A response body with at least this Content-Length is relayed to peer instead of buffered.
+  std::size_t response_threshold{std::numeric_limits<std::size_t>::max()};
+  // Gets the head of a relayed response and has to write it to peer. The callback then gets the
+  // response without its body, and an error if the relay broke off.
+  std::function<void(HttpResponse& head, std::size_t body_length)> on_head;
+};
+
+/**
+ * @brief HTTP/1.1 client of one upstream. Every loop keeps its own pool of keep-alive connections
+ * to it, so a request is written, answered and calls back on the loop it was sent from, reusing
+ * the most recently used idle connection.
+ *
+ * Requests that found their pooled connection closed by the upstream before any response byte
+ * are retried once on a new connection if their method is idempotent.
+ *
+ */
+struct HttpClient : public util::NonCopyable {
+ public:
+  explicit HttpClient(InetAddr const& upstream, HttpClientOptions options = {});
+  ~HttpClient();
+
+  // Send req from a loop thread. The Host header defaults to the upstream address.
+  void Send(HttpRequest req, HttpClientCallback callback);
+  // Send req on loop, from any thread.
+  void Send(EventLoop* loop, HttpRequest req, HttpClientCallback callback);
+  // Send req from the loop thread of splice.peer, relaying bodies as splice asks.
+  void Send(HttpRequest req, HttpClientCallback callback, HttpClientSplice splice);
+
+  [[nodiscard]] InetAddr const& GetUpstream() const { return upstream_; }
+
+ private:
+  struct Pool;
+
+  InetAddr          upstream_;
+  HttpClientOptions options_;
+
+  struct Pools {
+    std::mutex                                            mutex;
+    std::unordered_map<EventLoop*, std::shared_ptr<Pool>> pools;
+  };
+  // Shared with the loops, which drop their pool when they quit before the client goes away.
+  std::shared_ptr<Pools> pools_{std::make_shared<Pools>()};
+
+  std::shared_ptr<Pool> GetPool(EventLoop* loop);
+};
+}  // namespace simple_http::net::http
@@ -1,10 +1,30 @@
 #pragma once
 
+#include <memory>
+#include <optional>
+#include <vector>
+
 #include "net/http/http.hpp"
+#include "net/http/http2_session.hpp"
 #include "net/http/http_request.hpp"
+#include "net/http/http_response.hpp"
+#include "net/http/websocket.hpp"
+#include "utils/latency_histogram.hpp"
 #include "utils/msg_buffer.hpp"
 
 namespace simple_http::net::http {
+// A response whose body is still being pulled from its provider.
+struct ResponseStream {
+  HttpResponse::BodyProvider     provider;
+  bool                           chunked{false};
+  bool                           close{false};
+  StatusCode                     status{};
+  std::size_t                    sent{0};  // body bytes, without the chunk framing
+  std::optional<std::size_t>     length;   // the Content-Length sent, if not chunked
+  HttpRequest                    request;  // kept for the access log
+  util::ShardedLatencyHistogram* latency{nullptr};
+};
+
 struct HttpContext {
  public:
   enum class HttpRequestParseState {
@@ -30,10 +50,58 @@ struct HttpContext {
     request_.Swap(dummy);
   }
 
+  /**
+   * @brief Remember a response that is still queued in the connection, its latency is recorded
+   * once the write buffer drains.
+   *
+   */
+  void AddPendingLatency(util::ShardedLatencyHistogram* histogram, Timepoint receive_time) {
+    pending_latencies_.emplace_back(histogram, receive_time);
+  }
+
+  void FlushPendingLatencies(Timepoint now) {
+    for (auto const& [histogram, receive_time] : pending_latencies_) {
+      histogram->Record(now - receive_time);
+    }
+    pending_latencies_.clear();
+  }
+
+  // Between two requests: nothing of the next one parsed and no response in progress.
+  [[nodiscard]] bool IsIdle() const {
+    return state_ == HttpRequestParseState::kExpectRequestLine && !stream_ && !awaiting_response_;
+  }
+
+  // Set while a streamed response is sent, requests pipelined behind it wait until it ended.
+  [[nodiscard]] std::shared_ptr<ResponseStream> const& GetStream() const { return stream_; }
+  void SetStream(std::shared_ptr<ResponseStream> stream) { stream_ = std::move(stream); }
+
+  // Set while an asynchronous handler has not answered yet, the next request waits until it did.
+  [[nodiscard]] bool IsAwaitingResponse() const { return awaiting_response_; }
+  void               SetAwaitingResponse(bool on) { awaiting_response_ = on; }
+
+  // Set once the connection answers with an event stream, whatever the client sends then is dropped.
+  [[nodiscard]] bool IsEventStream() const { return event_stream_; }
+  void               SetEventStream(bool on) { event_stream_ = on; }
+
+  // Set once the connection switched to HTTP/2, which then handles all of its input.
+  [[nodiscard]] std::shared_ptr<Http2Session> const& GetHttp2() const { return http2_; }
+  void SetHttp2(std::shared_ptr<Http2Session> session) { http2_ = std::move(session); }
+
+  // Set once the connection was upgraded to a WebSocket.
+  [[nodiscard]] WebSocketSessionPtr const& GetWebSocket() const { return websocket_; }
+  void SetWebSocket(WebSocketSessionPtr session) { websocket_ = std::move(session); }
+
  private:
   bool ProcessRequestLine(char const* begin, char const* end);
 
   HttpRequestParseState state_{};
   HttpRequest           request_;
+
+  std::vector<std::pair<util::ShardedLatencyHistogram*, Timepoint>> pending_latencies_;
+  std::shared_ptr<Http2Session>                                      http2_;
+  WebSocketSessionPtr                                                websocket_;
+  std::shared_ptr<ResponseStream>                                    stream_;
+  bool                                                               event_stream_{false};
+  bool                                                               awaiting_response_{false};
 };
 }  // namespace simple_http::net::http
\ No newline at end of file
@@ -0,0 +1,34 @@
+#include <array>
+
+#include "http_date.hpp"
+
+namespace simple_http::net::http {
+
+namespace {
+constexpr std::array<char const*, 3> kDateFormats{
+    "%a, %d %b %Y %H:%M:%S GMT",  // IMF-fixdate
+    "%A, %d-%b-%y %H:%M:%S GMT",  // RFC 850
+    "%a %b %e %H:%M:%S %Y",       // asctime
+};
+}  // namespace
+
+std::string FormatHttpDate(std::time_t time) {
+  std::tm tm{};
+  ::gmtime_r(&time, &tm);
+  char buf[32];
+  auto n = std::strftime(buf, sizeof(buf), kDateFormats[0], &tm);
+  return {buf, n};
+}
+
+std::optional<std::time_t> ParseHttpDate(std::string_view date) {
+  std::string text{date};
+  for (auto const* format : kDateFormats) {
+    std::tm tm{};
+    auto const* end = ::strptime(text.c_str(), format, &tm);
+    if (end != nullptr && *end == '\0') {
+      return ::timegm(&tm);
+    }
+  }
+  return std::nullopt;
+}
+}  // namespace simple_http::net::http
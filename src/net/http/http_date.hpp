@@ -0,0 +1,15 @@
+#pragma once
+
+#include <ctime>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace simple_http::net::http {
+
+// The time as an IMF-fixdate, e.g. "Sun, 06 Nov 1994 08:49:37 GMT".
+[[nodiscard]] std::string FormatHttpDate(std::time_t time);
+
+// Parse an IMF-fixdate, or one of the obsolete RFC 850 and asctime formats.
+[[nodiscard]] std::optional<std::time_t> ParseHttpDate(std::string_view date);
+}  // namespace simple_http::net::http
@@ -18,14 +18,16 @@ struct HttpRequest {
   [[nodiscard]] auto const& GetPath() const { return path_; }
   [[nodiscard]] auto const& GetQuery() const { return query_; }
   [[nodiscard]] auto const& GetReceiveTime() const { return receiveTime_; }
-  [[nodiscard]] auto const& GetHeaders() const { return headers_; }
+  [[nodiscard]] auto const& GetHeaders() const { return headers_.GetMap(); }
+  [[nodiscard]] auto const& GetBody() const { return body_; }
 
   void SetVersion(Version v) { version_ = v; }
   void SetMethod(Method m) { method_ = m; }
   void SetPath(std::string_view path) { path_ = path; }
   void SetQuery(std::string_view query) { query_ = query; }
   void SetReceiveTime(std::chrono::steady_clock::time_point time) { receiveTime_ = time; }
-  void SetHeaders(Headers headers) { headers_ = std::move(headers); }
+  void SetHeaders(Headers headers) { headers_ = HeaderFields{std::move(headers)}; }
+  void SetBody(std::string body) { body_ = std::move(body); }
 
   [[nodiscard]] bool TrySetVersion(std::string_view version) {
     version_ = ParseVersion(version);
@@ -40,6 +42,7 @@ struct HttpRequest {
   [[nodiscard]] constexpr auto VersionString() const { return VersionName(version_); }
   [[nodiscard]] constexpr auto MethodString() const { return MethodName(method_); }
 
+  // Keeps the first value of a field that is set twice.
   void SetHeader(std::string_view key, std::string_view val) {
     if (key.empty()) {
       return;
@@ -48,25 +51,28 @@ struct HttpRequest {
       return;
     }
 
-    headers_.emplace(key, val);
+    headers_.Add(key, val);
   }
+  void SetHeader(HeaderId id, std::string_view val) { SetHeader(HeaderName(id), val); }
 
-  [[nodiscard]] std::string GetHeader(std::string_view key) const {
-    auto it = headers_.find(std::string{key});
-    if (it != headers_.end()) {
-      return it->second;
-    }
-    return {};
-  }
+  [[nodiscard]] std::string GetHeader(std::string_view key) const { return std::string{GetHeaderView(key)}; }
+  [[nodiscard]] std::string GetHeader(HeaderId id) const { return std::string{GetHeaderView(id)}; }
 
-  void RemoveHeader(std::string_view key) {
-    auto it = headers_.find(std::string{key});
-    if (it != headers_.end()) {
-      headers_.erase(it);
-    }
+  // Like GetHeader, without copying. The view is valid as long as the request is.
+  [[nodiscard]] std::string_view GetHeaderView(std::string_view key) const {
+    auto const* value = headers_.Find(key);
+    return value != nullptr ? std::string_view{*value} : std::string_view{};
   }
+  [[nodiscard]] std::string_view GetHeaderView(HeaderId id) const {
+    auto const* value = headers_.Find(id);
+    return value != nullptr ? std::string_view{*value} : std::string_view{};
+  }
+
+  void RemoveHeader(std::string_view key) { headers_.Remove(key); }
+  void RemoveHeader(HeaderId id) { headers_.Remove(id); }
 
-  [[nodiscard]] bool HasHeader(std::string_view key) const { return headers_.find(std::string{key}) != headers_.end(); }
+  [[nodiscard]] bool HasHeader(std::string_view key) const { return headers_.Find(key) != nullptr; }
+  [[nodiscard]] bool HasHeader(HeaderId id) const { return headers_.Find(id) != nullptr; }
 
   void Swap(HttpRequest& that) {
     std::swap(method_, that.method_);
@@ -74,13 +80,14 @@ struct HttpRequest {
     path_.swap(that.path_);
     query_.swap(that.query_);
     std::swap(receiveTime_, that.receiveTime_);
-    headers_.swap(that.headers_);
+    headers_.Swap(that.headers_);
+    body_.swap(that.body_);
   }
 
  private:
   Method                                method_{};
   std::string                           path_;
-  Headers                               headers_;
+  HeaderFields                          headers_;
   std::string                           body_;
   Version                               version_{};
   std::string                           query_;
@@ -1,37 +1,158 @@
 #pragma once
 
-#include <fstream>
+#include <functional>
+#include <memory>
+#include <optional>
 #include <sstream>
 #include <string>
 #include <string_view>
+#include <vector>
 
+#include "net/file_range.hpp"
 #include "net/http/http.hpp"
 #include "utils/msg_buffer.hpp"
 
 namespace simple_http::net::http {
+// A piece of a body sent from memory, followed by a file range if it has one.
+struct BodyPart {
+  std::string                data;
+  std::shared_ptr<FileRange> file;
+};
+
 struct HttpResponse {
  public:
+  // Appends the next part of a streamed body to out, returns false once out got the last part.
+  using BodyProvider = std::function<bool(std::string& out)>;
+
   explicit HttpResponse(bool close) : closeConnection_(close) {}
 
-  [[nodiscard]] std::string_view GetBody() const { return body_; }
-  [[nodiscard]] std::string_view GetStatusMessage() const { return statusMessage_; }
+  [[nodiscard]] std::string_view GetBody() const { return shared_body_ ? *shared_body_ : body_; }
+  [[nodiscard]] auto const&      GetSharedBody() const { return shared_body_; }
+  [[nodiscard]] auto const&      GetHeaders() const { return headers_.GetMap(); }
+  [[nodiscard]] auto const&      GetFileBody() const { return file_; }
+  [[nodiscard]] auto const&      GetBodyParts() const { return parts_; }
+  [[nodiscard]] std::size_t      GetBodySize() const {
+    if (provider_) {
+      return stream_length_.value_or(0);
+    }
+    if (!parts_.empty()) {
+      std::size_t size = 0;
+      for (auto const& part : parts_) {
+        size += part.data.size() + (part.file ? part.file->GetLength() : 0);
+      }
+      return size;
+    }
+    return file_ ? file_->GetLength() : GetBody().size();
+  }
+  [[nodiscard]] StatusCode       GetStatusCode() const { return statusCode_; }
+  // The message set, or the reason phrase of the code.
+  [[nodiscard]] std::string_view GetStatusMessage() const {
+    return statusMessage_.empty() ? ReasonPhrase(statusCode_) : std::string_view{statusMessage_};
+  }
 
   void SetStatusCode(StatusCode code) { statusCode_ = code; }
   void SetStatusCode(unsigned int code) { statusCode_ = static_cast<StatusCode>(code); }
   void SetStatusMessage(std::string_view message) { statusMessage_ = message; }
   void SetCloseConnection(bool on) { closeConnection_ = on; }
-  void SetContentType(std::string_view content_type) { SetHeader("Content-Type", content_type); }
-  void SetBody(std::string_view body) { body_ = body; }
+  void SetContentType(std::string_view content_type) { SetHeader(HeaderId::kContentType, content_type); }
+  void SetBody(std::string_view body) {
+    body_ = body;
+    shared_body_.reset();
+    file_.reset();
+    parts_.clear();
+    provider_ = nullptr;
+  }
+  void SetBody(std::string&& body) {
+    body_ = std::move(body);
+    shared_body_.reset();
+    file_.reset();
+    parts_.clear();
+    provider_ = nullptr;
+  }
+  void SetBody(char const* body) { SetBody(std::string_view{body}); }
+
+  /**
+   * @brief Send a body shared with other responses, e.g. a cached one. It is not copied, the
+   * connection holds a reference until it is written.
+   *
+   */
+  void SetSharedBody(std::shared_ptr<std::string const> body) {
+    body_.clear();
+    shared_body_ = std::move(body);
+    file_.reset();
+    parts_.clear();
+    provider_ = nullptr;
+  }
+
+  /**
+   * @brief Send the file as the body. It is not read into memory, the connection sends it with
+   * sendfile after the headers written by WriteTo.
+   *
+   */
   void SetFileBody(std::string_view file_path) {
-    std::fstream fs(file_path.data(), std::ios::in | std::ios::binary);
-    if (!fs.is_open()) {
+    auto file = FileRange::Open(std::string{file_path});
+    if (!file) {
       return;
     }
-    body_.assign(std::istreambuf_iterator<char>(fs), std::istreambuf_iterator<char>());
+    SetFileBody(std::move(file));
+  }
+  void SetFileBody(std::shared_ptr<FileRange> file) {
+    body_.clear();
+    shared_body_.reset();
+    parts_.clear();
+    file_     = std::move(file);
+    provider_ = nullptr;
+  }
+
+  /**
+   * @brief Send the body as a sequence of pieces, e.g. the parts of a multipart/byteranges
+   * response. Their file ranges are sent with sendfile like a file body.
+   *
+   */
+  void SetBodyParts(std::vector<BodyPart> parts) {
+    body_.clear();
+    shared_body_.reset();
+    file_.reset();
+    parts_    = std::move(parts);
+    provider_ = nullptr;
+  }
+
+  /**
+   * @brief Stream the body from provider once the headers are sent. The server asks for the next
+   * part whenever the connection's write buffer ran low, so only a few parts are in memory at a
+   * time. Without a length the body is sent with chunked transfer coding, or until the
+   * connection closes for HTTP/1.0 clients.
+   *
+   */
+  void SetBodyProvider(BodyProvider provider, std::optional<std::size_t> length = std::nullopt) {
+    body_.clear();
+    shared_body_.reset();
+    file_.reset();
+    parts_.clear();
+    provider_      = std::move(provider);
+    stream_length_ = length;
+  }
+
+  [[nodiscard]] bool         IsStreaming() const { return static_cast<bool>(provider_); }
+  [[nodiscard]] bool         IsChunked() const { return provider_ && !stream_length_ && !closeConnection_; }
+  [[nodiscard]] auto const&  GetStreamLength() const { return stream_length_; }
+  [[nodiscard]] BodyProvider TakeBodyProvider() {
+    auto provider = std::move(provider_);
+    provider_     = nullptr;
+    return provider;
   }
 
   [[nodiscard]] bool IsCloseConnection() const { return closeConnection_; }
 
+  [[nodiscard]] std::string_view GetHeader(std::string_view key) const {
+    auto const* value = headers_.Find(key);
+    return value != nullptr ? std::string_view{*value} : std::string_view{};
+  }
+  [[nodiscard]] std::string_view GetHeader(HeaderId id) const {
+    auto const* value = headers_.Find(id);
+    return value != nullptr ? std::string_view{*value} : std::string_view{};
+  }
+
   void SetHeader(std::string_view key, std::string_view val) {
     if (key.empty()) {
       return;
@@ -40,22 +161,46 @@ struct HttpResponse {
       return;
     }
 
-    headers_.emplace(key, val);
+    headers_.Set(key, val);
+  }
+  void SetHeader(HeaderId id, std::string_view val) {
+    if (HasCrlf(val)) {
+      return;
+    }
+    headers_.Set(id, val);
   }
 
+  void RemoveHeader(std::string_view key) { headers_.Remove(key); }
+  void RemoveHeader(HeaderId id) { headers_.Remove(id); }
+
+  // Writes the status line, the headers and an in-memory body. A shared, file, parts or streamed body is sent
+  // separately.
+
   void WriteTo(util::MsgBuffer& output) const {
     std::stringstream ss;
 
-    ss << "HTTP/1.1 " << static_cast<int>(statusCode_) << " " << statusMessage_ << "\r\n";
+    // Most responses carry the reason phrase of their code, their status line is precomputed.
+    if (auto line = StatusLine(statusCode_);
+        !line.empty() && (statusMessage_.empty() || statusMessage_ == ReasonPhrase(statusCode_))) {
+      ss << line;
+    } else {
+      ss << "HTTP/1.1 " << static_cast<int>(statusCode_) << " " << statusMessage_ << "\r\n";
+    }
 
     if (closeConnection_) {
       ss << "Connection: close\r\n";
+    } else if (IsChunked()) {
+      ss << "Transfer-Encoding: chunked\r\n"
+         << "Connection: Keep-Alive\r\n";
+    } else if (statusCode_ == StatusCode::k304NotModified) {
+      // Never has a body, a Content-Length would have to be that of the full response.
+      ss << "Connection: Keep-Alive\r\n";
     } else {
-      ss << "Content-Length: " << body_.size() << "\r\n"
+      ss << "Content-Length: " << GetBodySize() << "\r\n"
          << "Connection: Keep-Alive\r\n";
     }
 
-    for (auto const& header : headers_) {
+    for (auto const& header : headers_.GetMap()) {
       ss << header.first << ": " << header.second << "\r\n";
     }
 
@@ -65,11 +210,18 @@ struct HttpResponse {
   }
 
  private:
-  Headers     headers_;
-  StatusCode  statusCode_{};
-  Version     version_{Version::kHttp10};
-  std::string statusMessage_;
-  bool        closeConnection_;
-  std::string body_;
+  HeaderFields headers_;
+  StatusCode   statusCode_{};
+  Version      version_{Version::kHttp10};
+  std::string  statusMessage_;
+  bool         closeConnection_;
+  std::string  body_;
+
+  std::shared_ptr<std::string const> shared_body_;
+  std::shared_ptr<FileRange>         file_;
+  std::vector<BodyPart>              parts_;
+
+  BodyProvider               provider_;
+  std::optional<std::size_t> stream_length_;
 };
 }  // namespace simple_http::net::http
\ No newline at end of file
@@ -1,21 +1,298 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <charconv>
 #include <chrono>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <random>
+#include <stdexcept>
 #include <string_view>
 
 #include <sys/stat.h>
 #include <unistd.h>
 
+#include "net/file_range.hpp"
+
 #include "http_context.hpp"
 #include "http_server.hpp"
+#include "net/http/byte_range.hpp"
+#include "net/http/conditional.hpp"
 #include "net/http/http.hpp"
+#include "net/http/http_date.hpp"
+#include "utils/base64.hpp"
+#include "utils/logger.hpp"
+#include "utils/metrics.hpp"
 #include "utils/msg_buffer.hpp"
 
 namespace simple_http::net::http {
 
 using util::MsgBuffer;
 
+namespace {
+constexpr std::string_view kServiceUnavailable =
+    "HTTP/1.1 503 Service Unavailable\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+
+enum class CacheLookup {
+  kHit,
+  kStale,      // served while the handler computes its successor
+  kMiss,       // the handler ran for it
+  kCoalesced,  // waited for the handler running for another request
+};
+
+struct HttpMetrics {
+  std::array<util::Counter*, static_cast<size_t>(Method::kDelete) + 1> requests{};
+  std::array<util::Counter*, 6>                                         responses{};  // by status class, 0 for others
+  util::Counter&                                                        bad_requests;
+  std::array<util::Counter*, 4>                                         cache_lookups{};  // by CacheLookup
+  util::Histogram&                                                      request_duration;
+
+  static HttpMetrics& Get() {
+    static HttpMetrics metrics = [] {
+      auto&       registry = util::MetricsRegistry::Global();
+      HttpMetrics m{
+          .bad_requests = registry.GetCounter("simple_http_http_bad_requests_total", "Requests that failed to parse."),
+          .request_duration = registry.GetHistogram("simple_http_http_request_duration_seconds",
+                                                    "Time from receiving a request to sending its response.",
+                                                    util::Histogram::LatencyBounds()),
+      };
+      for (size_t i = 0; i < m.requests.size(); ++i) {
+        m.requests[i] = &registry.GetCounter("simple_http_http_requests_total", "Requests received by method.",
+                                             {{"method", MethodName(static_cast<Method>(i))}});
+      }
+      constexpr std::array<char const*, 4> kCacheResults{"hit", "stale", "miss", "coalesced"};
+      for (size_t i = 0; i < m.cache_lookups.size(); ++i) {
+        m.cache_lookups[i] = &registry.GetCounter("simple_http_http_cache_lookups_total",
+                                                  "Requests of cached routes by how the cache answered them.",
+                                                  {{"result", kCacheResults[i]}});
+      }
+      constexpr std::array<char const*, 6> kClasses{"other", "1xx", "2xx", "3xx", "4xx", "5xx"};
+      for (size_t i = 0; i < m.responses.size(); ++i) {
+        m.responses[i] = &registry.GetCounter("simple_http_http_responses_total", "Responses sent by status class.",
+                                              {{"code", kClasses[i]}});
+      }
+      return m;
+    }();
+    return metrics;
+  }
+
+  void RecordCacheLookup(CacheLookup result) { cache_lookups[static_cast<size_t>(result)]->Increment(); }
+
+  void RecordResponse(StatusCode code) {
+    auto cls = static_cast<size_t>(code) / 100;
+    responses[cls < responses.size() ? cls : 0]->Increment();
+  }
+};
+
+constexpr std::string_view kRouteLatencyMetric = "simple_http_http_route_latency_seconds";
+
+constexpr std::array<std::pair<double, char const*>, 4> kLatencyQuantiles{{
+    {0.5, "0.5"},
+    {0.9, "0.9"},
+    {0.99, "0.99"},
+    {0.999, "0.999"},
+}};
+
+constexpr std::string_view kSwitchingToHttp2 =
+    "HTTP/1.1 101 Switching Protocols\r\nConnection: Upgrade\r\nUpgrade: h2c\r\n\r\n";
+
+// HTTP/2 responses are framed into the connection's write buffer up to this many bytes at a time,
+// more once it drained.
+constexpr std::size_t kHttp2WriteBudget = 256 * 1024;
+
+// Streamed bodies are pulled from their provider until this many bytes wait in the write buffer,
+// the rest once it drained.
+constexpr std::size_t kStreamWriteBudget = 64 * 1024;
+
+// While draining, how long a keep-alive connection may stay idle before it is closed. Clients
+// keeping it busy get their connection closed by the next response instead, without a race
+// against a request they are sending.
+constexpr std::chrono::seconds kDrainIdleGrace{1};
+
+void AppendChunk(std::string_view data, std::string& out) {
+  std::array<char, 16> size{};
+  auto [end, ec] = std::to_chars(size.data(), size.data() + size.size(), data.size(), 16);
+  out.append(size.data(), end);
+  out += "\r\n";
+  out += data;
+  out += "\r\n";
+}
+
+// No length and no chunked coding, the stream ends with the connection and events are sent as they are.
+constexpr std::string_view kEventStreamHeaders =
+    "HTTP/1.1 200 OK\r\nContent-Type: text/event-stream\r\nCache-Control: no-cache\r\n\r\n";
+
+constexpr std::string_view kBadRequestClose =
+    "HTTP/1.1 400 Bad Request\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+constexpr std::string_view kUpgradeRequired =
+    "HTTP/1.1 426 Upgrade Required\r\nSec-WebSocket-Version: 13\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+
+// Whether a comma separated header value such as "keep-alive, Upgrade" has token, ignoring case.
+bool HasToken(std::string_view list, std::string_view token) {
+  while (!list.empty()) {
+    auto comma = list.find(',');
+    auto item  = list.substr(0, comma);
+    list       = comma == std::string_view::npos ? std::string_view{} : list.substr(comma + 1);
+    while (!item.empty() && item.front() == ' ') {
+      item.remove_prefix(1);
+    }
+    while (!item.empty() && item.back() == ' ') {
+      item.remove_suffix(1);
+    }
+    if (std::equal(item.begin(), item.end(), token.begin(), token.end(),
+                   [](char a, char b) { return ::tolower(a) == ::tolower(b); })) {
+      return true;
+    }
+  }
+  return false;
+}
+
+constexpr std::array<Method, 4> kRouteMethods{Method::kGet, Method::kPost, Method::kPut, Method::kDelete};
+
+constexpr std::array<char const*, 3> kAdmissionMetrics{
+    "simple_http_shed_connections_total",
+    "simple_http_shed_requests_total",
+    "simple_http_inflight_requests",
+};
+
+// A strong entity tag of a file version from its inode, size and modification time in nanoseconds,
+// tagged for the gzip variant.
+std::string FileETag(struct stat const& st, bool gzip) {
+  auto        mtime = static_cast<uint64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+  std::string token;
+  for (auto value : {static_cast<uint64_t>(st.st_ino), static_cast<uint64_t>(st.st_size), mtime}) {
+    char buf[16];
+    auto end = std::to_chars(buf, buf + sizeof(buf), value, 16).ptr;
+    if (!token.empty()) {
+      token += '-';
+    }
+    token.append(buf, end);
+  }
+  if (gzip) {
+    token += "-gzip";
+  }
+  return MakeETag(token);
+}
+
+std::string MakeBoundary() {
+  thread_local std::mt19937_64 random{std::random_device{}()};
+  constexpr std::string_view   kDigits = "0123456789abcdef";
+
+  std::string boundary(16, '0');
+  auto        value = random();
+  for (auto& c : boundary) {
+    c     = kDigits[value & 0xf];
+    value >>= 4;
+  }
+  return boundary;
+}
+
+std::string ContentRange(ByteRange const& range, std::size_t size) {
+  return "bytes " + std::to_string(range.first) + "-" + std::to_string(range.last) + "/" + std::to_string(size);
+}
+
+// Answer the Range field of a request for file with 206 or 416. Returns false if the whole file is
+// to be sent.
+bool ServeRanges(std::string_view field, HttpResponse& resp, std::shared_ptr<FileRange> const& file,
+                 std::string_view content_type) {
+  std::vector<ByteRange> ranges;
+  auto                   size = file->GetLength();
+  switch (ParseRange(field, size, ranges)) {
+    case RangeResult::kIgnored:
+      return false;
+    case RangeResult::kUnsatisfiable:
+      resp.SetStatusCode(StatusCode::k416RangeNotSatisfiable);
+      resp.SetStatusMessage("Range Not Satisfiable");
+      resp.SetHeader(HeaderId::kContentRange, "bytes */" + std::to_string(size));
+      resp.RemoveHeader(HeaderId::kContentType);
+      resp.SetBody("");
+      return true;
+    case RangeResult::kSatisfiable:
+      break;
+  }
+
+  resp.SetStatusCode(StatusCode::k206PartialContent);
+  resp.SetStatusMessage("Partial Content");
+  if (ranges.size() == 1) {
+    resp.SetHeader(HeaderId::kContentRange, ContentRange(ranges[0], size));
+    resp.SetFileBody(FileRange::Slice(file, ranges[0].first, ranges[0].GetLength()));
+    return true;
+  }
+
+  // Every part is its own file slice, only the part headers are in memory.
+  auto                  boundary = MakeBoundary();
+  std::vector<BodyPart> parts;
+  parts.reserve(ranges.size() + 1);
+  for (auto const& range : ranges) {
+    std::string head = "\r\n--" + boundary;
+    head             += "\r\nContent-Type: ";
+    head             += content_type;
+    head             += "\r\nContent-Range: " + ContentRange(range, size) + "\r\n\r\n";
+    parts.push_back({std::move(head), FileRange::Slice(file, range.first, range.GetLength())});
+  }
+  parts.push_back({"\r\n--" + boundary + "--\r\n", nullptr});
+  resp.SetContentType("multipart/byteranges; boundary=" + boundary);
+  resp.SetBodyParts(std::move(parts));
+  return true;
+}
+}  // namespace
+
+// The state of a response an asynchronous handler has not sent yet.
+struct AsyncResponse {
+  HttpServer*                  server;
+  std::weak_ptr<TcpConnection> conn;
+  HttpRequest                  request;
+  HttpRoute const*             route;
+  HttpResponse                 response;
+  uint32_t                     stream_id{0};  // of an HTTP/2 request
+  std::atomic<bool>            sent{false};
+  std::size_t                  relayed{0};  // body bytes a proxy relays, the head was written then
+  bool                         request_unread{false};  // part of an HTTP/1 request body a proxy relays
+
+  AsyncResponse(HttpServer* server, std::weak_ptr<TcpConnection> conn, HttpRequest request, HttpRoute const* route,
+                bool close, uint32_t stream_id)
+      : server(server),
+        conn(std::move(conn)),
+        request(std::move(request)),
+        route(route),
+        response(close),
+        stream_id(stream_id) {}
+
+  ~AsyncResponse() {
+    if (sent) {
+      return;
+    }
+    // The handler dropped its responder, answer for it so that the connection goes on.
+    auto rest = std::make_shared<AsyncResponse>(server, std::move(conn), std::move(request), route,
+                                                response.IsCloseConnection(), stream_id);
+    rest->sent = true;
+    rest->response.SetStatusCode(StatusCode::k500InternalError);
+    rest->response.SetStatusMessage("Internal Server Error");
+    rest->QueueInLoop([rest] { rest->server->FinishAsync(*rest); });
+  }
+
+  // Run func in the loop of the connection. Once the connection is gone its loop may be gone too,
+  // the request is only released then.
+  void QueueInLoop(Func func) {
+    if (auto locked = conn.lock(); locked) {
+      locked->GetEventLoop()->QueueInLoop(std::move(func));
+      return;
+    }
+    server->tcp_server_.GetAdmissionController().ReleaseRequest();
+  }
+};
+
+HttpResponse& HttpResponder::GetResponse() { return state_->response; }
+
+void HttpResponder::Send() const {
+  if (state_->sent.exchange(true)) {
+    return;
+  }
+  // Always from a later loop iteration, an HTTP/2 session may be in the middle of encoding headers.
+  state_->QueueInLoop([state = state_] { state->server->FinishAsync(*state); });
+}
+
 void DefaultHttpCallback(HttpRequest const& /*unused*/, HttpResponse& resp) {
   resp.SetStatusCode(StatusCode::k404NotFound);
   resp.SetStatusMessage("Not Found");
@@ -26,8 +303,12 @@ HttpServer::HttpServer(EventLoop* loop, bool web_api, InetAddr const& addr)
     : web_api_{web_api}, tcp_server_{loop, addr} {
   tcp_server_.OnConnection([this](std::shared_ptr<TcpConnection> const& conn) { OnConnection(conn.get()); });
   tcp_server_.OnReceiveMessage([this](std::shared_ptr<TcpConnection> const& conn, MsgBuffer& buf) {
-    OnMessage(conn.get(), buf, std::chrono::steady_clock::now());
+    OnMessage(conn.get(), buf, conn->GetEventLoop()->GetPollTime());
   });
+  tcp_server_.OnWriteComplete([this](std::shared_ptr<TcpConnection> const& conn) { OnWriteComplete(conn.get()); });
+  tcp_server_.OnDrain([](std::shared_ptr<TcpConnection> const& conn) { OnDrain(conn); });
+  tcp_server_.OnRetire([this](std::shared_ptr<TcpConnection> const& conn) { OnRetire(conn); });
+  tcp_server_.SetOverloadResponse(kServiceUnavailable);
   if (!web_api) {
     struct stat st;
     if (stat("wwwroot", &st) == -1) {
@@ -55,52 +336,805 @@ HttpServer::HttpServer(EventLoop* loop, bool web_api, InetAddr const& addr)
   }
 }
 
-void HttpServer::Start() { tcp_server_.Start(); }
+HttpServer::~HttpServer() {
+  if (metrics_enabled_) {
+    for (auto const* name : kAdmissionMetrics) {
+      util::MetricsRegistry::Global().RemoveCallback(name, metrics_labels_);
+    }
+    util::MetricsRegistry::Global().RemoveCollector(kRouteLatencyMetric, this);
+  }
+}
+
+void HttpServer::Start() {
+  started_ = true;
+  tcp_server_.Start();
+}
 
 void HttpServer::Stop() { tcp_server_.Stop(); }
 
 void HttpServer::OnConnection(TcpConnection* conn) {
   if (conn->IsConnected()) {
     conn->SetContext(HttpContext());
+    return;
+  }
+  auto* context = std::any_cast<HttpContext>(&conn->GetContext());
+  if (context == nullptr) {
+    return;
   }
+  if (context->GetWebSocket()) {
+    context->GetWebSocket()->HandleDisconnect();
+  }
+  // An unfinished stream may hold on to the handler's state, drop it with the connection.
+  context->SetStream(nullptr);
 }
 
-void HttpServer::OnMessage(TcpConnection* conn, util::MsgBuffer& buf, Timepoint const& receive_time) {
-  auto context = std::any_cast<HttpContext>(conn->GetContext());
+void HttpServer::OnWriteComplete(TcpConnection* conn) {
+  auto* context = std::any_cast<HttpContext>(&conn->GetContext());
+  if (context == nullptr) {
+    return;
+  }
+  context->FlushPendingLatencies(std::chrono::steady_clock::now());
+  if (auto const& session = context->GetHttp2(); session) {
+    std::string out;
+    FlushHttp2(conn, *session, out);
+  }
+  if (context->GetStream()) {
+    PumpStream(conn, *context);
+  }
+  Rebalance(conn, *context);
+}
 
-  if (!context.ParseRequest(buf, receive_time)) {
-    conn->Send("HTTP/1.1 400 Bad Request\r\n\r\n");
+void HttpServer::Rebalance(TcpConnection* conn, HttpContext const& context) {
+  // Only HTTP/1 connections between requests, everything else keeps state on its loop.
+  if (context.IsIdle() && !context.GetHttp2() && !context.GetWebSocket() && !context.IsEventStream() &&
+      conn->IsConnected() && conn->GetQueuedBytes() == 0) {
+    tcp_server_.Rebalance(conn->shared_from_this());
+  }
+}
+
+void HttpServer::OnRetire(std::shared_ptr<TcpConnection> const& conn) {
+  auto* context = std::any_cast<HttpContext>(&conn->GetContext());
+  if (context == nullptr) {
+    return;
+  }
+  // Sessions can't move, their clients reconnect and land on another loop.
+  if (context->GetHttp2() || context->GetWebSocket() || context->IsEventStream()) {
+    OnDrain(conn);
+    return;
+  }
+  // Requests in progress move the connection once answered.
+  Rebalance(conn.get(), *context);
+}
+
+void HttpServer::Drain(std::chrono::steady_clock::duration timeout, std::function<void()> done) {
+  draining_.store(true, std::memory_order_relaxed);
+  tcp_server_.Drain(timeout, std::move(done));
+}
+
+void HttpServer::OnDrain(std::shared_ptr<TcpConnection> const& conn) {
+  auto* context = std::any_cast<HttpContext>(&conn->GetContext());
+  if (context == nullptr) {
     conn->Shutdown();
+    return;
+  }
+  if (auto const& session = context->GetHttp2(); session) {
+    std::string out;
+    session->Drain(out);
+    FlushHttp2(conn.get(), *session, out);
+    return;
+  }
+  if (auto const& websocket = context->GetWebSocket(); websocket) {
+    websocket->Close(websocket::kCloseGoingAway);
+    return;
+  }
+  // Event streams never end by themselves, their clients reconnect to the new server.
+  if (context->IsEventStream()) {
+    conn->Shutdown();
+    return;
+  }
+  // Requests in progress or arriving meanwhile close the connection with their response.
+  conn->GetEventLoop()->RunAfter(kDrainIdleGrace, [weak = std::weak_ptr<TcpConnection>(conn)] {
+    auto conn = weak.lock();
+    if (!conn || !conn->IsConnected()) {
+      return;
+    }
+    auto* context = std::any_cast<HttpContext>(&conn->GetContext());
+    if (context != nullptr && context->IsIdle() && conn->GetPendingInput() == 0) {
+      conn->Shutdown();
+    }
+  });
+}
+
+void HttpServer::OnMessage(TcpConnection* conn, util::MsgBuffer& buf, Timepoint const& receive_time) {
+  // Parse in place, the context has to keep partial requests and pending latencies across reads.
+  auto* context = std::any_cast<HttpContext>(&conn->GetContext());
+  if (context == nullptr) {
+    return;
   }
 
-  if (context.Complete()) {
-    OnRequest(conn, context.GetRequest());
-    context.Reset();
+  // Pipelined requests may all arrive with one read, the rest of them is not announced again.
+  for (;;) {
+    if (auto const& session = context->GetHttp2(); session) {
+      ReceiveHttp2(conn, *session, buf, receive_time);
+      return;
+    }
+    if (auto const& websocket = context->GetWebSocket(); websocket) {
+      ReceiveWebSocket(conn, *websocket, buf, receive_time);
+      return;
+    }
+    if (context->IsEventStream()) {
+      buf.RetrieveAll();
+      return;
+    }
+    // Handled once the response in progress is through, see ResumeInput.
+    if (context->GetStream() || context->IsAwaitingResponse()) {
+      return;
+    }
+    if (http2_enabled_) {
+      // Prior knowledge clients start with the preface instead of a request line.
+      auto size = std::min(buf.ReadableSize(), kHttp2Preface.size());
+      if (size > 0 && std::equal(buf.Peek(), buf.Peek() + size, kHttp2Preface.begin())) {
+        if (size == kHttp2Preface.size()) {
+          StartHttp2(conn, *context);
+          std::string settings;
+          context->GetHttp2()->Start(settings);
+          conn->Send(settings);
+          ReceiveHttp2(conn, *context->GetHttp2(), buf, receive_time);
+        }
+        return;
+      }
+    }
+
+    if (!context->ParseRequest(buf, receive_time)) {
+      HttpMetrics::Get().bad_requests.Increment();
+      conn->Send("HTTP/1.1 400 Bad Request\r\n\r\n");
+      conn->Shutdown();
+      return;
+    }
+    if (!context->Complete()) {
+      return;
+    }
+
+    OnRequest(conn, *context, context->GetRequest());
+    context->Reset();
+    if (buf.ReadableSize() == 0) {
+      Rebalance(conn, *context);
+      return;
+    }
+    // What follows is the next request, or after an upgrade the first bytes of the new protocol.
+    if (!conn->IsConnected()) {
+      return;
+    }
   }
 }
 
-void HttpServer::OnRequest(TcpConnection* conn, HttpRequest const& req) {
-  auto connection = req.GetHeader("Connection");
+void HttpServer::ResumeInput(TcpConnection* conn) {
+  conn->GetEventLoop()->QueueInLoop([weak = std::weak_ptr<TcpConnection>(conn->shared_from_this())] {
+    if (auto conn = weak.lock(); conn) {
+      conn->HandleBufferedInput();
+    }
+  });
+}
+
+void HttpServer::OnRequest(TcpConnection* conn, HttpContext& context, HttpRequest const& req) {
+  auto connection = req.GetHeader(HeaderId::kConnection);
   auto close      = connection == "close" || (req.GetVersion() == Version::kHttp10 && connection != "Keep-Alive");
+  close           = close || draining_.load(std::memory_order_relaxed);
+
+  if (http2_enabled_ && req.GetHeaderView(HeaderId::kUpgrade).find("h2c") != std::string_view::npos &&
+      UpgradeToHttp2(conn, context, req)) {
+    return;
+  }
+  if (auto const* route = FindWebSocketRoute(req); route != nullptr) {
+    UpgradeToWebSocket(conn, context, req, *route);
+    return;
+  }
+  if (auto const* route = FindEventStreamRoute(req); route != nullptr) {
+    OpenEventStream(conn, context, req, *route);
+    return;
+  }
+
+  HttpMetrics::Get().requests[static_cast<size_t>(req.GetMethod())]->Increment();
+
+  auto& admission = tcp_server_.GetAdmissionController();
+  if (!admission.TryAcquireRequest(std::chrono::steady_clock::now() - req.GetReceiveTime())) {
+    conn->Send(kServiceUnavailable);
+    conn->Shutdown();
+    LogResponse(conn, req, StatusCode::k503ServiceUnavailable, 0, std::chrono::steady_clock::now());
+    return;
+  }
 
   HttpResponse response(close);
-  if (!Route(req, response)) {
-    DefaultHttpCallback(req, response);
+  auto const*  route = Respond(req, response);
+  if (route != nullptr && route->async_handler) {
+    context.SetAwaitingResponse(true);
+    RespondLater(conn, req, *route, close, 0);
+    return;
+  }
+  if (route != nullptr && route->cache) {
+    CachedResponsePtr hit;
+    if (!RespondCached(conn, req, *route, close, 0, response, hit)) {
+      context.SetAwaitingResponse(true);
+      return;
+    }
+    if (hit && !close) {
+      SendCached(conn, context, req, *hit, *route);
+      return;
+    }
+    if (hit) {
+      hit->CopyTo(response);
+    }
+  }
+  SendResponse(conn, context, req, response, route);
+}
+
+void HttpServer::SendResponse(TcpConnection* conn, HttpContext& context, HttpRequest const& req,
+                              HttpResponse& response, HttpRoute const* route) {
+  auto& admission = tcp_server_.GetAdmissionController();
+  if (draining_.load(std::memory_order_relaxed)) {
+    // Answered late by an asynchronous handler, after the drain began.
+    response.SetCloseConnection(true);
+  }
+  if (response.IsStreaming() && !response.GetStreamLength() && req.GetVersion() == Version::kHttp10) {
+    // HTTP/1.0 has no chunked coding, closing the connection ends the body.
+    response.SetCloseConnection(true);
   }
   MsgBuffer buf;
   response.WriteTo(buf);
   conn->Send(buf);
+  if (auto const& shared = response.GetSharedBody(); shared) {
+    conn->Send(shared);
+  }
+  if (response.IsStreaming()) {
+    admission.ReleaseRequest();
+    auto stream      = std::make_shared<ResponseStream>();
+    stream->chunked  = response.IsChunked();
+    stream->close    = response.IsCloseConnection();
+    stream->status   = response.GetStatusCode();
+    stream->length   = response.GetStreamLength();
+    stream->request  = req;
+    stream->latency  = route != nullptr ? route->latency.get() : nullptr;
+    stream->provider = response.TakeBodyProvider();
+    context.SetStream(std::move(stream));
+    PumpStream(conn, context);
+    return;
+  }
+  if (auto const& file = response.GetFileBody(); file) {
+    conn->SendFile(file);
+  }
+  for (auto const& part : response.GetBodyParts()) {
+    conn->Send(part.data);
+    if (part.file) {
+      conn->SendFile(part.file);
+    }
+  }
   if (response.IsCloseConnection()) {
     conn->Shutdown();
   }
+  admission.ReleaseRequest();
+
+  auto now = std::chrono::steady_clock::now();
+  if (route != nullptr) {
+    // The route latency ends with the last byte, if the kernel did not take it all yet that is
+    // when the write buffer drains.
+    if (conn->GetQueuedBytes() == 0) {
+      route->latency->Record(now - req.GetReceiveTime());
+    } else {
+      context.AddPendingLatency(route->latency.get(), req.GetReceiveTime());
+    }
+  }
+
+  LogResponse(conn, req, response.GetStatusCode(), response.GetBodySize(), now);
+}
+
+bool HttpServer::OnHttp2Request(TcpConnection* conn, uint32_t stream_id, HttpRequest const& req, HttpResponse& resp) {
+  HttpMetrics::Get().requests[static_cast<size_t>(req.GetMethod())]->Increment();
+
+  // Only the stream is refused when overloaded, the other requests of the connection go on.
+  auto& admission = tcp_server_.GetAdmissionController();
+  if (!admission.TryAcquireRequest(std::chrono::steady_clock::now() - req.GetReceiveTime())) {
+    resp.SetStatusCode(StatusCode::k503ServiceUnavailable);
+    LogResponse(conn, req, StatusCode::k503ServiceUnavailable, 0, std::chrono::steady_clock::now());
+    return true;
+  }
+  auto const* route = Respond(req, resp);
+  if (route != nullptr && route->async_handler) {
+    RespondLater(conn, req, *route, false, stream_id);
+    return false;
+  }
+  if (route != nullptr && route->cache) {
+    CachedResponsePtr hit;
+    if (!RespondCached(conn, req, *route, false, stream_id, resp, hit)) {
+      return false;
+    }
+    if (hit) {
+      hit->CopyTo(resp);
+    }
+  }
+  admission.ReleaseRequest();
+
+  // The DATA frames may wait for flow control, the latency of a stream ends with its response.
+  auto now = std::chrono::steady_clock::now();
+  if (route != nullptr) {
+    route->latency->Record(now - req.GetReceiveTime());
+  }
+  LogResponse(conn, req, resp.GetStatusCode(), resp.GetBodySize(), now);
+  return true;
+}
+
+void HttpServer::RespondLater(TcpConnection* conn, HttpRequest const& req, HttpRoute const& route, bool close,
+                              uint32_t stream_id) {
+  auto state = std::make_shared<AsyncResponse>(this, conn->shared_from_this(), req, &route, close, stream_id);
+  route.async_handler(state->request, HttpResponder{state});
+}
+
+void HttpServer::FinishAsync(AsyncResponse& state) {
+  auto& admission = tcp_server_.GetAdmissionController();
+  auto  conn      = state.conn.lock();
+  auto* context   = conn ? std::any_cast<HttpContext>(&conn->GetContext()) : nullptr;
+  if (context == nullptr || !conn->IsConnected()) {
+    admission.ReleaseRequest();
+    return;
+  }
+  AnswerNotModified(state.request, state.response);
+  if (compression_enabled_) {
+    Compress(state.request, state.response);
+  }
+  if (state.stream_id == 0) {
+    context->SetAwaitingResponse(false);
+    SendResponse(conn.get(), *context, state.request, state.response, state.route);
+    ResumeInput(conn.get());
+    return;
+  }
+
+  admission.ReleaseRequest();
+  auto now = std::chrono::steady_clock::now();
+  state.route->latency->Record(now - state.request.GetReceiveTime());
+  LogResponse(conn.get(), state.request, state.response.GetStatusCode(), state.response.GetBodySize(), now);
+  if (auto const& session = context->GetHttp2(); session) {
+    std::string out;
+    session->Respond(state.stream_id, state.response, out);
+    FlushHttp2(conn.get(), *session, out);
+  }
+}
+
+bool HttpServer::RespondCached(TcpConnection* conn, HttpRequest const& req, HttpRoute const& route, bool close,
+                               uint32_t stream_id, HttpResponse& resp, CachedResponsePtr& hit) {
+  auto& metrics = HttpMetrics::Get();
+  auto& cache   = *route.cache;
+  auto  variant = compression_enabled_ ? EncodingName(NegotiateEncoding(req.GetHeaderView(HeaderId::kAcceptEncoding)))
+                                       : std::string_view{};
+  auto  key     = cache.Key(req, variant);
+  bool  fresh   = false;
+  hit           = cache.Find(key, std::chrono::steady_clock::now(), fresh);
+  if (hit) {
+    metrics.RecordCacheLookup(fresh ? CacheLookup::kHit : CacheLookup::kStale);
+    if (!fresh && cache.Claim(key)) {
+      // The stale response goes out now, its successor is computed in the next loop iteration.
+      conn->GetEventLoop()->QueueInLoop([this, &route, key, req] {
+        HttpResponse successor(false);
+        ComputeCached(req, route, successor);
+        route.cache->Complete(key, successor, std::chrono::steady_clock::now());
+      });
+    }
+    if (IsNotModified(req, hit->response)) {
+      // A revalidation only costs the fields of the entry.
+      SetNotModified(hit->response, resp);
+      hit = nullptr;
+    }
+    return true;
+  }
+
+  auto state  = std::make_shared<AsyncResponse>(this, conn->shared_from_this(), req, &route, close, stream_id);
+  auto waiter = [state](CachedResponsePtr const& entry) {
+    if (entry) {
+      entry->CopyTo(state->response);
+      HttpResponder{state}.Send();
+      return;
+    }
+    // The response could not be stored, the request computes its own on its loop.
+    state->QueueInLoop([state] {
+      state->route->handler(state->request, state->response);
+      HttpResponder{state}.Send();
+    });
+  };
+  if (!cache.Claim(key, std::move(waiter))) {
+    metrics.RecordCacheLookup(CacheLookup::kCoalesced);
+    return false;
+  }
+  state->sent = true;  // not waiting after all
+
+  metrics.RecordCacheLookup(CacheLookup::kMiss);
+  ComputeCached(req, route, resp);
+  cache.Complete(key, resp, std::chrono::steady_clock::now());
+  AnswerNotModified(req, resp);
+  return true;
 }
 
-bool HttpServer::Route(HttpRequest const& req, HttpResponse& resp) {
+void HttpServer::ComputeCached(HttpRequest const& req, HttpRoute const& route, HttpResponse& resp) const {
+  route.handler(req, resp);
+  if (compression_enabled_) {
+    Compress(req, resp);
+  }
+}
+
+void HttpServer::SendCached(TcpConnection* conn, HttpContext& context, HttpRequest const& req,
+                            CachedResponse const& cached, HttpRoute const& route) {
+  conn->Send(cached.wire);
+  tcp_server_.GetAdmissionController().ReleaseRequest();
+
+  auto now = std::chrono::steady_clock::now();
+  if (conn->GetQueuedBytes() == 0) {
+    route.latency->Record(now - req.GetReceiveTime());
+  } else {
+    context.AddPendingLatency(route.latency.get(), req.GetReceiveTime());
+  }
+  LogResponse(conn, req, cached.response.GetStatusCode(), cached.response.GetBodySize(), now);
+}
+
+void HttpServer::PumpStream(TcpConnection* conn, HttpContext& context) {
+  auto stream = context.GetStream();
+  if (!conn->IsConnected()) {
+    return;
+  }
+
+  // Write complete events come back once the kernel took what was sent, so every pump is bounded
+  // by the budget even when nothing stays queued.
+  std::string out;
+  std::string part;
+  bool        more = true;
+  while (more && conn->GetQueuedBytes() + out.size() < kStreamWriteBudget) {
+    if (!stream->chunked) {
+      auto size    = out.size();
+      more         = stream->provider(out);
+      stream->sent += out.size() - size;
+      if (stream->length && stream->sent > *stream->length) {
+        // Past the Content-Length the bytes would be taken for the next response.
+        out.resize(out.size() - (stream->sent - *stream->length));
+        stream->sent = *stream->length + 1;
+        more         = false;
+      }
+      continue;
+    }
+    part.clear();
+    more         = stream->provider(part);
+    stream->sent += part.size();
+    if (!part.empty()) {
+      AppendChunk(part, out);
+    }
+  }
+  if (more) {
+    conn->Send(out);
+    return;
+  }
+
+  if (stream->chunked) {
+    out += "0\r\n\r\n";
+  }
+  if (stream->length && stream->sent != *stream->length) {
+    // Only closing tells the client the body is not what the head announced.
+    LOG_WARNING << "Body of " << stream->request.GetPath() << " is not the " << *stream->length
+                << " bytes of its Content-Length, closing the connection";
+    stream->sent  = std::min(stream->sent, *stream->length);
+    stream->close = true;
+  }
+  conn->Send(out);
+  context.SetStream(nullptr);
+  if (stream->close || draining_.load(std::memory_order_relaxed)) {
+    conn->Shutdown();
+  } else {
+    ResumeInput(conn);
+  }
+
+  auto now = std::chrono::steady_clock::now();
+  if (stream->latency != nullptr) {
+    if (conn->GetQueuedBytes() == 0) {
+      stream->latency->Record(now - stream->request.GetReceiveTime());
+    } else {
+      context.AddPendingLatency(stream->latency, stream->request.GetReceiveTime());
+    }
+  }
+  LogResponse(conn, stream->request, stream->status, stream->sent, now);
+}
+
+HttpRoute const* HttpServer::Respond(HttpRequest const& req, HttpResponse& resp) {
+  auto const* route = Route(req, resp);
+  if (route == nullptr) {
+    DefaultHttpCallback(req, resp);
+  } else if (route->async_handler || route->cache) {
+    return route;  // answered later or from the cache, compressed then
+  }
+  if (route == &static_route_) {
+    return route;
+  }
+  if (route != nullptr) {
+    AnswerNotModified(req, resp);
+  }
+  if (compression_enabled_) {
+    Compress(req, resp);
+  }
+  return route;
+}
+
+void HttpServer::LogResponse(TcpConnection* conn, HttpRequest const& req, StatusCode status, std::size_t bytes,
+                             Timepoint now) {
+  auto& metrics = HttpMetrics::Get();
+  metrics.RecordResponse(status);
+  metrics.request_duration.Observe(std::chrono::duration<double>(now - req.GetReceiveTime()).count());
+  if (access_log_) {
+    access_log_->Record(conn->GetPeerAddr(), req, status, bytes, now - req.GetReceiveTime());
+  }
+}
+
+void HttpServer::StartHttp2(TcpConnection* conn, HttpContext& context) {
+  // The session lives in the connection's context, it never outlives conn.
+  context.SetHttp2(std::make_shared<Http2Session>(
+      [this, conn](uint32_t stream_id, HttpRequest const& req, HttpResponse& resp) {
+        return OnHttp2Request(conn, stream_id, req, resp);
+      },
+      http2_options_));
+}
+
+bool HttpServer::UpgradeToHttp2(TcpConnection* conn, HttpContext& context, HttpRequest const& req) {
+  if (!req.HasHeader(HeaderId::kHttp2Settings)) {
+    return false;
+  }
+  StartHttp2(conn, context);
+  std::string out;
+  if (!context.GetHttp2()->StartUpgrade(req.GetHeaderView(HeaderId::kHttp2Settings), req, out)) {
+    // Answer over HTTP/1.1 as if the upgrade had not been asked for.
+    context.SetHttp2(nullptr);
+    return false;
+  }
+  out.insert(0, kSwitchingToHttp2);
+  FlushHttp2(conn, *context.GetHttp2(), out);
+  return true;
+}
+
+void HttpServer::ReceiveHttp2(TcpConnection* conn, Http2Session& session, util::MsgBuffer& buf,
+                              Timepoint const& receive_time) {
+  std::string out;
+  if (!session.Receive(buf, receive_time, out)) {
+    conn->Send(out);
+    conn->Shutdown();
+    return;
+  }
+  FlushHttp2(conn, session, out);
+}
+
+void HttpServer::FlushHttp2(TcpConnection* conn, Http2Session& session, std::string& out) {
+  if (conn->GetQueuedBytes() < kHttp2WriteBudget) {
+    session.Flush(out, kHttp2WriteBudget - conn->GetQueuedBytes());
+  }
+  if (!out.empty()) {
+    conn->Send(out);
+  }
+  if (session.IsFinished()) {
+    conn->Shutdown();
+  }
+}
+
+WebSocketRoute const* HttpServer::FindWebSocketRoute(HttpRequest const& req) const {
+  if (websocket_routes_.empty() || !HasToken(req.GetHeaderView(HeaderId::kUpgrade), "websocket")) {
+    return nullptr;
+  }
+  for (auto const& route : websocket_routes_) {
+    if (std::regex_match(req.GetPath(), route.pattern)) {
+      return &route;
+    }
+  }
+  return nullptr;
+}
+
+void HttpServer::ReceiveWebSocket(TcpConnection* conn, WebSocketSession& session, util::MsgBuffer& buf,
+                                  Timepoint const& receive_time) {
+  // Reads stay on until the peer closes its side, what it still sends is dropped instead of piling up.
+  if (session.IsClosed()) {
+    buf.RetrieveAll();
+    return;
+  }
+  if (session.Receive(buf, receive_time)) {
+    return;
+  }
+  buf.RetrieveAll();
+  conn->Shutdown();
+  // A peer that never closes its side does not keep the connection.
+  auto weak = std::weak_ptr<TcpConnection>(conn->shared_from_this());
+  conn->GetEventLoop()->RunAfter(session.GetCloseTimeout(), [weak] {
+    if (auto conn = weak.lock(); conn) {
+      conn->ForceClose();
+    }
+  });
+}
+
+void HttpServer::UpgradeToWebSocket(TcpConnection* conn, HttpContext& context, HttpRequest const& req,
+                                    WebSocketRoute const& route) {
+  HttpMetrics::Get().requests[static_cast<size_t>(req.GetMethod())]->Increment();
+
+  auto key   = req.GetHeaderView(HeaderId::kSecWebSocketKey);
+  auto nonce = util::Base64Decode(key);
+  if (req.GetMethod() != Method::kGet || req.GetVersion() != Version::kHttp11 ||
+      !HasToken(req.GetHeaderView(HeaderId::kConnection), "upgrade") || !nonce || nonce->size() != 16) {
+    conn->Send(kBadRequestClose);
+    conn->Shutdown();
+    LogResponse(conn, req, StatusCode::k400BadRequest, 0, std::chrono::steady_clock::now());
+    return;
+  }
+  if (req.GetHeaderView(HeaderId::kSecWebSocketVersion) != std::to_string(websocket::kVersion)) {
+    conn->Send(kUpgradeRequired);
+    conn->Shutdown();
+    LogResponse(conn, req, StatusCode::k426UpgradeRequired, 0, std::chrono::steady_clock::now());
+    return;
+  }
+
+  std::string handshake =
+      "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\nSec-WebSocket-Accept: ";
+  handshake += websocket::AcceptKey(key);
+  handshake += "\r\n\r\n";
+  conn->Send(handshake);
+  LogResponse(conn, req, StatusCode::k101SwitchingProtocols, 0, std::chrono::steady_clock::now());
+
+  auto session = std::make_shared<WebSocketSession>(conn->shared_from_this(), route.handlers, route.options);
+  context.SetWebSocket(session);
+  session->Open(req);
+}
+
+EventStreamRoute const* HttpServer::FindEventStreamRoute(HttpRequest const& req) const {
+  if (req.GetMethod() != Method::kGet) {
+    return nullptr;
+  }
+  for (auto const& route : event_stream_routes_) {
+    if (std::regex_match(req.GetPath(), route.pattern)) {
+      return &route;
+    }
+  }
+  return nullptr;
+}
+
+ProxyRoute const* HttpServer::FindProxyRoute(HttpRequest const& req) const {
+  for (auto const& proxy : proxy_routes_) {
+    if (std::regex_match(req.GetPath(), proxy.pattern)) {
+      return &proxy;
+    }
+  }
+  return nullptr;
+}
+
+void HttpServer::Forward(ProxyRoute const& proxy, HttpResponder responder) {
+  auto state = responder.state_;
+  auto conn  = state->conn.lock();
+  if (!conn) {
+    return;
+  }
+  auto const& req = state->request;
+
+  // HTTP/1 request bodies are not read by the server, they are relayed behind the request.
+  std::size_t request_body = 0;
+  if (state->stream_id == 0) {
+    auto length = req.GetHeaderView(HeaderId::kContentLength);
+    auto [end, ec] = std::from_chars(length.data(), length.data() + length.size(), request_body);
+    if (!req.GetHeaderView(HeaderId::kTransferEncoding).empty() || (!length.empty() && ec != std::errc{})) {
+      responder->SetStatusCode(StatusCode::k411LengthRequired);
+      responder->SetStatusMessage("Length Required");
+      responder->SetCloseConnection(true);
+      responder.Send();
+      return;
+    }
+  }
+
+  auto* upstream = proxy.upstreams->BeginRequest(conn->GetPeerAddr());
+  if (upstream == nullptr) {
+    responder->SetStatusCode(StatusCode::k503ServiceUnavailable);
+    responder->SetStatusMessage("Service Unavailable");
+    // The body that was not read would be taken for the next request.
+    responder->SetCloseConnection(responder->IsCloseConnection() || request_body > 0);
+    responder.Send();
+    return;
+  }
+
+  auto forwarded = req;
+  proxy::RewriteRequest(forwarded, conn->GetPeerAddr());
+  state->request_unread = request_body > 0;
+  auto callback = [this, group = proxy.upstreams, upstream, responder](HttpClientError error,
+                                                                         HttpResponse&   resp) mutable {
+    group->EndRequest(*upstream, error == HttpClientError::kConnectFailed);
+    auto& state = *responder.state_;
+    if (state.relayed > 0) {
+      FinishRelayed(state, error == HttpClientError::kNone);
+      return;
+    }
+    if (error == HttpClientError::kNone) {
+      proxy::CopyResponse(resp, responder.GetResponse());
+      responder->SetBody(std::string{resp.GetBody()});
+    } else if (error == HttpClientError::kTimeout) {
+      responder->SetStatusCode(StatusCode::k504GatewayTimeout);
+      responder->SetStatusMessage("Gateway Timeout");
+    } else {
+      responder->SetStatusCode(StatusCode::k502BadGateway);
+      responder->SetStatusMessage("Bad Gateway");
+    }
+    if (state.request_unread) {
+      // Answered before the request body was through, or without ever relaying it: what is left of
+      // it can't be told from a request.
+      responder->SetCloseConnection(true);
+    }
+    responder.Send();
+  };
+
+  if (state->stream_id != 0) {
+    upstream->GetClient().Send(conn->GetEventLoop(), std::move(forwarded), std::move(callback));
+    return;
+  }
+  HttpClientSplice splice{
+      .peer               = conn,
+      .request_body       = request_body,
+      .on_request_body    = [state](bool complete) { state->request_unread = !complete; },
+      .response_threshold = proxy.options.splice_threshold,
+      .on_head =
+          [state](HttpResponse& head, std::size_t length) {
+            std::string out;
+            proxy::AppendResponseHead(head, length, state->response.IsCloseConnection(), out);
+            state->response.SetStatusCode(head.GetStatusCode());
+            state->relayed = length;
+            state->sent    = true;
+            if (auto conn = state->conn.lock(); conn) {
+              conn->Send(out);
+            }
+          },
+  };
+  upstream->GetClient().Send(std::move(forwarded), std::move(callback), std::move(splice));
+}
+
+void HttpServer::FinishRelayed(AsyncResponse& state, bool complete) {
+  tcp_server_.GetAdmissionController().ReleaseRequest();
+  auto  conn    = state.conn.lock();
+  auto* context = conn ? std::any_cast<HttpContext>(&conn->GetContext()) : nullptr;
+  if (context == nullptr || !conn->IsConnected()) {
+    return;
+  }
+  if (!complete) {
+    // The client got the head and part of the body, only closing tells it.
+    conn->ForceClose();
+    return;
+  }
+  context->SetAwaitingResponse(false);
+  auto now = std::chrono::steady_clock::now();
+  state.route->latency->Record(now - state.request.GetReceiveTime());
+  LogResponse(conn.get(), state.request, state.response.GetStatusCode(), state.relayed, now);
+  if (state.response.IsCloseConnection() || state.request_unread || draining_.load(std::memory_order_relaxed)) {
+    conn->Shutdown();
+  } else {
+    ResumeInput(conn.get());
+  }
+}
+
+void HttpServer::OpenEventStream(TcpConnection* conn, HttpContext& context, HttpRequest const& req,
+                                 EventStreamRoute const& route) {
+  HttpMetrics::Get().requests[static_cast<size_t>(req.GetMethod())]->Increment();
+
+  conn->Send(kEventStreamHeaders);
+  context.SetEventStream(true);
+  auto ptr = conn->shared_from_this();
+  if (route.on_open) {
+    route.on_open(ptr, req);
+  }
+  route.hub->Subscribe(ptr);
+  LogResponse(conn, req, StatusCode::k200Ok, 0, std::chrono::steady_clock::now());
+}
+
+HttpRoute const* HttpServer::Route(HttpRequest const& req, HttpResponse& resp) {
+  if (auto const* proxy = FindProxyRoute(req); proxy != nullptr) {
+    return &proxy->route;
+  }
   auto const& method = req.GetMethod();
 
   if (method == Method::kGet) {
+    // Registered routes take precedence over static files.
+    if (auto const* route = Dispatch(req, resp, get_handlers_); route != nullptr) {
+      return route;
+    }
     if (web_api_ || req.GetPath() == "/") {
-      return Dispatch(req, resp, get_handlers_);
+      return nullptr;
     }
 
     std::string_view path = req.GetPath();
@@ -108,21 +1142,10 @@ bool HttpServer::Route(HttpRequest const& req, HttpResponse& resp) {
       path.remove_prefix(1);
     }
 
-    std::ifstream         file(path.data(), std::ios::binary);
-    std::filesystem::path file_path(path.data());
-    if (file.is_open()) {
-      resp.SetStatusCode(StatusCode::k200Ok);
-      resp.SetStatusMessage("OK");
-      auto extension = file_path.extension().string();
-      if (file_path.has_extension() && kMimeTypes.contains(extension)) {
-        resp.SetContentType(kMimeTypes.at(extension));
-      } else {
-        resp.SetContentType("text/plain");
-      }
-      resp.SetFileBody(path);
-      return true;
+    if (ServeFile(req, resp, std::string{path})) {
+      return &static_route_;
     }
-    return false;
+    return nullptr;
   }
 
   if (method == Method::kPost) {
@@ -139,43 +1162,350 @@ bool HttpServer::Route(HttpRequest const& req, HttpResponse& resp) {
 
   resp.SetStatusCode(StatusCode::k400BadRequest);
 
-  return false;
+  return nullptr;
+}
+
+bool HttpServer::ServeFile(HttpRequest const& req, HttpResponse& resp, std::string const& path) {
+  // Validators come from the metadata, a revalidation is answered without opening the file.
+  struct stat st {};
+  if (::stat(path.c_str(), &st) < 0 || !S_ISREG(st.st_mode)) {
+    return false;
+  }
+  std::filesystem::path file_path(path);
+  auto                  extension    = file_path.extension().string();
+  std::string_view      content_type = "text/plain";
+  if (auto type = FindMimeType(extension); !type.empty()) {
+    content_type = type;
+  }
+  bool varies = compression_enabled_ && IsCompressible(content_type) &&
+                static_cast<std::size_t>(st.st_size) >= compression_.min_size;
+  // Files are only kept in gzip, the coding every client accepting compression understands.
+  bool gzip = varies && NegotiateEncoding(req.GetHeaderView(HeaderId::kAcceptEncoding)) == ContentCoding::kGzip;
+
+  auto etag = FileETag(st, gzip);
+  resp.SetHeader(HeaderId::kETag, etag);
+  resp.SetHeader(HeaderId::kLastModified, FormatHttpDate(st.st_mtime));
+  if (varies) {
+    resp.SetHeader(HeaderId::kVary, "Accept-Encoding");
+  }
+  if (IsNotModified(req, etag, st.st_mtime)) {
+    resp.SetStatusCode(StatusCode::k304NotModified);
+    resp.SetStatusMessage("Not Modified");
+    return true;
+  }
+
+  auto file = FileRange::Open(path);
+  if (!file) {
+    return false;
+  }
+  resp.SetStatusCode(StatusCode::k200Ok);
+  resp.SetStatusMessage("OK");
+  resp.SetContentType(content_type);
+  resp.SetFileBody(file);
+  resp.SetHeader(HeaderId::kAcceptRanges, "bytes");
+
+  // Ranges are of the identity coding, a partial response is never compressed. Its tag stays
+  // unless a gzip variant is sent after all.
+  auto identity = gzip ? FileETag(st, false) : etag;
+  resp.SetHeader(HeaderId::kETag, identity);
+  if (auto range = req.GetHeaderView(HeaderId::kRange);
+      !range.empty() && IfRangeMatches(req, identity, st.st_mtime) && ServeRanges(range, resp, file, content_type)) {
+    return true;
+  }
+  if (!gzip) {
+    return true;
+  }
+
+  // A sidecar older than the file is stale, fall back to compressing the file itself.
+  if (auto sidecar = FileRange::Open(path + ".gz");
+      sidecar && sidecar->GetModifiedTime() >= file->GetModifiedTime()) {
+    resp.SetFileBody(std::move(sidecar));
+    resp.SetHeader(HeaderId::kContentEncoding, "gzip");
+    resp.SetHeader(HeaderId::kETag, etag);
+    return true;
+  }
+
+  if (file->GetLength() > compression_.max_cached_file) {
+    return true;
+  }
+  auto compressed = compressed_files_->Get(path, file->GetModifiedTime(), file->GetLength());
+  if (!compressed) {
+    // Not compressed yet, this one goes out as is rather than wait for deflate on the loop.
+    compressed_files_->Fill(path, file, compression_.level);
+    return true;
+  }
+  if (compressed->size() < file->GetLength()) {
+    resp.SetSharedBody(std::move(compressed));
+    resp.SetHeader(HeaderId::kContentEncoding, "gzip");
+    resp.SetHeader(HeaderId::kETag, etag);
+  }
+  return true;
 }
 
-bool HttpServer::Dispatch(HttpRequest const& req, HttpResponse& resp, HttpHandlers const& handlers) {
-  for (auto const& x : handlers) {
-    auto const& pattern = x.first;
-    auto const& handler = x.second;
+void HttpServer::Compress(HttpRequest const& req, HttpResponse& resp) const {
+  auto body = resp.GetBody();
+  if (resp.GetFileBody() || body.size() < compression_.min_size ||
+      !resp.GetHeader(HeaderId::kContentEncoding).empty() || !IsCompressible(resp.GetHeader(HeaderId::kContentType))) {
+    return;
+  }
+  resp.SetHeader(HeaderId::kVary, "Accept-Encoding");
+  auto coding = NegotiateEncoding(req.GetHeaderView(HeaderId::kAcceptEncoding));
+  if (coding == ContentCoding::kIdentity) {
+    return;
+  }
+
+  std::string compressed;
+  if (!Compressor::ForThisThread().Compress(coding, compression_.level, body, compressed) ||
+      compressed.size() >= body.size()) {
+    return;
+  }
+  resp.SetBody(std::move(compressed));
+  resp.SetHeader(HeaderId::kContentEncoding, EncodingName(coding));
+}
 
+HttpRoute const* HttpServer::Dispatch(HttpRequest const& req, HttpResponse& resp, HttpHandlers const& handlers) {
+  for (auto const& route : handlers) {
     std::smatch matches;
 
-    if (std::regex_match(req.GetPath(), matches, pattern)) {
-      handler(req, resp);
-      return true;
+    if (std::regex_match(req.GetPath(), matches, route.pattern)) {
+      if (route.handler && !route.cache) {
+        route.handler(req, resp);
+      }
+      return &route;
     }
   }
 
-  return false;
+  return nullptr;
 }
 
 HttpServer& HttpServer::Get(std::string_view path, HttpHandler handler) {
-  get_handlers_.emplace_back(std::regex{NormalizePath(path)}, std::move(handler));
+  auto normalized = NormalizePath(path);
+  get_handlers_.push_back({.path = normalized, .pattern = std::regex{normalized}, .handler = std::move(handler)});
+  return *this;
+}
+
+HttpServer& HttpServer::Get(std::string_view path, HttpHandler handler, CacheOptions options) {
+  auto normalized = NormalizePath(path);
+  get_handlers_.push_back({.path    = normalized,
+                           .pattern = std::regex{normalized},
+                           .handler = std::move(handler),
+                           .cache   = std::make_shared<ResponseCache>(std::move(options))});
   return *this;
 }
 
 HttpServer& HttpServer::Post(std::string_view path, HttpHandler handler) {
-  post_handlers_.emplace_back(std::regex{NormalizePath(path)}, std::move(handler));
+  auto normalized = NormalizePath(path);
+  post_handlers_.push_back({.path = normalized, .pattern = std::regex{normalized}, .handler = std::move(handler)});
   return *this;
 }
 
 HttpServer& HttpServer::Put(std::string_view path, HttpHandler handler) {
-  put_handlers_.emplace_back(std::regex{NormalizePath(path)}, std::move(handler));
+  auto normalized = NormalizePath(path);
+  put_handlers_.push_back({.path = normalized, .pattern = std::regex{normalized}, .handler = std::move(handler)});
   return *this;
 }
 
 HttpServer& HttpServer::Delete(std::string_view path, HttpHandler handler) {
-  delete_handlers_.emplace_back(std::regex{NormalizePath(path)}, std::move(handler));
+  auto normalized = NormalizePath(path);
+  delete_handlers_.push_back({.path = normalized, .pattern = std::regex{normalized}, .handler = std::move(handler)});
+  return *this;
+}
+
+HttpServer& HttpServer::GetAsync(std::string_view path, AsyncHttpHandler handler) {
+  auto normalized = NormalizePath(path);
+  get_handlers_.push_back(
+      {.path = normalized, .pattern = std::regex{normalized}, .async_handler = std::move(handler)});
+  return *this;
+}
+
+HttpServer& HttpServer::PostAsync(std::string_view path, AsyncHttpHandler handler) {
+  auto normalized = NormalizePath(path);
+  post_handlers_.push_back(
+      {.path = normalized, .pattern = std::regex{normalized}, .async_handler = std::move(handler)});
+  return *this;
+}
+
+HttpServer& HttpServer::PutAsync(std::string_view path, AsyncHttpHandler handler) {
+  auto normalized = NormalizePath(path);
+  put_handlers_.push_back({.path = normalized, .pattern = std::regex{normalized}, .async_handler = std::move(handler)});
+  return *this;
+}
+
+HttpServer& HttpServer::DeleteAsync(std::string_view path, AsyncHttpHandler handler) {
+  auto normalized = NormalizePath(path);
+  delete_handlers_.push_back(
+      {.path = normalized, .pattern = std::regex{normalized}, .async_handler = std::move(handler)});
   return *this;
 }
 
+HttpHandlers const* HttpServer::GetHandlers(Method method) const {
+  switch (method) {
+    case Method::kGet:
+      return &get_handlers_;
+    case Method::kPost:
+      return &post_handlers_;
+    case Method::kPut:
+      return &put_handlers_;
+    case Method::kDelete:
+      return &delete_handlers_;
+    default:
+      return nullptr;
+  }
+}
+
+RouteLatency HttpServer::Summarize(Method method, HttpRoute const& route) {
+  auto snapshot = route.latency->Snapshot();
+  auto ns       = [](uint64_t value) { return std::chrono::nanoseconds(value); };
+  return {
+      .method = method,
+      .path   = route.path,
+      .count  = snapshot.GetCount(),
+      .mean   = ns(static_cast<uint64_t>(snapshot.GetMean())),
+      .p50    = ns(snapshot.ValueAtQuantile(0.5)),
+      .p90    = ns(snapshot.ValueAtQuantile(0.9)),
+      .p99    = ns(snapshot.ValueAtQuantile(0.99)),
+      .p999   = ns(snapshot.ValueAtQuantile(0.999)),
+      .max    = ns(snapshot.GetMax()),
+  };
+}
+
+std::optional<RouteLatency> HttpServer::GetRouteLatency(Method method, std::string_view path) const {
+  if (method == Method::kGet && path == static_route_.path) {
+    return Summarize(method, static_route_);
+  }
+  auto const* handlers = GetHandlers(method);
+  if (handlers == nullptr) {
+    return std::nullopt;
+  }
+  auto normalized = NormalizePath(path);
+  for (auto const& route : *handlers) {
+    if (route.path == normalized) {
+      return Summarize(method, route);
+    }
+  }
+  return std::nullopt;
+}
+
+std::vector<RouteLatency> HttpServer::GetRouteLatencies() const {
+  std::vector<RouteLatency> latencies;
+  for (auto method : kRouteMethods) {
+    for (auto const& route : *GetHandlers(method)) {
+      latencies.push_back(Summarize(method, route));
+    }
+  }
+  if (!web_api_) {
+    latencies.push_back(Summarize(Method::kGet, static_route_));
+  }
+  return latencies;
+}
+
+HttpServer& HttpServer::EnableAccessLog(std::unique_ptr<util::LogSink> sink, AccessLogOptions options) {
+  if (started_) {
+    throw std::runtime_error("HttpServer::EnableAccessLog called after Start()");
+  }
+  access_log_ = std::make_unique<AccessLog>(std::move(sink), options);
+  access_log_->Start();
+  return *this;
+}
+
+HttpServer& HttpServer::EnableTrafficCapture(std::string const& path, TrafficCaptureOptions options) {
+  traffic_capture_ = std::make_shared<TrafficCapture>(path, options);
+  tcp_server_.SetTrafficCapture(traffic_capture_);
+  return *this;
+}
+
+HttpServer& HttpServer::EnableCompression(CompressionOptions options) {
+  compression_enabled_ = true;
+  compression_         = options;
+  compressed_files_    = std::make_unique<CompressedFileCache>(options.file_cache_bytes);
+  return *this;
+}
+
+HttpServer& HttpServer::EnableHttp2(Http2Options options) {
+  http2_enabled_ = true;
+  http2_options_ = options;
+  return *this;
+}
+
+HttpServer& HttpServer::WebSocket(std::string_view path, WebSocketHandlers handlers, WebSocketOptions options) {
+  auto normalized = NormalizePath(path);
+  websocket_routes_.push_back({.path     = normalized,
+                               .pattern  = std::regex{normalized},
+                               .handlers = std::move(handlers),
+                               .options  = options});
+  return *this;
+}
+
+HttpServer& HttpServer::EventStream(std::string_view path, EventHub& hub, EventStreamOpenHandler on_open) {
+  auto normalized = NormalizePath(path);
+  event_stream_routes_.push_back(
+      {.path = normalized, .pattern = std::regex{normalized}, .hub = &hub, .on_open = std::move(on_open)});
+  return *this;
+}
+
+HttpServer& HttpServer::Proxy(std::string_view path, std::shared_ptr<UpstreamGroup> upstreams, ProxyOptions options) {
+  auto  normalized = NormalizePath(path);
+  auto& proxy      = proxy_routes_.emplace_back(ProxyRoute{.path      = normalized,
+                                                           .pattern   = std::regex{normalized},
+                                                           .upstreams = std::move(upstreams),
+                                                           .options   = options,
+                                                           .route     = {.path = normalized}});
+  proxy.route.async_handler = [this, &proxy](HttpRequest const& /*unused*/, HttpResponder responder) {
+    Forward(proxy, std::move(responder));
+  };
+  return *this;
+}
+
+HttpServer& HttpServer::EnableMetrics(std::string_view path) {
+  if (!metrics_enabled_) {
+    metrics_enabled_ = true;
+    metrics_labels_  = {{"server", tcp_server_.GetAddr().ToIpPort()}};
+
+    auto&       registry  = util::MetricsRegistry::Global();
+    auto const& admission = tcp_server_.GetAdmissionController();
+    registry.AddCallback(
+        kAdmissionMetrics[0], "Connections rejected by admission control.", util::MetricType::kCounter,
+        [&admission] { return static_cast<double>(admission.GetShedConnections()); }, metrics_labels_);
+    registry.AddCallback(
+        kAdmissionMetrics[1], "Requests rejected by admission control.", util::MetricType::kCounter,
+        [&admission] { return static_cast<double>(admission.GetShedRequests()); }, metrics_labels_);
+    registry.AddCallback(
+        kAdmissionMetrics[2], "Requests being handled.", util::MetricType::kGauge,
+        [&admission] { return static_cast<double>(admission.GetInflightRequests()); }, metrics_labels_);
+
+    registry.AddCollector(
+        kRouteLatencyMetric, "Time from receiving a request to writing the last byte of its response, by route.",
+        util::MetricType::kSummary, this, [this](util::MetricsRegistry::SampleWriter const& write) {
+          auto write_route = [this, &write](Method method, HttpRoute const& route) {
+            auto                          snapshot = route.latency->Snapshot();
+            util::MetricsRegistry::Labels labels{metrics_labels_};
+            labels.emplace_back("method", MethodName(method));
+            labels.emplace_back("route", route.path);
+            for (auto [quantile, name] : kLatencyQuantiles) {
+              labels.emplace_back("quantile", name);
+              write("", labels, static_cast<double>(snapshot.ValueAtQuantile(quantile)) / 1e9);
+              labels.pop_back();
+            }
+            write("_sum", labels, static_cast<double>(snapshot.GetSum()) / 1e9);
+            write("_count", labels, static_cast<double>(snapshot.GetCount()));
+          };
+          for (auto method : kRouteMethods) {
+            for (auto const& route : *GetHandlers(method)) {
+              write_route(method, route);
+            }
+          }
+          if (!web_api_) {
+            write_route(Method::kGet, static_route_);
+          }
+        });
+  }
+
+  return Get(path, [](HttpRequest const& /*unused*/, HttpResponse& resp) {
+    resp.SetStatusCode(StatusCode::k200Ok);
+    resp.SetStatusMessage("OK");
+    resp.SetContentType("text/plain; version=0.0.4");
+    resp.SetBody(util::MetricsRegistry::Global().Serialize());
+  });
+}
+
 }  // namespace simple_http::net::http
\ No newline at end of file
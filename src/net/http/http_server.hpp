@@ -1,29 +1,122 @@
 #pragma once
 
+#include <atomic>
 #include <chrono>
+#include <deque>
 #include <functional>
 #include <map>
 #include <memory>
+#include <optional>
 #include <regex>
+#include <string>
 #include <vector>
 
 #include "net/event_loop.hpp"
+#include "net/http/access_log.hpp"
+#include "net/http/compression.hpp"
+#include "net/http/event_stream.hpp"
+#include "net/http/http2_session.hpp"
 #include "net/http/http_request.hpp"
 #include "net/http/http_response.hpp"
+#include "net/http/response_cache.hpp"
+#include "net/http/reverse_proxy.hpp"
+#include "net/http/websocket.hpp"
 #include "net/tcp_connection.hpp"
 #include "net/tcp_server.hpp"
+#include "utils/latency_histogram.hpp"
+#include "utils/metrics.hpp"
 #include "utils/msg_buffer.hpp"
 #include "utils/non_copyable.hpp"
 
 namespace simple_http::net::http {
-using HttpHandler  = std::function<void(HttpRequest const&, HttpResponse&)>;
-using HttpHandlers = std::vector<std::pair<std::regex, HttpHandler>>;
+struct HttpContext;
+
+struct HttpServer;
+struct AsyncResponse;
+
+using HttpHandler = std::function<void(HttpRequest const&, HttpResponse&)>;
+
+/**
+ * @brief Completes the response of an asynchronous handler. Send can be called once, from any
+ * thread, the response is written on the loop of the connection. A responder dropped without
+ * sending answers 500.
+ *
+ */
+struct HttpResponder {
+ public:
+  explicit HttpResponder(std::shared_ptr<AsyncResponse> state) : state_(std::move(state)) {}
+
+  [[nodiscard]] HttpResponse& GetResponse();
+  HttpResponse*               operator->() { return &GetResponse(); }
+
+  void Send() const;
+
+ private:
+  friend struct HttpServer;
+
+  std::shared_ptr<AsyncResponse> state_;
+};
+
+// The request stays valid until the response was sent.
+using AsyncHttpHandler = std::function<void(HttpRequest const&, HttpResponder)>;
+
+/**
+ * @brief A registered handler and the latency of the requests it served, from receiving the
+ * request to writing the last byte of the response.
+ *
+ */
+struct HttpRoute {
+  std::string                                    path;
+  std::regex                                     pattern;
+  HttpHandler                                    handler;
+  AsyncHttpHandler                               async_handler;  // set instead of handler for asynchronous routes
+  std::shared_ptr<ResponseCache>                 cache;          // of routes whose responses are cached
+  std::unique_ptr<util::ShardedLatencyHistogram> latency{std::make_unique<util::ShardedLatencyHistogram>()};
+};
+using HttpHandlers = std::vector<HttpRoute>;
+
+// A path accepting WebSocket upgrades and the handlers of its sessions.
+struct WebSocketRoute {
+  std::string       path;
+  std::regex        pattern;
+  WebSocketHandlers handlers;
+  WebSocketOptions  options;
+};
+
+// A path answered with an event stream, which then gets the events published to hub.
+struct EventStreamRoute {
+  std::string            path;
+  std::regex             pattern;
+  EventHub*              hub;
+  EventStreamOpenHandler on_open;
+};
+
+// A path whose requests are forwarded to upstreams, route answers them asynchronously.
+struct ProxyRoute {
+  std::string                    path;
+  std::regex                     pattern;
+  std::shared_ptr<UpstreamGroup> upstreams;
+  ProxyOptions                   options;
+  HttpRoute                      route;
+};
+
+struct RouteLatency {
+  Method                   method{Method::kGet};
+  std::string              path;
+  uint64_t                 count{0};
+  std::chrono::nanoseconds mean{0};
+  std::chrono::nanoseconds p50{0};
+  std::chrono::nanoseconds p90{0};
+  std::chrono::nanoseconds p99{0};
+  std::chrono::nanoseconds p999{0};
+  std::chrono::nanoseconds max{0};
+};
 
 struct HttpServer final : public util::NonCopyable {
  public:
   HttpServer(EventLoop* loop, bool web_api = true, InetAddr const& addr = {80});
 
-  ~HttpServer() = default;
+  ~HttpServer();
 
   void Start();
   void Stop();
@@ -33,23 +126,248 @@ struct HttpServer final : public util::NonCopyable {
   HttpServer& Put(std::string_view path, HttpHandler handler);
   HttpServer& Delete(std::string_view path, HttpHandler handler);
 
-  void SetEventLoopGroupNum(size_t num) { tcp_server_.SetEventLoopGroupNum(num); }
+  /**
+   * @brief Routes whose handlers answer later through the responder, e.g. once an HttpClient
+   * call on the same loop returned. The connection reads no further request meanwhile.
+   *
+   */
+  HttpServer& GetAsync(std::string_view path, AsyncHttpHandler handler);
+  HttpServer& PostAsync(std::string_view path, AsyncHttpHandler handler);
+  HttpServer& PutAsync(std::string_view path, AsyncHttpHandler handler);
+  HttpServer& DeleteAsync(std::string_view path, AsyncHttpHandler handler);
+
+  /**
+   * @brief A GET route whose responses are cached for options.ttl, for idempotent handlers. Hits
+   * are written without calling the handler, and while it runs for a key further requests for it
+   * wait for its response, on every loop. With compression enabled the coding is part of the key.
+   *
+   */
+  HttpServer& Get(std::string_view path, HttpHandler handler, CacheOptions options);
+
+  /**
+   * @brief Serve the global metrics registry in Prometheus text format at the given path. The
+   * samples of this server carry a server label with its listening address.
+   *
+   */
+  HttpServer& EnableMetrics(std::string_view path = "/metrics");
+
+  /**
+   * @brief Log every request to sink in Common or Combined Log Format. Loops only copy the request
+   * fields, formatting and writing happen on a background thread. Call it before Start(), loops
+   * read the log without synchronization, throws std::runtime_error after.
+   *
+   */
+  HttpServer& EnableAccessLog(std::unique_ptr<util::LogSink> sink, AccessLogOptions options = {});
+
+  [[nodiscard]] AccessLog const* GetAccessLog() const { return access_log_.get(); }
+
+  /**
+   * @brief Record the raw bytes clients send into a capture file at path, to be played back with
+   * tools/replay. Throws std::runtime_error if the file can't be created.
+   *
+   */
+  HttpServer& EnableTrafficCapture(std::string const& path, TrafficCaptureOptions options = {});
+
+  [[nodiscard]] TrafficCapture const* GetTrafficCapture() const { return traffic_capture_.get(); }
+
+  /**
+   * @brief Compress responses with gzip or deflate when the client accepts it. Static files are
+   * served from a .gz sidecar next to them if it is up to date, from a cached gzip variant
+   * otherwise.
+   *
+   */
+  HttpServer& EnableCompression(CompressionOptions options = {});
+
+  /**
+   * @brief Accept HTTP/2 over cleartext TCP, from clients starting with the connection preface
+   * and from HTTP/1.1 requests asking to upgrade to h2c. Requests are dispatched to the same
+   * routes, many of them at once on one connection.
+   *
+   */
+  HttpServer& EnableHttp2(Http2Options options = {});
+
+  /**
+   * @brief Accept WebSocket upgrades at path. A session stays on the loop of its connection,
+   * sessions that stay silent for options.ping_interval are pinged and dropped if they don't answer.
+   *
+   */
+  HttpServer& WebSocket(std::string_view path, WebSocketHandlers handlers, WebSocketOptions options = {});
+
+  /**
+   * @brief Answer GET requests for path with a text/event-stream and subscribe the connection to
+   * hub. on_open runs first and may send the events the client missed. The hub has to outlive the
+   * server.
+   *
+   */
+  HttpServer& EventStream(std::string_view path, EventHub& hub, EventStreamOpenHandler on_open = {});
+
+  /**
+   * @brief Forward requests for path of any method to one of upstreams, ahead of the other routes.
+   * Hop-by-hop fields are dropped and X-Forwarded-For is added. For HTTP/1.1 clients request
+   * bodies and large response bodies are relayed with splice(2), at the pace of the slower side.
+   * Failed upstreams are answered with 502, timed out ones with 504.
+   *
+   */
+  HttpServer& Proxy(std::string_view path, std::shared_ptr<UpstreamGroup> upstreams, ProxyOptions options = {});
+
+  /**
+   * @brief Serve connections on a group of num loops, see TcpServer::SetEventLoopGroupNum. Idle
+   * HTTP/1 connections of a loop leaving the group move to another one, HTTP/2, WebSocket and
+   * event stream connections are asked to reconnect.
+   *
+   */
+  void SetEventLoopGroupNum(size_t num, EventLoopGroupOptions options = {}) {
+    tcp_server_.SetEventLoopGroupNum(num, std::move(options));
+  }
+
+  void SetBusyPoll(std::chrono::microseconds idle_timeout, int socket_busy_poll_us = 0) {
+    tcp_server_.SetBusyPoll(idle_timeout, socket_busy_poll_us);
+  }
+
+  /**
+   * @brief Serve on a listening socket handed over by the process this one replaces, see
+   * HotRestart. Call it before Start().
+   *
+   */
+  void AdoptListenSocket(int listen_fd) { tcp_server_.AdoptListenSocket(listen_fd); }
+
+  [[nodiscard]] int GetListenFd() const { return tcp_server_.GetListenFd(); }
+
+  /**
+   * @brief Stop accepting and close connections as they become idle: keep-alive connections with
+   * their next response, or after a second without one. HTTP/2 clients get a GOAWAY, WebSocket
+   * clients a going away close. Whatever is left after timeout is closed, then done runs on the
+   * loop of the server.
+   *
+   */
+  void Drain(std::chrono::steady_clock::duration timeout, std::function<void()> done);
+
+  /**
+   * @brief Limits beyond which connections and requests are answered with 503 and closed.
+   *
+   */
+  void SetAdmissionOptions(AdmissionOptions const& options) { tcp_server_.SetAdmissionOptions(options); }
+
+  [[nodiscard]] AdmissionController const& GetAdmissionController() const {
+    return tcp_server_.GetAdmissionController();
+  }
+
+  /**
+   * @brief Latency percentiles of the route registered with the given method and path, merged
+   * over all loops. Static files are reported under the path "static".
+   *
+   */
+  [[nodiscard]] std::optional<RouteLatency> GetRouteLatency(Method method, std::string_view path) const;
+  [[nodiscard]] std::vector<RouteLatency>   GetRouteLatencies() const;
+
+  /**
+   * @brief Run the handler of the first of handlers whose pattern matches the path of req, as is
+   * done for every request. Returns that route, nullptr if none matched.
+   *
+   */
+  static HttpRoute const* Dispatch(HttpRequest const& req, HttpResponse& resp, HttpHandlers const& handlers);
 
  private:
+  friend struct AsyncResponse;
+  friend struct HttpResponder;
+
   bool      web_api_{true};
+  bool      metrics_enabled_{false};
+  bool      started_{false};
   TcpServer tcp_server_;
 
+  // Tells the samples of this server apart from those of others in the process.
+  util::MetricsRegistry::Labels metrics_labels_;
+
   HttpHandlers get_handlers_;
   HttpHandlers post_handlers_;
   HttpHandlers put_handlers_;
   HttpHandlers delete_handlers_;
+  HttpRoute    static_route_{.path = "static"};
+
+  std::unique_ptr<AccessLog> access_log_;
+
+  std::shared_ptr<TrafficCapture> traffic_capture_;
+
+  bool                                 compression_enabled_{false};
+  CompressionOptions                   compression_;
+  std::unique_ptr<CompressedFileCache> compressed_files_;
+
+  bool         http2_enabled_{false};
+  Http2Options http2_options_;
+
+  std::atomic_bool draining_{false};
+
+  std::deque<WebSocketRoute>    websocket_routes_;  // sessions keep references into it, a deque never moves them
+  std::vector<EventStreamRoute> event_stream_routes_;
+  std::deque<ProxyRoute>        proxy_routes_;  // handlers refer to their route
 
   static void OnConnection(TcpConnection* conn);
+  void        OnWriteComplete(TcpConnection* conn);
+  void        Rebalance(TcpConnection* conn, HttpContext const& context);
+  static void OnDrain(std::shared_ptr<TcpConnection> const& conn);
+  void        OnRetire(std::shared_ptr<TcpConnection> const& conn);
   void        OnMessage(TcpConnection* conn, util::MsgBuffer& buf, Timepoint const& receive_time);
-  void        OnRequest(TcpConnection* conn, HttpRequest const& req);
+  void        OnRequest(TcpConnection* conn, HttpContext& context, HttpRequest const& req);
+  bool        OnHttp2Request(TcpConnection* conn, uint32_t stream_id, HttpRequest const& req, HttpResponse& resp);
+
+  // Writes the response of an HTTP/1 request, and finishes its bookkeeping.
+  void SendResponse(TcpConnection* conn, HttpContext& context, HttpRequest const& req, HttpResponse& response,
+                    HttpRoute const* route);
+  // Hands req to the asynchronous handler of route, stream_id is zero for HTTP/1 requests.
+  void RespondLater(TcpConnection* conn, HttpRequest const& req, HttpRoute const& route, bool close,
+                    uint32_t stream_id);
+  void FinishAsync(AsyncResponse& state);
+
+  // Answers req of a cached route, with the entry hit or by running the handler into resp. Returns
+  // false if another request computes the response, it is then sent like that of an asynchronous
+  // handler.
+  bool RespondCached(TcpConnection* conn, HttpRequest const& req, HttpRoute const& route, bool close,
+                     uint32_t stream_id, HttpResponse& resp, CachedResponsePtr& hit);
+  void ComputeCached(HttpRequest const& req, HttpRoute const& route, HttpResponse& resp) const;
+  // Writes a cache hit to a keep-alive HTTP/1 connection, from the buffer shared by all of them.
+  void SendCached(TcpConnection* conn, HttpContext& context, HttpRequest const& req, CachedResponse const& cached,
+                  HttpRoute const& route);
+
+  [[nodiscard]] ProxyRoute const* FindProxyRoute(HttpRequest const& req) const;
+  void                            Forward(ProxyRoute const& proxy, HttpResponder responder);
+  // Ends an HTTP/1 response whose body the proxy relayed from the upstream.
+  void FinishRelayed(AsyncResponse& state, bool complete);
+
+  // Sends the next parts of the streamed response of the connection, and ends it after the last one.
+  void PumpStream(TcpConnection* conn, HttpContext& context);
+
+  // Runs the route of req, answers revalidations with 304 and compresses the response, for both protocols.
+  HttpRoute const* Respond(HttpRequest const& req, HttpResponse& resp);
+  // Metrics and access log of an answered request.
+  void LogResponse(TcpConnection* conn, HttpRequest const& req, StatusCode status, std::size_t bytes, Timepoint now);
+
+  void        StartHttp2(TcpConnection* conn, HttpContext& context);
+  bool        UpgradeToHttp2(TcpConnection* conn, HttpContext& context, HttpRequest const& req);
+  static void ReceiveHttp2(TcpConnection* conn, Http2Session& session, util::MsgBuffer& buf,
+                           Timepoint const& receive_time);
+  static void FlushHttp2(TcpConnection* conn, Http2Session& session, std::string& out);
+
+  [[nodiscard]] WebSocketRoute const* FindWebSocketRoute(HttpRequest const& req) const;
+  void UpgradeToWebSocket(TcpConnection* conn, HttpContext& context, HttpRequest const& req,
+                          WebSocketRoute const& route);
+  static void ReceiveWebSocket(TcpConnection* conn, WebSocketSession& session, util::MsgBuffer& buf,
+                               Timepoint const& receive_time);
+  // Requests pipelined behind a streamed or asynchronous response wait in the read buffer, handle
+  // them once it is through.
+  static void ResumeInput(TcpConnection* conn);
+
+  [[nodiscard]] EventStreamRoute const* FindEventStreamRoute(HttpRequest const& req) const;
+  void OpenEventStream(TcpConnection* conn, HttpContext& context, HttpRequest const& req,
+                       EventStreamRoute const& route);
+
+  // Returns the route that handled the request, or nullptr if none did.
+  HttpRoute const* Route(HttpRequest const& req, HttpResponse& resp);
 
-  bool Route(HttpRequest const& req, HttpResponse& resp);
+  bool ServeFile(HttpRequest const& req, HttpResponse& resp, std::string const& path);
+  void Compress(HttpRequest const& req, HttpResponse& resp) const;
 
-  static bool Dispatch(HttpRequest const& req, HttpResponse& resp, HttpHandlers const& handlers);
+  HttpHandlers const* GetHandlers(Method method) const;
+  static RouteLatency Summarize(Method method, HttpRoute const& route);
 };
 }  // namespace simple_http::net::http
\ No newline at end of file
@@ -0,0 +1,176 @@
+#include <algorithm>
+
+#include "utils/msg_buffer.hpp"
+
+#include "response_cache.hpp"
+
+namespace simple_http::net::http {
+
+namespace {
+std::atomic<uint64_t> next_response_cache_id{0};
+}  // namespace
+
+void CachedResponse::CopyTo(HttpResponse& to) const {
+  to.SetStatusCode(response.GetStatusCode());
+  to.SetStatusMessage(response.GetStatusMessage());
+  for (auto const& [name, value] : response.GetHeaders()) {
+    to.SetHeader(name, value);
+  }
+  to.SetBody(response.GetBody());
+}
+
+ResponseCache::ResponseCache(CacheOptions options)
+    : options_(std::move(options)), id_(next_response_cache_id.fetch_add(1, std::memory_order_relaxed)) {}
+
+ResponseCache::~ResponseCache() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto& tier : tiers_) {
+    tier->orphaned.store(true, std::memory_order_release);
+  }
+}
+
+std::string ResponseCache::Key(HttpRequest const& req, std::string_view variant) const {
+  std::string key{MethodName(req.GetMethod())};
+  key += ' ';
+  key += req.GetPath();
+  key += '?';
+  key += req.GetQuery();
+  // Field values cannot hold line breaks, they separate the parts unambiguously.
+  for (auto const& field : options_.vary) {
+    key += '\n';
+    key += req.GetHeaderView(field);
+  }
+  key += '\n';
+  key += variant;
+  return key;
+}
+
+CachedResponsePtr ResponseCache::Find(std::string const& key, Timepoint now, bool& fresh) {
+  fresh       = false;
+  auto& local = GetTier().entries;
+
+  CachedResponsePtr stale;
+  if (auto it = local.find(key); it != local.end()) {
+    if (now < it->second->fresh_until) {
+      fresh = true;
+      return it->second;
+    }
+    if (now < it->second->stale_until) {
+      stale = it->second;
+    } else {
+      local.erase(it);
+    }
+  }
+
+  CachedResponsePtr entry;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (auto it = shared_.find(key); it != shared_.end()) {
+      entry = it->second;
+    }
+  }
+  if (!entry || now >= entry->stale_until) {
+    return stale;
+  }
+  // Another loop stored the key, or a newer response than the local one.
+  if (now < entry->fresh_until) {
+    fresh = true;
+  } else if (stale && stale->stale_until >= entry->stale_until) {
+    return stale;
+  }
+  Insert(local, key, entry, now);
+  return entry;
+}
+
+bool ResponseCache::Claim(std::string const& key, Waiter waiter) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto [it, claimed] = flights_.try_emplace(key);
+  if (!claimed && waiter) {
+    it->second.push_back(std::move(waiter));
+  }
+  return claimed;
+}
+
+CachedResponsePtr ResponseCache::Complete(std::string const& key, HttpResponse const& response, Timepoint now) {
+  CachedResponsePtr entry;
+  if (IsCacheable(response)) {
+    auto stored         = std::make_shared<CachedResponse>();
+    stored->response    = response;
+    stored->fresh_until = now + options_.ttl;
+    stored->stale_until = stored->fresh_until + options_.stale_while_revalidate;
+    stored->response.SetCloseConnection(false);
+    util::MsgBuffer wire;
+    stored->response.WriteTo(wire);
+    stored->wire = std::make_shared<std::string const>(wire.Peek(), wire.ReadableSize());
+    entry        = std::move(stored);
+    Insert(GetTier().entries, key, entry, now);
+  }
+
+  std::vector<Waiter> waiters;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (entry) {
+      Insert(shared_, key, entry, now);
+    }
+    if (auto it = flights_.find(key); it != flights_.end()) {
+      waiters = std::move(it->second);
+      flights_.erase(it);
+    }
+  }
+  for (auto const& waiter : waiters) {
+    waiter(entry);
+  }
+  return entry;
+}
+
+ResponseCache::Tier& ResponseCache::GetTier() {
+  struct Registry {
+    std::vector<std::pair<uint64_t, std::shared_ptr<Tier>>> tiers;
+  };
+  thread_local Registry registry;
+
+  for (auto& [id, tier] : registry.tiers) {
+    if (id == id_) {
+      return *tier;
+    }
+  }
+
+  std::erase_if(registry.tiers,
+                [](auto const& entry) { return entry.second->orphaned.load(std::memory_order_acquire); });
+  auto tier = std::make_shared<Tier>();
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    tiers_.push_back(tier);
+  }
+  registry.tiers.emplace_back(id_, tier);
+  return *tier;
+}
+
+void ResponseCache::Insert(Entries& entries, std::string const& key, CachedResponsePtr const& entry,
+                           Timepoint now) const {
+  if (!entries.contains(key) && entries.size() >= options_.max_entries) {
+    std::erase_if(entries, [now](auto const& item) { return now >= item.second->stale_until; });
+  }
+  if (!entries.contains(key) && entries.size() >= options_.max_entries) {
+    // Still full of live entries, make room with the one expiring first.
+    auto first = std::min_element(entries.begin(), entries.end(), [](auto const& a, auto const& b) {
+      return a.second->stale_until < b.second->stale_until;
+    });
+    entries.erase(first);
+  }
+  entries.insert_or_assign(key, entry);
+}
+
+bool ResponseCache::IsCacheable(HttpResponse const& response) const {
+  if (response.GetStatusCode() != StatusCode::k200Ok || response.IsStreaming() || response.GetFileBody() ||
+      response.GetSharedBody() || response.GetBody().size() > options_.max_body_size || options_.max_entries == 0) {
+    return false;
+  }
+  // A cookie belongs to the client it was set for, replaying it would hand its session to others.
+  if (!response.GetHeader(HeaderId::kSetCookie).empty()) {
+    return false;
+  }
+  auto control = response.GetHeader(HeaderId::kCacheControl);
+  return control.find("no-store") == std::string_view::npos && control.find("private") == std::string_view::npos;
+}
+}  // namespace simple_http::net::http
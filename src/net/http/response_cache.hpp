@@ -0,0 +1,98 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "net/http/http.hpp"
+#include "net/http/http_request.hpp"
+#include "net/http/http_response.hpp"
+#include "utils/non_copyable.hpp"
+
+namespace simple_http::net::http {
+
+struct CacheOptions {
+  std::chrono::milliseconds ttl{1000};
+  // An expired response is still served this long while one request computes its successor.
+  std::chrono::milliseconds stale_while_revalidate{0};
+  // Request fields whose values are part of the key, next to method, path and query.
+  std::vector<std::string> vary;
+  std::size_t              max_entries{1024};  // per tier, the one shared by all loops and that of each loop
+  std::size_t              max_body_size{1024 * 1024};  // larger responses are not cached
+};
+
+// A response ready to be sent again.
+struct CachedResponse {
+  HttpResponse                       response{false};
+  std::shared_ptr<std::string const> wire;  // status line, fields and body for keep-alive connections
+  Timepoint                          fresh_until;
+  Timepoint                          stale_until;
+
+  // Copy status, fields and body, leaving the connection handling of to.
+  void CopyTo(HttpResponse& to) const;
+};
+
+using CachedResponsePtr = std::shared_ptr<CachedResponse const>;
+
+/**
+ * @brief Responses of an idempotent route, kept for the TTL. Every loop looks keys up in its own
+ * tier first, without locking, and falls back to the tier shared by all loops, which also gets
+ * every stored response.
+ *
+ * Only one computation of a key runs at a time. Requests missing it meanwhile wait for its result,
+ * on any loop. Only 200 responses with an in-memory body are stored, and none whose handler set
+ * Cache-Control to no-store or private, or a cookie.
+ *
+ */
+struct ResponseCache : public util::NonCopyable {
+ public:
+  // Gets the computed response, nullptr if it could not be stored.
+  using Waiter = std::function<void(CachedResponsePtr const& entry)>;
+
+  explicit ResponseCache(CacheOptions options);
+  ~ResponseCache();
+
+  // The key of req, variant tells apart responses that differ beyond the request, e.g. in coding.
+  [[nodiscard]] std::string Key(HttpRequest const& req, std::string_view variant) const;
+
+  // The entry of key that is still fresh, or stale within the revalidation window, then with
+  // fresh left false. nullptr if there is neither.
+  [[nodiscard]] CachedResponsePtr Find(std::string const& key, Timepoint now, bool& fresh);
+
+  // Claim the computation of key. Returns false if one is running already, waiter gets its result
+  // then, if given.
+  [[nodiscard]] bool Claim(std::string const& key, Waiter waiter = {});
+
+  // End the claimed computation of key with response, storing it if it can be, and hand it to those
+  // waiting.
+  CachedResponsePtr Complete(std::string const& key, HttpResponse const& response, Timepoint now);
+
+ private:
+  using Entries = std::unordered_map<std::string, CachedResponsePtr>;
+
+  // The entries of one loop, only touched by its thread.
+  struct Tier {
+    Entries           entries;
+    std::atomic<bool> orphaned{false};  // the cache is gone, the thread drops the tier
+  };
+
+  CacheOptions                                         options_;
+  uint64_t const                                       id_;
+  std::mutex                                           mutex_;
+  Entries                                              shared_;
+  std::vector<std::shared_ptr<Tier>>                   tiers_;
+  std::unordered_map<std::string, std::vector<Waiter>> flights_;
+
+  Tier&              GetTier();
+  void               Insert(Entries& entries, std::string const& key, CachedResponsePtr const& entry,
+                            Timepoint now) const;
+  [[nodiscard]] bool IsCacheable(HttpResponse const& response) const;
+};
+}  // namespace simple_http::net::http
@@ -0,0 +1,181 @@
+#include <algorithm>
+#include <charconv>
+#include <string_view>
+
+#include "utils/perfect_hash.hpp"
+
+#include "response_parser.hpp"
+
+namespace simple_http::net::http {
+
+namespace {
+constexpr std::size_t kMaxHeaderBytes = 64 * 1024;
+
+std::string_view Trim(std::string_view s) {
+  while (!s.empty() && (s.front() == ' ' || s.front() == '\t')) {
+    s.remove_prefix(1);
+  }
+  while (!s.empty() && (s.back() == ' ' || s.back() == '\t')) {
+    s.remove_suffix(1);
+  }
+  return s;
+}
+}  // namespace
+
+bool ResponseParser::Parse(util::MsgBuffer& buf) {
+  started_ = started_ || buf.ReadableSize() > 0;
+  while (state_ != State::kComplete && state_ != State::kRelay) {
+    if (state_ == State::kBody || state_ == State::kChunkData || state_ == State::kUntilClose) {
+      auto size = state_ == State::kUntilClose ? buf.ReadableSize() : std::min(remaining_, buf.ReadableSize());
+      if (size == 0) {
+        return true;
+      }
+      if (!TakeBody(buf, size)) {
+        return false;
+      }
+      if (state_ != State::kUntilClose && (remaining_ -= size) == 0) {
+        if (state_ == State::kBody) {
+          Done();
+        } else {
+          state_ = State::kChunkEnd;
+        }
+      }
+      continue;
+    }
+
+    auto const* crlf = buf.FindCRLF();
+    if (crlf == nullptr) {
+      return buf.ReadableSize() <= kMaxHeaderBytes;
+    }
+    std::string_view line{buf.Peek(), static_cast<std::size_t>(crlf - buf.Peek())};
+    header_bytes_ += line.size() + 2;
+    if (header_bytes_ > kMaxHeaderBytes + max_size_) {
+      return false;
+    }
+
+    bool ok = true;
+    switch (state_) {
+      case State::kStatusLine:
+        ok = ParseStatusLine(line);
+        break;
+      case State::kHeaders:
+        ok = line.empty() ? StartBody() : ParseHeader(line);
+        break;
+      case State::kChunkSize: {
+        std::size_t size   = 0;
+        auto        digits = line.substr(0, line.find(';'));
+        auto [end, ec]     = std::from_chars(digits.data(), digits.data() + digits.size(), size, 16);
+        ok                 = ec == std::errc{} && end != digits.data();
+        remaining_         = size;
+        state_             = size == 0 ? State::kTrailers : State::kChunkData;
+        break;
+      }
+      case State::kChunkEnd:
+        ok     = line.empty();
+        state_ = State::kChunkSize;
+        break;
+      case State::kTrailers:
+        if (line.empty()) {
+          Done();
+        }
+        break;
+      default:
+        break;
+    }
+    buf.RetrieveUntil(crlf + 2);
+    if (!ok) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool ResponseParser::ParseStatusLine(std::string_view line) {
+  // HTTP/1.1 200 OK
+  if (line.size() < 12 || line.substr(0, 7) != "HTTP/1." || line[8] != ' ') {
+    return false;
+  }
+  unsigned int code = 0;
+  auto [end, ec]    = std::from_chars(line.data() + 9, line.data() + 12, code);
+  if (ec != std::errc{} || end != line.data() + 12) {
+    return false;
+  }
+  keep_alive_ = line[7] == '1';
+  response_.SetStatusCode(code);
+  response_.SetStatusMessage(Trim(line.substr(12)));
+  state_ = State::kHeaders;
+  return true;
+}
+
+bool ResponseParser::ParseHeader(std::string_view line) {
+  auto colon = line.find(':');
+  if (colon == std::string_view::npos || colon == 0) {
+    return false;
+  }
+  auto name  = line.substr(0, colon);
+  auto value = Trim(line.substr(colon + 1));
+  if (FindHeaderId(name) == HeaderId::kConnection) {
+    if (util::EqualsIgnoreCase(value, "close")) {
+      keep_alive_ = false;
+    } else if (util::EqualsIgnoreCase(value, "keep-alive")) {
+      keep_alive_ = true;
+    }
+  }
+  // Repeated fields are combined into one list.
+  if (auto existing = response_.GetHeader(name); !existing.empty()) {
+    response_.SetHeader(name, std::string{existing} + ", " + std::string{value});
+  } else {
+    response_.SetHeader(name, value);
+  }
+  return true;
+}
+
+bool ResponseParser::StartBody() {
+  auto code = static_cast<unsigned int>(response_.GetStatusCode());
+  if (code / 100 == 1 && code != 101) {
+    // An interim response, the final one follows.
+    response_ = HttpResponse(false);
+    state_    = State::kStatusLine;
+    return true;
+  }
+  if (head_ || code / 100 == 1 || code == 204 || code == 304) {
+    Done();
+    return true;
+  }
+  if (response_.GetHeader(HeaderId::kTransferEncoding).find("chunked") != std::string_view::npos) {
+    state_ = State::kChunkSize;
+    return true;
+  }
+  if (auto length = response_.GetHeader(HeaderId::kContentLength); !length.empty()) {
+    auto [end, ec] = std::from_chars(length.data(), length.data() + length.size(), remaining_);
+    if (ec != std::errc{}) {
+      return false;
+    }
+    if (remaining_ > 0 && remaining_ >= relay_threshold_) {
+      state_ = State::kRelay;
+      return true;
+    }
+    if (remaining_ > max_size_) {
+      return false;
+    }
+    if (remaining_ == 0) {
+      Done();
+    } else {
+      state_ = State::kBody;
+    }
+    return true;
+  }
+  keep_alive_ = false;
+  state_      = State::kUntilClose;
+  return true;
+}
+
+bool ResponseParser::TakeBody(util::MsgBuffer& buf, std::size_t size) {
+  if (body_.size() + size > max_size_) {
+    return false;
+  }
+  body_.append(buf.Peek(), size);
+  buf.Retrieve(size);
+  return true;
+}
+}  // namespace simple_http::net::http
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+#include "net/http/http_response.hpp"
+#include "utils/msg_buffer.hpp"
+
+namespace simple_http::net::http {
+/**
+ * @brief Incremental parser of the HTTP/1.x responses of one connection, with Content-Length,
+ * chunked or close-delimited bodies. Interim 1xx responses are skipped.
+ *
+ */
+struct ResponseParser {
+ public:
+  enum class State {
+    kStatusLine,
+    kHeaders,
+    kBody,
+    kChunkSize,
+    kChunkData,
+    kChunkEnd,
+    kTrailers,
+    kUntilClose,
+    kRelay,  // the head is complete, the body is left to a relay
+    kComplete,
+  };
+
+  // Expect the response to a request, head for HEAD requests. Bodies larger than max_size are
+  // malformed, and those of at least relay_threshold bytes are left to a relay.
+  void Reset(bool head, std::size_t max_size, std::size_t relay_threshold) {
+    state_           = State::kStatusLine;
+    head_            = head;
+    max_size_        = max_size;
+    relay_threshold_ = relay_threshold;
+    keep_alive_      = true;
+    started_         = false;
+    remaining_       = 0;
+    header_bytes_    = 0;
+    response_        = HttpResponse(false);
+    body_.clear();
+  }
+
+  // Returns false on malformed input.
+  [[nodiscard]] bool Parse(util::MsgBuffer& buf);
+
+  // The connection closed, which completes a body that runs until then.
+  bool FinishAtClose() {
+    if (state_ != State::kUntilClose) {
+      return false;
+    }
+    Done();
+    return true;
+  }
+
+  // The body was relayed, the response is complete without it.
+  void FinishRelay() { Done(); }
+
+  [[nodiscard]] bool          Complete() const { return state_ == State::kComplete; }
+  [[nodiscard]] bool          Relayed() const { return state_ == State::kRelay; }
+  [[nodiscard]] std::size_t   GetRelayLength() const { return remaining_; }
+  [[nodiscard]] bool          Started() const { return started_; }
+  [[nodiscard]] bool          KeepAlive() const { return keep_alive_; }
+  [[nodiscard]] HttpResponse& GetResponse() { return response_; }
+
+ private:
+  State        state_{State::kStatusLine};
+  bool         head_{false};
+  std::size_t  max_size_{0};
+  std::size_t  relay_threshold_{0};
+  bool         keep_alive_{true};
+  bool         started_{false};
+  std::size_t  remaining_{0};
+  std::size_t  header_bytes_{0};
+  HttpResponse response_{false};
+  std::string  body_;
+
+  bool ParseStatusLine(std::string_view line);
+  bool ParseHeader(std::string_view line);
+  bool StartBody();
+  bool TakeBody(util::MsgBuffer& buf, std::size_t size);
+  void Done() {
+    response_.SetBody(std::move(body_));
+    state_ = State::kComplete;
+  }
+};
+}  // namespace simple_http::net::http
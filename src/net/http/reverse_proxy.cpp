@@ -0,0 +1,226 @@
+#include <algorithm>
+#include <array>
+#include <functional>
+
+#include "utils/logger.hpp"
+#include "utils/perfect_hash.hpp"
+
+#include "reverse_proxy.hpp"
+
+namespace simple_http::net::http {
+
+namespace {
+constexpr std::array<std::string_view, 9> kHopByHopFields{
+    "Connection", "Keep-Alive",        "Proxy-Connection", "Proxy-Authenticate", "Proxy-Authorization",
+    "TE",         "Transfer-Encoding", "Upgrade",          "Trailer",
+};
+
+HttpClientOptions ProbeOptions(UpstreamOptions const& options) {
+  auto probe            = options.client;
+  probe.connect_timeout = std::min(probe.connect_timeout, options.health_timeout);
+  probe.request_timeout = options.health_timeout;
+  probe.max_connections = 1;
+  return probe;
+}
+}  // namespace
+
+Upstream::Upstream(InetAddr const& addr, UpstreamOptions const& options)
+    : client_(addr, options.client), probe_(addr, ProbeOptions(options)) {}
+
+UpstreamGroup::UpstreamGroup(std::vector<InetAddr> const& servers, UpstreamOptions options)
+    : options_(std::move(options)) {
+  upstreams_.reserve(servers.size());
+  for (auto const& addr : servers) {
+    upstreams_.push_back(std::make_unique<Upstream>(addr, options_));
+  }
+}
+
+void UpstreamGroup::StartHealthChecks(EventLoop* loop) {
+  if (checking_.exchange(true)) {
+    return;
+  }
+  loop->RunInLoop([group = weak_from_this(), loop, interval = options_.health_interval] {
+    if (auto locked = group.lock(); locked) {
+      locked->Probe(loop);
+      ScheduleHealthCheck(group, loop, interval);
+    }
+  });
+}
+
+Upstream* UpstreamGroup::BeginRequest(InetAddr const& client) {
+  auto* upstream = Pick(client);
+  if (upstream != nullptr) {
+    upstream->in_flight_.fetch_add(1, std::memory_order_relaxed);
+  }
+  return upstream;
+}
+
+void UpstreamGroup::EndRequest(Upstream& upstream, bool connect_failed) {
+  upstream.in_flight_.fetch_sub(1, std::memory_order_relaxed);
+  if (!connect_failed) {
+    upstream.failures_.store(0, std::memory_order_relaxed);
+    return;
+  }
+  // Without health checks nothing would take the upstream back.
+  if (checking_.load(std::memory_order_relaxed) &&
+      upstream.failures_.fetch_add(1, std::memory_order_relaxed) + 1 >= options_.fall &&
+      upstream.healthy_.exchange(false)) {
+    LOG_WARNING << "Upstream " << upstream.GetAddr().ToIpPort() << " is down, connects failed";
+  }
+}
+
+std::size_t UpstreamGroup::GetHealthyCount() const {
+  return std::count_if(upstreams_.begin(), upstreams_.end(),
+                       [](auto const& upstream) { return upstream->IsHealthy(); });
+}
+
+Upstream* UpstreamGroup::Pick(InetAddr const& client) {
+  auto size = upstreams_.size();
+  if (size == 0) {
+    return nullptr;
+  }
+  std::size_t start = 0;
+  if (options_.balancing == LoadBalancing::kClientHash) {
+    start = std::hash<uint32_t>{}(client.GetIpInNetEndian()) % size;
+  } else {
+    start = next_.fetch_add(1, std::memory_order_relaxed) % size;
+  }
+
+  Upstream* best = nullptr;
+  for (std::size_t i = 0; i < size; ++i) {
+    auto* upstream = upstreams_[(start + i) % size].get();
+    if (!upstream->IsHealthy()) {
+      continue;
+    }
+    if (options_.balancing != LoadBalancing::kLeastRequests) {
+      return upstream;
+    }
+    // Scanning from a rotating start spreads the ties.
+    if (best == nullptr || upstream->GetInFlight() < best->GetInFlight()) {
+      best = upstream;
+    }
+  }
+  return best;
+}
+
+void UpstreamGroup::Probe(EventLoop* loop) {
+  for (auto const& upstream : upstreams_) {
+    HttpRequest req;
+    req.SetMethod(Method::kGet);
+    req.SetVersion(Version::kHttp11);
+    req.SetPath(options_.health_path);
+    auto done = [group = weak_from_this(), target = upstream.get()](HttpClientError error, HttpResponse& resp) {
+      if (auto locked = group.lock(); locked) {
+        locked->ProbeDone(*target, error == HttpClientError::kNone && static_cast<int>(resp.GetStatusCode()) < 500);
+      }
+    };
+    upstream->probe_.Send(loop, std::move(req), std::move(done));
+  }
+}
+
+void UpstreamGroup::ProbeDone(Upstream& upstream, bool passed) {
+  auto addr = upstream.GetAddr().ToIpPort();
+  if (!passed) {
+    upstream.passes_ = 0;
+    if (upstream.failures_.fetch_add(1, std::memory_order_relaxed) + 1 >= options_.fall &&
+        upstream.healthy_.exchange(false)) {
+      LOG_WARNING << "Upstream " << addr << " is down, health checks failed";
+    }
+    return;
+  }
+  upstream.failures_.store(0, std::memory_order_relaxed);
+  if (!upstream.IsHealthy() && ++upstream.passes_ >= options_.rise) {
+    upstream.passes_ = 0;
+    upstream.healthy_.store(true);
+    LOG_INFO << "Upstream " << addr << " is up again";
+  }
+}
+
+void UpstreamGroup::ScheduleHealthCheck(std::weak_ptr<UpstreamGroup> const& group, EventLoop* loop,
+                                        std::chrono::milliseconds interval) {
+  // The timer only holds on to the group weakly, the checks end with it.
+  loop->RunAfter(interval, [group, loop, interval] {
+    if (auto locked = group.lock(); locked) {
+      locked->Probe(loop);
+      ScheduleHealthCheck(group, loop, interval);
+    }
+  });
+}
+
+namespace proxy {
+bool IsHopByHop(std::string_view name, std::string_view connection) {
+  if (std::any_of(kHopByHopFields.begin(), kHopByHopFields.end(),
+                  [name](std::string_view field) { return util::EqualsIgnoreCase(name, field); })) {
+    return true;
+  }
+  // Connection lists further fields that are not to be forwarded.
+  while (!connection.empty()) {
+    auto comma = connection.find(',');
+    auto token = connection.substr(0, comma);
+    while (!token.empty() && token.front() == ' ') {
+      token.remove_prefix(1);
+    }
+    while (!token.empty() && token.back() == ' ') {
+      token.remove_suffix(1);
+    }
+    if (util::EqualsIgnoreCase(name, token)) {
+      return true;
+    }
+    connection = comma == std::string_view::npos ? std::string_view{} : connection.substr(comma + 1);
+  }
+  return false;
+}
+
+void RewriteRequest(HttpRequest& req, InetAddr const& client) {
+  auto                     connection = req.GetHeader(HeaderId::kConnection);
+  std::vector<std::string> hop_by_hop;
+  for (auto const& [name, value] : req.GetHeaders()) {
+    if (IsHopByHop(name, connection)) {
+      hop_by_hop.push_back(name);
+    }
+  }
+  for (auto const& name : hop_by_hop) {
+    req.RemoveHeader(name);
+  }
+
+  auto forwarded = req.GetHeader(HeaderId::kXForwardedFor);
+  forwarded      = forwarded.empty() ? client.ToIp() : forwarded + ", " + client.ToIp();
+  req.RemoveHeader(HeaderId::kXForwardedFor);
+  req.SetHeader(HeaderId::kXForwardedFor, forwarded);
+  req.RemoveHeader(HeaderId::kXForwardedProto);
+  req.SetHeader(HeaderId::kXForwardedProto, "http");
+}
+
+void CopyResponse(HttpResponse const& from, HttpResponse& to) {
+  to.SetStatusCode(from.GetStatusCode());
+  to.SetStatusMessage(from.GetStatusMessage());
+  auto connection = from.GetHeader(HeaderId::kConnection);
+  for (auto const& [name, value] : from.GetHeaders()) {
+    if (!IsHopByHop(name, connection) && !util::EqualsIgnoreCase(name, HeaderName(HeaderId::kContentLength))) {
+      to.SetHeader(name, value);
+    }
+  }
+}
+
+void AppendResponseHead(HttpResponse const& response, std::size_t length, bool close, std::string& out) {
+  out += "HTTP/1.1 ";
+  out += std::to_string(static_cast<int>(response.GetStatusCode()));
+  out += ' ';
+  out += response.GetStatusMessage();
+  out += "\r\nContent-Length: ";
+  out += std::to_string(length);
+  out += close ? "\r\nConnection: close\r\n" : "\r\nConnection: Keep-Alive\r\n";
+  auto connection = response.GetHeader(HeaderId::kConnection);
+  for (auto const& [name, value] : response.GetHeaders()) {
+    if (!IsHopByHop(name, connection) && !util::EqualsIgnoreCase(name, HeaderName(HeaderId::kContentLength))) {
+      out += name;
+      out += ": ";
+      out += value;
+      out += "\r\n";
+    }
+  }
+  out += "\r\n";
+}
+}  // namespace proxy
+
+}  // namespace simple_http::net::http
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "net/event_loop.hpp"
+#include "net/http/http_client.hpp"
+#include "net/http/http_request.hpp"
+#include "net/http/http_response.hpp"
+#include "net/inet_addr.hpp"
+#include "utils/non_copyable.hpp"
+
+namespace simple_http::net::http {
+
+enum class LoadBalancing {
+  kRoundRobin,
+  kLeastRequests,  // the upstream with the fewest requests in flight
+  kClientHash,     // requests of one client address go to the same upstream while it is healthy
+};
+
+struct UpstreamOptions {
+  LoadBalancing     balancing{LoadBalancing::kRoundRobin};
+  HttpClientOptions client;
+
+  // Upstreams are probed with a GET of this path, answers below 500 pass.
+  std::string               health_path{"/"};
+  std::chrono::milliseconds health_interval{5000};
+  std::chrono::milliseconds health_timeout{1000};
+  unsigned                  fall{3};  // failed probes or connects in a row that take an upstream out
+  unsigned                  rise{2};  // passed probes in a row that take it back
+};
+
+// A server of an upstream group and its connection pools.
+struct Upstream : public util::NonCopyable {
+ public:
+  Upstream(InetAddr const& addr, UpstreamOptions const& options);
+
+  [[nodiscard]] InetAddr const& GetAddr() const { return client_.GetUpstream(); }
+  [[nodiscard]] HttpClient&     GetClient() { return client_; }
+  [[nodiscard]] bool            IsHealthy() const { return healthy_.load(std::memory_order_relaxed); }
+  [[nodiscard]] std::size_t     GetInFlight() const { return in_flight_.load(std::memory_order_relaxed); }
+
+ private:
+  friend struct UpstreamGroup;
+
+  HttpClient               client_;
+  HttpClient               probe_;  // with the health timeout
+  std::atomic<bool>        healthy_{true};
+  std::atomic<std::size_t> in_flight_{0};
+  std::atomic<unsigned>    failures_{0};
+  unsigned                 passes_{0};  // only touched by the health check loop
+};
+
+/**
+ * @brief The servers a proxy route balances its requests over. Once health checks are started an
+ * upstream is taken out after fall failed probes or connects in a row, and back in after rise
+ * passed probes. The group has to be held in a shared_ptr.
+ *
+ */
+struct UpstreamGroup : public util::NonCopyable, public std::enable_shared_from_this<UpstreamGroup> {
+ public:
+  explicit UpstreamGroup(std::vector<InetAddr> const& servers, UpstreamOptions options = {});
+
+  // Probe the upstreams from a timer of loop, until the group is destroyed.
+  void StartHealthChecks(EventLoop* loop);
+
+  // Pick an upstream for a request of client, nullptr if none is healthy. Every request picked for
+  // has to be ended with EndRequest.
+  [[nodiscard]] Upstream* BeginRequest(InetAddr const& client);
+  void                    EndRequest(Upstream& upstream, bool connect_failed);
+
+  [[nodiscard]] std::vector<std::unique_ptr<Upstream>> const& GetUpstreams() const { return upstreams_; }
+  [[nodiscard]] std::size_t                                   GetHealthyCount() const;
+
+ private:
+  UpstreamOptions                        options_;
+  std::vector<std::unique_ptr<Upstream>> upstreams_;
+  std::atomic<std::size_t>               next_{0};
+  std::atomic<bool>                      checking_{false};
+
+  Upstream*   Pick(InetAddr const& client);
+  void        Probe(EventLoop* loop);
+  void        ProbeDone(Upstream& upstream, bool passed);
+  static void ScheduleHealthCheck(std::weak_ptr<UpstreamGroup> const& group, EventLoop* loop,
+                                  std::chrono::milliseconds interval);
+};
+
+struct ProxyOptions {
+  // Response bodies with at least this Content-Length are relayed to HTTP/1.1 clients with
+  // splice(2), smaller ones and those for HTTP/2 streams are buffered.
+  std::size_t splice_threshold{64 * 1024};
+};
+
+namespace proxy {
+// Whether a field only concerns one connection, connection is the value of its Connection field.
+[[nodiscard]] bool IsHopByHop(std::string_view name, std::string_view connection);
+
+// Drop the hop-by-hop fields of the client's connection and add those naming the client.
+void RewriteRequest(HttpRequest& req, InetAddr const& client);
+
+// Copy status and end-to-end fields of an upstream response.
+void CopyResponse(HttpResponse const& from, HttpResponse& to);
+
+// Append status line and fields of response, for a body of length bytes that is sent separately.
+void AppendResponseHead(HttpResponse const& response, std::size_t length, bool close, std::string& out);
+}  // namespace proxy
+}  // namespace simple_http::net::http
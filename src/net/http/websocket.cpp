@@ -0,0 +1,472 @@
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "net/event_loop.hpp"
+#include "utils/base64.hpp"
+#include "utils/sha1.hpp"
+
+#include "websocket.hpp"
+
+namespace simple_http::net::http {
+
+namespace {
+constexpr std::string_view kAcceptGuid = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+
+// A session holding a bigger read buffer or message gives it back once it is idle.
+constexpr std::size_t kIdleBufferSize = 64 * 1024;
+
+bool IsValidCloseCode(uint16_t code) {
+  return (code >= 1000 && code <= 1003) || (code >= 1007 && code <= 1011) || (code >= 3000 && code <= 4999);
+}
+
+/**
+ * @brief Keepalive of the sessions of one loop. Sessions sit in one-second slots by the time
+ * they have to be checked next, activity only moves the session's own deadline and the wheel
+ * catches up when the slot comes around. Idle sessions cost one weak pointer and no timer.
+ *
+ */
+struct KeepaliveWheel {
+ public:
+  static KeepaliveWheel& ForThisThread() {
+    thread_local KeepaliveWheel wheel;
+    return wheel;
+  }
+
+  void Watch(WebSocketSessionPtr const& session) {
+    if (!started_) {
+      started_ = true;
+      origin_  = std::chrono::steady_clock::now();
+      EventLoop::GetEventLoopOfCurrentThread()->RunEvery(kTick, [this]() { Tick(std::chrono::steady_clock::now()); });
+    }
+    Insert(session, session->GetDeadline());
+  }
+
+ private:
+  static constexpr std::size_t kSlots = 64;
+  static constexpr auto        kTick  = std::chrono::seconds(1);
+
+  std::array<std::vector<std::weak_ptr<WebSocketSession>>, kSlots> slots_;
+  Timepoint                                                          origin_;
+  uint64_t                                                           next_tick_{0};
+  bool                                                               started_{false};
+
+  [[nodiscard]] uint64_t TickOf(Timepoint time) const {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::seconds>(time - origin_).count());
+  }
+
+  void Insert(std::weak_ptr<WebSocketSession> session, Timepoint deadline) {
+    // Rounded up, a slot only holds sessions that are due when it comes around.
+    auto tick = std::max(TickOf(deadline + kTick - Timepoint::duration{1}), next_tick_);
+    slots_[tick % kSlots].push_back(std::move(session));
+  }
+
+  void Tick(Timepoint now) {
+    auto current = TickOf(now);
+    if (current >= next_tick_ + kSlots) {
+      next_tick_ = current + 1 - kSlots;  // each slot once after a stall
+    }
+    while (next_tick_ <= current) {
+      std::vector<std::weak_ptr<WebSocketSession>> due;
+      due.swap(slots_[next_tick_ % kSlots]);
+      ++next_tick_;
+      for (auto& weak : due) {
+        auto session = weak.lock();
+        if (!session) {
+          continue;
+        }
+        if (session->GetDeadline() <= now) {
+          session->CheckAlive(now);
+        }
+        if (auto deadline = session->GetDeadline(); deadline != Timepoint::max()) {
+          Insert(std::move(weak), deadline);
+        }
+      }
+    }
+  }
+};
+}  // namespace
+
+namespace websocket {
+std::string AcceptKey(std::string_view key) {
+  std::string input{key};
+  input += kAcceptGuid;
+  auto digest = util::Sha1(input);
+  return util::Base64Encode({reinterpret_cast<char const*>(digest.data()), digest.size()});
+}
+
+void Mask(char* data, std::size_t size, uint32_t key, std::size_t offset) {
+  // Rotate the key so that byte i of data is XORed with byte i % 4 of it.
+  std::array<unsigned char, 4> bytes{};
+  std::memcpy(bytes.data(), &key, sizeof(key));
+  std::rotate(bytes.begin(), bytes.begin() + static_cast<std::ptrdiff_t>(offset % 4), bytes.end());
+  std::memcpy(&key, bytes.data(), sizeof(key));
+
+  std::size_t i = 0;
+#if defined(__SSE2__)
+  auto const wide = _mm_set1_epi32(static_cast<int>(key));
+  for (; i + 16 <= size; i += 16) {
+    auto* p = reinterpret_cast<__m128i*>(data + i);
+    _mm_storeu_si128(p, _mm_xor_si128(_mm_loadu_si128(p), wide));
+  }
+#endif
+  uint64_t const key64 = (uint64_t{key} << 32) | key;
+  for (; i + 8 <= size; i += 8) {
+    uint64_t word = 0;
+    std::memcpy(&word, data + i, sizeof(word));
+    word ^= key64;
+    std::memcpy(data + i, &word, sizeof(word));
+  }
+  for (; i < size; ++i) {
+    data[i] = static_cast<char>(data[i] ^ bytes[i % 4]);
+  }
+}
+
+void AppendFrame(WebSocketOpcode opcode, std::string_view payload, bool fin, std::string& out) {
+  out.reserve(out.size() + payload.size() + 10);
+  out.push_back(static_cast<char>((fin ? 0x80 : 0x00) | static_cast<uint8_t>(opcode)));
+  if (payload.size() < 126) {
+    out.push_back(static_cast<char>(payload.size()));
+  } else if (payload.size() <= 0xffff) {
+    out.push_back(static_cast<char>(126));
+    out.push_back(static_cast<char>(payload.size() >> 8));
+    out.push_back(static_cast<char>(payload.size()));
+  } else {
+    out.push_back(static_cast<char>(127));
+    for (int shift = 56; shift >= 0; shift -= 8) {
+      out.push_back(static_cast<char>(static_cast<uint64_t>(payload.size()) >> shift));
+    }
+  }
+  out.append(payload);
+}
+
+bool IsValidUtf8(std::string_view data) {
+  auto const* p   = reinterpret_cast<unsigned char const*>(data.data());
+  auto const* end = p + data.size();
+  while (p < end) {
+    // Skip ASCII eight bytes at a time.
+    if (end - p >= 8) {
+      uint64_t word = 0;
+      std::memcpy(&word, p, sizeof(word));
+      if ((word & 0x8080808080808080ULL) == 0) {
+        p += 8;
+        continue;
+      }
+    }
+    if (*p < 0x80) {
+      ++p;
+      continue;
+    }
+    int      length = 0;
+    uint32_t point  = 0;
+    if ((*p & 0xe0) == 0xc0) {
+      length = 2;
+      point  = *p & 0x1f;
+    } else if ((*p & 0xf0) == 0xe0) {
+      length = 3;
+      point  = *p & 0x0f;
+    } else if ((*p & 0xf8) == 0xf0) {
+      length = 4;
+      point  = *p & 0x07;
+    } else {
+      return false;
+    }
+    if (end - p < length) {
+      return false;
+    }
+    for (int i = 1; i < length; ++i) {
+      if ((p[i] & 0xc0) != 0x80) {
+        return false;
+      }
+      point = (point << 6) | (p[i] & 0x3f);
+    }
+    // Overlong forms, surrogates and points past the last plane.
+    constexpr std::array<uint32_t, 5> kMinPoint{0, 0, 0x80, 0x800, 0x10000};
+    if (point < kMinPoint[length] || (point >= 0xd800 && point <= 0xdfff) || point > 0x10ffff) {
+      return false;
+    }
+    p += length;
+  }
+  return true;
+}
+}  // namespace websocket
+
+WebSocketSession::WebSocketSession(std::shared_ptr<TcpConnection> const& conn, WebSocketHandlers const& handlers,
+                                   WebSocketOptions const& options)
+    : conn_(conn),
+      peer_addr_(conn->GetPeerAddr()),
+      handlers_(handlers),
+      options_(options),
+      last_activity_(std::chrono::steady_clock::now()) {}
+
+void WebSocketSession::Open(HttpRequest const& req) {
+  last_activity_ = req.GetReceiveTime();
+  if (options_.ping_interval.count() > 0) {
+    KeepaliveWheel::ForThisThread().Watch(shared_from_this());
+  }
+  if (handlers_.on_open) {
+    handlers_.on_open(shared_from_this(), req);
+  }
+}
+
+void WebSocketSession::Close(uint16_t code, std::string_view reason) {
+  if (state_ != State::kOpen) {
+    return;
+  }
+  std::string payload;
+  payload.push_back(static_cast<char>(code >> 8));
+  payload.push_back(static_cast<char>(code));
+  payload.append(reason.substr(0, websocket::kMaxControlPayload - 2));
+
+  // Without the connection its loop may be gone as well.
+  auto conn = conn_.lock();
+  if (!conn) {
+    return;
+  }
+  conn->GetEventLoop()->RunInLoop([self = shared_from_this(), payload = std::move(payload)]() {
+    if (self->state_ != State::kOpen) {
+      return;
+    }
+    std::string frame;
+    websocket::AppendFrame(WebSocketOpcode::kClose, payload, true, frame);
+    self->SendFrame(std::move(frame));
+    self->state_      = State::kClosing;
+    self->probe_time_ = std::chrono::steady_clock::now();
+    if (self->options_.ping_interval.count() == 0) {
+      // Not watched for keepalive, the answer to the close still has a deadline.
+      KeepaliveWheel::ForThisThread().Watch(self);
+    }
+  });
+}
+
+bool WebSocketSession::Receive(util::MsgBuffer& buf, Timepoint receive_time) {
+  last_activity_ = receive_time;
+  awaiting_pong_ = false;
+
+  while (state_ != State::kClosed) {
+    auto        size = buf.ReadableSize();
+    auto const* head = reinterpret_cast<unsigned char const*>(buf.Peek());
+    if (size < 2) {
+      break;
+    }
+    if ((head[0] & 0x70) != 0) {
+      return Fail(websocket::kCloseProtocolError);  // no extension was negotiated
+    }
+    if ((head[1] & 0x80) == 0) {
+      return Fail(websocket::kCloseProtocolError);  // clients must mask their frames
+    }
+    bool        fin     = (head[0] & 0x80) != 0;
+    auto        opcode  = static_cast<WebSocketOpcode>(head[0] & 0x0f);
+    bool        control = (head[0] & 0x08) != 0;
+    uint64_t    length  = head[1] & 0x7f;
+    std::size_t header  = length == 126 ? 8 : length == 127 ? 14 : 6;
+    if (size < header) {
+      break;
+    }
+    if (length == 126) {
+      length = (uint64_t{head[2]} << 8) | head[3];
+    } else if (length == 127) {
+      if ((head[2] & 0x80) != 0) {
+        return Fail(websocket::kCloseProtocolError);  // the most significant bit must be 0
+      }
+      length = 0;
+      for (int i = 2; i < 10; ++i) {
+        length = (length << 8) | head[i];
+      }
+    }
+
+    if (control && (!fin || length > websocket::kMaxControlPayload)) {
+      return Fail(websocket::kCloseProtocolError);
+    }
+    // message_ never exceeds the limit, so the difference cannot wrap.
+    if (!control && length > options_.max_message_size - message_.size()) {
+      return Fail(websocket::kCloseMessageTooBig);
+    }
+    if (size - header < length) {
+      // The buffer grows with what arrives, a frame header alone reserves nothing.
+      break;
+    }
+
+    uint32_t key = 0;
+    std::memcpy(&key, head + header - 4, sizeof(key));
+    char* payload = buf.BeginRead() + header;
+    websocket::Mask(payload, length, key);
+    bool ok = HandleFrame(opcode, fin, {payload, length});
+    buf.Retrieve(header + length);
+    if (!ok) {
+      return false;
+    }
+  }
+
+  if (buf.Empty() && buf.WritableSize() > kIdleBufferSize) {
+    util::MsgBuffer fresh;
+    buf.Swap(fresh);
+  }
+  return state_ != State::kClosed;
+}
+
+bool WebSocketSession::HandleFrame(WebSocketOpcode opcode, bool fin, std::string_view payload) {
+  switch (opcode) {
+    case WebSocketOpcode::kText:
+    case WebSocketOpcode::kBinary:
+      if (message_opcode_ != WebSocketOpcode::kContinuation) {
+        return Fail(websocket::kCloseProtocolError);  // the previous message is not finished
+      }
+      if (fin) {
+        return Deliver(opcode, payload);
+      }
+      message_opcode_ = opcode;
+      message_.assign(payload);
+      return true;
+
+    case WebSocketOpcode::kContinuation: {
+      if (message_opcode_ == WebSocketOpcode::kContinuation) {
+        return Fail(websocket::kCloseProtocolError);
+      }
+      message_.append(payload);
+      if (!fin) {
+        return true;
+      }
+      auto message_opcode = message_opcode_;
+      message_opcode_     = WebSocketOpcode::kContinuation;
+      bool ok             = Deliver(message_opcode, message_);
+      message_.clear();
+      if (message_.capacity() > kIdleBufferSize) {
+        std::string{}.swap(message_);
+      }
+      return ok;
+    }
+
+    case WebSocketOpcode::kPing:
+      if (state_ == State::kOpen) {
+        std::string frame;
+        websocket::AppendFrame(WebSocketOpcode::kPong, payload, true, frame);
+        SendFrame(std::move(frame));
+      }
+      return true;
+
+    case WebSocketOpcode::kPong:
+      return true;
+
+    case WebSocketOpcode::kClose: {
+      uint16_t code = websocket::kCloseNoStatus;
+      if (payload.size() == 1) {
+        return Fail(websocket::kCloseProtocolError);
+      }
+      if (payload.size() >= 2) {
+        code = static_cast<uint16_t>((static_cast<uint8_t>(payload[0]) << 8) | static_cast<uint8_t>(payload[1]));
+        if (!IsValidCloseCode(code)) {
+          return Fail(websocket::kCloseProtocolError);
+        }
+        if (!websocket::IsValidUtf8(payload.substr(2))) {
+          return Fail(websocket::kCloseInvalidPayload);
+        }
+      }
+      if (state_ == State::kOpen) {
+        // Echo the code, the server closes the TCP connection right after.
+        std::string frame;
+        websocket::AppendFrame(WebSocketOpcode::kClose, payload.substr(0, 2), true, frame);
+        SendFrame(std::move(frame));
+      }
+      Closed(code);
+      return false;
+    }
+
+    default:
+      return Fail(websocket::kCloseProtocolError);  // reserved opcode
+  }
+}
+
+bool WebSocketSession::Deliver(WebSocketOpcode opcode, std::string_view message) {
+  if (opcode == WebSocketOpcode::kText && !websocket::IsValidUtf8(message)) {
+    return Fail(websocket::kCloseInvalidPayload);
+  }
+  // Messages that arrive after our close frame are dropped.
+  if (state_ == State::kOpen && handlers_.on_message) {
+    handlers_.on_message(shared_from_this(), message, opcode == WebSocketOpcode::kBinary);
+  }
+  return true;
+}
+
+bool WebSocketSession::Fail(uint16_t code) {
+  if (state_ == State::kOpen) {
+    std::string payload;
+    payload.push_back(static_cast<char>(code >> 8));
+    payload.push_back(static_cast<char>(code));
+    std::string frame;
+    websocket::AppendFrame(WebSocketOpcode::kClose, payload, true, frame);
+    SendFrame(std::move(frame));
+  }
+  Closed(code);
+  return false;
+}
+
+void WebSocketSession::Closed(uint16_t code) {
+  if (state_ == State::kClosed) {
+    return;
+  }
+  state_ = State::kClosed;
+  message_.clear();
+  if (handlers_.on_close) {
+    handlers_.on_close(shared_from_this(), code);
+  }
+}
+
+void WebSocketSession::HandleDisconnect() { Closed(websocket::kCloseAbnormal); }
+
+void WebSocketSession::CheckAlive(Timepoint now) {
+  if (state_ == State::kClosed) {
+    return;
+  }
+  if (state_ == State::kClosing || awaiting_pong_) {
+    if (now - probe_time_ >= options_.pong_timeout) {
+      if (auto conn = conn_.lock(); conn) {
+        conn->ForceClose();
+      }
+    }
+    return;
+  }
+  if (now - last_activity_ >= options_.ping_interval) {
+    awaiting_pong_ = true;
+    probe_time_    = now;
+    Send(WebSocketOpcode::kPing, {});
+  }
+}
+
+Timepoint WebSocketSession::GetDeadline() const {
+  if (state_ == State::kClosed) {
+    return Timepoint::max();
+  }
+  if (state_ == State::kClosing || awaiting_pong_) {
+    return probe_time_ + options_.pong_timeout;
+  }
+  if (options_.ping_interval.count() == 0) {
+    return Timepoint::max();
+  }
+  return last_activity_ + options_.ping_interval;
+}
+
+void WebSocketSession::Send(WebSocketOpcode opcode, std::string_view payload) {
+  if (state_ != State::kOpen) {
+    return;
+  }
+  std::string frame;
+  websocket::AppendFrame(opcode, payload, true, frame);
+  SendFrame(std::move(frame));
+}
+
+void WebSocketSession::SendFrame(std::string frame) {
+  auto conn = conn_.lock();
+  if (!conn) {
+    return;
+  }
+  // Shared, the connection may only write it in a later loop iteration.
+  conn->Send(std::make_shared<std::string const>(std::move(frame)));
+}
+
+}  // namespace simple_http::net::http
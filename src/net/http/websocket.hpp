@@ -0,0 +1,152 @@
+/**
+ * @file websocket.hpp
+ * @author Qirui Wang (qirui.wang@moegi.waseda.jp)
+ * @brief WebSocket protocol (RFC 6455)
+ * @version 0.1
+ * @date 2023-02-20
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#pragma once
+
+#include <any>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "net/http/http.hpp"
+#include "net/http/http_request.hpp"
+#include "net/inet_addr.hpp"
+#include "net/tcp_connection.hpp"
+#include "utils/msg_buffer.hpp"
+#include "utils/non_copyable.hpp"
+
+namespace simple_http::net::http {
+struct WebSocketSession;
+using WebSocketSessionPtr = std::shared_ptr<WebSocketSession>;
+
+enum class WebSocketOpcode : uint8_t {
+  kContinuation = 0x0,
+  kText         = 0x1,
+  kBinary       = 0x2,
+  kClose        = 0x8,
+  kPing         = 0x9,
+  kPong         = 0xa,
+};
+
+namespace websocket {
+constexpr uint16_t kCloseNormal         = 1000;
+constexpr uint16_t kCloseGoingAway      = 1001;
+constexpr uint16_t kCloseProtocolError  = 1002;
+constexpr uint16_t kCloseNoStatus       = 1005;  // never sent, reported when a close frame has no code
+constexpr uint16_t kCloseAbnormal       = 1006;  // never sent, reported when the connection was lost
+constexpr uint16_t kCloseInvalidPayload = 1007;
+constexpr uint16_t kCloseMessageTooBig  = 1009;
+constexpr uint16_t kCloseInternalError  = 1011;
+constexpr int      kVersion             = 13;
+constexpr uint8_t  kMaxControlPayload   = 125;
+
+// Sec-WebSocket-Accept answering a Sec-WebSocket-Key.
+std::string AcceptKey(std::string_view key);
+
+/**
+ * @brief XOR data with the masking key in place, for a payload whose first byte is offset bytes
+ * into the frame. 16 bytes at a time where SSE2 is available.
+ *
+ */
+void Mask(char* data, std::size_t size, uint32_t key, std::size_t offset = 0);
+
+// Append an unmasked frame, as sent by servers.
+void AppendFrame(WebSocketOpcode opcode, std::string_view payload, bool fin, std::string& out);
+
+[[nodiscard]] bool IsValidUtf8(std::string_view data);
+}  // namespace websocket
+
+struct WebSocketOptions {
+  std::size_t          max_message_size{16 * 1024 * 1024};
+  std::chrono::seconds ping_interval{30};  // idle time before a ping is sent, zero turns keepalive off
+  std::chrono::seconds pong_timeout{10};   // time to answer a ping or a close before the connection is dropped
+};
+
+using WebSocketOpenHandler    = std::function<void(WebSocketSessionPtr const&, HttpRequest const&)>;
+using WebSocketMessageHandler = std::function<void(WebSocketSessionPtr const&, std::string_view message, bool binary)>;
+using WebSocketCloseHandler   = std::function<void(WebSocketSessionPtr const&, uint16_t code)>;
+
+struct WebSocketHandlers {
+  WebSocketOpenHandler    on_open;
+  WebSocketMessageHandler on_message;
+  WebSocketCloseHandler   on_close;
+};
+
+/**
+ * @brief One upgraded connection. Frames are parsed and unmasked in the connection's read
+ * buffer, unfragmented messages are handed to the message handler without a copy.
+ *
+ * Send and Close can be called from any thread, also after the connection is gone.
+ *
+ */
+struct WebSocketSession : public util::NonCopyable, public std::enable_shared_from_this<WebSocketSession> {
+ public:
+  WebSocketSession(std::shared_ptr<TcpConnection> const& conn, WebSocketHandlers const& handlers,
+                   WebSocketOptions const& options);
+
+  void SendText(std::string_view text) { Send(WebSocketOpcode::kText, text); }
+  void SendBinary(std::string_view data) { Send(WebSocketOpcode::kBinary, data); }
+  void Ping(std::string_view payload = {}) {
+    Send(WebSocketOpcode::kPing, payload.substr(0, websocket::kMaxControlPayload));
+  }
+
+  // Start the closing handshake, the connection is closed once the peer answers.
+  void Close(uint16_t code = websocket::kCloseNormal, std::string_view reason = {});
+
+  [[nodiscard]] bool            IsOpen() const { return state_ == State::kOpen; }
+  [[nodiscard]] bool            IsClosed() const { return state_ == State::kClosed; }
+  [[nodiscard]] InetAddr const& GetPeerAddr() const { return peer_addr_; }
+
+  [[nodiscard]] std::any const& GetContext() const { return context_; }
+  [[nodiscard]] std::any&       GetContext() { return context_; }
+  void                          SetContext(std::any context) { context_ = std::move(context); }
+
+  // Called by the server in the loop thread.
+  void Open(HttpRequest const& req);
+  // Handle the complete frames in buf. Returns false once the connection should be shut down.
+  [[nodiscard]] bool Receive(util::MsgBuffer& buf, Timepoint receive_time);
+  void               HandleDisconnect();
+  // Send a ping after ping_interval of silence, drop the connection if nothing came back.
+  void CheckAlive(Timepoint now);
+  // When CheckAlive has to run next.
+  [[nodiscard]] Timepoint GetDeadline() const;
+  // How long the peer has to close its side once the session is closed.
+  [[nodiscard]] std::chrono::seconds GetCloseTimeout() const { return options_.pong_timeout; }
+
+ private:
+  enum class State : uint8_t { kOpen, kClosing, kClosed };
+
+  std::weak_ptr<TcpConnection> conn_;
+  InetAddr                     peer_addr_;
+  WebSocketHandlers const&     handlers_;
+  WebSocketOptions const&      options_;
+  std::any                     context_;
+
+  std::atomic<State> state_{State::kOpen};
+  bool               awaiting_pong_{false};
+  Timepoint          last_activity_;
+  Timepoint          probe_time_{};  // when the ping or close still waiting for an answer was sent
+
+  WebSocketOpcode message_opcode_{WebSocketOpcode::kContinuation};  // of the fragmented message in progress
+  std::string     message_;
+
+  void Send(WebSocketOpcode opcode, std::string_view payload);
+  void SendFrame(std::string frame);
+  bool HandleFrame(WebSocketOpcode opcode, bool fin, std::string_view payload);
+  bool Deliver(WebSocketOpcode opcode, std::string_view message);
+  bool Fail(uint16_t code);
+  void Closed(uint16_t code);
+};
+}  // namespace simple_http::net::http
@@ -0,0 +1,23 @@
+#include "net_metrics.hpp"
+
+namespace simple_http::net {
+
+NetMetrics& NetMetrics::Get() {
+  auto&             registry = util::MetricsRegistry::Global();
+  static NetMetrics metrics{
+      registry.GetCounter("simple_http_accepted_connections_total", "Connections accepted."),
+      registry.GetCounter("simple_http_accept_errors_total", "Failed accept calls."),
+      registry.GetGauge("simple_http_open_connections", "Connections currently open."),
+      registry.GetCounter("simple_http_received_bytes_total", "Bytes read from connections."),
+      registry.GetCounter("simple_http_sent_bytes_total", "Bytes written to connections."),
+      registry.GetCounter("simple_http_read_errors_total", "Failed reads on connections."),
+      registry.GetCounter("simple_http_write_errors_total", "Failed writes on connections."),
+      registry.GetCounter("simple_http_spliced_bytes_total", "Bytes relayed between connections with splice."),
+      registry.GetCounter("simple_http_loop_tasks_total", "Functions run by event loops."),
+      registry.GetGauge("simple_http_loop_pending_tasks", "Functions queued to event loops and not run yet."),
+      registry.GetCounter("simple_http_migrated_connections_total", "Idle connections moved to another loop."),
+  };
+  return metrics;
+}
+
+}  // namespace simple_http::net
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "utils/metrics.hpp"
+
+namespace simple_http::net {
+
+/**
+ * @brief Metrics of the transport layer, registered once in the global registry.
+ *
+ */
+struct NetMetrics {
+  util::Counter& accepted_connections;
+  util::Counter& accept_errors;
+  util::Gauge&   open_connections;
+  util::Counter& bytes_received;
+  util::Counter& bytes_sent;
+  util::Counter& read_errors;
+  util::Counter& write_errors;
+  util::Counter& spliced_bytes;
+  util::Counter& loop_tasks;
+  util::Gauge&   pending_loop_tasks;
+  util::Counter& migrated_connections;
+
+  static NetMetrics& Get();
+};
+}  // namespace simple_http::net
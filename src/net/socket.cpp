@@ -1,5 +1,6 @@
 #include <stdexcept>
 
+#include <cerrno>
 #include <cstdlib>
 #include <cstring>
 
@@ -44,6 +45,16 @@ InetAddr Socket::GetPeerAddr(int fd) {
   return InetAddr{peeraddr};
 }
 
+int Socket::GetIncomingCpu(int fd) noexcept {
+  int  cpu    = -1;
+  auto optlen = static_cast<socklen_t>(sizeof cpu);
+
+  if (::getsockopt(fd, SOL_SOCKET, SO_INCOMING_CPU, &cpu, &optlen) < 0) {
+    return -1;
+  }
+  return cpu;
+}
+
 int Socket::GetSocketError() const {
   int  optval = 0;
   auto optlen = static_cast<socklen_t>(sizeof optval);
@@ -83,7 +94,8 @@ void Socket::Listen() const {
 }
 
 void Socket::Shutdown() const {
-  if (::shutdown(fd_, SHUT_WR) < 0) {
+  // The peer may have reset the connection already, there is nothing left to shut down then.
+  if (::shutdown(fd_, SHUT_WR) < 0 && errno != ENOTCONN) {
     throw std::runtime_error("shutdown error");
   }
 }
@@ -108,4 +120,15 @@ void Socket::SetTcpNoDelay(bool on) const noexcept {
   ::setsockopt(fd_, IPPROTO_TCP, TCP_NODELAY, &optval, static_cast<socklen_t>(sizeof optval));
 }
 
+void Socket::SetBusyPoll(int usec) const noexcept {
+  ::setsockopt(fd_, SOL_SOCKET, SO_BUSY_POLL, &usec, static_cast<socklen_t>(sizeof usec));
+}
+
+void Socket::SetPreferBusyPoll(bool on) const noexcept {
+#ifdef SO_PREFER_BUSY_POLL
+  int optval = on ? 1 : 0;
+  ::setsockopt(fd_, SOL_SOCKET, SO_PREFER_BUSY_POLL, &optval, static_cast<socklen_t>(sizeof optval));
+#endif
+}
+
 }  // namespace simple_http::net
\ No newline at end of file
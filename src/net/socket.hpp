@@ -25,6 +25,8 @@ struct Socket : public simple_http::util::NonCopyable {
 
   [[nodiscard]] static InetAddr GetLocalAddr(int fd);
   [[nodiscard]] static InetAddr GetPeerAddr(int fd);
+  // Core that processed the last packets of the socket, -1 if unknown.
+  [[nodiscard]] static int GetIncomingCpu(int fd) noexcept;
 
   [[nodiscard]] int Accept(InetAddr& peer_addr) const noexcept;
   void              Bind(InetAddr const& addr) const;
@@ -35,6 +37,8 @@ struct Socket : public simple_http::util::NonCopyable {
   void SetReusePort(bool on) const noexcept;
   void SetKeepAlive(bool on) const noexcept;
   void SetTcpNoDelay(bool on) const noexcept;
+  void SetBusyPoll(int usec) const noexcept;
+  void SetPreferBusyPoll(bool on) const noexcept;
 
   [[nodiscard]] int GetFd() const noexcept { return fd_; }
 
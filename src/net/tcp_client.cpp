@@ -0,0 +1,77 @@
+#include "net/socket.hpp"
+
+#include "tcp_client.hpp"
+
+namespace simple_http::net {
+
+TcpClient::TcpClient(EventLoop *loop, InetAddr const &addr) : loop_(loop), addr_(addr) {}
+
+TcpClient::~TcpClient() {
+  if (connector_) {
+    connector_->Stop();
+  }
+  if (connection_) {
+    // The handlers refer to this client, only the cleanup may outlive it.
+    connection_->SetConnectionHandler([](std::shared_ptr<TcpConnection> const &) {});
+    connection_->SetReceiveMessageHandler([](std::shared_ptr<TcpConnection> const &, util::MsgBuffer &) {});
+    connection_->SetWriteCompleteHandler([](std::shared_ptr<TcpConnection> const &) {});
+    connection_->SetCloseHandler(DestroyLater);
+    connection_->ForceClose();
+  }
+}
+
+void TcpClient::DestroyLater(std::shared_ptr<TcpConnection> const &conn) {
+  conn->GetEventLoop()->QueueInLoop([conn] { conn->ConnectionDestroyed(); });
+}
+
+void TcpClient::Connect() {
+  if (connector_ || connection_) {
+    return;
+  }
+  connector_ = std::make_shared<Connector>(loop_, addr_);
+  connector_->Start(connect_timeout_, [this](int fd, int error) { HandleConnected(fd, error); });
+}
+
+void TcpClient::Disconnect() {
+  if (connection_) {
+    connection_->Shutdown();
+  }
+}
+
+void TcpClient::HandleConnected(int fd, int error) {
+  // Called by the connector, which is freed once it returned.
+  loop_->QueueInLoop([connector = std::move(connector_)] {});
+  if (fd < 0) {
+    if (connect_error_handler_) {
+      connect_error_handler_(error);
+    }
+    return;
+  }
+
+  connection_ = std::make_shared<TcpConnection>(loop_, fd, Socket::GetLocalAddr(fd), addr_);
+  connection_->socket_->SetTcpNoDelay(true);
+  connection_->SetConnectionHandler([this](std::shared_ptr<TcpConnection> const &conn) {
+    if (connection_handler_) {
+      connection_handler_(conn);
+    }
+  });
+  connection_->SetReceiveMessageHandler([this](std::shared_ptr<TcpConnection> const &conn, util::MsgBuffer &buf) {
+    if (receive_message_handler_) {
+      receive_message_handler_(conn, buf);
+    }
+  });
+  connection_->SetWriteCompleteHandler([this](std::shared_ptr<TcpConnection> const &conn) {
+    if (write_complete_handler_) {
+      write_complete_handler_(conn);
+    }
+  });
+  connection_->SetCloseHandler([this](std::shared_ptr<TcpConnection> const &conn) {
+    if (connection_ == conn) {
+      connection_.reset();
+    }
+    DestroyLater(conn);
+  });
+  connection_->InformConnected();
+}
+
+}  // namespace simple_http::net
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <memory>
+
+#include "net/connector.hpp"
+#include "net/event_loop.hpp"
+#include "net/inet_addr.hpp"
+#include "net/tcp_connection.hpp"
+#include "utils/non_copyable.hpp"
+
+namespace simple_http::net {
+
+using ConnectErrorHandler = std::function<void(int error)>;
+
+/**
+ * @brief An outgoing connection on a loop, with the handlers of TcpServer. It is used from its
+ * loop thread only, and must not be destroyed from inside one of its handlers.
+ *
+ */
+struct TcpClient : public simple_http::util::NonCopyable {
+ public:
+  TcpClient(EventLoop *loop, InetAddr const &addr);
+  // Closes the connection without waiting for queued writes.
+  ~TcpClient();
+
+  void OnConnection(ConnectionHandler handler) { connection_handler_ = std::move(handler); }
+  void OnReceiveMessage(ReceiveMessageHandler handler) { receive_message_handler_ = std::move(handler); }
+  void OnWriteComplete(WriteCompleteHandler handler) { write_complete_handler_ = std::move(handler); }
+  // Called with the errno of a failed connect, ETIMEDOUT if it took longer than the connect timeout.
+  void OnConnectError(ConnectErrorHandler handler) { connect_error_handler_ = std::move(handler); }
+
+  void SetConnectTimeout(std::chrono::milliseconds timeout) { connect_timeout_ = timeout; }
+
+  // Connect unless connected or connecting already.
+  void Connect();
+  // Close once everything queued is sent.
+  void Disconnect();
+
+  [[nodiscard]] EventLoop      *GetEventLoop() const { return loop_; }
+  [[nodiscard]] InetAddr const &GetAddr() const { return addr_; }
+  [[nodiscard]] bool            IsConnecting() const { return static_cast<bool>(connector_); }
+
+  // Null while not connected.
+  [[nodiscard]] std::shared_ptr<TcpConnection> const &GetConnection() const { return connection_; }
+
+ private:
+  EventLoop                *loop_;
+  InetAddr                  addr_;
+  std::chrono::milliseconds connect_timeout_{3000};
+
+  std::shared_ptr<Connector>     connector_;
+  std::shared_ptr<TcpConnection> connection_;
+
+  ConnectionHandler     connection_handler_;
+  ReceiveMessageHandler receive_message_handler_;
+  WriteCompleteHandler  write_complete_handler_;
+  ConnectErrorHandler   connect_error_handler_;
+
+  void        HandleConnected(int fd, int error);
+  static void DestroyLater(std::shared_ptr<TcpConnection> const &conn);
+};
+}  // namespace simple_http::net
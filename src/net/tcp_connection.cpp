@@ -1,35 +1,112 @@
+#include <algorithm>
 #include <memory>
 #include <mutex>
+#include <stdexcept>
 
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
 #include <unistd.h>
 
+#include "net/net_metrics.hpp"
 #include "utils/msg_buffer.hpp"
 
 #include "tcp_connection.hpp"
 
 namespace simple_http::net {
+namespace {
+// Bound a single sendfile(2) so that one large file does not hold up the loop.
+constexpr std::size_t kMaxSendfileChunk = 1024 * 1024;
+
+// Reads handled for one readiness event before the connection yields to the rest of the loop.
+constexpr int kMaxReadsPerEvent = 16;
+
+// Asked of the kernel for relay pipes, a full pipe holds the source back until the sink drained it.
+constexpr int kRelayPipeSize = 1024 * 1024;
+}  // namespace
+
+/**
+ * @brief Bytes on their way from one connection to another through a pipe. The source fills the
+ * pipe when it is readable, the sink drains it in its write handler.
+ *
+ */
+struct TcpConnection::Relay {
+  EventLoop                   *loop;
+  std::weak_ptr<TcpConnection> source;
+  std::weak_ptr<TcpConnection> sink;
+  SpliceDoneHandler            done;
+  int                          pipe[2]{-1, -1};
+  std::size_t                  capacity{0};
+  std::size_t                  unread{0};   // still to take from the source
+  std::size_t                  in_pipe{0};  // taken from the source, not written to the sink yet
+  bool                         source_blocked{false};  // the source stopped because the pipe was full
+  bool                         ended{false};
+
+  ~Relay() {
+    for (int fd : pipe) {
+      if (fd >= 0) {
+        ::close(fd);
+      }
+    }
+  }
+
+  void End(bool complete) {
+    if (ended) {
+      return;
+    }
+    ended     = true;
+    auto conn = source.lock();
+    if (conn && conn->splice_source_.get() == this) {
+      conn->splice_source_.reset();
+    }
+    loop->QueueInLoop([done = std::move(done), complete] { done(complete); });
+    if (complete && conn && conn->IsConnected()) {
+      // Edge triggered, what the source received behind the relayed bytes is not announced again.
+      loop->QueueInLoop([conn] { conn->HandleRead(); });
+    }
+    if (auto out = sink.lock(); !complete && out) {
+      // The sink may wait for the source, let it drop the relay and go on.
+      loop->QueueInLoop([out] { out->HandleWrite(); });
+    }
+  }
+};
+
 TcpConnection::TcpConnection(EventLoop *event_loop, int fd, InetAddr const &local_addr, InetAddr const &peer_addr)
     : event_loop_(event_loop),
       channel_(std::make_unique<Channel>(event_loop, fd)),
       socket_(std::make_unique<Socket>(fd)),
       local_addr_(local_addr),
       peer_addr_(peer_addr) {
+  SetUpChannel();
+  socket_->SetKeepAlive(true);
+  // Counted right away, connections accepted in a burst must see each other when picking a loop.
+  event_loop->AddConnections(1);
+}
+
+TcpConnection::~TcpConnection() = default;
+
+void TcpConnection::SetUpChannel() {
   channel_->SetReadEventHandler([this]() { HandleRead(); });
   channel_->SetWriteEventHandler([this]() { HandleWrite(); });
   channel_->SetCloseEventHandler([this]() { HandleClose(); });
   channel_->SetErrorEventHandler([this]() { HandleError(); });
+}
 
-  socket_->SetKeepAlive(true);
+void TcpConnection::AddQueuedBytes(int64_t n) {
+  queued_bytes_ += n;
+  if (counted_in_loop_) {
+    GetEventLoop()->AddQueuedBytes(n);
+  }
 }
 
 void TcpConnection::Send(std::string_view msg) {
-  if (event_loop_->IsInLoopThread()) {
+  if (GetEventLoop()->IsInLoopThread()) {
     std::lock_guard<std::mutex> lock(send_mutex_);
     if (send_count_ == 0) {
       SendInLoop(msg);
     } else {
       ++send_count_;
-      event_loop_->QueueInLoop([conn = shared_from_this(), msg]() {
+      GetEventLoop()->QueueInLoop([conn = shared_from_this(), msg]() {
         conn->SendInLoop(msg);
         std::lock_guard<std::mutex> lock2(conn->send_mutex_);
         --conn->send_count_;
@@ -38,7 +115,7 @@ void TcpConnection::Send(std::string_view msg) {
   } else {
     std::lock_guard<std::mutex> lock(send_mutex_);
     ++send_count_;
-    event_loop_->QueueInLoop([conn = shared_from_this(), msg]() {
+    GetEventLoop()->QueueInLoop([conn = shared_from_this(), msg]() {
       conn->SendInLoop(msg);
       std::lock_guard<std::mutex> lock2(conn->send_mutex_);
       --conn->send_count_;
@@ -47,13 +124,13 @@ void TcpConnection::Send(std::string_view msg) {
 }
 
 void TcpConnection::Send(util::MsgBuffer &msg) {
-  if (event_loop_->IsInLoopThread()) {
+  if (GetEventLoop()->IsInLoopThread()) {
     std::lock_guard<std::mutex> lock(send_mutex_);
     if (send_count_ == 0) {
       SendInLoop({msg.Peek(), msg.ReadableSize()});
     } else {
       ++send_count_;
-      event_loop_->QueueInLoop([conn = shared_from_this(), &msg]() {
+      GetEventLoop()->QueueInLoop([conn = shared_from_this(), &msg]() {
         conn->SendInLoop({msg.Peek(), msg.ReadableSize()});
         std::lock_guard<std::mutex> lock2(conn->send_mutex_);
         --conn->send_count_;
@@ -62,7 +139,7 @@ void TcpConnection::Send(util::MsgBuffer &msg) {
   } else {
     std::lock_guard<std::mutex> lock(send_mutex_);
     ++send_count_;
-    event_loop_->QueueInLoop([conn = shared_from_this(), &msg]() {
+    GetEventLoop()->QueueInLoop([conn = shared_from_this(), &msg]() {
       conn->SendInLoop({msg.Peek(), msg.ReadableSize()});
       std::lock_guard<std::mutex> lock2(conn->send_mutex_);
       --conn->send_count_;
@@ -80,13 +157,15 @@ void TcpConnection::SendInLoop(std::string_view msg) {
   if (!channel_->IsWritingEnabled() && write_buffer_.empty()) {
     send_len = ::write(socket_->GetFd(), msg.data(), msg.size());
     if (send_len >= 0) {
+      NetMetrics::Get().bytes_sent.Increment(send_len);
       remain_len = msg.size() - send_len;
       if (remain_len == 0 && write_complete_handler_) {
-        event_loop_->QueueInLoop([conn = shared_from_this()] { conn->write_complete_handler_(conn); });
+        GetEventLoop()->QueueInLoop([conn = shared_from_this()] { conn->write_complete_handler_(conn); });
       }
     } else {
       send_len = 0;
       if (errno != EWOULDBLOCK) {
+        NetMetrics::Get().write_errors.Increment();
         if (errno == EPIPE || errno == ECONNRESET) {
           fault_error = true;
         }
@@ -94,18 +173,212 @@ void TcpConnection::SendInLoop(std::string_view msg) {
     }
   }
   if (!fault_error && remain_len > 0) {
-    if (write_buffer_.empty()) {
-      write_buffer_.emplace_back(std::make_unique<util::MsgBuffer>());
+    if (max_queued_bytes_ != 0 && queued_bytes_ - queued_file_bytes_ + remain_len > max_queued_bytes_) {
+      // The peer does not keep up with us, drop it instead of buffering without bound.
+      state_ = ConnectionState::kDisconnecting;
+      HandleClose();
+      return;
     }
-    write_buffer_.back()->Write(msg.data() + send_len, remain_len);
+    AddQueuedBytes(static_cast<int64_t>(remain_len));
+    if (write_buffer_.empty() || !write_buffer_.back().buffer) {
+      write_buffer_.push_back({.buffer = std::make_shared<util::MsgBuffer>()});
+    }
+    write_buffer_.back().buffer->Write(msg.data() + send_len, remain_len);
     if (!channel_->IsWritingEnabled()) {
       channel_->EnableWriting();
     }
   }
 }
 
+void TcpConnection::SendFile(std::shared_ptr<FileRange> file) {
+  if (GetEventLoop()->IsInLoopThread()) {
+    std::lock_guard<std::mutex> lock(send_mutex_);
+    if (send_count_ == 0) {
+      SendFileInLoop(file);
+      return;
+    }
+  }
+  std::lock_guard<std::mutex> lock(send_mutex_);
+  ++send_count_;
+  GetEventLoop()->QueueInLoop([conn = shared_from_this(), file = std::move(file)]() {
+    conn->SendFileInLoop(file);
+    std::lock_guard<std::mutex> lock2(conn->send_mutex_);
+    --conn->send_count_;
+  });
+}
+
+void TcpConnection::SendFileInLoop(std::shared_ptr<FileRange> const &file) {
+  if (state_ != ConnectionState::kConnected) {
+    return;
+  }
+  auto offset    = file->GetOffset();
+  auto remaining = file->GetLength();
+  if (!channel_->IsWritingEnabled() && write_buffer_.empty() && remaining > 0) {
+    auto n = ::sendfile(socket_->GetFd(), file->GetFd(), &offset, std::min(remaining, kMaxSendfileChunk));
+    if (n > 0) {
+      NetMetrics::Get().bytes_sent.Increment(n);
+      remaining -= n;
+    } else if (n < 0 && errno != EAGAIN) {
+      NetMetrics::Get().write_errors.Increment();
+      if (errno == EPIPE || errno == ECONNRESET) {
+        return;
+      }
+    }
+  }
+  if (remaining == 0) {
+    if (write_complete_handler_) {
+      GetEventLoop()->QueueInLoop([conn = shared_from_this()] { conn->write_complete_handler_(conn); });
+    }
+    return;
+  }
+  write_buffer_.push_back({.file = file, .offset = offset, .remaining = remaining});
+  AddQueuedBytes(static_cast<int64_t>(remaining));
+  queued_file_bytes_ += remaining;
+  if (!channel_->IsWritingEnabled()) {
+    channel_->EnableWriting();
+  }
+}
+
+void TcpConnection::Send(std::shared_ptr<std::string const> data) {
+  if (GetEventLoop()->IsInLoopThread()) {
+    std::lock_guard<std::mutex> lock(send_mutex_);
+    if (send_count_ == 0) {
+      SendSharedInLoop(data);
+      return;
+    }
+  }
+  std::lock_guard<std::mutex> lock(send_mutex_);
+  ++send_count_;
+  GetEventLoop()->QueueInLoop([conn = shared_from_this(), data = std::move(data)]() {
+    conn->SendSharedInLoop(data);
+    std::lock_guard<std::mutex> lock2(conn->send_mutex_);
+    --conn->send_count_;
+  });
+}
+
+void TcpConnection::SendSharedInLoop(std::shared_ptr<std::string const> const &data) {
+  if (state_ != ConnectionState::kConnected) {
+    return;
+  }
+  std::size_t sent = 0;
+  if (!channel_->IsWritingEnabled() && write_buffer_.empty() && !data->empty()) {
+    auto n = ::write(socket_->GetFd(), data->data(), data->size());
+    if (n >= 0) {
+      NetMetrics::Get().bytes_sent.Increment(n);
+      sent = n;
+    } else if (errno != EWOULDBLOCK) {
+      NetMetrics::Get().write_errors.Increment();
+      if (errno == EPIPE || errno == ECONNRESET) {
+        return;
+      }
+    }
+  }
+  auto remaining = data->size() - sent;
+  if (remaining == 0) {
+    if (write_complete_handler_) {
+      GetEventLoop()->QueueInLoop([conn = shared_from_this()] { conn->write_complete_handler_(conn); });
+    }
+    return;
+  }
+  // The buffer is shared, but a peer that does not read still keeps it alive.
+  if (max_queued_bytes_ != 0 && queued_bytes_ - queued_file_bytes_ + remaining > max_queued_bytes_) {
+    state_ = ConnectionState::kDisconnecting;
+    HandleClose();
+    return;
+  }
+  write_buffer_.push_back({.shared = data, .offset = static_cast<off_t>(sent), .remaining = remaining});
+  AddQueuedBytes(static_cast<int64_t>(remaining));
+  if (!channel_->IsWritingEnabled()) {
+    channel_->EnableWriting();
+  }
+}
+
+void TcpConnection::Splice(std::shared_ptr<TcpConnection> const &source, std::size_t length, SpliceDoneHandler done) {
+  if (source->GetEventLoop() != GetEventLoop()) {
+    throw std::runtime_error("TcpConnection::Splice between connections of different loops");
+  }
+  auto buffered = std::min(length, source->read_buffer_.ReadableSize());
+  if (buffered > 0) {
+    SendInLoop({source->read_buffer_.Peek(), buffered});
+    source->read_buffer_.Retrieve(buffered);
+  }
+  bool connected = state_ == ConnectionState::kConnected && source->IsConnected();
+  if (buffered == length || !connected) {
+    GetEventLoop()->QueueInLoop([done = std::move(done), complete = buffered == length] { done(complete); });
+    return;
+  }
+
+  auto relay  = std::make_shared<Relay>();
+  relay->loop = GetEventLoop();
+  if (::pipe2(relay->pipe, O_NONBLOCK | O_CLOEXEC) < 0) {
+    GetEventLoop()->QueueInLoop([done = std::move(done)] { done(false); });
+    return;
+  }
+  ::fcntl(relay->pipe[1], F_SETPIPE_SZ, kRelayPipeSize);
+  auto capacity   = ::fcntl(relay->pipe[1], F_GETPIPE_SZ);
+  relay->capacity = capacity > 0 ? static_cast<std::size_t>(capacity) : 65536;
+  relay->source          = source;
+  relay->sink            = shared_from_this();
+  relay->done            = std::move(done);
+  relay->unread          = length - buffered;
+  source->splice_source_ = relay;
+  write_buffer_.push_back({.relay = relay});
+  if (!channel_->IsWritingEnabled()) {
+    channel_->EnableWriting();
+  }
+  // The source may have been announced readable already.
+  source->FillRelay();
+}
+
+void TcpConnection::FillRelay() {
+  auto relay = splice_source_;
+  bool added = false;
+  while (relay->unread > 0) {
+    if (relay->in_pipe >= relay->capacity) {
+      relay->source_blocked = true;
+      break;
+    }
+    auto n = ::splice(socket_->GetFd(), nullptr, relay->pipe[1], nullptr,
+                      std::min(relay->unread, relay->capacity - relay->in_pipe), SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+    if (n > 0) {
+      NetMetrics::Get().bytes_received.Increment(n);
+      relay->unread  -= n;
+      relay->in_pipe += n;
+      added           = true;
+      continue;
+    }
+    if (n < 0 && errno == EAGAIN) {
+      break;
+    }
+    // The peer closed or the read failed before all bytes came.
+    if (n < 0) {
+      NetMetrics::Get().read_errors.Increment();
+    }
+    HandleClose();
+    return;
+  }
+  if (auto sink = relay->sink.lock(); added && sink) {
+    sink->HandleWrite();
+  }
+}
+
+std::size_t TcpConnection::GetPendingInput() const {
+  int pending = 0;
+  if (::ioctl(socket_->GetFd(), FIONREAD, &pending) < 0) {
+    return 0;
+  }
+  return static_cast<std::size_t>(pending);
+}
+
+void TcpConnection::HandleBufferedInput() {
+  if (state_ == ConnectionState::kConnected && !splice_source_ && read_buffer_.ReadableSize() > 0 &&
+      receive_message_handler_) {
+    receive_message_handler_(shared_from_this(), read_buffer_);
+  }
+}
+
 void TcpConnection::Shutdown() {
-  event_loop_->RunInLoop([this_ptr = shared_from_this()]() {
+  GetEventLoop()->RunInLoop([this_ptr = shared_from_this()]() {
     if (this_ptr->state_ == ConnectionState::kConnected) {
       this_ptr->state_ = ConnectionState::kDisconnecting;
       if (!this_ptr->channel_->IsWritingEnabled()) {
@@ -116,7 +389,7 @@ void TcpConnection::Shutdown() {
 }
 
 void TcpConnection::ForceClose() {
-  event_loop_->RunInLoop([this_ptr = shared_from_this()]() {
+  GetEventLoop()->RunInLoop([this_ptr = shared_from_this()]() {
     if (this_ptr->state_ == ConnectionState::kConnected || this_ptr->state_ == ConnectionState::kDisconnecting) {
       this_ptr->state_ = ConnectionState::kDisconnecting;
       this_ptr->HandleClose();
@@ -124,9 +397,40 @@ void TcpConnection::ForceClose() {
   });
 }
 
+bool TcpConnection::MoveToLoop(EventLoop *loop) {
+  auto *from = GetEventLoop();
+  // Holding the lock, senders on other threads queue to one loop or the other, not in between.
+  std::lock_guard<std::mutex> lock(send_mutex_);
+  if (loop == from || state_ != ConnectionState::kConnected || send_count_ != 0 || !write_buffer_.empty() ||
+      splice_source_ || channel_->IsWritingEnabled()) {
+    return false;
+  }
+  channel_->DisableAll();
+  channel_->Remove();
+  channel_ = std::make_unique<Channel>(loop, socket_->GetFd());
+  SetUpChannel();
+  from->AddConnections(-1);
+  loop->AddConnections(1);
+  event_loop_.store(loop, std::memory_order_release);
+
+  // Edge triggered: registering the socket again reports what arrived while it was not watched.
+  loop->QueueInLoop([conn = shared_from_this()] {
+    if (conn->state_ != ConnectionState::kDisconnected) {
+      conn->channel_->EnableReading();
+    }
+  });
+  return true;
+}
+
 void TcpConnection::InformConnected() {
   auto this_ptr = shared_from_this();
-  event_loop_->RunInLoop([this_ptr]() {
+  GetEventLoop()->RunInLoop([this_ptr]() {
+    if (this_ptr->allocate_buffers_in_loop_) {
+      // The connection was built on the acceptor thread, replace its read buffer by one first
+      // touched here so that it lives on this loop's NUMA node.
+      util::MsgBuffer local;
+      this_ptr->read_buffer_.Swap(local);
+    }
     this_ptr->channel_->EnableReading();
     this_ptr->state_ = ConnectionState::kConnected;
     if (this_ptr->connection_handler_) {
@@ -146,61 +450,169 @@ void TcpConnection::ConnectionDestroyed() {
 }
 
 void TcpConnection::HandleRead() {
-  int     ret = 0;
-  ssize_t n   = read_buffer_.ReadFile(socket_->GetFd(), &ret);
+  // Events are edge triggered, keep reading until the socket is drained.
+  for (int reads = 0; state_ == ConnectionState::kConnected || state_ == ConnectionState::kDisconnecting; ++reads) {
+    if (reads == kMaxReadsPerEvent) {
+      // A client answering as fast as it is served would keep the loop here, let the other
+      // connections have their turn first. Once moved to another loop, that one reads.
+      auto resume = [weak = weak_from_this()] {
+        if (auto conn = weak.lock(); conn && conn->GetEventLoop()->IsInLoopThread()) {
+          conn->HandleRead();
+        }
+      };
+      GetEventLoop()->RunAfter(std::chrono::steady_clock::duration::zero(), resume);
+      return;
+    }
+    if (splice_source_) {
+      // What comes in now belongs to a relay, not to the message handler.
+      FillRelay();
+      return;
+    }
+    int     ret = 0;
+    ssize_t n   = read_buffer_.ReadFile(socket_->GetFd(), &ret);
 
-  if (n == 0) {
-    // socket is closed by peer
-    HandleClose();
-  } else if (n < 0) {
-    if (errno == EPIPE || errno == ECONNRESET) {
+    if (n == 0) {
+      // socket is closed by peer
+      HandleClose();
       return;
     }
-    if (errno == EAGAIN) {
+    if (n < 0) {
+      if (ret == EAGAIN) {
+        return;
+      }
+      NetMetrics::Get().read_errors.Increment();
+      if (ret == EPIPE || ret == ECONNRESET) {
+        return;
+      }
+      HandleClose();
       return;
     }
-    HandleClose();
-    return;
-  }
-  if (n > 0) {
+    NetMetrics::Get().bytes_received.Increment(n);
+    if (capture_) {
+      capture_->Data({read_buffer_.BeginWrite() - n, static_cast<std::size_t>(n)});
+    }
     if (receive_message_handler_) {
       receive_message_handler_(shared_from_this(), read_buffer_);
     }
   }
 }
+
 void TcpConnection::HandleWrite() {
   if (!channel_->IsWritingEnabled()) {
     // TODO: log error
     return;
   }
 
-  auto write_buf = write_buffer_.front();
-  if (write_buf->ReadableSize() == 0) {
-    write_buffer_.pop_front();
-    if (write_buffer_.empty()) {
-      channel_->DisableWriting();
-      if (write_complete_handler_) {
-        write_complete_handler_(shared_from_this());
+  // Events are edge triggered, keep writing until the socket is full or nothing is left.
+  while (!write_buffer_.empty()) {
+    auto   &node = write_buffer_.front();
+    ssize_t n    = 0;
+    if (node.file) {
+      if (node.remaining > 0) {
+        n = ::sendfile(socket_->GetFd(), node.file->GetFd(), &node.offset, std::min(node.remaining, kMaxSendfileChunk));
+        if (n == 0) {
+          // The file shrank, the promised length can't be sent anymore.
+          NetMetrics::Get().write_errors.Increment();
+          HandleClose();
+          return;
+        }
       }
-      if (state_ == ConnectionState::kDisconnecting) {
-        Shutdown();
+    } else if (node.shared) {
+      n = ::write(socket_->GetFd(), node.shared->data() + node.offset, node.remaining);
+    } else if (node.relay) {
+      auto &relay = *node.relay;
+      if (relay.in_pipe == 0) {
+        if (relay.unread > 0 && !relay.ended) {
+          // Waiting for the source, which calls back once it filled the pipe again.
+          return;
+        }
+        auto done = std::move(node.relay);
+        write_buffer_.pop_front();
+        done->End(done->unread == 0);
+        continue;
       }
-    } else {
-      auto next = write_buffer_.front();
+      n = ::splice(relay.pipe[0], nullptr, socket_->GetFd(), nullptr, relay.in_pipe, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+      if (n > 0) {
+        NetMetrics::Get().bytes_sent.Increment(n);
+        NetMetrics::Get().spliced_bytes.Increment(n);
+        relay.in_pipe -= n;
+        if (relay.source_blocked) {
+          // Resume the source from the loop, not recursively from inside its own call to us.
+          relay.source_blocked = false;
+          GetEventLoop()->QueueInLoop([source = relay.source] {
+            if (auto conn = source.lock(); conn && conn->splice_source_) {
+              conn->FillRelay();
+            }
+          });
+        }
+        continue;
+      }
+      if (n == 0) {
+        return;
+      }
+    } else if (node.buffer->ReadableSize() > 0) {
+      n = ::write(socket_->GetFd(), node.buffer->Peek(), node.buffer->ReadableSize());
     }
-  } else {
-    auto n = ::write(socket_->GetFd(), write_buf->Peek(), write_buf->ReadableSize());
-    if (n >= 0) {
-      write_buf->Retrieve(n);
+    if (n < 0) {
+      if (errno != EAGAIN) {
+        NetMetrics::Get().write_errors.Increment();
+        // TODO: log error
+      }
+      return;
+    }
+
+    AddQueuedBytes(-n);
+    NetMetrics::Get().bytes_sent.Increment(n);
+    if (node.file) {
+      node.remaining     -= n;
+      queued_file_bytes_ -= n;
+      if (node.remaining > 0) {
+        continue;
+      }
+    } else if (node.shared) {
+      node.offset    += n;
+      node.remaining -= n;
+      if (node.remaining > 0) {
+        continue;
+      }
     } else {
-      // TODO: log error
+      node.buffer->Retrieve(n);
+      if (node.buffer->ReadableSize() > 0) {
+        continue;
+      }
     }
+    write_buffer_.pop_front();
+  }
+
+  // Complete as soon as the last byte is written, the peer may close before another writable event.
+  channel_->DisableWriting();
+  if (write_complete_handler_) {
+    write_complete_handler_(shared_from_this());
+  }
+  if (state_ == ConnectionState::kDisconnecting) {
+    Shutdown();
   }
 }
 
 void TcpConnection::HandleClose() {
   state_ = ConnectionState::kDisconnected;
   channel_->DisableAll();
+  if (counted_in_loop_) {
+    GetEventLoop()->AddConnections(-1);
+    GetEventLoop()->AddQueuedBytes(-static_cast<int64_t>(queued_bytes_));
+    counted_in_loop_ = false;
+  }
+  if (auto capture = std::move(capture_); capture) {
+    capture->Close();
+  }
+  if (auto relay = std::move(splice_source_); relay) {
+    relay->End(false);
+  }
+  for (auto const &node : write_buffer_) {
+    if (node.relay) {
+      node.relay->End(false);
+    }
+  }
   //  ioChannelPtr_->remove();
   auto guard_this = shared_from_this();
   if (connection_handler_) {
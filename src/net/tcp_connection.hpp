@@ -1,9 +1,11 @@
 #pragma once
 
 #include <any>
+#include <atomic>
 #include <list>
 #include <memory>
 #include <mutex>
+#include <string>
 #include <string_view>
 #include <utility>
 
@@ -11,8 +13,10 @@
 
 #include "net/channel.hpp"
 #include "net/event_loop.hpp"
+#include "net/file_range.hpp"
 #include "net/inet_addr.hpp"
 #include "net/socket.hpp"
+#include "net/traffic_capture.hpp"
 #include "utils/msg_buffer.hpp"
 #include "utils/non_copyable.hpp"
 
@@ -23,6 +27,7 @@ using ReceiveMessageHandler = std::function<void(std::shared_ptr<TcpConnection>
 using ConnectionHandler     = std::function<void(std::shared_ptr<TcpConnection> const &)>;
 using CloseHandler          = std::function<void(std::shared_ptr<TcpConnection> const &)>;
 using WriteCompleteHandler  = std::function<void(std::shared_ptr<TcpConnection> const &)>;
+using SpliceDoneHandler     = std::function<void(bool complete)>;
 
 struct TcpConnection : public simple_http::util::NonCopyable, std::enable_shared_from_this<TcpConnection> {
  public:
@@ -34,38 +39,90 @@ struct TcpConnection : public simple_http::util::NonCopyable, std::enable_shared
   };
 
   TcpConnection(EventLoop *event_loop, int fd, InetAddr const &local_addr, InetAddr const &peer_addr);
-  ~TcpConnection() = default;
+  ~TcpConnection();
 
   InetAddr const &GetLocalAddr() const { return local_addr_; }
   InetAddr const &GetPeerAddr() const { return peer_addr_; }
-  EventLoop      *GetEventLoop() const { return event_loop_; }
+  EventLoop      *GetEventLoop() const { return event_loop_.load(std::memory_order_acquire); }
   std::any const &GetContext() const { return context_; }
   std::any       &GetContext() { return context_; }
 
   void Send(std::string_view msg);
   void Send(util::MsgBuffer &msg);
 
+  // Send the file range with sendfile(2), after everything sent before it.
+  void SendFile(std::shared_ptr<FileRange> file);
+
+  // Send a buffer shared with other connections. It is queued by reference, not copied.
+  void Send(std::shared_ptr<std::string const> data);
+
+  /**
+   * @brief Relay the next length bytes received by source to this connection, after everything
+   * sent before them. They go through a pipe with splice(2) without being copied to user space,
+   * except for those source had read already. Until they are through source neither reads further
+   * nor calls its message handler, and it reads only as fast as this connection writes.
+   *
+   * Both connections have to be on the same loop, call it from there. done is called on the loop
+   * with whether all bytes were relayed, not if either connection closed before.
+   *
+   */
+  void Splice(std::shared_ptr<TcpConnection> const &source, std::size_t length, SpliceDoneHandler done);
+
+  // Whether the connection is the source of a relay that did not end yet.
+  bool IsSplicing() const { return static_cast<bool>(splice_source_); }
+
   void SetContext(std::any const &context) { context_ = context; }
 
   bool IsConnected() const { return state_ == ConnectionState::kConnected; }
   bool IsDisconnected() const { return state_ == ConnectionState::kDisconnected; }
   bool HasContext() const { return context_.has_value(); }
 
+  // Bytes accepted by Send() but not yet written to the socket.
+  std::size_t GetQueuedBytes() const { return queued_bytes_; }
+
+  // Bytes received by the socket but not read yet.
+  std::size_t GetPendingInput() const;
+
+  // Call the message handler again with what it left in the read buffer, no read event announces
+  // those bytes again. Call it from the loop.
+  void HandleBufferedInput();
+
   void Shutdown();
   void ForceClose();
 
+  /**
+   * @brief Move the connection to loop, which reads and writes it from then on. Only between two
+   * messages: returns false if anything is queued for sending or relayed, or if it is closing. Call
+   * it from a function queued to the current loop, not from a handler of the connection.
+   *
+   */
+  bool MoveToLoop(EventLoop *loop);
+
   void InformConnected();
 
  private:
   friend class TcpServer;
+  friend struct TcpClient;
 
-  EventLoop               *event_loop_{nullptr};
+  std::atomic<EventLoop *> event_loop_{nullptr};  // changes only when the connection moves to another loop
   std::unique_ptr<Channel> channel_{nullptr};
   std::unique_ptr<Socket>  socket_{nullptr};
   std::any                 context_{};
 
-  util::MsgBuffer                             read_buffer_{};
-  std::list<std::shared_ptr<util::MsgBuffer>> write_buffer_{};
+  struct Relay;
+
+  // A queued write is either a buffer, the unsent rest of a file range or of a shared buffer, or a relay.
+  struct WriteNode {
+    std::shared_ptr<util::MsgBuffer>   buffer;
+    std::shared_ptr<FileRange>         file;
+    std::shared_ptr<std::string const> shared;
+    std::shared_ptr<Relay>             relay;
+    off_t                              offset{0};
+    std::size_t                        remaining{0};
+  };
+
+  util::MsgBuffer      read_buffer_{};
+  std::list<WriteNode> write_buffer_{};
 
   InetAddr local_addr_{};
   InetAddr peer_addr_{};
@@ -75,6 +132,18 @@ struct TcpConnection : public simple_http::util::NonCopyable, std::enable_shared
   std::mutex send_mutex_{};
   uint32_t   send_count_{};
 
+  std::size_t queued_bytes_{0};  // counted in the gauges of the loop until the connection closed
+  std::size_t queued_file_bytes_{0};  // part of queued_bytes_ that is in files, not in memory
+  std::size_t max_queued_bytes_{0};
+
+  bool allocate_buffers_in_loop_{false};
+  bool counted_in_loop_{true};
+
+  std::shared_ptr<Relay> splice_source_{};  // the relay reading from this connection
+
+  // Records what is read, except bytes relayed with splice(2) which never reach user space.
+  std::unique_ptr<CaptureStream> capture_{};
+
   ReceiveMessageHandler receive_message_handler_{};
   ConnectionHandler     connection_handler_{};
   CloseHandler          close_handler_{};
@@ -84,14 +153,23 @@ struct TcpConnection : public simple_http::util::NonCopyable, std::enable_shared
   void SetConnectionHandler(ConnectionHandler handler) { connection_handler_ = std::move(handler); }
   void SetCloseHandler(CloseHandler handler) { close_handler_ = std::move(handler); }
   void SetWriteCompleteHandler(WriteCompleteHandler handler) { write_complete_handler_ = std::move(handler); }
+  void SetMaxQueuedBytes(std::size_t max_bytes) { max_queued_bytes_ = max_bytes; }
+  void SetAllocateBuffersInLoop(bool on) { allocate_buffers_in_loop_ = on; }
+  void SetCapture(std::unique_ptr<CaptureStream> capture) { capture_ = std::move(capture); }
+
+  void SetUpChannel();
+  void AddQueuedBytes(int64_t n);
 
   void HandleRead();
   void HandleWrite();
   void HandleClose();
   void HandleError();
+  void FillRelay();
 
   void ConnectionDestroyed();
 
   void SendInLoop(std::string_view msg);
+  void SendFileInLoop(std::shared_ptr<FileRange> const &file);
+  void SendSharedInLoop(std::shared_ptr<std::string const> const &data);
 };
 }  // namespace simple_http::net
\ No newline at end of file
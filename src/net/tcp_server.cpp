@@ -13,8 +13,10 @@
 
 #include "net/event_loop.hpp"
 #include "net/inet_addr.hpp"
+#include "net/net_metrics.hpp"
 #include "net/socket.hpp"
 #include "net/tcp_connection.hpp"
+#include "utils/logger.hpp"
 #include "utils/msg_buffer.hpp"
 
 #include "tcp_server.hpp"
@@ -34,7 +36,11 @@ TcpServer::TcpServer(EventLoop *event_loop, InetAddr const &addr)
   acceptor_->OnNewConnection([this](int fd, InetAddr const &addr) { this->HandleNewConnection(fd, addr); });
 }
 
-TcpServer::~TcpServer() = default;
+TcpServer::~TcpServer() {
+  if (resize_timer_ != 0) {
+    event_loop_->Cancel(resize_timer_);
+  }
+}
 
 void TcpServer::Start() {
   event_loop_->RunInLoop([this]() {
@@ -46,6 +52,8 @@ void TcpServer::Start() {
 void TcpServer::Stop() {
   running_.store(false, std::memory_order_release);
   if (event_loop_->IsInLoopThread()) {
+    event_loop_->Cancel(resize_timer_);
+    resize_timer_ = 0;
     acceptor_.reset();
     for (auto const &connection : connections_) {
       connection->ForceClose();
@@ -54,6 +62,8 @@ void TcpServer::Stop() {
     std::promise<void> pro;
     auto               f = pro.get_future();
     event_loop_->QueueInLoop([this, &pro]() {
+      event_loop_->Cancel(resize_timer_);
+      resize_timer_ = 0;
       acceptor_.reset();
       for (auto const &connection : connections_) {
         connection->ForceClose();
@@ -65,14 +75,145 @@ void TcpServer::Stop() {
   event_loop_group_.reset();
 }
 
-void TcpServer::HandleNewConnection(int fd, InetAddr const &addr) {
+void TcpServer::SetEventLoopGroupNum(size_t num, EventLoopGroupOptions options) {
+  if (event_loop_group_) {
+    event_loop_->RunInLoop([this, num] { ResizeEventLoopGroup(num); });
+    return;
+  }
+  event_loop_group_ = std::make_unique<EventLoopGroup>(num, std::move(options));
+  event_loop_group_->Start();
+  ApplyBusyPoll();
+  if (event_loop_group_->IsElastic()) {
+    resize_timer_ = event_loop_->RunEvery(event_loop_group_->GetOptions().resize_interval,
+                                          [this] { AutoscaleEventLoopGroup(); });
+  }
+}
+
+void TcpServer::ResizeEventLoopGroup(size_t num) {
+  num = std::max<size_t>(num, 1);
+  while (event_loop_group_->GetSize() < num) {
+    AddEventLoop();
+  }
+  while (event_loop_group_->GetSize() > num) {
+    RetireEventLoop();
+  }
+  // Retired loops are released once their connections are gone.
+  if (resize_timer_ == 0 && event_loop_group_->HasRetiringLoops()) {
+    resize_timer_ = event_loop_->RunEvery(event_loop_group_->GetOptions().resize_interval,
+                                          [this] { AutoscaleEventLoopGroup(); });
+  }
+}
+
+void TcpServer::AutoscaleEventLoopGroup() {
+  ReleaseRetiredLoops();
+  if (!event_loop_group_->IsElastic() && !event_loop_group_->HasRetiringLoops()) {
+    event_loop_->Cancel(resize_timer_);
+    resize_timer_ = 0;
+    return;
+  }
+  // One loop at a time, utilization needs a while to settle after connections moved.
+  auto step = event_loop_group_->GetResizeStep();
+  if (step > 0) {
+    AddEventLoop();
+  } else if (step < 0) {
+    RetireEventLoop();
+  }
+}
+
+void TcpServer::AddEventLoop() {
+  auto *loop = event_loop_group_->AddLoop();
+  loop->SetBusyPoll(busy_poll_idle_);
+  LOG_INFO << "Added an event loop, " << event_loop_group_->GetSize() << " serving";
+}
+
+void TcpServer::RetireEventLoop() {
+  auto *loop = event_loop_group_->RetireLoop();
+  if (loop == nullptr) {
+    return;
+  }
+  LOG_INFO << "Retiring an event loop with " << loop->GetConnectionCount() << " connections, "
+           << event_loop_group_->GetSize() << " serving";
+  for (auto const &connection : connections_) {
+    if (connection->GetEventLoop() != loop) {
+      continue;
+    }
+    loop->RunInLoop([this, connection] {
+      if (retire_handler_) {
+        retire_handler_(connection);
+      } else {
+        Rebalance(connection);
+      }
+    });
+  }
+}
+
+void TcpServer::ReleaseRetiredLoops() {
+  // Twice without connections in a row: connections being moved to the loop have arrived meanwhile.
+  std::set<EventLoop *> quiet;
+  for (auto *loop : event_loop_group_->GetRetiringLoops()) {
+    if (loop->GetConnectionCount() != 0 || loop_connections_[loop] != 0) {
+      continue;
+    }
+    if (!quiet_loops_.contains(loop)) {
+      quiet.insert(loop);
+      continue;
+    }
+    loop_connections_.erase(loop);
+    event_loop_group_->ReleaseLoop(loop);
+    LOG_INFO << "Released a retired event loop";
+  }
+  quiet_loops_ = std::move(quiet);
+}
+
+void TcpServer::ApplyBusyPoll() {
+  // Only loops serving connections spin, the acceptor loop keeps blocking once it has workers.
+  if (!event_loop_group_) {
+    event_loop_->SetBusyPoll(busy_poll_idle_);
+    return;
+  }
+  event_loop_->SetBusyPoll(std::chrono::microseconds{0});
+  for (size_t i = 0; i < event_loop_group_->GetSize(); ++i) {
+    event_loop_group_->GetEventLoop(i)->SetBusyPoll(busy_poll_idle_);
+  }
+}
+
+EventLoop *TcpServer::PickEventLoop(int fd) {
   EventLoop *io_loop = nullptr;
   if (event_loop_group_) {
-    io_loop = event_loop_group_->GetNextEventLoop();
+    if (event_loop_group_->GetOptions().steer_by_incoming_cpu) {
+      io_loop = event_loop_group_->GetEventLoopForCpu(Socket::GetIncomingCpu(fd));
+    } else {
+      io_loop = event_loop_group_->GetNextEventLoop();
+    }
+    // Skip loops that are already full, admission control sheds the connection if all of them are.
+    auto per_loop = admission_.GetOptions().max_connections_per_loop;
+    for (size_t i = 1; io_loop != nullptr && per_loop != 0 && loop_connections_[io_loop] >= per_loop &&
+                       i < event_loop_group_->GetSize();
+         ++i) {
+      io_loop = event_loop_group_->GetNextEventLoop();
+    }
   }
   if (io_loop == nullptr) {
     io_loop = event_loop_;
   }
+  return io_loop;
+}
+
+void TcpServer::RejectConnection(int fd) const {
+  if (!overload_response_.empty()) {
+    // Best effort: the socket is fresh, so the response almost always fits in its send buffer.
+    (void)::write(fd, overload_response_.data(), overload_response_.size());
+  }
+  ::close(fd);
+}
+
+void TcpServer::HandleNewConnection(int fd, InetAddr const &addr) {
+  EventLoop *io_loop = PickEventLoop(fd);
+
+  if (!admission_.AdmitConnection(connections_.size(), loop_connections_[io_loop], io_loop->GetLag())) {
+    RejectConnection(fd);
+    return;
+  }
 
   auto new_conn = std::make_shared<TcpConnection>(io_loop, fd, InetAddr{Socket::GetLocalAddr(fd)}, addr);
   new_conn->SetReceiveMessageHandler(receive_message_handler_);
@@ -88,22 +229,125 @@ void TcpServer::HandleNewConnection(int fd, InetAddr const &addr) {
     }
   });
 
+  new_conn->SetMaxQueuedBytes(admission_.GetOptions().max_queued_write_bytes);
+  // Responses may go out in several writes, e.g. a head followed by a sendfile body, Nagle would hold
+  // back the last one until the client's delayed ACK.
+  new_conn->socket_->SetTcpNoDelay(true);
+  if (event_loop_group_ && event_loop_group_->GetOptions().numa_local_buffers) {
+    new_conn->SetAllocateBuffersInLoop(true);
+  }
+  if (socket_busy_poll_us_ > 0) {
+    new_conn->socket_->SetBusyPoll(socket_busy_poll_us_);
+    new_conn->socket_->SetPreferBusyPoll(true);
+  }
+  if (capture_) {
+    new_conn->SetCapture(CaptureStream::Open(capture_));
+  }
+
   connections_.emplace(new_conn);
+  ++loop_connections_[io_loop];
+  NetMetrics::Get().open_connections.Increment();
   new_conn->InformConnected();
 }
 
 void TcpServer::HandleConnectionClosed(std::shared_ptr<TcpConnection> const &conn) {
   if (event_loop_->IsInLoopThread()) {
-    auto  id   = connections_.erase(conn);
-    auto *loop = conn->GetEventLoop();
-    loop->QueueInLoop([conn, id] { conn->ConnectionDestroyed(); });
+    RemoveConnection(conn);
   } else {
-    event_loop_->QueueInLoop([this, conn] {
-      auto  id   = connections_.erase(conn);
-      auto *loop = conn->GetEventLoop();
-      loop->QueueInLoop([conn, id] { conn->ConnectionDestroyed(); });
+    event_loop_->QueueInLoop([this, conn] { RemoveConnection(conn); });
+  }
+}
+
+void TcpServer::RemoveConnection(std::shared_ptr<TcpConnection> const &conn) {
+  auto  id   = connections_.erase(conn);
+  auto *loop = conn->GetEventLoop();
+  if (id != 0) {
+    --loop_connections_[loop];
+    NetMetrics::Get().open_connections.Decrement();
+  }
+  loop->QueueInLoop([conn, id] { conn->ConnectionDestroyed(); });
+  CheckDrained();
+}
+
+void TcpServer::Rebalance(std::shared_ptr<TcpConnection> const &conn) {
+  if (!event_loop_group_ ||
+      (event_loop_group_->GetOptions().migrate_utilization_gap <= 0 && !event_loop_group_->HasRetiringLoops())) {
+    return;
+  }
+  auto *from = conn->GetEventLoop();
+  auto *to   = event_loop_group_->GetMigrationTarget(from);
+  if (to == nullptr) {
+    return;
+  }
+  // Not from inside a handler of the connection, its channel is replaced.
+  from->QueueInLoop([this, conn, from, to] {
+    if (!conn->MoveToLoop(to)) {
+      return;
+    }
+    NetMetrics::Get().migrated_connections.Increment();
+    event_loop_->RunInLoop([this, from, to] {
+      --loop_connections_[from];
+      ++loop_connections_[to];
+    });
+  });
+}
+
+void TcpServer::AdoptListenSocket(int listen_fd) {
+  auto adopt = [this, listen_fd] {
+    acceptor_ = std::make_unique<Acceptor>(event_loop_, listen_fd);
+    acceptor_->OnNewConnection([this](int fd, InetAddr const &addr) { this->HandleNewConnection(fd, addr); });
+    addr_ = acceptor_->GetAddr();
+  };
+  // The acceptor bound by the constructor is torn down with its channel, in the loop.
+  if (event_loop_->IsInLoopThread()) {
+    adopt();
+    return;
+  }
+  std::promise<void> done;
+  event_loop_->QueueInLoop([&adopt, &done] {
+    adopt();
+    done.set_value();
+  });
+  done.get_future().wait();
+}
+
+void TcpServer::Drain(std::chrono::steady_clock::duration timeout, std::function<void()> done) {
+  event_loop_->RunInLoop([this, timeout, done = std::move(done)]() mutable {
+    running_.store(false, std::memory_order_release);
+    // Drain may run from a handler of this loop with the acceptor among the pending events, release it after them.
+    // Connections it accepts meanwhile are closed by their first response or by the timer.
+    event_loop_->QueueInLoop([acceptor = std::shared_ptr<Acceptor>(std::move(acceptor_))] {});
+    draining_        = true;
+    drained_handler_ = std::move(done);
+    // Connections served by this loop may close right away, iterate over a copy.
+    auto connections = connections_;
+    for (auto const &connection : connections) {
+      connection->GetEventLoop()->RunInLoop([connection, handler = drain_handler_] {
+        if (handler) {
+          handler(connection);
+        } else {
+          connection->Shutdown();
+        }
+      });
+    }
+    drain_timer_ = event_loop_->RunAfter(timeout, [this] {
+      auto connections = connections_;
+      for (auto const &connection : connections) {
+        connection->ForceClose();
+      }
     });
+    CheckDrained();
+  });
+}
+
+void TcpServer::CheckDrained() {
+  if (!draining_ || !connections_.empty() || !drained_handler_) {
+    return;
   }
+  event_loop_->Cancel(drain_timer_);
+  auto done        = std::move(drained_handler_);
+  drained_handler_ = nullptr;
+  done();
 }
 
 }  // namespace simple_http::net
\ No newline at end of file
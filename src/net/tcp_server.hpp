@@ -12,16 +12,20 @@
 #pragma once
 
 #include <atomic>
+#include <chrono>
 #include <condition_variable>
 #include <future>
+#include <map>
 #include <memory>
 #include <mutex>
 #include <set>
+#include <string>
 #include <thread>
 
 #include <cstdint>
 
 #include "net/acceptor.hpp"
+#include "net/admission_controller.hpp"
 #include "net/channel.hpp"
 #include "net/epoll.hpp"
 #include "net/event_loop.hpp"
@@ -29,6 +33,7 @@
 #include "net/inet_addr.hpp"
 #include "net/socket.hpp"
 #include "net/tcp_connection.hpp"
+#include "net/traffic_capture.hpp"
 #include "utils/non_copyable.hpp"
 
 namespace simple_http::net {
@@ -42,14 +47,84 @@ struct TcpServer : public simple_http::util::NonCopyable {
   void Start();
   void Stop();
 
-  void SetEventLoopGroupNum(size_t num) {
-    event_loop_group_ = std::make_unique<EventLoopGroup>(num);
-    event_loop_group_->Start();
+  /**
+   * @brief Serve connections on a group of num loops. Calling it again resizes the group in place,
+   * keeping options: the loops beyond num retire, see OnRetire(), the others keep their connections.
+   * An elastic group, see EventLoopGroupOptions::max_loops, resizes itself every resize_interval.
+   *
+   */
+  void SetEventLoopGroupNum(size_t num, EventLoopGroupOptions options = {});
+
+  /**
+   * @brief Put the loops serving this server in busy polling mode, see EventLoop::SetBusyPoll.
+   * A non-zero socket_busy_poll_us also sets SO_BUSY_POLL and SO_PREFER_BUSY_POLL on accepted sockets.
+   *
+   */
+  void SetBusyPoll(std::chrono::microseconds idle_timeout, int socket_busy_poll_us = 0) {
+    busy_poll_idle_      = idle_timeout;
+    socket_busy_poll_us_ = socket_busy_poll_us;
+    ApplyBusyPoll();
   }
 
+  /**
+   * @brief Accept on listen_fd, a socket bound to the same address by another process and handed
+   * over to this one, instead of the socket bound by the constructor. Call it before Start().
+   *
+   */
+  void AdoptListenSocket(int listen_fd);
+
+  [[nodiscard]] InetAddr const& GetAddr() const { return addr_; }
+
+  // The listening socket, to be handed over to a successor. -1 once the server stopped accepting.
+  [[nodiscard]] int GetListenFd() const { return acceptor_ ? acceptor_->GetFd() : -1; }
+
+  /**
+   * @brief Stop accepting and let the open connections finish. The drain handler runs on the loop
+   * of every connection to wind it down, without one connections are shut down. Those still open
+   * after timeout are closed. done runs on the acceptor loop once the last connection closed.
+   *
+   */
+  void Drain(std::chrono::steady_clock::duration timeout, std::function<void()> done);
+
+  /**
+   * @brief Move connection to a less utilized loop if the group asks for it, see
+   * EventLoopGroupOptions::migrate_utilization_gap. Call it from the loop of the connection while
+   * it is idle between two messages.
+   *
+   */
+  void Rebalance(std::shared_ptr<TcpConnection> const& connection);
+
   void OnReceiveMessage(ReceiveMessageHandler handler) { receive_message_handler_ = std::move(handler); }
   void OnWriteComplete(WriteCompleteHandler handler) { write_complete_handler_ = std::move(handler); }
   void OnConnection(ConnectionHandler handler) { connection_handler_ = std::move(handler); }
+  void OnDrain(ConnectionHandler handler) { drain_handler_ = std::move(handler); }
+
+  /**
+   * @brief The retire handler runs on the loop of every connection of a loop leaving the group, to
+   * move it with Rebalance() once idle or to wind it down. Without one idle connections move right
+   * away, the others stay until they close. The loop stops once it serves no connection.
+   *
+   */
+  void OnRetire(ConnectionHandler handler) { retire_handler_ = std::move(handler); }
+
+  void SetAdmissionOptions(AdmissionOptions const& options) { admission_.SetOptions(options); }
+
+  /**
+   * @brief Bytes written to a connection that is rejected by admission control before it is closed,
+   * e.g. a canned "503 Service Unavailable". Empty means close immediately.
+   *
+   */
+  void SetOverloadResponse(std::string_view response) { overload_response_ = response; }
+
+  /**
+   * @brief Record what clients send on every accepted connection, see TrafficCapture. Call it
+   * before Start().
+   *
+   */
+  void SetTrafficCapture(std::shared_ptr<TrafficCapture> capture) { capture_ = std::move(capture); }
+
+  [[nodiscard]] AdmissionController&       GetAdmissionController() { return admission_; }
+  [[nodiscard]] AdmissionController const& GetAdmissionController() const { return admission_; }
 
  private:
   std::string      name_{};
@@ -59,14 +134,44 @@ struct TcpServer : public simple_http::util::NonCopyable {
   ReceiveMessageHandler receive_message_handler_{};
   WriteCompleteHandler  write_complete_handler_{};
   ConnectionHandler     connection_handler_{};
+  ConnectionHandler     drain_handler_{};
+  ConnectionHandler     retire_handler_{};
 
   EventLoop*                      event_loop_{};
   std::unique_ptr<Acceptor>       acceptor_;
   std::unique_ptr<EventLoopGroup> event_loop_group_{nullptr};
 
   std::set<std::shared_ptr<TcpConnection>> connections_{};
+  std::map<EventLoop*, std::size_t>        loop_connections_{};
+
+  AdmissionController             admission_{};
+  std::string                     overload_response_{};
+  std::shared_ptr<TrafficCapture> capture_{};
+
+  std::chrono::microseconds busy_poll_idle_{0};
+  int                       socket_busy_poll_us_{0};
+
+  bool                  draining_{false};
+  TimerId               drain_timer_{};
+  std::function<void()> drained_handler_{};
+
+  TimerId              resize_timer_{0};
+  std::set<EventLoop*> quiet_loops_{};  // retiring loops found without connections by the last check
+
+  void ApplyBusyPoll();
+
+  void ResizeEventLoopGroup(size_t num);
+  void AutoscaleEventLoopGroup();
+  void AddEventLoop();
+  void RetireEventLoop();
+  void ReleaseRetiredLoops();
+
+  EventLoop* PickEventLoop(int fd);
+  void       RejectConnection(int fd) const;
 
   void HandleNewConnection(int fd, InetAddr const& addr);
   void HandleConnectionClosed(std::shared_ptr<TcpConnection> const& connection);
+  void RemoveConnection(std::shared_ptr<TcpConnection> const& connection);
+  void CheckDrained();
 };
 }  // namespace simple_http::net
\ No newline at end of file
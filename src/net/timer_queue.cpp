@@ -0,0 +1,111 @@
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include "net/channel.hpp"
+
+#include "timer_queue.hpp"
+
+namespace simple_http::net {
+
+namespace {
+int CreateTimerfd() {
+  int timer_fd = ::timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  if (timer_fd < 0) {
+    std::abort();
+  }
+  return timer_fd;
+}
+}  // namespace
+
+TimerQueue::TimerQueue(EventLoop* loop)
+    : timer_fd_(CreateTimerfd()), channel_(std::make_unique<Channel>(loop, timer_fd_)) {
+  channel_->SetReadEventHandler([this]() { HandleRead(); });
+  channel_->EnableReading();
+}
+
+TimerQueue::~TimerQueue() {
+  channel_->DisableAll();
+  channel_->Remove();
+  ::close(timer_fd_);
+}
+
+void TimerQueue::Add(TimerId id, Clock::time_point when, Clock::duration interval, Callback callback) {
+  timers_.emplace(id, Timer{when, interval, std::move(callback)});
+  queue_.emplace(when, id);
+  Arm();
+}
+
+void TimerQueue::Cancel(TimerId id) {
+  auto it = timers_.find(id);
+  if (it == timers_.end()) {
+    return;
+  }
+  queue_.erase({it->second.when, id});
+  timers_.erase(it);
+  Arm();
+}
+
+void TimerQueue::HandleRead() {
+  uint64_t expirations = 0;
+  (void)::read(timer_fd_, &expirations, sizeof(expirations));
+  armed_ = Clock::time_point::max();
+
+  auto                 now = Clock::now();
+  std::vector<TimerId> expired;
+  while (!queue_.empty() && queue_.begin()->first <= now) {
+    expired.push_back(queue_.begin()->second);
+    queue_.erase(queue_.begin());
+  }
+
+  for (auto id : expired) {
+    auto it = timers_.find(id);
+    if (it == timers_.end()) {
+      continue;  // cancelled by an earlier callback
+    }
+    // The callback may cancel its own timer or add others, which can rehash the map.
+    auto callback = std::move(it->second.callback);
+    callback();
+
+    it = timers_.find(id);
+    if (it == timers_.end()) {
+      continue;
+    }
+    auto& timer = it->second;
+    if (timer.interval == Clock::duration::zero()) {
+      timers_.erase(it);
+      continue;
+    }
+    // Keep the cadence, but don't fire a burst to catch up after the loop was busy.
+    timer.when += timer.interval;
+    if (timer.when <= now) {
+      timer.when = now + timer.interval;
+    }
+    timer.callback = std::move(callback);
+    queue_.emplace(timer.when, id);
+  }
+  Arm();
+}
+
+void TimerQueue::Arm() {
+  auto earliest = queue_.empty() ? Clock::time_point::max() : queue_.begin()->first;
+  if (earliest == armed_) {
+    return;
+  }
+  armed_ = earliest;
+
+  struct itimerspec spec {};
+  if (earliest != Clock::time_point::max()) {
+    // steady_clock is CLOCK_MONOTONIC, its time points can be used as absolute timerfd values.
+    auto since_epoch = std::max(earliest.time_since_epoch(), Clock::duration{1});
+    auto seconds     = std::chrono::duration_cast<std::chrono::seconds>(since_epoch);
+    spec.it_value.tv_sec  = seconds.count();
+    spec.it_value.tv_nsec = std::chrono::duration_cast<std::chrono::nanoseconds>(since_epoch - seconds).count();
+  }
+  ::timerfd_settime(timer_fd_, TFD_TIMER_ABSTIME, &spec, nullptr);
+}
+
+}  // namespace simple_http::net
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <set>
+#include <unordered_map>
+#include <utility>
+
+#include "utils/non_copyable.hpp"
+
+namespace simple_http::net {
+struct EventLoop;
+struct Channel;
+
+using TimerId = uint64_t;
+
+/**
+ * @brief Timers of one event loop, backed by a single timerfd armed for the earliest of them.
+ * Add and Cancel are called in the loop thread, EventLoop forwards calls from other threads.
+ *
+ */
+struct TimerQueue : public simple_http::util::NonCopyable {
+ public:
+  using Clock    = std::chrono::steady_clock;
+  using Callback = std::function<void()>;
+
+  explicit TimerQueue(EventLoop* loop);
+  ~TimerQueue();
+
+  // Ids are handed out before the timer is added, so that they can be returned to any thread.
+  [[nodiscard]] TimerId NextId() { return next_id_.fetch_add(1, std::memory_order_relaxed); }
+
+  // Run callback at when, then every interval if it is not zero, until cancelled.
+  void Add(TimerId id, Clock::time_point when, Clock::duration interval, Callback callback);
+  void Cancel(TimerId id);
+
+  [[nodiscard]] std::size_t GetCount() const { return timers_.size(); }
+
+ private:
+  struct Timer {
+    Clock::time_point when;
+    Clock::duration   interval;
+    Callback          callback;
+  };
+
+  int                      timer_fd_;
+  std::unique_ptr<Channel> channel_;
+  std::atomic<TimerId>     next_id_{1};
+
+  std::set<std::pair<Clock::time_point, TimerId>> queue_;
+  std::unordered_map<TimerId, Timer>              timers_;
+  Clock::time_point                               armed_{Clock::time_point::max()};
+
+  void HandleRead();
+  void Arm();
+};
+}  // namespace simple_http::net
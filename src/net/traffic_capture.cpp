@@ -0,0 +1,151 @@
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+#include "utils/log_sink.hpp"
+
+#include "traffic_capture.hpp"
+
+namespace simple_http::net {
+
+namespace {
+std::runtime_error SystemError(std::string const& what, std::string const& path) {
+  return std::runtime_error(what + " " + path + ": " + std::strerror(errno));
+}
+
+template <typename T>
+void Put(char*& out, T value) {
+  std::memcpy(out, &value, sizeof(value));
+  out += sizeof(value);
+}
+
+template <typename T>
+T Get(char const*& in) {
+  T value;
+  std::memcpy(&value, in, sizeof(value));
+  in += sizeof(value);
+  return value;
+}
+
+// Writes the file header once, then the batches of the logger as they come.
+struct CaptureFileSink final : public util::LogSink {
+ public:
+  CaptureFileSink(std::string const& path, uint64_t start_unix_ns) : file_(std::fopen(path.c_str(), "wb")) {
+    if (file_ == nullptr) {
+      throw SystemError("Failed to create capture", path);
+    }
+    char  header[CaptureFormat::kHeaderSize];
+    char* out = header;
+    std::memcpy(out, CaptureFormat::kMagic, sizeof(CaptureFormat::kMagic));
+    out += sizeof(CaptureFormat::kMagic);
+    Put(out, CaptureFormat::kVersion);
+    Put(out, uint32_t{0});
+    Put(out, start_unix_ns);
+    std::fwrite(header, 1, sizeof(header), file_);
+    std::fflush(file_);
+  }
+  ~CaptureFileSink() override { std::fclose(file_); }
+
+  void Write(std::string_view data) override { std::fwrite(data.data(), 1, data.size(), file_); }
+  void Flush() override { std::fflush(file_); }
+
+ private:
+  std::FILE* file_;
+};
+
+uint64_t UnixNowNs() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch())
+      .count();
+}
+}  // namespace
+
+TrafficCapture::TrafficCapture(std::string const& path, TrafficCaptureOptions options)
+    : options_(options),
+      start_(std::chrono::steady_clock::now()),
+      logger_(std::make_unique<CaptureFileSink>(path, UnixNowNs()), options.thread_buffer_size,
+              options.flush_interval) {
+  logger_.Start();
+}
+
+TrafficCapture::~TrafficCapture() { logger_.Stop(); }
+
+uint32_t TrafficCapture::NextConnection() {
+  auto n = connections_.fetch_add(1, std::memory_order_relaxed) + 1;
+  // Spread the sampled connections evenly: take n when the running count of sampled ones grows.
+  auto sampled = [this](uint32_t count) { return std::floor(static_cast<double>(count) * options_.sample); };
+  return sampled(n) != sampled(n - 1) ? n : 0;
+}
+
+void TrafficCapture::Append(uint32_t connection, uint32_t sequence, CaptureEvent event, std::string_view data) {
+  thread_local std::string record;
+  record.resize(CaptureFormat::kRecordHeaderSize + data.size());
+
+  auto  time = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start_);
+  char* out  = record.data();
+  Put(out, static_cast<uint64_t>(time.count()));
+  Put(out, connection);
+  Put(out, sequence);
+  Put(out, static_cast<uint8_t>(event));
+  Put(out, static_cast<uint32_t>(data.size()));
+  std::memcpy(out, data.data(), data.size());
+  logger_.Append(record);
+}
+
+std::unique_ptr<CaptureStream> CaptureStream::Open(std::shared_ptr<TrafficCapture> capture) {
+  auto id = capture->NextConnection();
+  if (id == 0) {
+    return nullptr;
+  }
+  auto stream = std::make_unique<CaptureStream>(std::move(capture), id);
+  stream->capture_->Append(id, stream->sequence_++, CaptureEvent::kOpen, {});
+  return stream;
+}
+
+void CaptureStream::Data(std::string_view data) {
+  while (!data.empty()) {
+    auto chunk = data.substr(0, CaptureFormat::kMaxPayload);
+    capture_->Append(id_, sequence_++, CaptureEvent::kData, chunk);
+    data.remove_prefix(chunk.size());
+  }
+}
+
+TrafficCaptureReader::TrafficCaptureReader(std::string const& path) : file_(std::fopen(path.c_str(), "rb")) {
+  if (file_ == nullptr) {
+    throw SystemError("Failed to open capture", path);
+  }
+  char header[CaptureFormat::kHeaderSize];
+  if (std::fread(header, 1, sizeof(header), file_) != sizeof(header) ||
+      std::memcmp(header, CaptureFormat::kMagic, sizeof(CaptureFormat::kMagic)) != 0) {
+    std::fclose(file_);
+    throw std::runtime_error("Not a capture file: " + path);
+  }
+  char const* in = header + sizeof(CaptureFormat::kMagic);
+  if (Get<uint32_t>(in) != CaptureFormat::kVersion) {
+    std::fclose(file_);
+    throw std::runtime_error("Unsupported capture version: " + path);
+  }
+  in += sizeof(uint32_t);
+  start_unix_ns_ = Get<uint64_t>(in);
+}
+
+TrafficCaptureReader::~TrafficCaptureReader() { std::fclose(file_); }
+
+bool TrafficCaptureReader::Next(CaptureRecord& record) {
+  char header[CaptureFormat::kRecordHeaderSize];
+  if (std::fread(header, 1, sizeof(header), file_) != sizeof(header)) {
+    return false;
+  }
+  char const* in    = header;
+  record.time_ns    = Get<uint64_t>(in);
+  record.connection = Get<uint32_t>(in);
+  record.sequence   = Get<uint32_t>(in);
+  record.event      = static_cast<CaptureEvent>(Get<uint8_t>(in));
+  auto size         = Get<uint32_t>(in);
+  if (size > CaptureFormat::kMaxPayload) {
+    return false;
+  }
+  record.data.resize(size);
+  return std::fread(record.data.data(), 1, size, file_) == size;
+}
+}  // namespace simple_http::net
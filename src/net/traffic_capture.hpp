@@ -0,0 +1,137 @@
+/**
+ * @file traffic_capture.hpp
+ * @author Qirui Wang (qirui.wang@moegi.waseda.jp)
+ * @brief Recording of the bytes clients send, to be replayed against a server later
+ * @version 0.1
+ * @date 2023-03-06
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#pragma once
+
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "utils/async_logger.hpp"
+#include "utils/non_copyable.hpp"
+
+namespace simple_http::net {
+
+/**
+ * @brief Layout of a capture file: the file header, then records of a fixed 21 byte header and
+ * their payload, all integers little-endian.
+ *
+ *   header:  magic[8] version:u32 reserved:u32 start_unix_ns:u64
+ *   record:  time_ns:u64 connection:u32 sequence:u32 event:u8 size:u32 payload[size]
+ *
+ * time_ns counts from the start of the capture. Records of one connection are in order, those
+ * of connections on different loops are interleaved in batches.
+ *
+ */
+struct CaptureFormat {
+  static constexpr char        kMagic[8]         = {'S', 'H', 'T', 'T', 'P', 'C', 'A', 'P'};
+  static constexpr uint32_t    kVersion          = 1;
+  static constexpr std::size_t kHeaderSize       = 24;
+  static constexpr std::size_t kRecordHeaderSize = 21;
+  static constexpr std::size_t kMaxPayload       = 64 * 1024;  // larger reads span several records
+  static_assert(std::endian::native == std::endian::little, "capture files are written in host order");
+};
+
+enum class CaptureEvent : uint8_t {
+  kOpen,
+  kData,
+  kClose,
+};
+
+struct CaptureRecord {
+  uint64_t     time_ns{0};
+  uint32_t     connection{0};
+  uint32_t     sequence{0};  // per connection, a gap means records were dropped
+  CaptureEvent event{CaptureEvent::kData};
+  std::string  data;
+};
+
+struct TrafficCaptureOptions {
+  double      sample{1.0};  // fraction of the connections recorded
+  std::size_t thread_buffer_size{4 * 1024 * 1024};
+
+  std::chrono::milliseconds flush_interval{1000};
+};
+
+/**
+ * @brief Appends the records of the captured connections to a file. Loops copy each read into a
+ * ring of their own, a background thread writes the rings out, so capturing costs a memcpy per
+ * read and no system call. If the disk can't keep up records are dropped and counted, and replay
+ * skips what follows a gap on that connection.
+ *
+ */
+struct TrafficCapture : public util::NonCopyable {
+ public:
+  // Throws std::runtime_error if path can't be created.
+  explicit TrafficCapture(std::string const& path, TrafficCaptureOptions options = {});
+  ~TrafficCapture();
+
+  // Pick the id of a new connection, 0 if it is not sampled.
+  uint32_t NextConnection();
+
+  void Append(uint32_t connection, uint32_t sequence, CaptureEvent event, std::string_view data);
+
+  // Records lost because a ring was full.
+  [[nodiscard]] uint64_t GetDropped() const { return logger_.GetDropped(); }
+
+ private:
+  TrafficCaptureOptions                       options_;
+  std::chrono::steady_clock::time_point const start_;
+  util::AsyncLogger                           logger_;
+  std::atomic_uint32_t                        connections_{0};
+};
+
+/**
+ * @brief The recording of one connection, used on its loop only.
+ *
+ */
+struct CaptureStream : public util::NonCopyable {
+ public:
+  // Records the opening of a connection, nullptr if it is not sampled.
+  static std::unique_ptr<CaptureStream> Open(std::shared_ptr<TrafficCapture> capture);
+
+  CaptureStream(std::shared_ptr<TrafficCapture> capture, uint32_t id) : capture_(std::move(capture)), id_(id) {}
+
+  void Data(std::string_view data);
+  void Close() { capture_->Append(id_, sequence_++, CaptureEvent::kClose, {}); }
+
+ private:
+  std::shared_ptr<TrafficCapture> capture_;
+  uint32_t                        id_;
+  uint32_t                        sequence_{0};
+};
+
+/**
+ * @brief Reads the records of a capture file in the order they were written.
+ *
+ */
+struct TrafficCaptureReader : public util::NonCopyable {
+ public:
+  // Throws std::runtime_error if path can't be opened or is not a capture file.
+  explicit TrafficCaptureReader(std::string const& path);
+  ~TrafficCaptureReader();
+
+  // Returns false at the end of the file, or at a record cut short by a writer that died.
+  bool Next(CaptureRecord& record);
+
+  [[nodiscard]] uint64_t GetStartUnixNs() const { return start_unix_ns_; }
+
+ private:
+  std::FILE* file_{nullptr};
+  uint64_t   start_unix_ns_{0};
+};
+}  // namespace simple_http::net
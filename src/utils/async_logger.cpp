@@ -0,0 +1,165 @@
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <utility>
+
+#include "async_logger.hpp"
+#include "metrics.hpp"
+
+namespace simple_http::util {
+
+namespace {
+std::atomic_uint64_t next_logger_id{0};
+}  // namespace
+
+/**
+ * @brief Single producer, single consumer byte ring. head and tail only grow, the position in
+ * data is taken modulo capacity.
+ *
+ */
+struct AsyncLogger::ThreadBuffer {
+  explicit ThreadBuffer(std::size_t size)
+      : capacity(std::bit_ceil(std::max<std::size_t>(size, 4096))),
+        data(std::make_unique<char[]>(capacity)) {}  // NOLINT
+
+  std::size_t const       capacity;
+  std::unique_ptr<char[]> data;  // NOLINT
+
+  alignas(kCacheLineSize) std::atomic_size_t head{0};  // written by the producer
+  alignas(kCacheLineSize) std::atomic_size_t tail{0};  // written by the backend
+
+  std::atomic_bool retired{false};   // the producing thread exited
+  std::atomic_bool orphaned{false};  // the logger was destroyed
+};
+
+AsyncLogger::AsyncLogger(std::unique_ptr<LogSink> sink, std::size_t thread_buffer_size,
+                         std::chrono::milliseconds flush_interval)
+    : id_(next_logger_id.fetch_add(1, std::memory_order_relaxed)),
+      sink_(std::move(sink)),
+      thread_buffer_size_(thread_buffer_size),
+      flush_interval_(flush_interval) {}
+
+AsyncLogger::~AsyncLogger() {
+  Stop();
+  Drain();
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto& buffer : buffers_) {
+    buffer->orphaned.store(true, std::memory_order_release);
+  }
+}
+
+void AsyncLogger::Start() {
+  if (running_.exchange(true)) {
+    return;
+  }
+  thread_ = std::thread([this] { Run(); });
+}
+
+void AsyncLogger::Stop() {
+  if (!running_.exchange(false)) {
+    return;
+  }
+  cv_.notify_one();
+  thread_.join();
+}
+
+void AsyncLogger::Append(std::string_view data) {
+  auto& buffer = GetThreadBuffer();
+  auto  head   = buffer.head.load(std::memory_order_relaxed);
+  auto  used   = head - buffer.tail.load(std::memory_order_acquire);
+  if (data.size() > buffer.capacity - used) {
+    dropped_.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+
+  auto offset = head & (buffer.capacity - 1);
+  auto first  = std::min(data.size(), buffer.capacity - offset);
+  std::memcpy(buffer.data.get() + offset, data.data(), first);
+  std::memcpy(buffer.data.get(), data.data() + first, data.size() - first);
+  buffer.head.store(head + data.size(), std::memory_order_release);
+
+  // Wake the backend early once, when the ring crosses half full.
+  auto half = buffer.capacity / 2;
+  if (used < half && used + data.size() >= half) {
+    cv_.notify_one();
+  }
+}
+
+AsyncLogger::ThreadBuffer& AsyncLogger::GetThreadBuffer() {
+  struct Registry {
+    std::vector<std::pair<uint64_t, std::shared_ptr<ThreadBuffer>>> buffers;
+
+    ~Registry() {
+      for (auto& [id, buffer] : buffers) {
+        buffer->retired.store(true, std::memory_order_release);
+      }
+    }
+  };
+  thread_local Registry registry;
+
+  for (auto& [id, buffer] : registry.buffers) {
+    if (id == id_) {
+      return *buffer;
+    }
+  }
+
+  std::erase_if(registry.buffers,
+                [](auto const& entry) { return entry.second->orphaned.load(std::memory_order_acquire); });
+  auto buffer = std::make_shared<ThreadBuffer>(thread_buffer_size_);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    buffers_.push_back(buffer);
+  }
+  registry.buffers.emplace_back(id_, buffer);
+  return *buffer;
+}
+
+void AsyncLogger::Run() {
+  while (running_.load(std::memory_order_acquire)) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cv_.wait_for(lock, flush_interval_);
+    }
+    Drain();
+  }
+  Drain();
+}
+
+bool AsyncLogger::Drain() {
+  std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    buffers = buffers_;
+  }
+
+  bool wrote = false;
+  for (auto& buffer : buffers) {
+    auto tail = buffer->tail.load(std::memory_order_relaxed);
+    auto head = buffer->head.load(std::memory_order_acquire);
+    if (head == tail) {
+      continue;
+    }
+    auto offset = tail & (buffer->capacity - 1);
+    auto size   = head - tail;
+    auto first  = std::min(size, buffer->capacity - offset);
+    sink_->Write({buffer->data.get() + offset, first});
+    if (size > first) {
+      sink_->Write({buffer->data.get(), size - first});
+    }
+    buffer->tail.store(head, std::memory_order_release);
+    wrote = true;
+  }
+  if (wrote) {
+    sink_->Flush();
+  }
+
+  // Forget the rings of threads that exited once they are empty.
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::erase_if(buffers_, [](auto const& buffer) {
+    return buffer->retired.load(std::memory_order_acquire) &&
+           buffer->head.load(std::memory_order_acquire) == buffer->tail.load(std::memory_order_relaxed);
+  });
+  return wrote;
+}
+
+}  // namespace simple_http::util
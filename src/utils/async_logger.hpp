@@ -0,0 +1,79 @@
+/**
+ * @file async_logger.hpp
+ * @author Qirui Wang (qirui.wang@moegi.waseda.jp)
+ * @brief Logger backend that moves formatting threads off the disk
+ * @version 0.1
+ * @date 2023-02-14
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "log_sink.hpp"
+#include "non_copyable.hpp"
+
+namespace simple_http::util {
+
+/**
+ * @brief Every producing thread appends to its own ring buffer with a memcpy and a release store,
+ * no lock is taken and nothing is allocated after the first append. A backend thread drains the
+ * rings into the sink every flush_interval, or sooner once a ring is half full. When a ring is
+ * full because the sink can't keep up the line is dropped and counted, a producer never waits.
+ *
+ * Lines from one thread stay in order; lines from different threads are only ordered per batch.
+ *
+ */
+struct AsyncLogger : public NonCopyable {
+ public:
+  explicit AsyncLogger(std::unique_ptr<LogSink> sink, std::size_t thread_buffer_size = 1024 * 1024,
+                       std::chrono::milliseconds flush_interval = std::chrono::seconds(1));
+  ~AsyncLogger();
+
+  void Start();
+
+  // Drain everything appended so far, flush the sink and join the backend thread.
+  void Stop();
+
+  /**
+   * @brief Append one or more complete lines. Safe to call from any thread.
+   *
+   */
+  void Append(std::string_view data);
+
+  [[nodiscard]] uint64_t GetDropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+  [[nodiscard]] LogSink& GetSink() { return *sink_; }
+
+ private:
+  struct ThreadBuffer;
+
+  uint64_t const                             id_;
+  std::unique_ptr<LogSink>                   sink_;
+  std::size_t                                thread_buffer_size_;
+  std::chrono::milliseconds                  flush_interval_;
+  std::atomic_uint64_t                       dropped_{0};
+  std::atomic_bool                           running_{false};
+  std::thread                                thread_;
+  std::mutex                                 mutex_;
+  std::condition_variable                    cv_;
+  std::vector<std::shared_ptr<ThreadBuffer>> buffers_;
+
+  ThreadBuffer& GetThreadBuffer();
+  void          Run();
+  bool          Drain();
+};
+
+}  // namespace simple_http::util
@@ -0,0 +1,85 @@
+#include <array>
+#include <cstdint>
+
+#include "base64.hpp"
+
+namespace simple_http::util {
+
+namespace {
+constexpr std::string_view kAlphabet    = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+constexpr std::string_view kUrlAlphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+
+constexpr uint8_t kInvalid = 0xff;
+
+constexpr std::array<uint8_t, 256> kDecodeTable = [] {
+  std::array<uint8_t, 256> table{};
+  table.fill(kInvalid);
+  for (uint8_t i = 0; i < 64; ++i) {
+    table[static_cast<uint8_t>(kAlphabet[i])]    = i;
+    table[static_cast<uint8_t>(kUrlAlphabet[i])] = i;
+  }
+  return table;
+}();
+}  // namespace
+
+std::string Base64Encode(std::string_view data, bool url) {
+  auto const& alphabet = url ? kUrlAlphabet : kAlphabet;
+
+  std::string out;
+  out.reserve((data.size() + 2) / 3 * 4);
+  std::size_t i = 0;
+  for (; i + 2 < data.size(); i += 3) {
+    uint32_t n = (static_cast<uint8_t>(data[i]) << 16) | (static_cast<uint8_t>(data[i + 1]) << 8) |
+                 static_cast<uint8_t>(data[i + 2]);
+    out += alphabet[(n >> 18) & 0x3f];
+    out += alphabet[(n >> 12) & 0x3f];
+    out += alphabet[(n >> 6) & 0x3f];
+    out += alphabet[n & 0x3f];
+  }
+  if (i < data.size()) {
+    uint32_t n = static_cast<uint8_t>(data[i]) << 16;
+    if (i + 1 < data.size()) {
+      n |= static_cast<uint8_t>(data[i + 1]) << 8;
+    }
+    out += alphabet[(n >> 18) & 0x3f];
+    out += alphabet[(n >> 12) & 0x3f];
+    if (i + 1 < data.size()) {
+      out += alphabet[(n >> 6) & 0x3f];
+    } else if (!url) {
+      out += '=';
+    }
+    if (!url) {
+      out += '=';
+    }
+  }
+  return out;
+}
+
+std::optional<std::string> Base64Decode(std::string_view data) {
+  while (!data.empty() && data.back() == '=') {
+    data.remove_suffix(1);
+  }
+  if (data.size() % 4 == 1) {
+    return std::nullopt;
+  }
+
+  std::string out;
+  out.reserve(data.size() * 3 / 4);
+  uint32_t bits  = 0;
+  int      count = 0;
+  for (auto c : data) {
+    auto value = kDecodeTable[static_cast<uint8_t>(c)];
+    if (value == kInvalid) {
+      return std::nullopt;
+    }
+    bits = (bits << 6) | value;
+    count += 6;
+    if (count >= 8) {
+      count -= 8;
+      out += static_cast<char>((bits >> count) & 0xff);
+    }
+  }
+  return out;
+}
+
+}  // namespace simple_http::util
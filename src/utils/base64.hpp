@@ -0,0 +1,19 @@
+#pragma once
+
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace simple_http::util {
+
+// Standard alphabet with padding, or the URL and filename safe alphabet without it (RFC 4648).
+std::string Base64Encode(std::string_view data, bool url = false);
+
+/**
+ * @brief Decode either alphabet, with or without padding.
+ *
+ * @return std::nullopt if data is not valid base64
+ */
+std::optional<std::string> Base64Decode(std::string_view data);
+
+}  // namespace simple_http::util
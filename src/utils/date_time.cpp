@@ -0,0 +1,60 @@
+#include <chrono>
+#include <cstring>
+#include <ctime>
+
+#include "date_time.hpp"
+
+namespace simple_http::util {
+
+namespace {
+constexpr std::size_t kSecondsSize = 17;  // "20230214 12:34:56"
+
+void WriteDigits(char* buf, int64_t value, int width) {
+  for (int i = width - 1; i >= 0; --i) {
+    buf[i] = static_cast<char>('0' + value % 10);
+    value  /= 10;
+  }
+}
+}  // namespace
+
+DateTime DateTime::Now() {
+  auto now = std::chrono::system_clock::now().time_since_epoch();
+  return DateTime{std::chrono::duration_cast<std::chrono::microseconds>(now).count()};
+}
+
+std::size_t DateTime::Format(char* buf, bool show_micro_seconds) const {
+  thread_local int64_t last_second = -1;
+  thread_local char    cached[kSecondsSize];
+
+  auto seconds = GetSecondsSinceEpoch();
+  if (seconds != last_second) {
+    last_second = seconds;
+    auto    time = static_cast<std::time_t>(seconds);
+    std::tm tm{};
+    ::gmtime_r(&time, &tm);
+    WriteDigits(cached, tm.tm_year + 1900, 4);
+    WriteDigits(cached + 4, tm.tm_mon + 1, 2);
+    WriteDigits(cached + 6, tm.tm_mday, 2);
+    cached[8] = ' ';
+    WriteDigits(cached + 9, tm.tm_hour, 2);
+    cached[11] = ':';
+    WriteDigits(cached + 12, tm.tm_min, 2);
+    cached[14] = ':';
+    WriteDigits(cached + 15, tm.tm_sec, 2);
+  }
+
+  std::memcpy(buf, cached, kSecondsSize);
+  if (!show_micro_seconds) {
+    return kSecondsSize;
+  }
+  buf[kSecondsSize] = '.';
+  WriteDigits(buf + kSecondsSize + 1, micro_seconds_since_epoch_ % 1000000, 6);
+  return kFormattedSize;
+}
+
+std::string DateTime::ToFormattedString(bool show_micro_seconds) const {
+  char buf[kFormattedSize];
+  return {buf, Format(buf, show_micro_seconds)};
+}
+
+}  // namespace simple_http::util
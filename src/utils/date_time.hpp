@@ -1,8 +1,49 @@
+/**
+ * @file date_time.hpp
+ * @author Qirui Wang (qirui.wang@moegi.waseda.jp)
+ * @brief Wall clock time point with cached formatting
+ * @version 0.1
+ * @date 2023-02-14
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
 #pragma once
 
+#include <compare>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
 namespace simple_http::util {
 struct DateTime {
  public:
+  // Length of "20230214 12:34:56.789012".
+  static constexpr std::size_t kFormattedSize = 24;
+
+  DateTime() = default;
+  explicit DateTime(int64_t micro_seconds_since_epoch) : micro_seconds_since_epoch_(micro_seconds_since_epoch) {}
+
+  static DateTime Now();
+
+  [[nodiscard]] int64_t GetMicroSecondsSinceEpoch() const { return micro_seconds_since_epoch_; }
+  [[nodiscard]] int64_t GetSecondsSinceEpoch() const { return micro_seconds_since_epoch_ / 1000000; }
+
+  /**
+   * @brief Write the UTC time as "20230214 12:34:56.789012" to buf, which must hold kFormattedSize
+   * chars, no terminating null is written. The date and time part is cached per thread and only
+   * recomputed when the second changes.
+   *
+   * @return the number of chars written
+   */
+  std::size_t Format(char* buf, bool show_micro_seconds = true) const;
+
+  [[nodiscard]] std::string ToFormattedString(bool show_micro_seconds = true) const;
+
+  auto operator<=>(DateTime const&) const = default;
+
  private:
+  int64_t micro_seconds_since_epoch_{0};
 };
-}  // namespace simple_http::util
\ No newline at end of file
+}  // namespace simple_http::util
@@ -0,0 +1,73 @@
+#include <algorithm>
+#include <cmath>
+
+#include "latency_histogram.hpp"
+
+namespace simple_http::util {
+
+void LatencyHistogram::Merge(LatencyHistogram const& other) {
+  for (std::size_t i = 0; i < kBuckets; ++i) {
+    counts_[i] += other.counts_[i];
+  }
+  total_ += other.total_;
+  sum_   += other.sum_;
+  max_   = std::max(max_, other.max_);
+}
+
+uint64_t LatencyHistogram::ValueAtQuantile(double quantile) const {
+  if (total_ == 0) {
+    return 0;
+  }
+  quantile    = std::clamp(quantile, 0.0, 1.0);
+  auto target = std::max<uint64_t>(static_cast<uint64_t>(std::ceil(quantile * static_cast<double>(total_))), 1);
+
+  uint64_t seen = 0;
+  for (std::size_t i = 0; i < kBuckets; ++i) {
+    seen += counts_[i];
+    if (seen >= target) {
+      return std::min(BucketUpperBound(i), max_);
+    }
+  }
+  return max_;
+}
+
+ShardedLatencyHistogram::~ShardedLatencyHistogram() {
+  for (auto& shard : shards_) {
+    delete shard.load(std::memory_order_acquire);
+  }
+}
+
+ShardedLatencyHistogram::Shard& ShardedLatencyHistogram::GetShard() {
+  auto& slot  = shards_[CurrentMetricShard()];
+  auto* shard = slot.load(std::memory_order_acquire);
+  if (shard != nullptr) {
+    return *shard;
+  }
+  // First record from this shard. Allocated on the recording thread so the memory is local to it.
+  auto* fresh = new Shard();
+  if (slot.compare_exchange_strong(shard, fresh, std::memory_order_acq_rel)) {
+    return *fresh;
+  }
+  delete fresh;
+  return *shard;
+}
+
+LatencyHistogram ShardedLatencyHistogram::Snapshot() const {
+  LatencyHistogram merged;
+  for (auto const& slot : shards_) {
+    auto const* shard = slot.load(std::memory_order_acquire);
+    if (shard == nullptr) {
+      continue;
+    }
+    for (std::size_t i = 0; i < LatencyHistogram::kBuckets; ++i) {
+      auto n            = shard->counts[i].load(std::memory_order_relaxed);
+      merged.counts_[i] += n;
+      merged.total_     += n;
+    }
+    merged.sum_ += shard->sum.load(std::memory_order_relaxed);
+    merged.max_ = std::max(merged.max_, shard->max.load(std::memory_order_relaxed));
+  }
+  return merged;
+}
+
+}  // namespace simple_http::util
@@ -0,0 +1,129 @@
+/**
+ * @file latency_histogram.hpp
+ * @author Qirui Wang (qirui.wang@moegi.waseda.jp)
+ * @brief Log-linear (HDR style) latency histograms with lock-free per-thread recording
+ * @version 0.1
+ * @date 2023-02-12
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+#include "metrics.hpp"
+#include "non_copyable.hpp"
+
+namespace simple_http::util {
+
+/**
+ * @brief Plain histogram of nanosecond values. Every power of two range is split into
+ * kSubBuckets linear buckets, so a recorded value is reported within 1/kSubBuckets (~3%) of
+ * its real value. Values of 2^kMaxExponent ns (~68s) and above are clamped
+ * into the last bucket.
+ *
+ */
+struct LatencyHistogram {
+ public:
+  static constexpr uint32_t    kSubBucketBits = 5;
+  static constexpr uint64_t    kSubBuckets    = uint64_t{1} << kSubBucketBits;
+  static constexpr uint32_t    kMaxExponent   = 36;
+  static constexpr std::size_t kBuckets       = (kMaxExponent - kSubBucketBits + 1) * kSubBuckets;
+
+  static constexpr std::size_t BucketIndex(uint64_t value) {
+    if (value >= (uint64_t{1} << kMaxExponent)) {
+      return kBuckets - 1;
+    }
+    if (value < kSubBuckets) {
+      return value;
+    }
+    auto exponent = static_cast<uint32_t>(std::bit_width(value)) - 1;
+    auto shift    = exponent - kSubBucketBits;
+    return (shift + 1) * kSubBuckets + ((value >> shift) - kSubBuckets);
+  }
+
+  // Highest value that falls into the bucket.
+  static constexpr uint64_t BucketUpperBound(std::size_t index) {
+    if (index < kSubBuckets) {
+      return index;
+    }
+    auto shift = index / kSubBuckets - 1;
+    auto sub   = index % kSubBuckets + kSubBuckets;
+    return ((sub + 1) << shift) - 1;
+  }
+
+  void Record(uint64_t value, uint64_t count = 1) {
+    counts_[BucketIndex(value)] += count;
+    total_                      += count;
+    sum_                        += value * count;
+    max_                        = std::max(max_, value);
+  }
+
+  void Merge(LatencyHistogram const& other);
+  void Clear() { *this = LatencyHistogram{}; }
+
+  [[nodiscard]] uint64_t GetCount() const { return total_; }
+  [[nodiscard]] uint64_t GetMax() const { return max_; }
+  [[nodiscard]] uint64_t GetSum() const { return sum_; }
+  [[nodiscard]] double   GetMean() const { return total_ == 0 ? 0 : static_cast<double>(sum_) / total_; }
+
+  /**
+   * @brief Smallest recorded value v such that at least quantile of all values are <= v.
+   *
+   * @param quantile in [0, 1], e.g. 0.99
+   */
+  [[nodiscard]] uint64_t ValueAtQuantile(double quantile) const;
+
+ private:
+  friend struct ShardedLatencyHistogram;
+
+  std::array<uint64_t, kBuckets> counts_{};
+  uint64_t                       total_{0};
+  uint64_t                       sum_{0};
+  uint64_t                       max_{0};
+};
+
+/**
+ * @brief Concurrent histogram: each thread records into its own lazily allocated shard without
+ * locks, shards are merged on demand by Snapshot().
+ *
+ */
+struct ShardedLatencyHistogram : public NonCopyable {
+ public:
+  ShardedLatencyHistogram() = default;
+  ~ShardedLatencyHistogram();
+
+  void Record(uint64_t value) {
+    auto& shard = GetShard();
+    shard.counts[LatencyHistogram::BucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+    shard.sum.fetch_add(value, std::memory_order_relaxed);
+    auto max = shard.max.load(std::memory_order_relaxed);
+    while (value > max && !shard.max.compare_exchange_weak(max, value, std::memory_order_relaxed)) {
+    }
+  }
+
+  void Record(std::chrono::nanoseconds value) { Record(static_cast<uint64_t>(std::max<int64_t>(value.count(), 0))); }
+
+  [[nodiscard]] LatencyHistogram Snapshot() const;
+
+ private:
+  struct Shard {
+    std::array<std::atomic_uint64_t, LatencyHistogram::kBuckets> counts{};
+    std::atomic_uint64_t                                         sum{0};
+    std::atomic_uint64_t                                         max{0};
+  };
+
+  std::array<std::atomic<Shard*>, kMetricShards> shards_{};
+
+  Shard& GetShard();
+};
+
+}  // namespace simple_http::util
@@ -0,0 +1,87 @@
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include <unistd.h>
+
+#include "date_time.hpp"
+#include "log_sink.hpp"
+
+namespace simple_http::util {
+
+void ConsoleSink::Write(std::string_view data) {
+  while (!data.empty()) {
+    auto n = ::write(STDOUT_FILENO, data.data(), data.size());
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return;
+    }
+    data.remove_prefix(n);
+  }
+}
+
+FileSink::FileSink(std::string base_name, std::size_t roll_size, std::chrono::seconds roll_interval)
+    : base_name_(std::move(base_name)), roll_size_(roll_size), roll_interval_(roll_interval) {
+  if (!Roll()) {
+    throw std::runtime_error("Failed to open log file " + file_name_ + ": " + std::strerror(errno));
+  }
+}
+
+FileSink::~FileSink() {
+  if (file_ != nullptr) {
+    std::fclose(file_);
+  }
+}
+
+void FileSink::Write(std::string_view data) {
+  if (written_ >= roll_size_ || std::chrono::steady_clock::now() >= next_roll_) {
+    // Keep writing to the current file if a new one can't be opened.
+    Roll();
+  }
+  written_ += ::fwrite_unlocked(data.data(), 1, data.size(), file_);
+}
+
+void FileSink::Flush() { std::fflush(file_); }
+
+bool FileSink::Roll() {
+  char stamp[DateTime::kFormattedSize];
+  auto len = DateTime::Now().Format(stamp, false);
+  std::string_view time{stamp, len};  // "20230214 12:34:56"
+
+  std::string name = base_name_ + '.';
+  name.append(time.substr(0, 8)).append("-");
+  for (auto c : time.substr(9)) {
+    if (c != ':') {
+      name += c;
+    }
+  }
+  // Rolling again within the same second, e.g. on size during a burst, needs a distinct name.
+  if (name == last_stamp_) {
+    name += '.' + std::to_string(++sequence_);
+  } else {
+    last_stamp_ = name;
+    sequence_   = 0;
+  }
+  name += ".log";
+
+  auto* file = std::fopen(name.c_str(), "ae");
+  next_roll_ = std::chrono::steady_clock::now() + roll_interval_;
+  written_   = 0;
+  if (file == nullptr) {
+    if (file_ == nullptr) {
+      file_name_ = std::move(name);
+    }
+    return false;
+  }
+  if (file_ != nullptr) {
+    std::fclose(file_);
+  }
+  file_      = file;
+  file_name_ = std::move(name);
+  std::setvbuf(file_, buffer_, _IOFBF, sizeof(buffer_));
+  return true;
+}
+
+}  // namespace simple_http::util
@@ -0,0 +1,81 @@
+/**
+ * @file log_sink.hpp
+ * @author Qirui Wang (qirui.wang@moegi.waseda.jp)
+ * @brief Destinations the async logger writes batches to
+ * @version 0.1
+ * @date 2023-02-14
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <string>
+#include <string_view>
+
+#include "non_copyable.hpp"
+
+namespace simple_http::util {
+
+/**
+ * @brief Only called from the logger's backend thread, so implementations may block and need no
+ * locking.
+ *
+ */
+struct LogSink : public NonCopyable {
+ public:
+  virtual ~LogSink() = default;
+
+  virtual void Write(std::string_view data) = 0;
+  virtual void Flush()                      = 0;
+};
+
+/**
+ * @brief Writes to stdout.
+ *
+ */
+struct ConsoleSink final : public LogSink {
+ public:
+  void Write(std::string_view data) override;
+  void Flush() override {}
+};
+
+/**
+ * @brief Writes to base_name.YYYYmmdd-HHMMSS.log, starting a new file once the current one holds
+ * roll_size bytes or is roll_interval old. Files started within the same second get a .N suffix.
+ * Output is buffered and reaches the file on Flush().
+ *
+ */
+struct FileSink final : public LogSink {
+ public:
+  explicit FileSink(std::string base_name, std::size_t roll_size = 64 * 1024 * 1024,
+                    std::chrono::seconds roll_interval = std::chrono::hours(24));
+  ~FileSink() override;
+
+  void Write(std::string_view data) override;
+  void Flush() override;
+
+  [[nodiscard]] std::string const& GetFileName() const { return file_name_; }
+
+ private:
+  static constexpr std::size_t kFileBufferSize = 64 * 1024;
+
+  std::string                           base_name_;
+  std::size_t                           roll_size_;
+  std::chrono::seconds                  roll_interval_;
+  std::string                           file_name_;
+  std::string                           last_stamp_;
+  std::size_t                           sequence_{0};
+  std::FILE*                            file_{nullptr};
+  std::size_t                           written_{0};
+  std::chrono::steady_clock::time_point next_roll_;
+  char                                  buffer_[kFileBufferSize];
+
+  bool Roll();
+};
+
+}  // namespace simple_http::util
@@ -1,10 +1,79 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+
 #include "utils/non_copyable.hpp"
 
 namespace simple_http::util {
+/**
+ * @brief Formats a log line into a fixed inline buffer, never allocates. Output beyond
+ * kBufferSize is truncated.
+ *
+ */
 struct LogStream : public NonCopyable {
  public:
+  static constexpr std::size_t kBufferSize = 4000;
+
+  LogStream& operator<<(std::string_view str) {
+    Append(str.data(), str.size());
+    return *this;
+  }
+  LogStream& operator<<(char const* str) { return *this << std::string_view{str != nullptr ? str : "(null)"}; }
+  LogStream& operator<<(std::string const& str) { return *this << std::string_view{str}; }
+
+  LogStream& operator<<(char c) {
+    Append(&c, 1);
+    return *this;
+  }
+
+  LogStream& operator<<(bool value) { return *this << (value ? std::string_view{"true"} : std::string_view{"false"}); }
+
+  template <typename T>
+    requires std::integral<T> || std::floating_point<T>
+  LogStream& operator<<(T value) {
+    auto [end, ec] = std::to_chars(buffer_.data() + size_, buffer_.data() + buffer_.size(), value);
+    if (ec == std::errc{}) {
+      size_ = end - buffer_.data();
+    }
+    return *this;
+  }
+
+  LogStream& operator<<(void const* ptr) {
+    Append("0x", 2);
+    auto [end, ec] =
+        std::to_chars(Current(), buffer_.data() + buffer_.size(), reinterpret_cast<std::uintptr_t>(ptr), 16);
+    if (ec == std::errc{}) {
+      size_ = end - buffer_.data();
+    }
+    return *this;
+  }
+
+  void Append(char const* data, std::size_t len) {
+    len = std::min(len, buffer_.size() - size_);
+    std::memcpy(buffer_.data() + size_, data, len);
+    size_ += len;
+  }
+
+  // Space left for writing in place, e.g. by DateTime::Format.
+  [[nodiscard]] char*       Current() { return buffer_.data() + size_; }
+  [[nodiscard]] std::size_t Available() const { return buffer_.size() - size_; }
+  void                      Advance(std::size_t len) { size_ += std::min(len, Available()); }
+  void                      Unwind(std::size_t len) { size_ -= std::min(len, size_); }
+
+  [[nodiscard]] std::string_view View() const { return {buffer_.data(), size_}; }
+  [[nodiscard]] std::size_t      Size() const { return size_; }
+  void                           Reset() { size_ = 0; }
+
  private:
+  std::array<char, kBufferSize> buffer_;
+  std::size_t                   size_{0};
 };
-}  // namespace simple_http::util
\ No newline at end of file
+}  // namespace simple_http::util
@@ -0,0 +1,94 @@
+#include <array>
+#include <cerrno>
+#include <iostream>
+
+#include <unistd.h>
+
+#include "date_time.hpp"
+#include "logger.hpp"
+
+namespace simple_http::util {
+
+namespace {
+constexpr std::array<std::string_view, 5> kLevelNames{"DEBUG ", "INFO  ", "WARN  ", "ERROR ", "FATAL "};
+
+void WriteToStdout(std::string_view line) {
+  while (!line.empty()) {
+    auto n = ::write(STDOUT_FILENO, line.data(), line.size());
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return;
+    }
+    line.remove_prefix(n);
+  }
+}
+
+Logger::Output& GetOutput() {
+  static Logger::Output output{WriteToStdout};
+  return output;
+}
+
+int CurrentThreadId() {
+  thread_local int const tid = static_cast<int>(::gettid());
+  return tid;
+}
+
+std::string_view BaseName(std::string_view path) {
+  auto slash = path.rfind('/');
+  return slash == std::string_view::npos ? path : path.substr(slash + 1);
+}
+}  // namespace
+
+Logger::Logger(LogLevel level, std::source_location location) : location_(location), level_(level) {
+  FormatPrefix(level);
+}
+
+Logger::~Logger() {
+  if (level_.has_value()) {
+    Emit();
+  }
+}
+
+void Logger::SetOutput(Output output) { GetOutput() = output ? std::move(output) : Output{WriteToStdout}; }
+
+void Logger::SetTarget(std::ostream& os) {
+  GetTarget().rdbuf(os.rdbuf());
+  SetOutput([](std::string_view line) {
+    GetTarget().write(line.data(), static_cast<std::streamsize>(line.size())).flush();
+  });
+}
+
+std::ostream& Logger::GetTarget() {
+  static std::ostream target{std::cout.rdbuf()};
+  return target;
+}
+
+void Logger::Log(LogLevel level, std::string_view message) {
+  if (level < GetLogLevel()) {
+    return;
+  }
+  stream_.Reset();
+  FormatPrefix(level);
+  stream_ << message;
+  Emit();
+}
+
+void Logger::FormatPrefix(LogLevel level) {
+  if (stream_.Available() >= DateTime::kFormattedSize) {
+    stream_.Advance(DateTime::Now().Format(stream_.Current()));
+  }
+  stream_ << ' ' << kLevelNames[static_cast<std::size_t>(level)] << CurrentThreadId() << ' '
+          << BaseName(location_.file_name()) << ':' << location_.line() << " - ";
+}
+
+void Logger::Emit() {
+  if (stream_.Available() == 0) {
+    stream_.Unwind(1);  // truncated, make room for the line end
+  }
+  stream_ << '\n';
+  GetOutput()(stream_.View());
+}
+
+}  // namespace simple_http::util
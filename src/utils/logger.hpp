@@ -11,12 +11,14 @@
 
 #pragma once
 
-#include <iomanip>
-#include <iostream>
+#include <atomic>
+#include <functional>
+#include <optional>
 #include <ostream>
 #include <source_location>
 #include <string_view>
 
+#include "log_stream.hpp"
 #include "non_copyable.hpp"
 
 namespace simple_http::util {
@@ -29,16 +31,41 @@ enum class LogLevel {
   kFatal,
 };
 
+/**
+ * @brief Formats "20230214 12:34:56.789012 INFO  1234 file.cpp:42 - message" lines and hands
+ * them to the output, by default a write(2) to stdout. Use SetOutput to route them to an
+ * AsyncLogger.
+ *
+ * Either log a whole message, Logger().Info("..."), or stream into a line that is emitted when the
+ * logger is destroyed, LOG_INFO << "..." << 42.
+ *
+ */
 struct Logger : public NonCopyable {
  public:
-  Logger() : location_(std::source_location::current()) {}
+  using Output = std::function<void(std::string_view line)>;
+
+  explicit Logger(std::source_location location = std::source_location::current()) : location_(location) {}
+  explicit Logger(LogLevel level, std::source_location location = std::source_location::current());
   ~Logger();
 
-  static auto const& GetLogLevel() { return log_level; }
-  static auto        SetLogLevel(LogLevel const& level) { log_level = level; }
+  static LogLevel GetLogLevel() { return log_level.load(std::memory_order_relaxed); }
+  static void     SetLogLevel(LogLevel const& level) { log_level.store(level, std::memory_order_relaxed); }
+
+  /**
+   * @brief Replace the output of all loggers, call before logging starts.
+   *
+   */
+  static void SetOutput(Output output);
+
+  /**
+   * @brief Write lines to os, which must outlive logging. Kept for code written before SetOutput,
+   * GetTarget returns a stream writing to the last target, std::cout by default.
+   *
+   */
+  static void          SetTarget(std::ostream& os);
+  static std::ostream& GetTarget();
 
-  static auto& GetTarget() { return target; }
-  static auto  SetTarget(std::ostream& os) { target.rdbuf(os.rdbuf()); }
+  LogStream& Stream() { return stream_; }
 
   void Debug(std::string_view message) { Log(LogLevel::kDebug, message); }
 
@@ -51,15 +78,25 @@ struct Logger : public NonCopyable {
   void Fatal(std::string_view message) { Log(LogLevel::kFatal, message); }
 
  private:
-  inline static LogLevel     log_level{LogLevel::kDebug};
-  inline static std::ostream target{std::cout.rdbuf()};
+  inline static std::atomic<LogLevel> log_level{LogLevel::kInfo};
 
-  std::source_location location_;
+  std::source_location    location_;
+  std::optional<LogLevel> level_;
+  LogStream               stream_;
 
-  void Log(LogLevel level, std::string_view message) {
-    if (level >= log_level) {
-      target << "[" << location_.file_name() << ":" << location_.line() << "] " << message << std::endl;
-    }
-  }
+  void Log(LogLevel level, std::string_view message);
+  void FormatPrefix(LogLevel level);
+  void Emit();
 };
-}  // namespace simple_http::util
\ No newline at end of file
+}  // namespace simple_http::util
+
+#define SIMPLE_HTTP_LOG(level)                                \
+  if (::simple_http::util::Logger::GetLogLevel() > (level)) { \
+  } else                                                      \
+    ::simple_http::util::Logger(level).Stream()
+
+#define LOG_DEBUG   SIMPLE_HTTP_LOG(::simple_http::util::LogLevel::kDebug)
+#define LOG_INFO    SIMPLE_HTTP_LOG(::simple_http::util::LogLevel::kInfo)
+#define LOG_WARNING SIMPLE_HTTP_LOG(::simple_http::util::LogLevel::kWarning)
+#define LOG_ERROR   SIMPLE_HTTP_LOG(::simple_http::util::LogLevel::kError)
+#define LOG_FATAL   SIMPLE_HTTP_LOG(::simple_http::util::LogLevel::kFatal)
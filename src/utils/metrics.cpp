@@ -0,0 +1,236 @@
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+#include "metrics.hpp"
+
+namespace simple_http::util {
+
+namespace {
+std::string FormatLabels(MetricsRegistry::Labels const& labels) {
+  std::string out;
+  for (auto const& [key, value] : labels) {
+    if (!out.empty()) {
+      out += ',';
+    }
+    out += key;
+    out += "=\"";
+    for (auto c : value) {
+      if (c == '\\' || c == '"') {
+        out += '\\';
+        out += c;
+      } else if (c == '\n') {
+        out += "\\n";
+      } else {
+        out += c;
+      }
+    }
+    out += '"';
+  }
+  return out;
+}
+
+void WriteSample(std::ostringstream& out, std::string_view name, std::string_view labels, double value) {
+  out << name;
+  if (!labels.empty()) {
+    out << '{' << labels << '}';
+  }
+  out << ' ';
+  if (std::isinf(value)) {
+    out << (value > 0 ? "+Inf" : "-Inf");
+  } else {
+    out << value;
+  }
+  out << '\n';
+}
+
+std::string_view TypeName(MetricType type) {
+  switch (type) {
+    case MetricType::kCounter:
+      return "counter";
+    case MetricType::kGauge:
+      return "gauge";
+    case MetricType::kHistogram:
+      return "histogram";
+    case MetricType::kSummary:
+      return "summary";
+  }
+  return "untyped";
+}
+
+std::string JoinLabels(std::string_view labels, std::string_view extra) {
+  if (labels.empty()) {
+    return std::string{extra};
+  }
+  return std::string{labels} + "," + std::string{extra};
+}
+}  // namespace
+
+uint64_t Counter::Value() const {
+  uint64_t sum = 0;
+  for (auto const& shard : shards_) {
+    sum += shard.value.load(std::memory_order_relaxed);
+  }
+  return sum;
+}
+
+int64_t Gauge::Value() const {
+  int64_t sum = 0;
+  for (auto const& shard : shards_) {
+    sum += shard.value.load(std::memory_order_relaxed);
+  }
+  return sum;
+}
+
+Histogram::Histogram(std::vector<double> bounds)
+    : bounds_(std::move(bounds)), shards_(std::make_unique<Shard[]>(kMetricShards)) {  // NOLINT
+  if (bounds_.size() > kMaxBuckets) {
+    throw std::invalid_argument("Histogram with more than " + std::to_string(kMaxBuckets) + " buckets");
+  }
+  std::sort(bounds_.begin(), bounds_.end());
+}
+
+void Histogram::Observe(double value) {
+  auto bucket = static_cast<std::size_t>(std::lower_bound(bounds_.begin(), bounds_.end(), value) - bounds_.begin());
+  auto& shard = shards_[CurrentMetricShard()];
+  shard.buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+  shard.sum.fetch_add(value, std::memory_order_relaxed);
+}
+
+Histogram::Snapshot Histogram::Collect() const {
+  Snapshot snapshot;
+  snapshot.bounds = bounds_;
+  snapshot.counts.resize(bounds_.size() + 1);
+  for (std::size_t i = 0; i < kMetricShards; ++i) {
+    auto const& shard = shards_[i];
+    for (std::size_t b = 0; b < snapshot.counts.size(); ++b) {
+      auto n             = shard.buckets[b].load(std::memory_order_relaxed);
+      snapshot.counts[b] += n;
+      snapshot.count     += n;
+    }
+    snapshot.sum += shard.sum.load(std::memory_order_relaxed);
+  }
+  return snapshot;
+}
+
+std::vector<double> Histogram::LatencyBounds() {
+  return {0.0001, 0.00025, 0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10};
+}
+
+MetricsRegistry& MetricsRegistry::Global() {
+  static MetricsRegistry registry;
+  return registry;
+}
+
+MetricsRegistry::Family& MetricsRegistry::GetFamily(std::string_view name, std::string_view help, MetricType type) {
+  auto [it, inserted] = families_.try_emplace(std::string{name});
+  if (inserted) {
+    it->second.help = help;
+    it->second.type = type;
+  }
+  return it->second;
+}
+
+Counter& MetricsRegistry::GetCounter(std::string_view name, std::string_view help, Labels const& labels) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto&                       slot = GetFamily(name, help, MetricType::kCounter).counters[FormatLabels(labels)];
+  if (!slot) {
+    slot = std::make_unique<Counter>();
+  }
+  return *slot;
+}
+
+Gauge& MetricsRegistry::GetGauge(std::string_view name, std::string_view help, Labels const& labels) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto&                       slot = GetFamily(name, help, MetricType::kGauge).gauges[FormatLabels(labels)];
+  if (!slot) {
+    slot = std::make_unique<Gauge>();
+  }
+  return *slot;
+}
+
+Histogram& MetricsRegistry::GetHistogram(std::string_view name, std::string_view help,
+                                         std::vector<double> const& bounds, Labels const& labels) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto&                       slot = GetFamily(name, help, MetricType::kHistogram).histograms[FormatLabels(labels)];
+  if (!slot) {
+    slot = std::make_unique<Histogram>(bounds);
+  }
+  return *slot;
+}
+
+void MetricsRegistry::AddCallback(std::string_view name, std::string_view help, MetricType type,
+                                  std::function<double()> callback, Labels const& labels) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  GetFamily(name, help, type).callbacks[FormatLabels(labels)] = std::move(callback);
+}
+
+void MetricsRegistry::RemoveCallback(std::string_view name, Labels const& labels) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto                        it = families_.find(std::string{name});
+  if (it != families_.end()) {
+    it->second.callbacks.erase(FormatLabels(labels));
+  }
+}
+
+void MetricsRegistry::AddCollector(std::string_view name, std::string_view help, MetricType type, void const* owner,
+                                   std::function<void(SampleWriter const&)> collector) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  GetFamily(name, help, type).collectors[owner] = std::move(collector);
+}
+
+void MetricsRegistry::RemoveCollector(std::string_view name, void const* owner) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto                        it = families_.find(std::string{name});
+  if (it != families_.end()) {
+    it->second.collectors.erase(owner);
+  }
+}
+
+std::string MetricsRegistry::Serialize() const {
+  std::ostringstream out;
+  out.precision(15);
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto const& [name, family] : families_) {
+    out << "# HELP " << name << ' ' << family.help << '\n';
+    out << "# TYPE " << name << ' ' << TypeName(family.type) << '\n';
+
+    for (auto const& [labels, counter] : family.counters) {
+      WriteSample(out, name, labels, static_cast<double>(counter->Value()));
+    }
+    for (auto const& [labels, gauge] : family.gauges) {
+      WriteSample(out, name, labels, static_cast<double>(gauge->Value()));
+    }
+    for (auto const& [labels, callback] : family.callbacks) {
+      WriteSample(out, name, labels, callback());
+    }
+    for (auto const& [labels, histogram] : family.histograms) {
+      auto     snapshot   = histogram->Collect();
+      uint64_t cumulative = 0;
+      for (std::size_t i = 0; i < snapshot.counts.size(); ++i) {
+        cumulative += snapshot.counts[i];
+        std::ostringstream le;
+        le.precision(15);
+        if (i < snapshot.bounds.size()) {
+          le << "le=\"" << snapshot.bounds[i] << '"';
+        } else {
+          le << "le=\"+Inf\"";
+        }
+        WriteSample(out, name + "_bucket", JoinLabels(labels, le.str()), static_cast<double>(cumulative));
+      }
+      WriteSample(out, name + "_sum", labels, snapshot.sum);
+      WriteSample(out, name + "_count", labels, static_cast<double>(snapshot.count));
+    }
+    for (auto const& [owner, collector] : family.collectors) {
+      collector([&out, &name](std::string_view suffix, Labels const& labels, double value) {
+        WriteSample(out, name + std::string{suffix}, FormatLabels(labels), value);
+      });
+    }
+  }
+  return out.str();
+}
+
+}  // namespace simple_http::util
@@ -0,0 +1,165 @@
+/**
+ * @file metrics.hpp
+ * @author Qirui Wang (qirui.wang@moegi.waseda.jp)
+ * @brief Low overhead counters, gauges and histograms exported in Prometheus text format
+ * @version 0.1
+ * @date 2023-02-10
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "non_copyable.hpp"
+
+namespace simple_http::util {
+
+/**
+ * @brief Every metric keeps one slot per shard, each on its own cache line. Threads are spread
+ * over the shards, so an update is a relaxed add on a line no other loop writes to.
+ *
+ */
+inline constexpr std::size_t kMetricShards  = 64;
+inline constexpr std::size_t kCacheLineSize = 64;
+
+inline std::size_t CurrentMetricShard() {
+  static std::atomic_size_t      next_shard{0};
+  thread_local std::size_t const shard = next_shard.fetch_add(1, std::memory_order_relaxed) % kMetricShards;
+  return shard;
+}
+
+enum class MetricType { kCounter, kGauge, kHistogram, kSummary };
+
+struct Counter : public NonCopyable {
+ public:
+  void Increment(uint64_t n = 1) { shards_[CurrentMetricShard()].value.fetch_add(n, std::memory_order_relaxed); }
+
+  [[nodiscard]] uint64_t Value() const;
+
+ private:
+  struct alignas(kCacheLineSize) Shard {
+    std::atomic_uint64_t value{0};
+  };
+  std::array<Shard, kMetricShards> shards_{};
+};
+
+struct Gauge : public NonCopyable {
+ public:
+  void Add(int64_t n) { shards_[CurrentMetricShard()].value.fetch_add(n, std::memory_order_relaxed); }
+  void Sub(int64_t n) { Add(-n); }
+  void Increment() { Add(1); }
+  void Decrement() { Add(-1); }
+
+  [[nodiscard]] int64_t Value() const;
+
+ private:
+  struct alignas(kCacheLineSize) Shard {
+    std::atomic_int64_t value{0};
+  };
+  std::array<Shard, kMetricShards> shards_{};
+};
+
+struct Histogram : public NonCopyable {
+ public:
+  static constexpr std::size_t kMaxBuckets = 24;
+
+  // Upper bounds of at most kMaxBuckets buckets, std::invalid_argument if more. An implicit +Inf bucket follows.
+  explicit Histogram(std::vector<double> bounds);
+
+  void Observe(double value);
+
+  struct Snapshot {
+    std::vector<double>   bounds;
+    std::vector<uint64_t> counts;  // per bucket, not cumulative, the last one is +Inf
+    double                sum{0};
+    uint64_t              count{0};
+  };
+  [[nodiscard]] Snapshot Collect() const;
+
+  // Latency buckets in seconds, from 100us to 10s.
+  static std::vector<double> LatencyBounds();
+
+ private:
+  struct alignas(kCacheLineSize) Shard {
+    std::array<std::atomic_uint64_t, kMaxBuckets + 1> buckets{};
+    std::atomic<double>                               sum{0};
+  };
+
+  std::vector<double>      bounds_;
+  std::unique_ptr<Shard[]> shards_;  // NOLINT
+};
+
+/**
+ * @brief Owns the metrics and renders them on scrape. Registration takes a lock and should happen
+ * once, callers keep the returned reference for the hot path.
+ *
+ */
+struct MetricsRegistry : public NonCopyable {
+ public:
+  using Labels = std::vector<std::pair<std::string, std::string>>;
+
+  static MetricsRegistry& Global();
+
+  Counter&   GetCounter(std::string_view name, std::string_view help, Labels const& labels = {});
+  Gauge&     GetGauge(std::string_view name, std::string_view help, Labels const& labels = {});
+  Histogram& GetHistogram(std::string_view name, std::string_view help, std::vector<double> const& bounds,
+                          Labels const& labels = {});
+
+  /**
+   * @brief Register a value computed on scrape, for state that is already tracked elsewhere.
+   *
+   */
+  void AddCallback(std::string_view name, std::string_view help, MetricType type, std::function<double()> callback,
+                   Labels const& labels = {});
+  void RemoveCallback(std::string_view name, Labels const& labels = {});
+
+  /**
+   * @brief Register a collector that renders the samples of a family itself on scrape, for
+   * metrics whose label set is not known up front. The owner key allows several collectors per
+   * family and is used to remove them again.
+   *
+   */
+  using SampleWriter = std::function<void(std::string_view suffix, Labels const& labels, double value)>;
+  void AddCollector(std::string_view name, std::string_view help, MetricType type, void const* owner,
+                    std::function<void(SampleWriter const&)> collector);
+  void RemoveCollector(std::string_view name, void const* owner);
+
+  /**
+   * @brief Render every metric in the Prometheus text exposition format (version 0.0.4).
+   *
+   */
+  [[nodiscard]] std::string Serialize() const;
+
+ private:
+  struct Family {
+    std::string help;
+    MetricType  type{MetricType::kCounter};
+
+    std::map<std::string, std::unique_ptr<Counter>>   counters;
+    std::map<std::string, std::unique_ptr<Gauge>>     gauges;
+    std::map<std::string, std::unique_ptr<Histogram>> histograms;
+    std::map<std::string, std::function<double()>>    callbacks;
+
+    std::map<void const*, std::function<void(SampleWriter const&)>> collectors;
+  };
+
+  mutable std::mutex            mutex_;
+  std::map<std::string, Family> families_;
+
+  Family& GetFamily(std::string_view name, std::string_view help, MetricType type);
+};
+
+}  // namespace simple_http::util
@@ -25,6 +25,7 @@ void MsgBuffer::Write(MsgBuffer const& other) {
   EnsureSize(other.ReadableSize());
   std::copy(other.buffer_.begin() + ToDiff(other.head_), other.buffer_.begin() + ToDiff(other.tail_),
             buffer_.begin() + ToDiff(tail_));
+  tail_ += other.ReadableSize();
 }
 
 std::span<char const> MsgBuffer::Read(std::size_t size) {
@@ -25,6 +25,7 @@ struct MsgBuffer {
   [[nodiscard]] bool                  Empty() const { return ReadableSize() == 0; }
   [[nodiscard]] char const*           Peek() const { return buffer_.data() + head_; }
   [[nodiscard]] std::span<char const> Data() const { return {Peek(), ReadableSize()}; }
+  [[nodiscard]] char*                 BeginRead() { return Begin() + head_; }  // Peek, to modify in place
   [[nodiscard]] char const*           BeginWrite() const { return Begin() + tail_; }
   [[nodiscard]] char*                 BeginWrite() { return Begin() + tail_; }
 
@@ -0,0 +1,175 @@
+/**
+ * @file perfect_hash.hpp
+ * @author Qirui Wang (qirui.wang@moegi.waseda.jp)
+ * @brief Collision-free string tables built at compile time
+ * @version 0.1
+ * @date 2023-03-02
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <string_view>
+#include <utility>
+
+namespace simple_http::util {
+
+inline constexpr std::array<char, 256> kAsciiLower = [] {
+  std::array<char, 256> table{};
+  for (std::size_t i = 0; i < table.size(); ++i) {
+    table[i] = static_cast<char>(i >= 'A' && i <= 'Z' ? i + ('a' - 'A') : i);
+  }
+  return table;
+}();
+
+constexpr char AsciiLower(char c) { return kAsciiLower[static_cast<unsigned char>(c)]; }
+
+constexpr bool EqualsIgnoreCase(std::string_view a, std::string_view b) {
+  if (a.size() != b.size()) {
+    return false;
+  }
+  for (std::size_t i = 0; i < a.size(); ++i) {
+    if (AsciiLower(a[i]) != AsciiLower(b[i])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief A read-only map from strings to values, laid out at compile time by hash and displace:
+ * the hash of a key picks a bucket, and the displacement found for the bucket sends each of its
+ * keys to a slot of its own. A lookup hashes the key once, reads two small arrays and compares
+ * the one candidate key.
+ *
+ * Building fails to compile on duplicate keys.
+ *
+ */
+template <typename Value, std::size_t N, bool kIgnoreCase = false>
+struct PerfectHashMap {
+ public:
+  using Entry = std::pair<std::string_view, Value>;
+
+  consteval explicit PerfectHashMap(std::array<Entry, N> const& entries) : entries_(entries) { Build(); }
+
+  [[nodiscard]] constexpr Value const* Find(std::string_view key) const {
+    if (key.size() < min_size_ || key.size() > max_size_) {
+      return nullptr;
+    }
+    auto hash  = Hash(key);
+    auto index = slots_[Slot(hash, displacements_[Bucket(hash)])];
+    if (index == kEmpty) {
+      return nullptr;
+    }
+    auto const& entry = entries_[index];
+    return Equals(entry.first, key) ? &entry.second : nullptr;
+  }
+
+  [[nodiscard]] constexpr auto const& GetEntries() const { return entries_; }
+
+ private:
+  static constexpr std::size_t kSlots   = std::bit_ceil(N * 2);
+  static constexpr std::size_t kBuckets = std::bit_ceil(N / 4 + 1);
+  static constexpr uint16_t    kEmpty   = std::numeric_limits<uint16_t>::max();
+  static_assert(N < kEmpty, "too many entries");
+
+  std::array<Entry, N>           entries_;
+  std::array<uint16_t, kSlots>   slots_{};
+  std::array<uint32_t, kBuckets> displacements_{};
+  std::size_t                    min_size_{std::numeric_limits<std::size_t>::max()};
+  std::size_t                    max_size_{0};
+
+  static constexpr uint64_t Hash(std::string_view key) {
+    uint64_t hash = 0xcbf29ce484222325;  // FNV-1a
+    for (auto c : key) {
+      hash ^= static_cast<unsigned char>(kIgnoreCase ? AsciiLower(c) : c);
+      hash *= 0x100000001b3;
+    }
+    return hash;
+  }
+
+  static constexpr std::size_t Bucket(uint64_t hash) { return (hash >> 48) & (kBuckets - 1); }
+
+  static constexpr std::size_t Slot(uint64_t hash, uint32_t displacement) {
+    auto x = hash + displacement * 0x9e3779b97f4a7c15;
+    x      = (x ^ (x >> 31)) * 0xbf58476d1ce4e5b9;
+    return (x ^ (x >> 29)) & (kSlots - 1);
+  }
+
+  static constexpr bool Equals(std::string_view a, std::string_view b) {
+    return kIgnoreCase ? EqualsIgnoreCase(a, b) : a == b;
+  }
+
+  consteval void Build() {
+    slots_.fill(kEmpty);
+    std::array<uint64_t, N>    hashes{};
+    std::array<std::size_t, N> order{};
+    for (std::size_t i = 0; i < N; ++i) {
+      hashes[i] = Hash(entries_[i].first);
+      order[i]  = i;
+      min_size_ = std::min(min_size_, entries_[i].first.size());
+      max_size_ = std::max(max_size_, entries_[i].first.size());
+      for (std::size_t j = 0; j < i; ++j) {
+        if (Equals(entries_[i].first, entries_[j].first)) {
+          throw std::logic_error("duplicate key");
+        }
+      }
+    }
+
+    // Place the fullest buckets first, while most slots are free.
+    std::array<std::size_t, kBuckets> sizes{};
+    for (auto hash : hashes) {
+      ++sizes[Bucket(hash)];
+    }
+    std::sort(order.begin(), order.end(), [&](std::size_t a, std::size_t b) {
+      auto bucket_a = Bucket(hashes[a]);
+      auto bucket_b = Bucket(hashes[b]);
+      return sizes[bucket_a] != sizes[bucket_b] ? sizes[bucket_a] > sizes[bucket_b] : bucket_a < bucket_b;
+    });
+
+    std::size_t begin = 0;
+    while (begin < N) {
+      auto        bucket = Bucket(hashes[order[begin]]);
+      std::size_t end    = begin + sizes[bucket];
+      bool        placed = false;
+      for (uint32_t displacement = 0; !placed && displacement < 1000000; ++displacement) {
+        placed = true;
+        for (std::size_t i = begin; i < end && placed; ++i) {
+          auto slot = Slot(hashes[order[i]], displacement);
+          placed    = slots_[slot] == kEmpty;
+          for (std::size_t j = begin; j < i && placed; ++j) {
+            placed = Slot(hashes[order[j]], displacement) != slot;
+          }
+        }
+        if (placed) {
+          displacements_[bucket] = displacement;
+          for (std::size_t i = begin; i < end; ++i) {
+            slots_[Slot(hashes[order[i]], displacement)] = static_cast<uint16_t>(order[i]);
+          }
+        }
+      }
+      if (!placed) {
+        throw std::logic_error("no displacement places the bucket");
+      }
+      begin = end;
+    }
+  }
+};
+
+// Deduces the map from its entries, e.g. MakePerfectHashMap<int>({{{"a", 1}, {"b", 2}}}).
+template <typename Value, bool kIgnoreCase = false, std::size_t N>
+consteval auto MakePerfectHashMap(std::pair<std::string_view, Value> const (&entries)[N]) {
+  std::array<std::pair<std::string_view, Value>, N> array{};
+  std::copy(std::begin(entries), std::end(entries), array.begin());
+  return PerfectHashMap<Value, N, kIgnoreCase>(array);
+}
+}  // namespace simple_http::util
@@ -0,0 +1,88 @@
+#include <bit>
+#include <cstring>
+
+#include "sha1.hpp"
+
+namespace simple_http::util {
+
+namespace {
+uint32_t LoadBigEndian(unsigned char const* p) {
+  return (uint32_t{p[0]} << 24) | (uint32_t{p[1]} << 16) | (uint32_t{p[2]} << 8) | uint32_t{p[3]};
+}
+
+void Compress(std::array<uint32_t, 5>& state, unsigned char const* block) {
+  std::array<uint32_t, 80> w{};
+  for (int i = 0; i < 16; ++i) {
+    w[i] = LoadBigEndian(block + 4 * i);
+  }
+  for (int i = 16; i < 80; ++i) {
+    w[i] = std::rotl(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+  }
+
+  auto [a, b, c, d, e] = state;
+  for (int i = 0; i < 80; ++i) {
+    uint32_t f = 0;
+    uint32_t k = 0;
+    if (i < 20) {
+      f = (b & c) | (~b & d);
+      k = 0x5a827999;
+    } else if (i < 40) {
+      f = b ^ c ^ d;
+      k = 0x6ed9eba1;
+    } else if (i < 60) {
+      f = (b & c) | (b & d) | (c & d);
+      k = 0x8f1bbcdc;
+    } else {
+      f = b ^ c ^ d;
+      k = 0xca62c1d6;
+    }
+    uint32_t temp = std::rotl(a, 5) + f + e + k + w[i];
+    e             = d;
+    d             = c;
+    c             = std::rotl(b, 30);
+    b             = a;
+    a             = temp;
+  }
+  state[0] += a;
+  state[1] += b;
+  state[2] += c;
+  state[3] += d;
+  state[4] += e;
+}
+}  // namespace
+
+std::array<uint8_t, 20> Sha1(std::string_view data) {
+  std::array<uint32_t, 5> state{0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0};
+
+  auto const* bytes = reinterpret_cast<unsigned char const*>(data.data());
+  std::size_t size  = data.size();
+  std::size_t i     = 0;
+  for (; i + 64 <= size; i += 64) {
+    Compress(state, bytes + i);
+  }
+
+  // The rest, a one bit, zeros and the length in bits fill one or two more blocks.
+  std::array<unsigned char, 128> tail{};
+  std::size_t                    rest = size - i;
+  std::memcpy(tail.data(), bytes + i, rest);
+  tail[rest]         = 0x80;
+  std::size_t blocks = rest + 9 <= 64 ? 1 : 2;
+  uint64_t    bits   = static_cast<uint64_t>(size) * 8;
+  for (int j = 0; j < 8; ++j) {
+    tail[blocks * 64 - 1 - j] = static_cast<unsigned char>(bits >> (8 * j));
+  }
+  for (std::size_t j = 0; j < blocks; ++j) {
+    Compress(state, tail.data() + j * 64);
+  }
+
+  std::array<uint8_t, 20> digest{};
+  for (int j = 0; j < 5; ++j) {
+    digest[4 * j]     = static_cast<uint8_t>(state[j] >> 24);
+    digest[4 * j + 1] = static_cast<uint8_t>(state[j] >> 16);
+    digest[4 * j + 2] = static_cast<uint8_t>(state[j] >> 8);
+    digest[4 * j + 3] = static_cast<uint8_t>(state[j]);
+  }
+  return digest;
+}
+
+}  // namespace simple_http::util
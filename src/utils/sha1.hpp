@@ -0,0 +1,12 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string_view>
+
+namespace simple_http::util {
+
+// SHA-1 digest (RFC 3174). Only for protocols that require it, such as the WebSocket handshake.
+std::array<uint8_t, 20> Sha1(std::string_view data);
+
+}  // namespace simple_http::util
@@ -0,0 +1,207 @@
+#include <algorithm>
+#include <bit>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "shm_ring.hpp"
+
+namespace simple_http::util {
+
+namespace {
+constexpr std::size_t kRecordHeaderSize = 16;
+constexpr std::size_t kMinCapacity      = 64 * 1024;
+
+constexpr uint64_t Align8(uint64_t value) { return (value + 7) & ~uint64_t{7}; }
+
+std::runtime_error SystemError(std::string const& what, std::string const& path) {
+  return std::runtime_error(what + " " + path + ": " + std::strerror(errno));
+}
+
+uint64_t& WordAt(char* data, std::size_t capacity, uint64_t position) {
+  return *reinterpret_cast<uint64_t*>(data + (position & (capacity - 1)));  // NOLINT
+}
+}  // namespace
+
+ShmRingWriter::ShmRingWriter(std::string const& path, std::size_t capacity)
+    : capacity_(std::bit_ceil(std::max(capacity, kMinCapacity))), map_size_(ShmRingHeader::kHeaderSize + capacity_) {
+  int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    throw SystemError("Failed to open ring", path);
+  }
+  struct stat st {};
+  ::fstat(fd, &st);
+  bool same_size = static_cast<std::size_t>(st.st_size) == map_size_;
+  if (!same_size && ::ftruncate(fd, static_cast<off_t>(map_size_)) < 0) {
+    ::close(fd);
+    throw SystemError("Failed to resize ring", path);
+  }
+  map_ = ::mmap(nullptr, map_size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (map_ == MAP_FAILED) {
+    throw SystemError("Failed to map ring", path);
+  }
+  header_ = static_cast<ShmRingHeader*>(map_);
+  data_   = static_cast<char*>(map_) + ShmRingHeader::kHeaderSize;
+
+  // Keep the records of a previous run if the layout matches, start over otherwise.
+  bool valid = same_size && std::memcmp(header_->magic, ShmRingHeader::kMagic, sizeof(header_->magic)) == 0 &&
+               header_->version == ShmRingHeader::kVersion && header_->header_size == ShmRingHeader::kHeaderSize &&
+               header_->capacity == capacity_;
+  if (!valid) {
+    std::memset(map_, 0, map_size_);
+    header_->version     = ShmRingHeader::kVersion;
+    header_->header_size = ShmRingHeader::kHeaderSize;
+    header_->capacity    = capacity_;
+    header_->write_cursor.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    std::memcpy(header_->magic, ShmRingHeader::kMagic, sizeof(header_->magic));
+  }
+}
+
+ShmRingWriter::~ShmRingWriter() {
+  if (map_ != nullptr) {
+    ::munmap(map_, map_size_);
+  }
+}
+
+void ShmRingWriter::Append(uint32_t channel, std::string_view payload) {
+  auto const max_payload = capacity_ / 4 - kRecordHeaderSize;
+  do {
+    auto chunk = payload.substr(0, max_payload);
+    AppendRecord(channel, chunk);
+    payload.remove_prefix(chunk.size());
+  } while (!payload.empty());
+}
+
+void ShmRingWriter::AppendRecord(uint32_t channel, std::string_view payload) {
+  auto total    = kRecordHeaderSize + Align8(payload.size());
+  auto position = header_->write_cursor.fetch_add(total, std::memory_order_relaxed);
+
+  WordAt(data_, capacity_, position + 8) = (uint64_t{channel} << 32) | payload.size();
+
+  auto offset = (position + kRecordHeaderSize) & (capacity_ - 1);
+  auto first  = std::min(payload.size(), capacity_ - offset);
+  std::memcpy(data_ + offset, payload.data(), first);
+  std::memcpy(data_, payload.data() + first, payload.size() - first);
+
+  std::atomic_ref<uint64_t>(WordAt(data_, capacity_, position)).store(position + 1, std::memory_order_release);
+}
+
+ShmRingReader::ShmRingReader(std::string const& path, bool from_oldest) {
+  int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    throw SystemError("Failed to open ring", path);
+  }
+  struct stat st {};
+  ::fstat(fd, &st);
+  map_size_ = static_cast<std::size_t>(st.st_size);
+  map_      = map_size_ > ShmRingHeader::kHeaderSize ? ::mmap(nullptr, map_size_, PROT_READ, MAP_SHARED, fd, 0)
+                                                     : MAP_FAILED;
+  ::close(fd);
+  if (map_ == MAP_FAILED) {
+    map_ = nullptr;
+    throw std::runtime_error("Not a ring file: " + path);
+  }
+  header_ = static_cast<ShmRingHeader const*>(map_);
+  data_   = static_cast<char const*>(map_) + ShmRingHeader::kHeaderSize;
+
+  capacity_ = header_->capacity;
+  if (std::memcmp(header_->magic, ShmRingHeader::kMagic, sizeof(header_->magic)) != 0 ||
+      header_->version != ShmRingHeader::kVersion || header_->header_size != ShmRingHeader::kHeaderSize ||
+      !std::has_single_bit(capacity_) || ShmRingHeader::kHeaderSize + capacity_ != map_size_) {
+    ::munmap(const_cast<void*>(map_), map_size_);
+    map_ = nullptr;
+    throw std::runtime_error("Not a ring file: " + path);
+  }
+
+  auto write = WriteCursor();
+  if (!from_oldest) {
+    cursor_ = write;
+  } else if (write > capacity_) {
+    Resync(write - capacity_);
+    lost_ = 0;
+  }
+}
+
+ShmRingReader::~ShmRingReader() {
+  if (map_ != nullptr) {
+    ::munmap(const_cast<void*>(map_), map_size_);
+  }
+}
+
+uint64_t ShmRingReader::WriteCursor() const { return header_->write_cursor.load(std::memory_order_acquire); }
+
+uint64_t ShmRingReader::LoadWord(uint64_t position, std::memory_order order) const {
+  // The mapping is read only, an atomic load never writes.
+  auto& word = WordAt(const_cast<char*>(data_), capacity_, position);  // NOLINT
+  return std::atomic_ref<uint64_t>(word).load(order);
+}
+
+void ShmRingReader::Resync(uint64_t from) {
+  auto write    = WriteCursor();
+  auto position = Align8(std::max(from, write > capacity_ ? write - capacity_ : 0));
+  while (position < write && LoadWord(position, std::memory_order_acquire) != position + 1) {
+    position += 8;
+  }
+  lost_          += position - std::min(position, cursor_);
+  cursor_        = position;
+  pending_since_ = {};
+}
+
+bool ShmRingReader::Next(ShmRingRecord& record) {
+  while (true) {
+    auto write = WriteCursor();
+    if (write - cursor_ > capacity_) {
+      Resync(cursor_);  // fell a lap behind
+      continue;
+    }
+    if (cursor_ >= write) {
+      return false;
+    }
+
+    if (LoadWord(cursor_, std::memory_order_acquire) != cursor_ + 1) {
+      // Reserved but not committed yet. Give the writer some time before giving up on it.
+      auto now = std::chrono::steady_clock::now();
+      if (pending_since_ == std::chrono::steady_clock::time_point{}) {
+        pending_since_ = now;
+      } else if (now - pending_since_ > pending_timeout_) {
+        Resync(cursor_ + 8);
+        continue;
+      }
+      return false;
+    }
+    pending_since_ = {};
+
+    auto meta    = LoadWord(cursor_ + 8, std::memory_order_relaxed);
+    auto size    = static_cast<std::size_t>(meta & 0xffffffff);
+    auto channel = static_cast<uint32_t>(meta >> 32);
+    if (size > capacity_ / 4) {
+      Resync(cursor_ + 8);
+      continue;
+    }
+
+    payload_.resize(size);
+    auto offset = (cursor_ + kRecordHeaderSize) & (capacity_ - 1);
+    auto first  = std::min(size, capacity_ - offset);
+    std::memcpy(payload_.data(), data_ + offset, first);
+    std::memcpy(payload_.data() + first, data_, size - first);
+
+    // A writer a lap ahead may have overwritten the record while it was copied.
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (WriteCursor() - cursor_ > capacity_) {
+      continue;
+    }
+
+    record  = {cursor_, channel, payload_};
+    cursor_ += kRecordHeaderSize + Align8(size);
+    return true;
+  }
+}
+
+}  // namespace simple_http::util
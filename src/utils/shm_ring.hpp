@@ -0,0 +1,141 @@
+/**
+ * @file shm_ring.hpp
+ * @author Qirui Wang (qirui.wang@moegi.waseda.jp)
+ * @brief Memory-mapped ring buffer file for shipping log records to another process
+ * @version 0.1
+ * @date 2023-02-16
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "log_sink.hpp"
+#include "non_copyable.hpp"
+
+namespace simple_http::util {
+
+/**
+ * @brief Layout of the file: this header on its own page, followed by capacity bytes of records.
+ *
+ * A record starts on an 8 byte boundary with two words, the commit stamp and the payload size and
+ * channel, followed by the payload padded to 8 bytes. Positions only grow and are taken modulo
+ * capacity, so records may wrap around the end of the data area. Writers reserve space with a
+ * fetch_add on write_cursor, copy the record and then store position + 1 as its commit stamp.
+ * Writers never wait for readers, a slow reader loses the records that were overwritten.
+ *
+ */
+struct ShmRingHeader {
+  static constexpr char        kMagic[8]   = {'S', 'H', 'T', 'P', 'R', 'I', 'N', 'G'};
+  static constexpr uint32_t    kVersion    = 1;
+  static constexpr std::size_t kHeaderSize = 4096;
+
+  char                 magic[8];
+  uint32_t             version;
+  uint32_t             header_size;
+  uint64_t             capacity;
+  std::atomic_uint64_t write_cursor;
+};
+
+struct ShmRingRecord {
+  uint64_t         position{0};
+  uint32_t         channel{0};
+  std::string_view payload;  // valid until the next call to ShmRingReader::Next
+};
+
+/**
+ * @brief Maps a ring file and appends records to it. Any number of writers, in this or other
+ * processes, may share a file.
+ *
+ */
+struct ShmRingWriter : public NonCopyable {
+ public:
+  /**
+   * @brief Open the ring at path, creating it with the given capacity if it does not exist or has
+   * another layout. Put it on a tmpfs such as /dev/shm so that the kernel never writes it back.
+   *
+   */
+  ShmRingWriter(std::string const& path, std::size_t capacity);
+  ~ShmRingWriter();
+
+  // Payloads larger than a quarter of the capacity are split over several records.
+  void Append(uint32_t channel, std::string_view payload);
+
+  [[nodiscard]] std::size_t GetCapacity() const { return capacity_; }
+
+ private:
+  std::size_t    capacity_;
+  std::size_t    map_size_;
+  void*          map_{nullptr};
+  ShmRingHeader* header_{nullptr};
+  char*          data_{nullptr};
+
+  void AppendRecord(uint32_t channel, std::string_view payload);
+};
+
+/**
+ * @brief Reads the records of a ring file in order, from another process. Never writes to the file.
+ *
+ */
+struct ShmRingReader : public NonCopyable {
+ public:
+  // Start at the oldest record still in the ring, or only read records appended from now on.
+  explicit ShmRingReader(std::string const& path, bool from_oldest = true);
+  ~ShmRingReader();
+
+  /**
+   * @brief Read the next complete record. Returns false if there is none yet. A record reserved
+   * but not committed within pending_timeout, e.g. because its writer died, is skipped.
+   *
+   */
+  bool Next(ShmRingRecord& record);
+
+  // Bytes skipped because writers overwrote them before they were read.
+  [[nodiscard]] uint64_t GetLost() const { return lost_; }
+
+  void SetPendingTimeout(std::chrono::milliseconds timeout) { pending_timeout_ = timeout; }
+
+ private:
+  std::size_t                           capacity_{0};
+  std::size_t                           map_size_{0};
+  void const*                           map_{nullptr};
+  ShmRingHeader const*                  header_{nullptr};
+  char const*                           data_{nullptr};
+  uint64_t                              cursor_{0};
+  uint64_t                              lost_{0};
+  std::string                           payload_;
+  std::chrono::milliseconds             pending_timeout_{1000};
+  std::chrono::steady_clock::time_point pending_since_{};
+
+  [[nodiscard]] uint64_t WriteCursor() const;
+  [[nodiscard]] uint64_t LoadWord(uint64_t position, std::memory_order order) const;
+  void                   Resync(uint64_t from);
+};
+
+/**
+ * @brief LogSink that appends every batch to a ring file on the given channel, so that the log and
+ * the access log can share a ring and still be told apart. Costs no system calls.
+ *
+ */
+struct ShmRingSink final : public LogSink {
+ public:
+  ShmRingSink(std::string const& path, std::size_t capacity, uint32_t channel = 0)
+      : writer_(path, capacity), channel_(channel) {}
+
+  void Write(std::string_view data) override { writer_.Append(channel_, data); }
+  void Flush() override {}
+
+ private:
+  ShmRingWriter writer_;
+  uint32_t      channel_;
+};
+
+}  // namespace simple_http::util
@@ -1,11 +1,13 @@
 target("simple_http_shared")
   set_kind("shared")
   set_basename("simple_http_$(mode)_$(arch)")
+  add_syslinks("z")
 
   add_files("**.cpp")
 
 target("simple_http_static")
   set_kind("static")
   set_basename("simple_http_$(mode)_$(arch)")
+  add_syslinks("z", {public = true})
 
   add_files("**.cpp")
@@ -0,0 +1,107 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "test.hpp"
+
+#include "net/http/access_log.hpp"
+
+namespace {
+using namespace simple_http;
+
+struct StringSink final : public util::LogSink {
+ public:
+  explicit StringSink(std::string& out) : out_(out) {}
+  void Write(std::string_view data) override { out_ += data; }
+  void Flush() override {}
+
+ private:
+  std::string& out_;
+};
+
+// The line without the time, which depends on when the request was logged.
+std::string WithoutTime(std::string const& line) {
+  auto open  = line.find(" [");
+  auto close = line.find("] ");
+  if (open == std::string::npos || close == std::string::npos) {
+    return line;
+  }
+  return line.substr(0, open) + line.substr(close + 1);
+}
+
+bool HasTime(std::string const& line) {
+  // e.g. "[14/Feb/2023:12:24:56 +0000]"
+  auto open = line.find(" [");
+  return open != std::string::npos && line.size() > open + 29 && line[open + 4] == '/' && line[open + 8] == '/' &&
+         line[open + 13] == ':' && line.compare(open + 22, 7, " +0000]") == 0;
+}
+}  // namespace
+
+int main(int argc, char* const argv[]) {
+  using namespace simple_http::net;
+  using namespace simple_http::net::http;
+
+  HttpRequest get;
+  get.SetMethod(Method::kGet);
+  get.SetVersion(Version::kHttp11);
+  get.SetPath("/index.html");
+  get.SetHeader(HeaderId::kReferer, "http://example.com/");
+  get.SetHeader(HeaderId::kUserAgent, "curl \"8\"\x01");
+
+  HttpRequest post;
+  post.SetMethod(Method::kPost);
+  post.SetVersion(Version::kHttp10);
+  post.SetPath("/submit");
+
+  InetAddr peer{"10.0.0.1", 1234};
+
+  std::string combined;
+  {
+    AccessLog log{std::make_unique<StringSink>(combined)};
+    log.Start();
+    log.Record(peer, get, StatusCode::k200Ok, 512, std::chrono::microseconds(1500));
+    log.Record(peer, post, StatusCode::k404NotFound, 0, std::chrono::microseconds(7));
+    log.Stop();
+  }
+  auto first = combined.substr(0, combined.find('\n'));
+  auto rest  = combined.substr(first.size() + 1);
+  Equals(HasTime(first), true);
+  Equals(WithoutTime(first),
+         std::string{"10.0.0.1 - - \"GET /index.html HTTP/1.1\" 200 512 \"http://example.com/\" \"curl \\\"8\\\"\\x01\" "
+                     "1500"});
+  Equals(WithoutTime(rest), std::string{"10.0.0.1 - - \"POST /submit HTTP/1.0\" 404 - \"-\" \"-\" 7\n"});
+
+  std::string common;
+  {
+    AccessLog log{std::make_unique<StringSink>(common), {.format = AccessLogFormat::kCommon}};
+    log.Start();
+    log.Record(peer, get, StatusCode::k200Ok, 512, std::chrono::microseconds(1500));
+    log.Stop();
+  }
+  Equals(WithoutTime(common), std::string{"10.0.0.1 - - \"GET /index.html HTTP/1.1\" 200 512 1500\n"});
+
+  // A full ring drops instead of blocking.
+  std::string dropped;
+  {
+    AccessLog log{std::make_unique<StringSink>(dropped), {.ring_slots = 2}};
+    for (int i = 0; i < 3; ++i) {
+      log.Record(peer, post, StatusCode::k200Ok, 1, std::chrono::microseconds(1));
+    }
+    Equals(log.GetDropped(), uint64_t{1});
+  }
+  Equals(static_cast<int>(std::count(dropped.begin(), dropped.end(), '\n')), 2);
+
+  auto [pass, total] = GetTestInfo();
+
+  if (pass != total) {
+    std::cout << "Passed " << pass << " out of " << total << " tests." << std::endl;
+  } else {
+    std::cout << "All tests passed!" << std::endl;
+  }
+
+  return 0;
+}
@@ -0,0 +1,62 @@
+#include <chrono>
+#include <iostream>
+
+#include "test.hpp"
+
+#include "net/admission_controller.hpp"
+
+int main(int argc, char* const argv[]) {
+  using namespace simple_http::net;
+  using namespace std::chrono_literals;
+
+  auto const target   = std::chrono::duration_cast<Clock::duration>(5ms);
+  auto const interval = std::chrono::duration_cast<Clock::duration>(100ms);
+  auto const now      = Clock::now();
+
+  CoDel codel;
+
+  // Below target never drops.
+  Equals(codel.ShouldDrop(now, 1ms, target, interval), false);
+
+  // Above target, but not yet for a whole interval.
+  Equals(codel.ShouldDrop(now, 10ms, target, interval), false);
+  Equals(codel.ShouldDrop(now + 50ms, 10ms, target, interval), false);
+  Equals(codel.IsDropping(), false);
+
+  // Persistently above target: start dropping, then space drops by the control law.
+  Equals(codel.ShouldDrop(now + 101ms, 10ms, target, interval), true);
+  Equals(codel.IsDropping(), true);
+  Equals(codel.ShouldDrop(now + 102ms, 10ms, target, interval), false);
+  Equals(codel.ShouldDrop(now + 202ms, 10ms, target, interval), true);
+
+  // Recovery resets the state.
+  Equals(codel.ShouldDrop(now + 203ms, 1ms, target, interval), false);
+  Equals(codel.IsDropping(), false);
+
+  AdmissionOptions options;
+  options.max_connections          = 2;
+  options.max_connections_per_loop = 1;
+  options.max_inflight_requests    = 1;
+  AdmissionController admission{options};
+
+  Equals(admission.AdmitConnection(0, 0, 0ms), true);
+  Equals(admission.AdmitConnection(1, 1, 0ms), false);
+  Equals(admission.AdmitConnection(2, 0, 0ms), false);
+  Equals(admission.GetShedConnections(), 2U);
+
+  Equals(admission.TryAcquireRequest(0ms), true);
+  Equals(admission.TryAcquireRequest(0ms), false);
+  admission.ReleaseRequest();
+  Equals(admission.TryAcquireRequest(0ms), true);
+  Equals(admission.GetShedRequests(), 1U);
+
+  auto [pass, total] = GetTestInfo();
+
+  if (pass != total) {
+    std::cout << "Passed " << pass << " out of " << total << " tests." << std::endl;
+  } else {
+    std::cout << "All tests passed!" << std::endl;
+  }
+
+  return 0;
+}
@@ -0,0 +1,112 @@
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "test.hpp"
+
+#include "net/http/byte_range.hpp"
+#include "net/http/conditional.hpp"
+#include "net/http/http_date.hpp"
+
+int main(int argc, char* const argv[]) {
+  using namespace simple_http::net::http;
+
+  std::vector<ByteRange> ranges;
+  auto                   parse = [&](std::string_view field, std::size_t size) {
+    return static_cast<int>(ParseRange(field, size, ranges));
+  };
+  auto constexpr kIgnored       = static_cast<int>(RangeResult::kIgnored);
+  auto constexpr kSatisfiable   = static_cast<int>(RangeResult::kSatisfiable);
+  auto constexpr kUnsatisfiable = static_cast<int>(RangeResult::kUnsatisfiable);
+
+  // RFC 9110 14.1.2
+  Equals(parse("bytes=0-499", 10000), kSatisfiable);
+  Equals(ranges.size(), 1U);
+  Equals(ranges[0].first, 0U);
+  Equals(ranges[0].GetLength(), 500U);
+  Equals(parse("bytes=-500", 10000), kSatisfiable);
+  Equals(ranges[0].first, 9500U);
+  Equals(ranges[0].last, 9999U);
+  Equals(parse("bytes=9500-", 10000), kSatisfiable);
+  Equals(ranges[0].last, 9999U);
+  Equals(parse("bytes=500-600,601-999", 10000), kSatisfiable);
+  Equals(ranges.size(), 1U);  // adjacent, merged
+  Equals(ranges[0].last, 999U);
+  Equals(parse("bytes= 9000-9099 , 0-99,", 10000), kSatisfiable);
+  Equals(ranges.size(), 2U);
+  Equals(ranges[0].first, 0U);
+  Equals(ranges[1].first, 9000U);
+
+  // Clipped to the representation.
+  Equals(parse("bytes=9990-20000", 10000), kSatisfiable);
+  Equals(ranges[0].last, 9999U);
+  Equals(parse("bytes=-20000", 10000), kSatisfiable);
+  Equals(ranges[0].first, 0U);
+  Equals(parse("bytes=0-99999999999999999999999", 10), kSatisfiable);
+  Equals(ranges[0].last, 9U);
+
+  Equals(parse("bytes=10000-", 10000), kUnsatisfiable);
+  Equals(parse("bytes=-0", 10000), kUnsatisfiable);
+  Equals(parse("bytes=0-", 0), kUnsatisfiable);
+  Equals(parse("bytes=20000-,0-5", 10000), kSatisfiable);
+
+  Equals(parse("items=0-5", 10000), kIgnored);
+  Equals(parse("bytes=5-1", 10000), kIgnored);
+  Equals(parse("bytes=a-b", 10000), kIgnored);
+  Equals(parse("bytes=5", 10000), kIgnored);
+  Equals(parse("bytes=", 10000), kIgnored);
+  std::string many = "bytes=0-0";
+  for (int i = 1; i <= 16; ++i) {
+    many += "," + std::to_string(i * 2) + "-" + std::to_string(i * 2);
+  }
+  Equals(parse(many, 10000), kIgnored);
+
+  // RFC 9110 5.6.7
+  Equals(FormatHttpDate(784111777), std::string("Sun, 06 Nov 1994 08:49:37 GMT"));
+  Equals(ParseHttpDate("Sun, 06 Nov 1994 08:49:37 GMT").value_or(0), 784111777L);
+  Equals(ParseHttpDate("Sunday, 06-Nov-94 08:49:37 GMT").value_or(0), 784111777L);
+  Equals(ParseHttpDate("Sun Nov  6 08:49:37 1994").value_or(0), 784111777L);
+  Equals(ParseHttpDate("\"an-etag\"").has_value(), false);
+
+  // RFC 9110 13.1.2 and 13.1.3, If-None-Match takes precedence over If-Modified-Since.
+  HttpRequest req;
+  req.SetMethod(Method::kGet);
+  auto etag = MakeETag("v1");
+  Equals(etag, std::string("\"v1\""));
+  Equals(IsNotModified(req, etag, 784111777), false);
+  req.SetHeaders({{"If-None-Match", "\"v0\", W/\"v1\""}});
+  Equals(IsNotModified(req, etag, 784111777), true);
+  req.SetHeaders({{"If-None-Match", "*"}});
+  Equals(IsNotModified(req, etag, 784111777), true);
+  req.SetHeaders({{"If-None-Match", "\"v0\""}, {"If-Modified-Since", "Sun, 06 Nov 1994 08:49:37 GMT"}});
+  Equals(IsNotModified(req, etag, 784111777), false);
+  req.SetHeaders({{"If-Modified-Since", "Sun, 06 Nov 1994 08:49:37 GMT"}});
+  Equals(IsNotModified(req, etag, 784111777), true);
+  Equals(IsNotModified(req, etag, 784111778), false);
+  req.SetHeaders({{"If-Range", "W/\"v1\""}});
+  Equals(IfRangeMatches(req, MakeETag("v1", true), 0), false);  // weak tags never match
+  req.SetHeaders({{"If-Range", "\"v1\""}});
+  Equals(IfRangeMatches(req, etag, 0), true);
+
+  HttpResponse resp(false);
+  resp.SetStatusCode(StatusCode::k200Ok);
+  resp.SetHeader("ETag", etag);
+  resp.SetHeader("Content-Type", "text/plain");
+  resp.SetBody("body");
+  req.SetHeaders({{"If-None-Match", etag}});
+  Equals(AnswerNotModified(req, resp), true);
+  Equals(static_cast<int>(resp.GetStatusCode()), 304);
+  Equals(resp.GetBodySize(), 0U);
+  Equals(resp.GetHeader("ETag"), std::string_view{etag});
+  Equals(resp.GetHeader("Content-Type").empty(), true);
+
+  auto [pass, total] = GetTestInfo();
+
+  if (pass != total) {
+    std::cout << "Passed " << pass << " out of " << total << " tests." << std::endl;
+  } else {
+    std::cout << "All tests passed!" << std::endl;
+  }
+
+  return 0;
+}
@@ -0,0 +1,102 @@
+#include <zlib.h>
+
+#include <iostream>
+#include <string>
+#include <string_view>
+
+#include "test.hpp"
+
+#include "net/http/compression.hpp"
+
+namespace {
+using namespace simple_http::net::http;
+
+// Inflate a gzip or zlib stream, empty if it is not one.
+std::string Inflate(std::string_view input, int window_bits) {
+  z_stream stream{};
+  if (::inflateInit2(&stream, window_bits) != Z_OK) {
+    return {};
+  }
+  std::string output;
+  char        buf[4096];
+  stream.next_in  = reinterpret_cast<Bytef*>(const_cast<char*>(input.data()));  // NOLINT
+  stream.avail_in = static_cast<uInt>(input.size());
+  int ret         = Z_OK;
+  while (ret == Z_OK) {
+    stream.next_out  = reinterpret_cast<Bytef*>(buf);  // NOLINT
+    stream.avail_out = sizeof(buf);
+    ret              = ::inflate(&stream, Z_NO_FLUSH);
+    output.append(buf, sizeof(buf) - stream.avail_out);
+  }
+  ::inflateEnd(&stream);
+  return ret == Z_STREAM_END ? output : std::string{};
+}
+
+int Negotiate(std::string_view accept_encoding) { return static_cast<int>(NegotiateEncoding(accept_encoding)); }
+}  // namespace
+
+int main(int argc, char* const argv[]) {
+  auto const identity = static_cast<int>(ContentCoding::kIdentity);
+  auto const gzip     = static_cast<int>(ContentCoding::kGzip);
+  auto const deflate  = static_cast<int>(ContentCoding::kDeflate);
+
+  Equals(Negotiate(""), identity);
+  Equals(Negotiate("gzip"), gzip);
+  Equals(Negotiate("x-gzip"), gzip);
+  Equals(Negotiate("GZIP"), gzip);
+  Equals(Negotiate("deflate"), deflate);
+  Equals(Negotiate("br"), identity);
+  Equals(Negotiate("deflate, gzip"), gzip);  // equally acceptable
+  Equals(Negotiate(" deflate ;q=0.9 , gzip;q=0.5"), deflate);
+  Equals(Negotiate("gzip;Q=0.5, deflate;q=0.6"), deflate);
+  Equals(Negotiate("gzip;q=0"), identity);
+  Equals(Negotiate("gzip;q=0, deflate"), deflate);
+  Equals(Negotiate("gzip;q=x"), identity);  // a q-value that is no number
+  Equals(Negotiate("gzip;level=1"), gzip);  // parameters other than q
+  Equals(Negotiate("*"), gzip);
+  Equals(Negotiate("*;q=0"), identity);
+  Equals(Negotiate("gzip;q=0, *"), deflate);  // listed codings are not covered by "*"
+  Equals(Negotiate("deflate;q=0.5, *;q=0.8"), gzip);
+
+  Equals(IsCompressible("text/html; charset=utf-8"), true);
+  Equals(IsCompressible("application/json"), true);
+  Equals(IsCompressible("image/svg+xml"), true);
+  Equals(IsCompressible(""), false);
+  Equals(IsCompressible("image/png"), false);
+  Equals(IsCompressible("video/mp4"), false);
+  Equals(IsCompressible("audio/ogg"), false);
+  Equals(IsCompressible("application/zip"), false);
+  Equals(IsCompressible("Application/GZIP"), false);
+  Equals(IsCompressible(" application/octet-stream ;x=1"), false);
+
+  std::string input;
+  for (int i = 0; i < 1000; ++i) {
+    input += "line " + std::to_string(i) + " of a body that compresses well\n";
+  }
+  auto&       compressor = Compressor::ForThisThread();
+  std::string output{"previous contents"};
+  Equals(compressor.Compress(ContentCoding::kGzip, 6, input, output), true);
+  Equals(output.size() < input.size(), true);
+  Equals(Inflate(output, 15 + 16) == input, true);
+  Equals(Inflate(output, 15).empty(), true);  // gzip framing, not zlib
+
+  // The state is reused, for other levels and bodies too.
+  Equals(compressor.Compress(ContentCoding::kGzip, 1, "short", output), true);
+  Equals(Inflate(output, 15 + 16), std::string("short"));
+  Equals(compressor.Compress(ContentCoding::kDeflate, 9, input, output), true);
+  Equals(Inflate(output, 15) == input, true);
+  Equals(compressor.Compress(ContentCoding::kDeflate, 6, "", output), true);
+  Equals(Inflate(output, 15).empty() && !output.empty(), true);
+  Equals(compressor.Compress(ContentCoding::kIdentity, 6, "as is", output), true);
+  Equals(output, std::string("as is"));
+
+  auto [pass, total] = GetTestInfo();
+
+  if (pass != total) {
+    std::cout << "Passed " << pass << " out of " << total << " tests." << std::endl;
+  } else {
+    std::cout << "All tests passed!" << std::endl;
+  }
+
+  return 0;
+}
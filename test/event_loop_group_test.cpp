@@ -0,0 +1,104 @@
+#include <algorithm>
+#include <cstddef>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "test.hpp"
+
+#include "net/event_loop_group.hpp"
+#include "net/http/event_stream.hpp"
+#include "net/tcp_connection.hpp"
+
+int main(int argc, char* const argv[]) {
+  using namespace simple_http::net;
+
+  auto cpus = EventLoopGroup::GetAvailableCpus();
+  Equals(cpus >= 1 && cpus <= std::max(std::thread::hardware_concurrency(), 1U), true);
+
+  // A fixed group never resizes itself.
+  EventLoopGroup fixed{2};
+  fixed.Start();
+  Equals(fixed.IsElastic(), false);
+  Equals(fixed.GetResizeStep(), 0);
+
+  EventLoopGroup group{1, {.min_loops = 1, .max_loops = 3}};
+  group.Start();
+  Equals(group.GetSize(), std::size_t{1});
+  Equals(group.RetireLoop() == nullptr, true);  // never the last one
+
+  auto* first  = group.GetEventLoop(0);
+  auto* second = group.AddLoop();
+  Equals(group.GetSize(), std::size_t{2});
+  Equals(second != first && second != nullptr, true);
+
+  // Added loops run and take connections right away.
+  std::promise<bool> ran;
+  second->RunInLoop([&ran, second] { ran.set_value(second->IsInLoopThread()); });
+  Equals(ran.get_future().get(), true);
+
+  // The loop with fewer connections retires, its connections move to the others.
+  first->AddConnections(1);
+  Equals(group.RetireLoop() == second, true);
+  Equals(group.GetSize(), std::size_t{1});
+  Equals(group.HasRetiringLoops(), true);
+  Equals(group.GetRetiringLoops().size(), std::size_t{1});
+  for (int i = 0; i < 4; ++i) {
+    Equals(group.GetNextEventLoop() == first, true);
+  }
+  Equals(group.GetMigrationTarget(second) == first, true);
+  Equals(group.GetMigrationTarget(first) == nullptr, true);  // migrate_utilization_gap is 0
+  first->AddConnections(-1);
+
+  group.ReleaseLoop(second);
+  Equals(group.HasRetiringLoops(), false);
+  Equals(group.GetSize(), std::size_t{1});
+
+  // Idle loops above min_loops shrink the group, never below it.
+  group.AddLoop();
+  Equals(group.GetResizeStep(), -1);
+  group.ReleaseLoop(group.RetireLoop());
+  Equals(group.GetResizeStep(), 0);
+
+  // Events published after a loop was released are not queued to it.
+  http::EventHub     hub{{.heartbeat = std::chrono::seconds{0}}};
+  auto*              third = group.AddLoop();
+  std::promise<void> subscribed;
+  third->RunInLoop([&hub, &subscribed, third] {
+    int fds[2];
+    ::socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+    ::close(fds[1]);
+    hub.Subscribe(std::make_shared<TcpConnection>(third, fds[0], InetAddr{}, InetAddr{}));
+    third->AddConnections(-1);  // never established, no server counts it off
+    subscribed.set_value();
+  });
+  subscribed.get_future().wait();
+  Equals(hub.GetSubscriberCount(), std::size_t{1});
+  Equals(group.RetireLoop() == third, true);
+  group.ReleaseLoop(third);
+  Equals(hub.GetSubscriberCount(), std::size_t{0});
+  hub.Publish(http::ServerSentEvent{.data = "after"});
+
+  bool thrown = false;
+  try {
+    EventLoopGroup invalid{1, {.cpu_sets = {{-1}}}};
+  } catch (std::invalid_argument const&) {
+    thrown = true;
+  }
+  Equals(thrown, true);
+
+  auto [pass, total] = GetTestInfo();
+
+  if (pass != total) {
+    std::cout << "Passed " << pass << " out of " << total << " tests." << std::endl;
+  } else {
+    std::cout << "All tests passed!" << std::endl;
+  }
+
+  return 0;
+}
@@ -0,0 +1,50 @@
+#include <chrono>
+#include <iostream>
+#include <string>
+
+#include "test.hpp"
+
+#include "net/http/event_stream.hpp"
+
+namespace {
+using namespace simple_http::net::http;
+
+std::string Wire(ServerSentEvent const& event) {
+  std::string out;
+  sse::AppendEvent(event, out);
+  return out;
+}
+}  // namespace
+
+int main(int argc, char* const argv[]) {
+  using namespace std::chrono_literals;
+
+  Equals(Wire({.data = "hello"}), std::string("data: hello\n\n"));
+  Equals(Wire({}), std::string("data: \n\n"));
+  Equals(Wire({.data = "a", .event = "update", .id = "7", .retry = 3s}),
+         std::string("event: update\nid: 7\nretry: 3000\ndata: a\n\n"));
+
+  // Every line of data becomes a field, whichever line break ends it.
+  Equals(Wire({.data = "one\ntwo\r\nthree\rfour"}), std::string("data: one\ndata: two\ndata: three\ndata: four\n\n"));
+  Equals(Wire({.data = "end\n"}), std::string("data: end\ndata: \n\n"));
+  Equals(Wire({.data = "\r\n\n"}), std::string("data: \ndata: \ndata: \n\n"));
+
+  // Other fields can't be split, they end at their first line break.
+  Equals(Wire({.data = "x", .event = "a\nevent: forged", .id = "1\r2"}), std::string("event: a\nid: 1\ndata: x\n\n"));
+
+  // Events follow each other in the same buffer.
+  std::string out;
+  sse::AppendEvent({.data = "1"}, out);
+  sse::AppendEvent({.data = "2"}, out);
+  Equals(out, std::string("data: 1\n\ndata: 2\n\n"));
+
+  auto [pass, total] = GetTestInfo();
+
+  if (pass != total) {
+    std::cout << "Passed " << pass << " out of " << total << " tests." << std::endl;
+  } else {
+    std::cout << "All tests passed!" << std::endl;
+  }
+
+  return 0;
+}
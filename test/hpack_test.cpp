@@ -0,0 +1,91 @@
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "test.hpp"
+
+#include "net/http/hpack.hpp"
+#include "utils/base64.hpp"
+
+namespace {
+std::string FromHex(std::string_view hex) {
+  std::string out;
+  for (std::size_t i = 0; i + 1 < hex.size(); i += 2) {
+    out.push_back(static_cast<char>(std::stoi(std::string(hex.substr(i, 2)), nullptr, 16)));
+  }
+  return out;
+}
+
+std::string Join(std::vector<simple_http::net::http::HeaderField> const& headers) {
+  std::string out;
+  for (auto const& field : headers) {
+    out += field.name + ": " + field.value + "\n";
+  }
+  return out;
+}
+}  // namespace
+
+int main(int argc, char* const argv[]) {
+  using namespace simple_http::net::http;
+  using namespace simple_http::util;
+
+  // Requests with Huffman coding, RFC 7541 C.4. The dynamic table carries over between blocks.
+  HpackDecoder             decoder;
+  std::vector<HeaderField> headers;
+  Equals(decoder.Decode(FromHex("828684418cf1e3c2e5f23a6ba0ab90f4ff"), headers), true);
+  Equals(Join(headers), std::string(":method: GET\n:scheme: http\n:path: /\n:authority: www.example.com\n"));
+
+  headers.clear();
+  Equals(decoder.Decode(FromHex("828684be5886a8eb10649cbf"), headers), true);
+  Equals(Join(headers),
+         std::string(":method: GET\n:scheme: http\n:path: /\n:authority: www.example.com\ncache-control: no-cache\n"));
+
+  headers.clear();
+  Equals(decoder.Decode(FromHex("828785bf408825a849e95ba97d7f8925a849e95bb8e8b4bf"), headers), true);
+  Equals(Join(headers), std::string(":method: GET\n:scheme: https\n:path: /index.html\n:authority: www.example.com\n"
+                                    "custom-key: custom-value\n"));
+
+  // An index past the end of both tables is a compression error.
+  headers.clear();
+  Equals(decoder.Decode(FromHex("ff7f"), headers), false);
+
+  // What the encoder writes decodes to the same fields, also after the peer shrinks the table.
+  HpackEncoder             encoder;
+  HpackDecoder             peer;
+  std::vector<HeaderField> response{
+      {":status", "200"}, {"content-type", "text/html"}, {"x-trace", "abc"}, {"date", "Fri, 17 Feb 2023 00:00:00 GMT"}};
+  for (int i = 0; i < 3; ++i) {
+    if (i == 2) {
+      encoder.SetMaxTableSize(64);
+    }
+    std::string block;
+    encoder.Encode(response, block);
+    headers.clear();
+    Equals(peer.Decode(block, headers), true);
+    Equals(Join(headers), Join(response));
+  }
+
+  std::string huffman;
+  std::string decoded;
+  hpack::HuffmanEncode("no-cache", huffman);
+  Equals(huffman, FromHex("a8eb10649cbf"));
+  Equals(hpack::HuffmanDecode(huffman, decoded), true);
+  Equals(decoded, std::string("no-cache"));
+
+  Equals(Base64Encode("any carnal pleas"), std::string("YW55IGNhcm5hbCBwbGVhcw=="));
+  Equals(Base64Encode("\xfb\xff", true), std::string("-_8"));
+  Equals(Base64Decode("YW55IGNhcm5hbCBwbGVhcw").value_or(""), std::string("any carnal pleas"));
+  Equals(Base64Decode("-_8").value_or(""), std::string("\xfb\xff"));
+  Equals(Base64Decode("YW5*").has_value(), false);
+
+  auto [pass, total] = GetTestInfo();
+
+  if (pass != total) {
+    std::cout << "Passed " << pass << " out of " << total << " tests." << std::endl;
+  } else {
+    std::cout << "All tests passed!" << std::endl;
+  }
+
+  return 0;
+}
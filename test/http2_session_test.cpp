@@ -0,0 +1,111 @@
+#include <chrono>
+#include <cstddef>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "test.hpp"
+
+#include "net/http/hpack.hpp"
+#include "net/http/http2_session.hpp"
+
+namespace {
+using namespace simple_http;
+using namespace simple_http::net::http;
+
+// What the client got for one stream.
+struct Received {
+  std::string body;
+  bool        end_stream{false};
+  bool        reset{false};
+};
+
+// Answer a GET of path over a fresh session with a provider yielding parts, announcing length.
+Received Get(std::string const& path, std::vector<std::string> parts, std::optional<std::size_t> length) {
+  Http2Session session{[&](uint32_t /*stream_id*/, HttpRequest const& /*req*/, HttpResponse& response) {
+    response.SetBodyProvider(
+        [parts, next = std::size_t{0}](std::string& out) mutable {
+          out += parts[next++];
+          return next < parts.size();
+        },
+        length);
+    return true;
+  }};
+
+  std::string out;
+  session.Start(out);
+
+  std::string  block;
+  HpackEncoder encoder;
+  encoder.Encode({{":method", "GET"}, {":scheme", "http"}, {":path", path}, {":authority", "test"}}, block);
+  std::string input{kHttp2Preface};
+  Http2FrameHeader{.type = Http2FrameType::kSettings}.AppendTo(input);
+  Http2FrameHeader{.length    = static_cast<uint32_t>(block.size()),
+                   .type      = Http2FrameType::kHeaders,
+                   .flags     = http2::kFlagEndStream | http2::kFlagEndHeaders,
+                   .stream_id = 1}
+      .AppendTo(input);
+  input += block;
+
+  util::MsgBuffer buf;
+  buf.Write(input.data(), input.size());
+  Equals(session.Receive(buf, std::chrono::steady_clock::now(), out), true);
+  session.Flush(out, 1024 * 1024);
+
+  Received         received;
+  std::string_view rest = out;
+  while (rest.size() >= Http2FrameHeader::kSize) {
+    auto header = Http2FrameHeader::Parse(rest.data());
+    auto frame  = rest.substr(Http2FrameHeader::kSize, header.length);
+    rest.remove_prefix(Http2FrameHeader::kSize + header.length);
+    if (header.stream_id != 1) {
+      continue;
+    }
+    if (header.type == Http2FrameType::kData) {
+      received.body += frame;
+    }
+    if (header.type == Http2FrameType::kRstStream) {
+      received.reset = true;
+    }
+    received.end_stream = received.end_stream || header.HasFlag(http2::kFlagEndStream);
+  }
+  return received;
+}
+}  // namespace
+
+int main(int argc, char* const argv[]) {
+  std::string const part(10000, 'x');
+
+  // Provided bodies ending at their content-length, or without one.
+  auto exact = Get("/", {part, part, "tail"}, 20004);
+  Equals(exact.body.size(), std::size_t{20004});
+  Equals(exact.end_stream && !exact.reset, true);
+  auto unknown = Get("/", {part, "tail"}, std::nullopt);
+  Equals(unknown.body.size(), std::size_t{10004});
+  Equals(unknown.end_stream && !unknown.reset, true);
+
+  // Bodies running past their content-length are reset before a byte too many is sent.
+  auto longer = Get("/", {part, part, part}, 25000);
+  Equals(longer.reset && !longer.end_stream, true);
+  Equals(longer.body.size() <= 25000, true);
+  auto whole = Get("/", {"abcdef"}, 4);
+  Equals(whole.reset && !whole.end_stream && whole.body.empty(), true);
+
+  // Bodies ending short of it are reset instead of ended.
+  auto shorter = Get("/", {part, part}, 30000);
+  Equals(shorter.reset && !shorter.end_stream, true);
+  auto empty = Get("/", {""}, 4);
+  Equals(empty.reset && !empty.end_stream, true);
+
+  auto [pass, total] = GetTestInfo();
+
+  if (pass != total) {
+    std::cout << "Passed " << pass << " out of " << total << " tests." << std::endl;
+  } else {
+    std::cout << "All tests passed!" << std::endl;
+  }
+
+  return 0;
+}
@@ -0,0 +1,75 @@
+#include <cstdint>
+#include <iostream>
+#include <thread>
+
+#include "test.hpp"
+
+#include "utils/latency_histogram.hpp"
+
+namespace {
+bool Near(uint64_t actual, uint64_t expected) {
+  // One sub-bucket of relative error.
+  auto error = static_cast<double>(expected) / simple_http::util::LatencyHistogram::kSubBuckets;
+  return static_cast<double>(actual) >= static_cast<double>(expected) - error &&
+         static_cast<double>(actual) <= static_cast<double>(expected) + error;
+}
+}  // namespace
+
+int main(int argc, char* const argv[]) {
+  using namespace simple_http::util;
+
+  // Small values are exact, every bucket's upper bound maps back into it.
+  Equals(LatencyHistogram::BucketIndex(0), 0UL);
+  Equals(LatencyHistogram::BucketIndex(31), 31UL);
+  for (std::size_t i = 0; i + 1 < LatencyHistogram::kBuckets; ++i) {
+    if (LatencyHistogram::BucketIndex(LatencyHistogram::BucketUpperBound(i)) != i ||
+        LatencyHistogram::BucketIndex(LatencyHistogram::BucketUpperBound(i) + 1) != i + 1) {
+      Equals(i, LatencyHistogram::kBuckets);
+      break;
+    }
+  }
+  Equals(LatencyHistogram::BucketIndex(UINT64_MAX), LatencyHistogram::kBuckets - 1);
+
+  LatencyHistogram histogram;
+  Equals(histogram.ValueAtQuantile(0.99), 0UL);
+  for (uint64_t us = 1; us <= 1000; ++us) {
+    histogram.Record(us * 1000);
+  }
+  Equals(histogram.GetCount(), 1000UL);
+  Equals(histogram.GetMax(), 1000000UL);
+  Equals(Near(histogram.ValueAtQuantile(0.5), 500000), true);
+  Equals(Near(histogram.ValueAtQuantile(0.9), 900000), true);
+  Equals(Near(histogram.ValueAtQuantile(0.99), 990000), true);
+  Equals(histogram.ValueAtQuantile(1), 1000000UL);
+
+  // Shards recorded from different threads merge into the same distribution.
+  ShardedLatencyHistogram sharded;
+  std::thread first([&sharded] {
+    for (uint64_t us = 1; us <= 500; ++us) {
+      sharded.Record(us * 1000);
+    }
+  });
+  std::thread second([&sharded] {
+    for (uint64_t us = 501; us <= 1000; ++us) {
+      sharded.Record(us * 1000);
+    }
+  });
+  first.join();
+  second.join();
+
+  auto merged = sharded.Snapshot();
+  Equals(merged.GetCount(), 1000UL);
+  Equals(merged.GetMax(), 1000000UL);
+  Equals(merged.ValueAtQuantile(0.99), histogram.ValueAtQuantile(0.99));
+  Equals(merged.ValueAtQuantile(0.999), histogram.ValueAtQuantile(0.999));
+
+  auto [pass, total] = GetTestInfo();
+
+  if (pass != total) {
+    std::cout << "Passed " << pass << " out of " << total << " tests." << std::endl;
+  } else {
+    std::cout << "All tests passed!" << std::endl;
+  }
+
+  return 0;
+}
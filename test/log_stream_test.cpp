@@ -0,0 +1,69 @@
+#include <cstdint>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include "test.hpp"
+
+#include "utils/date_time.hpp"
+#include "utils/log_stream.hpp"
+#include "utils/logger.hpp"
+
+int main(int argc, char* const argv[]) {
+  using namespace simple_http::util;
+
+  LogStream stream;
+  stream << "id=" << 42 << ' ' << -7L << ' ' << uint64_t{18446744073709551615ULL} << ' ' << true << ' ' << 1.5
+         << ' ' << std::string{"str"} << ' ' << static_cast<char const*>(nullptr);
+  Equals(std::string{stream.View()}, std::string{"id=42 -7 18446744073709551615 true 1.5 str (null)"});
+
+  stream.Reset();
+  stream << static_cast<void const*>(reinterpret_cast<char const*>(0xbeef));
+  Equals(std::string{stream.View()}, std::string{"0xbeef"});
+
+  // Output beyond the buffer is truncated, numbers that don't fit are dropped whole.
+  stream.Reset();
+  stream << std::string(LogStream::kBufferSize - 2, 'x');
+  stream << 12345;
+  Equals(stream.Size(), LogStream::kBufferSize - 2);
+  stream << "abcdef";
+  Equals(stream.Size(), LogStream::kBufferSize);
+  Equals(stream.Available(), std::size_t{0});
+  Equals(std::string{stream.View().substr(stream.Size() - 2)}, std::string{"ab"});
+  stream.Unwind(1);
+  Equals(stream.Available(), std::size_t{1});
+
+  // 2023-02-14 12:24:56.789012 UTC.
+  DateTime time{1676377496789012};
+  Equals(time.GetSecondsSinceEpoch(), int64_t{1676377496});
+  Equals(time.ToFormattedString(), std::string{"20230214 12:24:56.789012"});
+  Equals(time.ToFormattedString(false), std::string{"20230214 12:24:56"});
+  // The cached seconds are refreshed when the second changes, also backwards.
+  Equals(DateTime{1676377497000001}.ToFormattedString(), std::string{"20230214 12:24:57.000001"});
+  Equals(DateTime{1676377496000000}.ToFormattedString(), std::string{"20230214 12:24:56.000000"});
+  Equals(DateTime{0}.ToFormattedString(), std::string{"19700101 00:00:00.000000"});
+  Equals(time.ToFormattedString().size(), DateTime::kFormattedSize);
+
+  // Lines go to the target stream set the old way.
+  std::ostringstream target;
+  Logger::SetTarget(target);
+  Logger().Warning("to the target");
+  LOG_DEBUG << "below the level";
+  LOG_ERROR << "streamed " << 1;
+  Logger::SetOutput(nullptr);
+  auto lines = target.str();
+  Equals(lines.find("WARN  ") != std::string::npos && lines.find(" - to the target\n") != std::string::npos, true);
+  Equals(lines.find("below the level"), std::string::npos);
+  Equals(lines.find("ERROR ") != std::string::npos && lines.find(" - streamed 1\n") != std::string::npos, true);
+  Equals(lines.find("log_stream_test.cpp:") != std::string::npos, true);
+
+  auto [pass, total] = GetTestInfo();
+
+  if (pass != total) {
+    std::cout << "Passed " << pass << " out of " << total << " tests." << std::endl;
+  } else {
+    std::cout << "All tests passed!" << std::endl;
+  }
+
+  return 0;
+}
@@ -0,0 +1,91 @@
+#include <cstddef>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "test.hpp"
+
+#include "utils/metrics.hpp"
+
+namespace {
+bool Contains(std::string const& text, std::string const& line) { return text.find(line) != std::string::npos; }
+}  // namespace
+
+int main(int argc, char* const argv[]) {
+  using namespace simple_http::util;
+
+  MetricsRegistry registry;
+  registry.GetCounter("requests_total", "Requests.", {{"method", "GET"}}).Increment(3);
+  registry.GetGauge("open", "Open connections.").Add(2);
+  registry.AddCallback("shed_total", "Shed.", MetricType::kCounter, [] { return 7.0; }, {{"server", "a"}});
+  registry.AddCallback("shed_total", "Shed.", MetricType::kCounter, [] { return 9.0; }, {{"server", "b"}});
+  registry.GetCounter("escaped_total", "Escaping.", {{"path", "a\"b\\c\nd"}}).Increment();
+
+  auto& histogram = registry.GetHistogram("latency_seconds", "Latency.", {0.5, 0.1});
+  histogram.Observe(0.05);
+  histogram.Observe(0.1);  // bounds are inclusive
+  histogram.Observe(0.3);
+  histogram.Observe(2);
+
+  auto text = registry.Serialize();
+  Equals(Contains(text, "# HELP requests_total Requests.\n# TYPE requests_total counter\n"), true);
+  Equals(Contains(text, "requests_total{method=\"GET\"} 3\n"), true);
+  Equals(Contains(text, "# TYPE open gauge\nopen 2\n"), true);
+  Equals(Contains(text, "shed_total{server=\"a\"} 7\n"), true);
+  Equals(Contains(text, "shed_total{server=\"b\"} 9\n"), true);
+  Equals(Contains(text, "escaped_total{path=\"a\\\"b\\\\c\\nd\"} 1\n"), true);
+
+  // Buckets are sorted and cumulative, +Inf counts everything.
+  Equals(Contains(text, "# TYPE latency_seconds histogram\n"), true);
+  Equals(Contains(text, "latency_seconds_bucket{le=\"0.1\"} 2\n"), true);
+  Equals(Contains(text, "latency_seconds_bucket{le=\"0.5\"} 3\n"), true);
+  Equals(Contains(text, "latency_seconds_bucket{le=\"+Inf\"} 4\n"), true);
+  Equals(Contains(text, "latency_seconds_sum 2.45\n"), true);
+  Equals(Contains(text, "latency_seconds_count 4\n"), true);
+
+  // Removing one server's callback keeps the other's.
+  registry.RemoveCallback("shed_total", {{"server", "a"}});
+  text = registry.Serialize();
+  Equals(Contains(text, "server=\"a\""), false);
+  Equals(Contains(text, "shed_total{server=\"b\"} 9\n"), true);
+
+  int owner = 0;
+  registry.AddCollector("route_seconds", "Routes.", MetricType::kSummary, &owner,
+                        [](MetricsRegistry::SampleWriter const& write) {
+                          write("_count", {{"route", "/"}}, 5);
+                        });
+  Equals(Contains(registry.Serialize(), "# TYPE route_seconds summary\nroute_seconds_count{route=\"/\"} 5\n"), true);
+  registry.RemoveCollector("route_seconds", &owner);
+  Equals(Contains(registry.Serialize(), "route_seconds_count"), false);
+
+  // Up to kMaxBuckets bounds, more are refused instead of dropped.
+  std::vector<double> bounds(Histogram::kMaxBuckets);
+  for (std::size_t i = 0; i < bounds.size(); ++i) {
+    bounds[i] = static_cast<double>(i + 1);
+  }
+  Histogram full{bounds};
+  full.Observe(100);
+  auto snapshot = full.Collect();
+  Equals(snapshot.counts.size(), Histogram::kMaxBuckets + 1);
+  Equals(snapshot.counts.back(), uint64_t{1});
+
+  bounds.push_back(1000);
+  bool refused = false;
+  try {
+    Histogram too_many{bounds};
+  } catch (std::invalid_argument const&) {
+    refused = true;
+  }
+  Equals(refused, true);
+
+  auto [pass, total] = GetTestInfo();
+
+  if (pass != total) {
+    std::cout << "Passed " << pass << " out of " << total << " tests." << std::endl;
+  } else {
+    std::cout << "All tests passed!" << std::endl;
+  }
+
+  return 0;
+}
@@ -1,4 +1,5 @@
 #include <iostream>
+#include <string>
 #include <string_view>
 
 #include <cstdint>
@@ -33,6 +34,14 @@ int main(int argc, char* const argv[]) {
   Equals(buf.ReadableSize(), 0);
   Equals(buf.WritableSize(), 121);
 
+  // Growing keeps what has not been read yet.
+  buf.Write("0123456789"sv);
+  std::string filler(200, 'x');
+  buf.Write(filler.data(), filler.size());
+
+  Equals(buf.ReadableSize(), 210);
+  Equals(buf.Read(10), "0123456789"sv);
+
   auto [pass, total] = GetTestInfo();
 
   if (pass != total) {
@@ -0,0 +1,97 @@
+#include <iostream>
+#include <string>
+#include <string_view>
+
+#include "test.hpp"
+
+#include "net/http/http.hpp"
+#include "net/http/http_request.hpp"
+#include "net/http/http_response.hpp"
+#include "utils/perfect_hash.hpp"
+
+int main(int argc, char* const argv[]) {
+  using namespace simple_http::net::http;
+  using simple_http::util::MakePerfectHashMap;
+
+  static_assert(ParseMethod("DELETE") == Method::kDelete);
+  static_assert(FindHeaderId("content-LENGTH") == HeaderId::kContentLength);
+  static_assert(ReasonPhrase(StatusCode::k404NotFound) == "Not Found");
+
+  auto constexpr kSmall = MakePerfectHashMap<int>({{"a", 1}, {"bb", 2}, {"ccc", 3}});
+  Equals(*kSmall.Find("bb"), 2);
+  Equals(kSmall.Find("BB") == nullptr, true);
+  Equals(kSmall.Find("dd") == nullptr, true);
+  Equals(kSmall.Find("") == nullptr, true);
+
+  for (auto const& [name, method] : kMethods.GetEntries()) {
+    Equals(static_cast<int>(ParseMethod(name)), static_cast<int>(method));
+  }
+  Equals(static_cast<int>(ParseMethod("get")), static_cast<int>(Method::kInvalid));
+  Equals(static_cast<int>(ParseMethod("PATCH")), static_cast<int>(Method::kInvalid));
+
+  for (std::size_t i = 0; i < kHeaderIdCount; ++i) {
+    std::string lower;
+    for (auto c : kHeaderNames[i]) {
+      lower += simple_http::util::AsciiLower(c);
+    }
+    Equals(static_cast<std::size_t>(FindHeaderId(kHeaderNames[i])), i);
+    Equals(static_cast<std::size_t>(FindHeaderId(lower)), i);
+  }
+  Equals(static_cast<int>(FindHeaderId("X-Custom")), static_cast<int>(HeaderId::kUnknown));
+  Equals(static_cast<int>(FindHeaderId("Content-Lengt")), static_cast<int>(HeaderId::kUnknown));
+
+  for (auto const& [extension, type] : kMimeTypes.GetEntries()) {
+    Equals(FindMimeType(extension), type);
+  }
+  Equals(FindMimeType(".HTML"), std::string_view{"text/html"});
+  Equals(FindMimeType(".nope").empty(), true);
+
+  Equals(StatusLine(StatusCode::k200Ok), std::string_view{"HTTP/1.1 200 OK\r\n"});
+  Equals(StatusLine(StatusCode::k416RangeNotSatisfiable), std::string_view{"HTTP/1.1 416 Range Not Satisfiable\r\n"});
+  Equals(ReasonPhrase(static_cast<StatusCode>(505)), std::string_view{"HTTP Version Not Supported"});
+  Equals(StatusLine(static_cast<StatusCode>(299)).empty(), true);
+  Equals(ReasonPhrase(static_cast<StatusCode>(99)).empty(), true);
+  Equals(ReasonPhrase(static_cast<StatusCode>(600)).empty(), true);
+
+  // Known fields are found through their slots, by id or by name in any case.
+  HttpRequest req;
+  req.SetHeader("host", "example.com");
+  req.SetHeader("Host", "ignored");
+  req.SetHeader("X-Custom", "1");
+  Equals(req.GetHeaderView(HeaderId::kHost), std::string_view{"example.com"});
+  Equals(req.GetHeader("HOST"), std::string{"example.com"});
+  Equals(req.GetHeader("x-custom"), std::string{"1"});
+  Equals(req.GetHeaders().size(), 2U);
+
+  // Copies and moves keep the slots pointing into their own fields.
+  auto copy = req;
+  req.RemoveHeader(HeaderId::kHost);
+  Equals(req.HasHeader("Host"), false);
+  Equals(copy.GetHeaderView(HeaderId::kHost), std::string_view{"example.com"});
+  auto moved = std::move(copy);
+  Equals(moved.GetHeaderView(HeaderId::kHost), std::string_view{"example.com"});
+  moved.Swap(req);
+  Equals(req.HasHeader(HeaderId::kHost), true);
+  Equals(moved.HasHeader(HeaderId::kHost), false);
+
+  HttpResponse resp(false);
+  resp.SetStatusCode(StatusCode::k404NotFound);
+  resp.SetHeader(HeaderId::kContentType, "text/plain");
+  resp.SetHeader("content-type", "text/html");
+  Equals(resp.GetHeader(HeaderId::kContentType), std::string_view{"text/html"});
+  Equals(resp.GetHeaders().size(), 1U);
+  Equals(resp.GetStatusMessage(), std::string_view{"Not Found"});
+  simple_http::util::MsgBuffer wire;
+  resp.WriteTo(wire);
+  Equals(std::string_view{wire.Peek(), wire.ReadableSize()}.starts_with("HTTP/1.1 404 Not Found\r\n"), true);
+
+  auto [pass, total] = GetTestInfo();
+
+  if (pass != total) {
+    std::cout << "Passed " << pass << " out of " << total << " tests." << std::endl;
+  } else {
+    std::cout << "All tests passed!" << std::endl;
+  }
+
+  return 0;
+}
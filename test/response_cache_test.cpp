@@ -0,0 +1,164 @@
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include "test.hpp"
+
+#include "net/http/response_cache.hpp"
+
+namespace {
+using namespace simple_http::net::http;
+using namespace std::chrono_literals;
+
+HttpResponse Ok(std::string body) {
+  HttpResponse response(false);
+  response.SetStatusCode(StatusCode::k200Ok);
+  response.SetStatusMessage("OK");
+  response.SetBody(std::move(body));
+  return response;
+}
+
+// Find from a thread of its own, which sees only the tier shared by all loops.
+CachedResponsePtr FindElsewhere(ResponseCache& cache, std::string const& key, Timepoint now, bool& fresh) {
+  CachedResponsePtr entry;
+  std::thread([&] { entry = cache.Find(key, now, fresh); }).join();
+  return entry;
+}
+}  // namespace
+
+int main(int argc, char* const argv[]) {
+  auto const t0 = std::chrono::steady_clock::now();
+  bool       fresh{false};
+
+  // Keys tell apart method, path, query, the varying fields and the variant.
+  {
+    ResponseCache cache{{.vary = {"Accept-Language"}}};
+    HttpRequest   req;
+    req.SetMethod(Method::kGet);
+    req.SetPath("/a");
+    req.SetQuery("x=1");
+    req.SetHeader("Accept-Language", "en");
+    auto key = cache.Key(req, "gzip");
+    Equals(key, std::string("GET /a?x=1\nen\ngzip"));
+    Equals(cache.Key(req, "deflate") != key, true);
+    HttpRequest other = req;
+    other.SetHeaders({{"Accept-Language", "ja"}});
+    Equals(cache.Key(other, "gzip") != key, true);
+  }
+
+  // Fresh for the TTL, then stale within the revalidation window, then gone, on every loop.
+  {
+    ResponseCache cache{{.ttl = 100ms, .stale_while_revalidate = 100ms}};
+    Equals(cache.Find("k", t0, fresh) == nullptr, true);
+    Equals(cache.Claim("k"), true);
+    auto stored = cache.Complete("k", Ok("body"), t0);
+    Equals(stored != nullptr, true);
+    Equals(stored->response.GetBody(), std::string_view{"body"});
+    Equals(stored->wire->ends_with("\r\n\r\nbody"), true);
+
+    Equals(cache.Find("k", t0 + 50ms, fresh) == stored, true);
+    Equals(fresh, true);
+    Equals(cache.Find("k", t0 + 150ms, fresh) == stored, true);
+    Equals(fresh, false);
+    Equals(cache.Find("k", t0 + 250ms, fresh) == nullptr, true);
+
+    Equals(FindElsewhere(cache, "k", t0 + 50ms, fresh) == stored, true);
+    Equals(fresh, true);
+    Equals(FindElsewhere(cache, "k", t0 + 150ms, fresh) == stored, true);
+    Equals(fresh, false);
+    Equals(FindElsewhere(cache, "k", t0 + 250ms, fresh) == nullptr, true);
+
+    // A newer response stored by another loop replaces the stale local one.
+    CachedResponsePtr newer;
+    std::thread([&] {
+      Equals(cache.Claim("k"), true);
+      newer = cache.Complete("k", Ok("newer"), t0 + 120ms);
+    }).join();
+    Equals(cache.Find("k", t0 + 150ms, fresh) == newer, true);
+    Equals(fresh, true);
+  }
+
+  // A second claim waits for the first computation and gets its entry.
+  {
+    ResponseCache     cache{{}};
+    CachedResponsePtr waited;
+    int               calls{0};
+    Equals(cache.Claim("k"), true);
+    Equals(cache.Claim("k",
+                       [&](CachedResponsePtr const& entry) {
+                         waited = entry;
+                         ++calls;
+                       }),
+           false);
+    Equals(calls, 0);
+    auto stored = cache.Complete("k", Ok("body"), t0);
+    Equals(calls, 1);
+    Equals(waited != nullptr && waited == stored, true);
+    // The computation is over, the next one can be claimed.
+    Equals(cache.Claim("k"), true);
+  }
+
+  // Waiters of a response that can't be stored get nullptr, and it is not found later.
+  {
+    ResponseCache     cache{{}};
+    CachedResponsePtr waited = std::make_shared<CachedResponse const>();
+    Equals(cache.Claim("k"), true);
+    Equals(cache.Claim("k", [&](CachedResponsePtr const& entry) { waited = entry; }), false);
+    HttpResponse missing(false);
+    missing.SetStatusCode(StatusCode::k404NotFound);
+    Equals(cache.Complete("k", missing, t0) == nullptr, true);
+    Equals(waited == nullptr, true);
+    Equals(cache.Find("k", t0, fresh) == nullptr, true);
+  }
+
+  // Responses that are private, not to be stored, that set a cookie or that are too large.
+  {
+    ResponseCache cache{{.max_body_size = 8}};
+    auto          no_store = Ok("a");
+    no_store.SetHeader(HeaderId::kCacheControl, "no-store");
+    auto personal = Ok("b");
+    personal.SetHeader(HeaderId::kCacheControl, "max-age=60, private");
+    auto cookie = Ok("c");
+    cookie.SetHeader(HeaderId::kSetCookie, "session=1");
+    int n{0};
+    for (auto const& response : {no_store, personal, cookie, Ok("0123456789")}) {
+      auto key = std::to_string(n++);
+      Equals(cache.Claim(key), true);
+      Equals(cache.Complete(key, response, t0) == nullptr, true);
+      Equals(cache.Find(key, t0, fresh) == nullptr, true);
+      Equals(FindElsewhere(cache, key, t0, fresh) == nullptr, true);
+    }
+  }
+
+  // Full tiers drop expired entries first, then the one expiring first.
+  {
+    ResponseCache cache{{.ttl = 100ms, .max_entries = 2}};
+    (void)cache.Claim("a");
+    (void)cache.Complete("a", Ok("a"), t0);
+    (void)cache.Claim("b");
+    (void)cache.Complete("b", Ok("b"), t0 + 10ms);
+    (void)cache.Claim("c");
+    (void)cache.Complete("c", Ok("c"), t0 + 20ms);
+    Equals(cache.Find("a", t0 + 30ms, fresh) == nullptr, true);
+    Equals(FindElsewhere(cache, "a", t0 + 30ms, fresh) == nullptr, true);
+    Equals(cache.Find("b", t0 + 30ms, fresh) != nullptr, true);
+    Equals(FindElsewhere(cache, "c", t0 + 30ms, fresh) != nullptr, true);
+
+    (void)cache.Claim("d");
+    (void)cache.Complete("d", Ok("d"), t0 + 115ms);
+    Equals(FindElsewhere(cache, "c", t0 + 115ms, fresh) != nullptr, true);
+    Equals(FindElsewhere(cache, "d", t0 + 115ms, fresh) != nullptr, true);
+  }
+
+  auto [pass, total] = GetTestInfo();
+
+  if (pass != total) {
+    std::cout << "Passed " << pass << " out of " << total << " tests." << std::endl;
+  } else {
+    std::cout << "All tests passed!" << std::endl;
+  }
+
+  return 0;
+}
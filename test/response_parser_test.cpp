@@ -0,0 +1,156 @@
+#include <cstddef>
+#include <iostream>
+#include <string>
+#include <string_view>
+
+#include "test.hpp"
+
+#include "net/http/response_parser.hpp"
+
+namespace {
+using namespace simple_http;
+
+constexpr std::size_t kMaxSize = 1024;
+
+void Feed(util::MsgBuffer& buf, std::string_view data) { buf.Write(data.data(), data.size()); }
+
+unsigned int Status(net::http::ResponseParser& parser) {
+  return static_cast<unsigned int>(parser.GetResponse().GetStatusCode());
+}
+}  // namespace
+
+int main(int argc, char* const argv[]) {
+  using namespace simple_http::net::http;
+
+  ResponseParser  parser;
+  util::MsgBuffer buf;
+
+  // A Content-Length body arriving in pieces, the next response stays in the buffer.
+  parser.Reset(false, kMaxSize, kMaxSize);
+  Feed(buf, "HTTP/1.1 200 OK\r\nContent-Length: 10\r\nX-A: 1\r\n");
+  Equals(parser.Parse(buf), true);
+  Equals(parser.Complete(), false);
+  Equals(parser.Started(), true);
+  Feed(buf, "x-a: 2\r\n\r\n01234");
+  Equals(parser.Parse(buf), true);
+  Equals(parser.Complete(), false);
+  Feed(buf, "56789HTTP/1.1 204 No Content\r\n\r\n");
+  Equals(parser.Parse(buf), true);
+  Equals(parser.Complete(), true);
+  Equals(Status(parser), 200U);
+  Equals(parser.GetResponse().GetStatusMessage(), std::string_view{"OK"});
+  Equals(parser.GetResponse().GetBody(), std::string_view{"0123456789"});
+  Equals(parser.GetResponse().GetHeader("X-A"), std::string_view{"1, 2"});  // repeated fields are combined
+  Equals(parser.KeepAlive(), true);
+
+  parser.Reset(false, kMaxSize, kMaxSize);
+  Equals(parser.Parse(buf), true);
+  Equals(parser.Complete(), true);
+  Equals(Status(parser), 204U);
+  Equals(buf.ReadableSize(), std::size_t{0});
+
+  // Chunked, with an extension and a trailer.
+  parser.Reset(false, kMaxSize, kMaxSize);
+  Feed(buf, "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n5;ext=1\r\nHello\r\n1\r\n!\r\n0\r\nX-T: t\r\n\r\n");
+  Equals(parser.Parse(buf), true);
+  Equals(parser.Complete(), true);
+  Equals(parser.GetResponse().GetBody(), std::string_view{"Hello!"});
+
+  // A chunk not followed by CRLF, and a chunk size that is no number.
+  parser.Reset(false, kMaxSize, kMaxSize);
+  Feed(buf, "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n1\r\nab\r\n");
+  Equals(parser.Parse(buf), false);
+  buf.RetrieveAll();
+  parser.Reset(false, kMaxSize, kMaxSize);
+  Feed(buf, "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\nzz\r\n");
+  Equals(parser.Parse(buf), false);
+  buf.RetrieveAll();
+
+  // Interim responses are skipped.
+  parser.Reset(false, kMaxSize, kMaxSize);
+  Feed(buf, "HTTP/1.1 100 Continue\r\n\r\nHTTP/1.1 201 Created\r\nContent-Length: 2\r\n\r\nok");
+  Equals(parser.Parse(buf), true);
+  Equals(parser.Complete(), true);
+  Equals(Status(parser), 201U);
+  Equals(parser.GetResponse().GetBody(), std::string_view{"ok"});
+
+  // The answer to HEAD has no body, whatever its length says.
+  parser.Reset(true, kMaxSize, kMaxSize);
+  Feed(buf, "HTTP/1.1 200 OK\r\nContent-Length: 100\r\n\r\n");
+  Equals(parser.Parse(buf), true);
+  Equals(parser.Complete(), true);
+  Equals(parser.GetResponse().GetBody().empty(), true);
+
+  // HTTP/1.0 closes unless asked not to, HTTP/1.1 if asked to.
+  parser.Reset(false, kMaxSize, kMaxSize);
+  Feed(buf, "HTTP/1.0 200 OK\r\nContent-Length: 0\r\n\r\n");
+  Equals(parser.Parse(buf), true);
+  Equals(parser.KeepAlive(), false);
+  parser.Reset(false, kMaxSize, kMaxSize);
+  Feed(buf, "HTTP/1.0 200 OK\r\nConnection: Keep-Alive\r\nContent-Length: 0\r\n\r\n");
+  Equals(parser.Parse(buf), true);
+  Equals(parser.KeepAlive(), true);
+  parser.Reset(false, kMaxSize, kMaxSize);
+  Feed(buf, "HTTP/1.1 200 OK\r\nConnection: close\r\nContent-Length: 0\r\n\r\n");
+  Equals(parser.Parse(buf), true);
+  Equals(parser.KeepAlive(), false);
+
+  // Without a length the body runs until the connection closes.
+  parser.Reset(false, kMaxSize, kMaxSize);
+  Feed(buf, "HTTP/1.1 200 OK\r\n\r\nsome");
+  Equals(parser.Parse(buf), true);
+  Feed(buf, " more");
+  Equals(parser.Parse(buf), true);
+  Equals(parser.Complete(), false);
+  Equals(parser.KeepAlive(), false);
+  Equals(parser.FinishAtClose(), true);
+  Equals(parser.Complete(), true);
+  Equals(parser.GetResponse().GetBody(), std::string_view{"some more"});
+
+  // A closed connection only completes such a body.
+  parser.Reset(false, kMaxSize, kMaxSize);
+  Feed(buf, "HTTP/1.1 200 OK\r\nContent-Length: 5\r\n\r\nab");
+  Equals(parser.Parse(buf), true);
+  Equals(parser.FinishAtClose(), false);
+  buf.RetrieveAll();
+
+  // Large bodies are left to a relay, after the head.
+  parser.Reset(false, kMaxSize, 100);
+  Feed(buf, "HTTP/1.1 200 OK\r\nContent-Length: 2000\r\n\r\nbody");
+  Equals(parser.Parse(buf), true);
+  Equals(parser.Relayed(), true);
+  Equals(parser.GetRelayLength(), std::size_t{2000});
+  Equals(buf.ReadableSize(), std::size_t{4});
+  parser.FinishRelay();
+  Equals(parser.Complete(), true);
+  buf.RetrieveAll();
+
+  // Too large to buffer, by its length or as it arrives.
+  parser.Reset(false, 8, 100);
+  Feed(buf, "HTTP/1.1 200 OK\r\nContent-Length: 9\r\n\r\n");
+  Equals(parser.Parse(buf), false);
+  buf.RetrieveAll();
+  parser.Reset(false, 8, 100);
+  Feed(buf, "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n9\r\n123456789\r\n0\r\n\r\n");
+  Equals(parser.Parse(buf), false);
+  buf.RetrieveAll();
+
+  // Malformed heads.
+  for (std::string_view head : {"HTTP/2.0 200 OK\r\n", "HTTP/1.1 2x0 OK\r\n", "HTTP/1.1 20 OK\r\n",
+                                "HTTP/1.1 200 OK\r\nno colon\r\n", "HTTP/1.1 200 OK\r\nContent-Length: x\r\n\r\n"}) {
+    parser.Reset(false, kMaxSize, kMaxSize);
+    Feed(buf, head);
+    Equals(parser.Parse(buf), false);
+    buf.RetrieveAll();
+  }
+
+  auto [pass, total] = GetTestInfo();
+
+  if (pass != total) {
+    std::cout << "Passed " << pass << " out of " << total << " tests." << std::endl;
+  } else {
+    std::cout << "All tests passed!" << std::endl;
+  }
+
+  return 0;
+}
@@ -0,0 +1,136 @@
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <iostream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include "test.hpp"
+
+#include "net/event_loop.hpp"
+#include "net/http/http_server.hpp"
+#include "net/http/reverse_proxy.hpp"
+
+namespace {
+using namespace simple_http::net;
+
+// Send raw to a proxy in front of an upstream nothing listens on, what comes back until it closes.
+std::string ExchangeWithUnreachable(std::string_view raw) {
+  EventLoop loop;
+  auto      group = std::make_shared<http::UpstreamGroup>(std::vector<InetAddr>{InetAddr{"127.0.0.1", 1}});
+  http::HttpServer server{&loop, false, InetAddr{0, true}};
+  server.Proxy("/up.*", group);
+  server.Start();
+
+  sockaddr_in addr{};
+  socklen_t   len = sizeof(addr);
+  ::getsockname(server.GetListenFd(), reinterpret_cast<sockaddr*>(&addr), &len);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+  std::string received;
+  std::thread client([&] {
+    int     fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    timeval timeout{.tv_sec = 5, .tv_usec = 0};
+    ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    if (::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0 &&
+        ::send(fd, raw.data(), raw.size(), MSG_NOSIGNAL) == static_cast<ssize_t>(raw.size())) {
+      char buf[4096];
+      for (ssize_t n; (n = ::recv(fd, buf, sizeof(buf), 0)) > 0;) {
+        received.append(buf, static_cast<std::size_t>(n));
+      }
+    }
+    ::close(fd);
+    loop.Stop();
+  });
+  loop.Start();
+  client.join();
+  return received;
+}
+}  // namespace
+
+int main(int argc, char* const argv[]) {
+  using namespace simple_http::net;
+  using namespace simple_http::net::http;
+
+  // The fixed hop-by-hop fields in any case, and those the Connection field names.
+  Equals(proxy::IsHopByHop("Connection", ""), true);
+  Equals(proxy::IsHopByHop("transfer-encoding", ""), true);
+  Equals(proxy::IsHopByHop("KEEP-ALIVE", ""), true);
+  Equals(proxy::IsHopByHop("Content-Type", ""), false);
+  Equals(proxy::IsHopByHop("X-Trace", "close, x-trace"), true);
+  Equals(proxy::IsHopByHop("X-Trace", "x-trace ,close"), true);
+  Equals(proxy::IsHopByHop("X-Trace", "close,x-traced"), false);
+  Equals(proxy::IsHopByHop("X-Trace", ","), false);
+
+  HttpRequest req;
+  req.SetHeader("Host", "example.com");
+  req.SetHeader("Connection", "keep-alive, X-Secret");
+  req.SetHeader("X-Secret", "1");
+  req.SetHeader("Upgrade", "websocket");
+  req.SetHeader("Accept", "*/*");
+  proxy::RewriteRequest(req, InetAddr{"10.0.0.7", 4000});
+  Equals(req.GetHeader("Host"), std::string("example.com"));
+  Equals(req.GetHeader("Accept"), std::string("*/*"));
+  Equals(req.GetHeader("Connection").empty(), true);
+  Equals(req.GetHeader("X-Secret").empty(), true);
+  Equals(req.GetHeader("Upgrade").empty(), true);
+  Equals(req.GetHeader(HeaderId::kXForwardedFor), std::string("10.0.0.7"));
+  Equals(req.GetHeader(HeaderId::kXForwardedProto), std::string("http"));
+
+  // Proxies before this one stay in the chain, a client's claimed protocol does not.
+  HttpRequest chained;
+  chained.SetHeader(HeaderId::kXForwardedFor, "192.0.2.1");
+  chained.SetHeader(HeaderId::kXForwardedProto, "https");
+  proxy::RewriteRequest(chained, InetAddr{"10.0.0.7", 4000});
+  Equals(chained.GetHeader(HeaderId::kXForwardedFor), std::string("192.0.2.1, 10.0.0.7"));
+  Equals(chained.GetHeader(HeaderId::kXForwardedProto), std::string("http"));
+
+  // Responses keep their end-to-end fields, the length is that of the response sent.
+  HttpResponse upstream(false);
+  upstream.SetStatusCode(StatusCode::k404NotFound);
+  upstream.SetStatusMessage("Not Here");
+  upstream.SetHeader("Content-Type", "text/plain");
+  upstream.SetHeader("Content-Length", "12");
+  upstream.SetHeader("Connection", "X-Hop");
+  upstream.SetHeader("X-Hop", "1");
+  upstream.SetHeader("Transfer-Encoding", "chunked");
+  HttpResponse copy(false);
+  proxy::CopyResponse(upstream, copy);
+  Equals(static_cast<int>(copy.GetStatusCode()), 404);
+  Equals(copy.GetStatusMessage(), std::string_view{"Not Here"});
+  Equals(copy.GetHeader("Content-Type"), std::string_view{"text/plain"});
+  Equals(copy.GetHeader("Content-Length").empty(), true);
+  Equals(copy.GetHeader("X-Hop").empty(), true);
+  Equals(copy.GetHeader("Transfer-Encoding").empty(), true);
+
+  std::string head;
+  proxy::AppendResponseHead(upstream, 5, true, head);
+  Equals(head.starts_with("HTTP/1.1 404 Not Here\r\nContent-Length: 5\r\nConnection: close\r\n"), true);
+  Equals(head.find("Content-Type: text/plain\r\n") != std::string::npos, true);
+  Equals(head.find("X-Hop") == std::string::npos && head.find("chunked") == std::string::npos, true);
+  Equals(head.find("Content-Length: 12") == std::string::npos, true);
+  Equals(head.ends_with("\r\n\r\n"), true);
+
+  // A request body left unread when the upstream can't be reached must not pass for the next request.
+  std::string_view smuggled = "GET /up/second HTTP/1.1\r\nHost: x\r\n\r\n";
+  auto             answer   = ExchangeWithUnreachable("POST /up/first HTTP/1.1\r\nHost: x\r\nContent-Length: " +
+                                                      std::to_string(smuggled.size()) + "\r\n\r\n" +
+                                                      std::string{smuggled});
+  Equals(answer.starts_with("HTTP/1.1 502 Bad Gateway\r\n"), true);
+  Equals(answer.find("Connection: close\r\n") != std::string::npos, true);
+  Equals(answer.find("HTTP/1.1", 1) == std::string::npos, true);
+
+  auto [pass, total] = GetTestInfo();
+
+  if (pass != total) {
+    std::cout << "Passed " << pass << " out of " << total << " tests." << std::endl;
+  } else {
+    std::cout << "All tests passed!" << std::endl;
+  }
+
+  return 0;
+}
@@ -0,0 +1,166 @@
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "test.hpp"
+
+#include "utils/shm_ring.hpp"
+
+namespace {
+using namespace simple_http::util;
+
+constexpr std::size_t kCapacity = 64 * 1024;
+
+std::string Payload(int i, std::size_t size) {
+  auto payload = std::to_string(i) + ":";
+  payload.resize(size, static_cast<char>('a' + i % 26));
+  return payload;
+}
+
+// Reserve size bytes as a writer that dies before committing them would.
+void ReserveWithoutCommit(std::string const& path, uint64_t size) {
+  int   fd  = ::open(path.c_str(), O_RDWR);
+  void* map = ::mmap(nullptr, ShmRingHeader::kHeaderSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  ::close(fd);
+  static_cast<ShmRingHeader*>(map)->write_cursor.fetch_add(size);
+  ::munmap(map, ShmRingHeader::kHeaderSize);
+}
+}  // namespace
+
+int main(int argc, char* const argv[]) {
+  auto path = "/tmp/shm_ring_test." + std::to_string(::getpid());
+
+  // Records come out in order with their channels, also those wrapping around the end of the ring.
+  {
+    ShmRingWriter writer{path, kCapacity};
+    ShmRingReader reader{path};
+    Equals(writer.GetCapacity(), kCapacity);
+
+    ShmRingRecord record;
+    Equals(reader.Next(record), false);
+    bool in_order = true;
+    for (int i = 0; i < 200; ++i) {
+      writer.Append(i % 3, Payload(i, 1000 + i % 7));
+      if (!reader.Next(record) || record.payload != Payload(i, 1000 + i % 7) || record.channel != i % 3) {
+        in_order = false;
+      }
+    }
+    Equals(in_order, true);
+    Equals(reader.Next(record), false);
+    Equals(reader.GetLost(), uint64_t{0});
+
+    // Payloads over a quarter of the ring are split into several records.
+    std::string large(kCapacity / 2, 'x');
+    writer.Append(7, large);
+    std::string joined;
+    int         records = 0;
+    while (reader.Next(record)) {
+      Equals(record.channel, uint32_t{7});
+      joined += record.payload;
+      ++records;
+    }
+    Equals(records, 3);
+    Equals(joined == large, true);
+  }
+
+  // A reader a lap behind skips to the oldest record still intact and counts what it lost.
+  {
+    ShmRingWriter writer{path, kCapacity};
+    ShmRingReader reader{path, false};
+    uint64_t      written = 0;
+    for (int i = 0; i < 300; ++i) {
+      auto payload = Payload(i, 500);
+      writer.Append(1, payload);
+      written += 16 + payload.size() + (8 - payload.size() % 8) % 8;
+    }
+
+    ShmRingRecord record;
+    uint64_t      read  = 0;
+    int           count = 0;
+    std::string   last;
+    bool          consecutive = true;
+    int           previous    = -1;
+    while (reader.Next(record)) {
+      auto index = std::stoi(std::string{record.payload.substr(0, record.payload.find(':'))});
+      consecutive &= previous < 0 || index == previous + 1;
+      previous = index;
+      read += 16 + record.payload.size() + (8 - record.payload.size() % 8) % 8;
+      ++count;
+    }
+    Equals(consecutive, true);
+    Equals(previous, 299);
+    Equals(count > 0 && count < 300, true);
+    Equals(reader.GetLost() > 0, true);
+    Equals(reader.GetLost() + read, written);
+
+    // A new reader starts at the oldest record, or at the end.
+    ShmRingReader oldest{path};
+    Equals(oldest.Next(record), true);
+    Equals(std::stoi(std::string{record.payload.substr(0, record.payload.find(':'))}), 300 - count);
+    ShmRingReader newest{path, false};
+    Equals(newest.Next(record), false);
+  }
+
+  // A record reserved but never committed is skipped after the pending timeout.
+  {
+    ::unlink(path.c_str());
+    ShmRingWriter writer{path, kCapacity};
+    ShmRingReader reader{path};
+    writer.Append(0, "before");
+    ReserveWithoutCommit(path, 32);
+    writer.Append(0, "after");
+
+    ShmRingRecord record;
+    Equals(reader.Next(record) && record.payload == "before", true);
+    reader.SetPendingTimeout(std::chrono::milliseconds(0));
+    Equals(reader.Next(record), false);  // the writer may still commit
+    Equals(reader.Next(record) && record.payload == "after", true);
+    Equals(reader.GetLost(), uint64_t{32});
+  }
+
+  // Reopening keeps the records of a ring with the same layout, another capacity starts over.
+  {
+    {
+      ShmRingWriter writer{path, kCapacity};
+    }
+    ShmRingRecord record;
+    ShmRingReader kept{path};
+    Equals(kept.Next(record) && record.payload == "before", true);
+
+    ShmRingWriter bigger{path, kCapacity * 2};
+    Equals(bigger.GetCapacity(), kCapacity * 2);
+    ShmRingReader fresh{path};
+    Equals(fresh.Next(record), false);
+  }
+
+  // Other files are refused.
+  {
+    std::ofstream{path, std::ios::trunc} << std::string(ShmRingHeader::kHeaderSize + kCapacity, 'z');
+    bool refused = false;
+    try {
+      ShmRingReader reader{path};
+    } catch (std::runtime_error const&) {
+      refused = true;
+    }
+    Equals(refused, true);
+  }
+  ::unlink(path.c_str());
+
+  auto [pass, total] = GetTestInfo();
+
+  if (pass != total) {
+    std::cout << "Passed " << pass << " out of " << total << " tests." << std::endl;
+  } else {
+    std::cout << "All tests passed!" << std::endl;
+  }
+
+  return 0;
+}
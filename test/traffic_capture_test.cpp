@@ -0,0 +1,72 @@
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+#include "test.hpp"
+
+#include "net/traffic_capture.hpp"
+
+int main(int argc, char* const argv[]) {
+  using namespace simple_http::net;
+
+  std::string path = "/tmp/traffic_capture_test." + std::to_string(::getpid()) + ".bin";
+  std::string large(CaptureFormat::kMaxPayload + 10, 'x');
+  {
+    auto capture = std::make_shared<TrafficCapture>(path, TrafficCaptureOptions{.sample = 0.5});
+    // Every other connection is sampled, the first one is not.
+    Equals(CaptureStream::Open(capture) == nullptr, true);
+    auto stream = CaptureStream::Open(capture);
+    Equals(stream != nullptr, true);
+    stream->Data("GET / HTTP/1.1\r\n\r\n");
+    stream->Data(large);
+    stream->Close();
+
+    // Streams of other threads are written alongside.
+    std::thread other([&capture] {
+      Equals(CaptureStream::Open(capture) == nullptr, true);
+      auto stream = CaptureStream::Open(capture);
+      stream->Data("ping");
+      stream->Close();
+    });
+    other.join();
+  }
+
+  TrafficCaptureReader       reader{path};
+  CaptureRecord              record;
+  std::vector<CaptureRecord> first;
+  std::vector<CaptureRecord> second;
+  while (reader.Next(record)) {
+    (record.connection == 2 ? first : second).push_back(record);
+  }
+  std::remove(path.c_str());
+
+  Equals(first.size(), std::size_t{5});
+  Equals(static_cast<int>(first[0].event), static_cast<int>(CaptureEvent::kOpen));
+  Equals(first[1].data, std::string{"GET / HTTP/1.1\r\n\r\n"});
+  // Large reads are split, the parts keep their order.
+  Equals(first[2].data.size(), CaptureFormat::kMaxPayload);
+  Equals(first[3].data.size(), std::size_t{10});
+  Equals(static_cast<int>(first[4].event), static_cast<int>(CaptureEvent::kClose));
+  for (std::size_t i = 0; i < first.size(); ++i) {
+    Equals(first[i].sequence, static_cast<uint32_t>(i));
+  }
+  Equals(first[4].time_ns >= first[0].time_ns, true);
+
+  Equals(second.size(), std::size_t{3});
+  Equals(second[0].connection, uint32_t{4});
+  Equals(second[1].data, std::string{"ping"});
+
+  auto [pass, total] = GetTestInfo();
+
+  if (pass != total) {
+    std::cout << "Passed " << pass << " out of " << total << " tests." << std::endl;
+  } else {
+    std::cout << "All tests passed!" << std::endl;
+  }
+
+  return 0;
+}
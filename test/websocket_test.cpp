@@ -0,0 +1,198 @@
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "test.hpp"
+
+#include "net/event_loop.hpp"
+#include "net/http/websocket.hpp"
+#include "net/tcp_connection.hpp"
+#include "utils/base64.hpp"
+#include "utils/sha1.hpp"
+
+namespace {
+constexpr char kMaskKey[] = "\x37\xfa\x21\x3d";
+
+// A frame as a client sends it, masked with kMaskKey.
+std::string ClientFrame(uint8_t first, std::string_view payload) {
+  std::string frame(1, static_cast<char>(first));
+  if (payload.size() < 126) {
+    frame.push_back(static_cast<char>(0x80 | payload.size()));
+  } else if (payload.size() <= 0xffff) {
+    frame.push_back(static_cast<char>(0x80 | 126));
+    frame.push_back(static_cast<char>(payload.size() >> 8));
+    frame.push_back(static_cast<char>(payload.size()));
+  } else {
+    frame.push_back(static_cast<char>(0x80 | 127));
+    for (int shift = 56; shift >= 0; shift -= 8) {
+      frame.push_back(static_cast<char>(static_cast<uint64_t>(payload.size()) >> shift));
+    }
+  }
+  frame.append(kMaskKey, 4);
+  auto offset = frame.size();
+  frame.append(payload);
+  uint32_t key = 0;
+  std::memcpy(&key, kMaskKey, sizeof(key));
+  simple_http::net::http::websocket::Mask(frame.data() + offset, payload.size(), key);
+  return frame;
+}
+
+// The head of a frame with a 64-bit length, the payload does not follow.
+std::string LongFrameHead(uint8_t first, uint64_t length) {
+  std::string head{static_cast<char>(first), static_cast<char>(0x80 | 127)};
+  for (int shift = 56; shift >= 0; shift -= 8) {
+    head.push_back(static_cast<char>(length >> shift));
+  }
+  head.append(kMaskKey, 4);
+  return head;
+}
+}  // namespace
+
+int main(int argc, char* const argv[]) {
+  using namespace simple_http::net;
+  using namespace simple_http::net::http;
+  using namespace simple_http::util;
+
+  auto digest = Sha1("abc");
+  Equals(Base64Encode({reinterpret_cast<char const*>(digest.data()), digest.size()}),
+         std::string("qZk+NkcGgWq6PiVxeFDCbJzQ2J0="));
+
+  // RFC 6455 1.3
+  Equals(websocket::AcceptKey("dGhlIHNhbXBsZSBub25jZQ=="), std::string("s3pPLMBiTxaQ9kYGzzhZRbK+xOo="));
+
+  // RFC 6455 5.7, a masked "Hello". Masking twice gives the original back, also in pieces.
+  std::string masked = "\x7f\x9f\x4d\x51\x58";
+  uint32_t    key    = 0;
+  std::memcpy(&key, "\x37\xfa\x21\x3d", 4);
+  websocket::Mask(masked.data(), masked.size(), key);
+  Equals(masked, std::string("Hello"));
+
+  std::string long_text(100, 'a');
+  std::string copy = long_text;
+  websocket::Mask(copy.data(), copy.size(), key);
+  websocket::Mask(copy.data(), 37, key);
+  websocket::Mask(copy.data() + 37, copy.size() - 37, key, 37);
+  Equals(copy, long_text);
+
+  std::string frame;
+  websocket::AppendFrame(WebSocketOpcode::kText, "Hello", true, frame);
+  Equals(frame, std::string("\x81\x05Hello"));
+  frame.clear();
+  websocket::AppendFrame(WebSocketOpcode::kBinary, std::string(256, 'x'), true, frame);
+  Equals(frame.substr(0, 4), std::string("\x82\x7e\x01\x00", 4));
+  frame.clear();
+  websocket::AppendFrame(WebSocketOpcode::kBinary, std::string(65536, 'x'), false, frame);
+  Equals(frame.substr(0, 10), std::string("\x02\x7f\x00\x00\x00\x00\x00\x01\x00\x00", 10));
+
+  Equals(websocket::IsValidUtf8("plain ascii text, longer than eight bytes"), true);
+  Equals(websocket::IsValidUtf8("\xce\xba\xe1\xbd\xb9\xcf\x83\xce\xbc\xce\xb5"), true);
+  Equals(websocket::IsValidUtf8("\xf0\x9f\x98\x80"), true);
+  Equals(websocket::IsValidUtf8("\xc0\xaf"), false);          // overlong
+  Equals(websocket::IsValidUtf8("\xed\xa0\x80"), false);      // surrogate
+  Equals(websocket::IsValidUtf8("\xf4\x90\x80\x80"), false);  // past U+10FFFF
+  Equals(websocket::IsValidUtf8("abc\xe1\xbd"), false);       // truncated
+
+  // Sessions over a connection that never runs, frames to the peer are dropped.
+  EventLoop                loop;
+  std::vector<std::string> messages;
+  std::vector<uint16_t>    close_codes;
+  WebSocketHandlers        handlers;
+  handlers.on_message = [&messages](WebSocketSessionPtr const&, std::string_view message, bool) {
+    messages.emplace_back(message);
+  };
+  handlers.on_close = [&close_codes](WebSocketSessionPtr const&, uint16_t code) { close_codes.push_back(code); };
+
+  WebSocketOptions options{.max_message_size = 16, .ping_interval = std::chrono::seconds{0}};
+  auto make_session = [&] {
+    int fds[2];
+    ::socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+    ::close(fds[1]);
+    auto conn = std::make_shared<TcpConnection>(&loop, fds[0], InetAddr{}, InetAddr{});
+    return std::make_pair(conn, std::make_shared<WebSocketSession>(conn, handlers, options));
+  };
+  auto now = std::chrono::steady_clock::now();
+
+  {
+    // A frame split across reads is handled once complete.
+    auto [conn, session] = make_session();
+    MsgBuffer buf;
+    auto      frame = ClientFrame(0x81, "Hello");
+    buf.Write(frame.data(), 3);
+    Equals(session->Receive(buf, now), true);
+    Equals(messages.empty(), true);
+    buf.Write(frame.data() + 3, frame.size() - 3);
+    Equals(session->Receive(buf, now), true);
+    Equals(messages.size(), std::size_t{1});
+    Equals(messages.back(), std::string("Hello"));
+    Equals(buf.ReadableSize(), std::size_t{0});
+
+    // Fragments are joined, control frames may come in between.
+    auto fragments = ClientFrame(0x01, "Hel") + ClientFrame(0x89, "") + ClientFrame(0x80, "lo!");
+    buf.Write(fragments.data(), fragments.size());
+    Equals(session->Receive(buf, now), true);
+    Equals(messages.back(), std::string("Hello!"));
+
+    // A close ends the session.
+    auto close = ClientFrame(0x88, std::string_view{"\x03\xe8", 2});
+    buf.Write(close.data(), close.size());
+    Equals(session->Receive(buf, now), false);
+    Equals(session->IsClosed(), true);
+    Equals(close_codes.size(), std::size_t{1});
+    Equals(close_codes.back(), websocket::kCloseNormal);
+  }
+
+  auto fails_with = [&](std::string const& data) {
+    auto [conn, session] = make_session();
+    close_codes.clear();
+    MsgBuffer buf;
+    buf.Write(data.data(), data.size());
+    return !session->Receive(buf, now) && close_codes.size() == 1 ? close_codes.front() : uint16_t{0};
+  };
+  // Unmasked, reserved bits, reserved opcode, fragmented or long control frames.
+  Equals(fails_with(std::string("\x81\x05Hello")), websocket::kCloseProtocolError);
+  Equals(fails_with(ClientFrame(0xc1, "x")), websocket::kCloseProtocolError);
+  Equals(fails_with(ClientFrame(0x83, "x")), websocket::kCloseProtocolError);
+  Equals(fails_with(ClientFrame(0x09, "")), websocket::kCloseProtocolError);
+  Equals(fails_with(ClientFrame(0x89, std::string(126, 'x'))), websocket::kCloseProtocolError);
+  Equals(fails_with(ClientFrame(0x80, "x")), websocket::kCloseProtocolError);  // nothing to continue
+  Equals(fails_with(ClientFrame(0x81, "\xc0\xaf")), websocket::kCloseInvalidPayload);
+  // The most significant bit of a 64-bit length is reserved.
+  Equals(fails_with(LongFrameHead(0x82, uint64_t{1} << 63)), websocket::kCloseProtocolError);
+  // Too long for max_message_size, alone or together with the fragments before it.
+  Equals(fails_with(ClientFrame(0x82, std::string(17, 'x'))), websocket::kCloseMessageTooBig);
+  Equals(fails_with(ClientFrame(0x02, std::string(10, 'x')) + ClientFrame(0x80, std::string(7, 'x'))),
+         websocket::kCloseMessageTooBig);
+  Equals(fails_with(ClientFrame(0x02, std::string(10, 'x')) + LongFrameHead(0x80, ~uint64_t{0} >> 1)),
+         websocket::kCloseMessageTooBig);
+
+  {
+    // A frame head alone does not make the buffer grow to the length it announces.
+    options.max_message_size = std::size_t{1} << 30;
+    auto [conn, session]     = make_session();
+    MsgBuffer buf;
+    auto      head     = LongFrameHead(0x82, std::size_t{1} << 29);
+    auto      writable = buf.WritableSize();
+    buf.Write(head.data(), head.size());
+    Equals(session->Receive(buf, now), true);
+    Equals(buf.ReadableSize(), head.size());
+    Equals(buf.WritableSize() + head.size(), writable);
+  }
+
+  auto [pass, total] = GetTestInfo();
+
+  if (pass != total) {
+    std::cout << "Passed " << pass << " out of " << total << " tests." << std::endl;
+  } else {
+    std::cout << "All tests passed!" << std::endl;
+  }
+
+  return 0;
+}
@@ -1,4 +1,77 @@
 target("msg_buffer_test")
   add_deps("simple_http_static")
 
-  add_files("msg_buffer_test.cpp")
\ No newline at end of file
+  add_files("msg_buffer_test.cpp")
+
+target("admission_controller_test")
+  add_deps("simple_http_static")
+
+  add_files("admission_controller_test.cpp")
+target("latency_histogram_test")
+  add_deps("simple_http_static")
+
+  add_files("latency_histogram_test.cpp")
+target("hpack_test")
+  add_deps("simple_http_static")
+
+  add_files("hpack_test.cpp")
+target("websocket_test")
+  add_deps("simple_http_static")
+
+  add_files("websocket_test.cpp")
+target("byte_range_test")
+  add_deps("simple_http_static")
+
+  add_files("byte_range_test.cpp")
+target("perfect_hash_test")
+  add_deps("simple_http_static")
+
+  add_files("perfect_hash_test.cpp")
+target("traffic_capture_test")
+  add_deps("simple_http_static")
+
+  add_files("traffic_capture_test.cpp")
+target("event_loop_group_test")
+  add_deps("simple_http_static")
+
+  add_files("event_loop_group_test.cpp")
+target("metrics_test")
+  add_deps("simple_http_static")
+
+  add_files("metrics_test.cpp")
+target("log_stream_test")
+  add_deps("simple_http_static")
+
+  add_files("log_stream_test.cpp")
+target("access_log_test")
+  add_deps("simple_http_static")
+
+  add_files("access_log_test.cpp")
+target("shm_ring_test")
+  add_deps("simple_http_static")
+
+  add_files("shm_ring_test.cpp")
+target("response_parser_test")
+  add_deps("simple_http_static")
+
+  add_files("response_parser_test.cpp")
+target("reverse_proxy_test")
+  add_deps("simple_http_static")
+
+  add_files("reverse_proxy_test.cpp")
+target("response_cache_test")
+  add_deps("simple_http_static")
+
+  add_files("response_cache_test.cpp")
+target("compression_test")
+  add_deps("simple_http_static")
+
+  add_files("compression_test.cpp")
+target("http2_session_test")
+  add_deps("simple_http_static")
+
+  add_files("http2_session_test.cpp")
+target("event_stream_test")
+  add_deps("simple_http_static")
+
+  add_files("event_stream_test.cpp")
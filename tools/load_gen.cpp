@@ -0,0 +1,498 @@
+/**
+ * @file load_gen.cpp
+ * @author Qirui Wang (qirui.wang@moegi.waseda.jp)
+ * @brief HTTP/1.1 load generator with closed and open (constant rate) loops and latency percentiles
+ * @version 0.1
+ * @date 2023-03-05
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <future>
+#include <limits>
+#include <memory>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <unistd.h>
+
+#include "net/event_loop_group.hpp"
+#include "net/http/response_parser.hpp"
+#include "net/inet_addr.hpp"
+#include "net/tcp_client.hpp"
+#include "utils/latency_histogram.hpp"
+#include "utils/msg_buffer.hpp"
+
+using namespace std;
+using namespace simple_http;
+using namespace simple_http::net;
+
+namespace {
+using Clock     = chrono::steady_clock;
+using Timepoint = Clock::time_point;
+
+constexpr auto        kRetryDelay      = chrono::milliseconds(100);  // after a failed connect
+constexpr std::size_t kMaxResponseSize = 64 * 1024 * 1024;
+
+struct Options {
+  string   host{"127.0.0.1"};
+  uint16_t port{12345};
+  int      connections{16};
+  int      threads{2};
+  int      depth{1};  // requests in flight per connection
+  double   rate{0};   // requests per second in total, 0 for a closed loop
+  double   duration{10};
+  double   warmup{1};
+  bool     json{false};
+
+  vector<pair<string, unsigned>> mix;  // serialized requests and their weights
+};
+
+struct Stats {
+  util::LatencyHistogram latency;  // from the intended send time, corrected for coordinated omission
+  util::LatencyHistogram service;  // from the actual send time
+  uint64_t               responses{0};
+  uint64_t               non_2xx{0};
+  uint64_t               errors{0};  // connects failed, connections lost and malformed responses
+  uint64_t               bytes{0};   // received
+
+  void Merge(Stats const& other) {
+    latency.Merge(other.latency);
+    service.Merge(other.service);
+    responses += other.responses;
+    non_2xx   += other.non_2xx;
+    errors    += other.errors;
+    bytes     += other.bytes;
+  }
+};
+
+// A connection of the generator, it keeps up to depth requests in flight.
+struct Connection {
+  struct Request {
+    Timepoint intended;
+    Timepoint sent;
+  };
+
+  unique_ptr<TcpClient>    client;
+  http::ResponseParser     parser;
+  deque<Request>           in_flight;
+  deque<Timepoint>         backlog;  // open loop, due but not sent because depth requests are in flight
+  uint64_t                 scheduled{0};
+  double                   phase{0};  // open loop, the connection sends at phase + k of the interval
+  mt19937                  rng;
+  discrete_distribution<>* pick{nullptr};
+};
+
+/**
+ * @brief The connections of one loop. Everything is touched on the loop thread only, the stats
+ * are read once the run ended.
+ *
+ */
+struct Worker {
+ public:
+  Worker(EventLoop* loop, Options const& options, InetAddr const& addr, int connections, int first)
+      : loop_(loop), options_(options) {
+    vector<double> weights;
+    for (auto const& [request, weight] : options.mix) {
+      weights.push_back(weight);
+    }
+    pick_ = discrete_distribution<>(weights.begin(), weights.end());
+
+    for (int i = 0; i < connections; ++i) {
+      auto conn    = make_unique<Connection>();
+      conn->client = make_unique<TcpClient>(loop, addr);
+      conn->rng.seed(first + i);  // reproducible request sequences
+      // Connections take turns, so that requests are spread evenly over the interval.
+      conn->phase = static_cast<double>(first + i) / options.connections;
+      conn->pick = &pick_;
+      connections_.push_back(std::move(conn));
+    }
+  }
+
+  void Start(Timepoint begin, Timepoint record_from, Timepoint end) {
+    begin_       = begin;
+    record_from_ = record_from;
+    end_         = end;
+    if (options_.rate > 0) {
+      interval_ = chrono::duration<double>(options_.connections / options_.rate);
+    }
+    for (auto& conn : connections_) {
+      auto* raw = conn.get();
+      raw->client->OnConnection([this, raw](auto const& tcp) {
+        if (tcp->IsConnected()) {
+          Pump(*raw);
+        } else {
+          Lost(*raw, Clock::duration::zero());
+        }
+      });
+      raw->client->OnReceiveMessage([this, raw](auto const& /*unused*/, util::MsgBuffer& buf) { Receive(*raw, buf); });
+      raw->client->OnConnectError([this, raw](int /*unused*/) {
+        ++stats_.errors;
+        Lost(*raw, kRetryDelay);
+      });
+      raw->client->Connect();
+    }
+    if (options_.rate > 0) {
+      timer_ = loop_->RunAt(begin_, [this] { Schedule(); });
+    }
+  }
+
+  // Close every connection, on the loop thread.
+  void Stop() {
+    stopped_ = true;
+    if (options_.rate > 0) {
+      loop_->Cancel(timer_);
+    }
+    connections_.clear();
+  }
+
+  [[nodiscard]] Stats const& GetStats() const { return stats_; }
+
+ private:
+  EventLoop*                     loop_;
+  Options const&                 options_;
+  vector<unique_ptr<Connection>> connections_;
+  discrete_distribution<>        pick_;
+  Stats                          stats_;
+  Timepoint                      begin_;
+  Timepoint                      record_from_;
+  Timepoint                      end_;
+  chrono::duration<double>       interval_{0};
+  TimerId                        timer_{};
+  bool                           stopped_{false};
+
+  // Open loop: queue every request whose time came on each connection, and wake up again when
+  // the next one is due.
+  void Schedule() {
+    auto now = Clock::now();
+    if (stopped_ || now >= end_) {
+      return;
+    }
+    auto elapsed = chrono::duration<double>(now - begin_) / interval_;
+    auto next    = end_;
+    for (auto& conn : connections_) {
+      for (; static_cast<double>(conn->scheduled) + conn->phase <= elapsed; ++conn->scheduled) {
+        conn->backlog.push_back(IntendedTime(*conn, conn->scheduled));
+      }
+      next = min(next, IntendedTime(*conn, conn->scheduled));
+      Pump(*conn);
+    }
+    timer_ = loop_->RunAt(next, [this] { Schedule(); });
+  }
+
+  [[nodiscard]] Timepoint IntendedTime(Connection const& conn, uint64_t k) const {
+    return begin_ + chrono::duration_cast<Clock::duration>(interval_ * (static_cast<double>(k) + conn.phase));
+  }
+
+  void Pump(Connection& conn) {
+    auto const& tcp = conn.client->GetConnection();
+    if (stopped_ || !tcp || !tcp->IsConnected()) {
+      return;
+    }
+    auto now = Clock::now();
+    while (now < end_ && conn.in_flight.size() < static_cast<size_t>(options_.depth)) {
+      Timepoint intended = now;
+      if (options_.rate > 0) {
+        if (conn.backlog.empty()) {
+          break;
+        }
+        intended = conn.backlog.front();
+        conn.backlog.pop_front();
+      }
+      if (conn.in_flight.empty()) {
+        conn.parser.Reset(false, kMaxResponseSize, numeric_limits<size_t>::max());
+      }
+      conn.in_flight.push_back({intended, now});
+      tcp->Send(options_.mix[(*conn.pick)(conn.rng)].first);
+    }
+  }
+
+  void Receive(Connection& conn, util::MsgBuffer& buf) {
+    stats_.bytes += buf.ReadableSize();
+    while (buf.ReadableSize() > 0) {
+      if (conn.in_flight.empty() || !conn.parser.Parse(buf)) {
+        Fail(conn);
+        return;
+      }
+      if (!conn.parser.Complete()) {
+        return;
+      }
+      bool keep_alive = conn.parser.KeepAlive();
+      Completed(conn);
+      if (!keep_alive) {
+        // The server closes, the connection is opened again once it did.
+        return;
+      }
+    }
+    Pump(conn);
+  }
+
+  void Completed(Connection& conn) {
+    auto now     = Clock::now();
+    auto request = conn.in_flight.front();
+    conn.in_flight.pop_front();
+    if (now >= record_from_ && now < end_) {
+      auto code = static_cast<int>(conn.parser.GetResponse().GetStatusCode());
+      ++stats_.responses;
+      stats_.non_2xx += code / 100 != 2 ? 1 : 0;
+      stats_.latency.Record(chrono::duration_cast<chrono::nanoseconds>(now - request.intended).count());
+      stats_.service.Record(chrono::duration_cast<chrono::nanoseconds>(now - request.sent).count());
+    }
+    conn.parser.Reset(false, kMaxResponseSize, numeric_limits<size_t>::max());
+  }
+
+  void Fail(Connection& conn) {
+    ++stats_.errors;
+    conn.in_flight.clear();
+    if (auto const& tcp = conn.client->GetConnection(); tcp) {
+      tcp->Shutdown();
+    }
+  }
+
+  // Requests in flight are lost, those of the open loop are sent again with their intended times.
+  void Lost(Connection& conn, Clock::duration retry_after) {
+    // A body without length ends with the connection.
+    if (!conn.in_flight.empty() && conn.parser.FinishAtClose()) {
+      Completed(conn);
+    }
+    if (Clock::now() < end_) {
+      stats_.errors += conn.in_flight.size();
+    }
+    if (options_.rate > 0) {
+      for (auto it = conn.in_flight.rbegin(); it != conn.in_flight.rend(); ++it) {
+        conn.backlog.push_front(it->intended);
+      }
+    }
+    conn.in_flight.clear();
+    if (!stopped_ && Clock::now() < end_ && !conn.client->IsConnecting()) {
+      // Connect again from the loop, not from inside the handler of the connection that closed.
+      loop_->RunAfter(retry_after, [client = conn.client.get(), this] {
+        if (!stopped_) {
+          client->Connect();
+        }
+      });
+    }
+  }
+};
+
+bool ParseTarget(string_view target, Options& options) {
+  auto colon = target.rfind(':');
+  if (colon == string_view::npos) {
+    return false;
+  }
+  options.host = string{target.substr(0, colon)};
+  options.port = static_cast<uint16_t>(atoi(string{target.substr(colon + 1)}.c_str()));
+  return options.port != 0;
+}
+
+// "GET /path" or "POST /path:3", the weight defaults to 1.
+bool AddRequest(string_view spec, string const& body, vector<string> const& fields, Options& options) {
+  auto space = spec.find(' ');
+  if (space == string_view::npos) {
+    return false;
+  }
+  auto     method = spec.substr(0, space);
+  auto     path   = spec.substr(space + 1);
+  unsigned weight = 1;
+  if (auto colon = path.rfind(':'); colon != string_view::npos && colon + 1 < path.size() &&
+                                    path.find_first_not_of("0123456789", colon + 1) == string_view::npos) {
+    weight = static_cast<unsigned>(atoi(string{path.substr(colon + 1)}.c_str()));
+    path   = path.substr(0, colon);
+  }
+  if (path.empty() || path[0] != '/' || weight == 0) {
+    return false;
+  }
+
+  string request{method};
+  request += ' ';
+  request += path;
+  request += " HTTP/1.1\r\nHost: " + options.host + ':' + to_string(options.port) + "\r\n";
+  for (auto const& field : fields) {
+    request += field + "\r\n";
+  }
+  bool with_body = method == "POST" || method == "PUT";
+  if (with_body) {
+    request += "Content-Length: " + to_string(body.size()) + "\r\n";
+  }
+  request += "\r\n";
+  if (with_body) {
+    request += body;
+  }
+  options.mix.emplace_back(std::move(request), weight);
+  return true;
+}
+
+void PrintLatency(char const* name, util::LatencyHistogram const& histogram) {
+  auto ms = [&](double quantile) { return static_cast<double>(histogram.ValueAtQuantile(quantile)) / 1e6; };
+  printf("  %-8s mean %8.3fms  p50 %8.3fms  p90 %8.3fms  p99 %8.3fms  p99.9 %8.3fms  p99.99 %8.3fms  max %8.3fms\n",
+         name, histogram.GetMean() / 1e6, ms(0.5), ms(0.9), ms(0.99), ms(0.999), ms(0.9999),
+         static_cast<double>(histogram.GetMax()) / 1e6);
+}
+
+void PrintLatencyJson(char const* name, util::LatencyHistogram const& histogram, bool last) {
+  printf("  \"%s_ns\": {\"mean\": %.0f, \"p50\": %llu, \"p90\": %llu, \"p99\": %llu, \"p999\": %llu, "
+         "\"p9999\": %llu, \"max\": %llu}%s\n",
+         name, histogram.GetMean(), static_cast<unsigned long long>(histogram.ValueAtQuantile(0.5)),
+         static_cast<unsigned long long>(histogram.ValueAtQuantile(0.9)),
+         static_cast<unsigned long long>(histogram.ValueAtQuantile(0.99)),
+         static_cast<unsigned long long>(histogram.ValueAtQuantile(0.999)),
+         static_cast<unsigned long long>(histogram.ValueAtQuantile(0.9999)),
+         static_cast<unsigned long long>(histogram.GetMax()), last ? "" : ",");
+}
+
+void Usage(char const* name) {
+  fprintf(stderr,
+          "Usage: %s [options] [host:port]\n"
+          "  -c N        connections, default 16\n"
+          "  -t N        loop threads, default 2\n"
+          "  -d SECONDS  measured duration, default 10\n"
+          "  -w SECONDS  warmup before measuring, default 1\n"
+          "  -p N        requests pipelined per connection, default 1\n"
+          "  -R N        open loop at N requests/s in total, latency counted from the intended send\n"
+          "              time; without it every connection sends as soon as a response came back\n"
+          "  -r SPEC     a request of the mix, \"GET /path\" or \"POST /path:WEIGHT\", default \"GET /\"\n"
+          "  -b BODY     body of POST and PUT requests\n"
+          "  -H FIELD    extra request field, \"Name: value\"\n"
+          "  -j          print the results as JSON\n"
+          "The target defaults to 127.0.0.1:12345, example_http_server.\n",
+          name);
+}
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  Options        options;
+  vector<string> specs;
+  vector<string> fields;
+  string         body;
+
+  int opt;
+  while ((opt = ::getopt(argc, argv, "c:t:d:w:p:R:r:b:H:j")) != -1) {
+    switch (opt) {
+      case 'c':
+        options.connections = atoi(optarg);
+        break;
+      case 't':
+        options.threads = atoi(optarg);
+        break;
+      case 'd':
+        options.duration = atof(optarg);
+        break;
+      case 'w':
+        options.warmup = atof(optarg);
+        break;
+      case 'p':
+        options.depth = atoi(optarg);
+        break;
+      case 'R':
+        options.rate = atof(optarg);
+        break;
+      case 'r':
+        specs.emplace_back(optarg);
+        break;
+      case 'b':
+        body = optarg;
+        break;
+      case 'H':
+        fields.emplace_back(optarg);
+        break;
+      case 'j':
+        options.json = true;
+        break;
+      default:
+        Usage(argv[0]);
+        return 1;
+    }
+  }
+  if ((optind < argc && !ParseTarget(argv[optind], options)) || options.connections < 1 || options.threads < 1 ||
+      options.depth < 1 || options.duration <= 0 || options.warmup < 0 || options.rate < 0) {
+    Usage(argv[0]);
+    return 1;
+  }
+  options.threads = min(options.threads, options.connections);
+  if (specs.empty()) {
+    specs.emplace_back("GET /");
+  }
+  for (auto const& spec : specs) {
+    if (!AddRequest(spec, body, fields, options)) {
+      fprintf(stderr, "Bad request spec: %s\n", spec.c_str());
+      return 1;
+    }
+  }
+
+  InetAddr addr{options.host, options.port};
+  auto     group = make_unique<EventLoopGroup>(options.threads);
+  group->Start();
+
+  vector<unique_ptr<Worker>> workers;
+  for (int i = 0, first = 0; i < options.threads; ++i) {
+    int count = options.connections / options.threads + (i < options.connections % options.threads ? 1 : 0);
+    workers.push_back(make_unique<Worker>(group->GetEventLoop(i), options, addr, count, first));
+    first += count;
+  }
+
+  auto begin       = Clock::now() + chrono::milliseconds(10);
+  auto record_from = begin + chrono::duration_cast<Clock::duration>(chrono::duration<double>(options.warmup));
+  auto end = record_from + chrono::duration_cast<Clock::duration>(chrono::duration<double>(options.duration));
+  for (int i = 0; i < options.threads; ++i) {
+    group->GetEventLoop(i)->RunInLoop(
+        [worker = workers[i].get(), begin, record_from, end] { worker->Start(begin, record_from, end); });
+  }
+
+  if (!options.json) {
+    printf("Running %.0fs (after %.0fs warmup) @ %s:%u, %d threads, %d connections, depth %d, ", options.duration,
+           options.warmup, options.host.c_str(), options.port, options.threads, options.connections, options.depth);
+    if (options.rate > 0) {
+      printf("open loop at %.0f requests/s\n", options.rate);
+    } else {
+      printf("closed loop\n");
+    }
+    fflush(stdout);
+  }
+  this_thread::sleep_until(end);
+
+  Stats total;
+  for (int i = 0; i < options.threads; ++i) {
+    promise<void> stopped;
+    group->GetEventLoop(i)->RunInLoop([&, worker = workers[i].get()] {
+      worker->Stop();
+      total.Merge(worker->GetStats());
+      stopped.set_value();
+    });
+    stopped.get_future().wait();
+  }
+  group.reset();
+
+  double seconds = options.duration;
+  if (options.json) {
+    printf("{\n  \"connections\": %d, \"threads\": %d, \"depth\": %d, \"rate\": %.0f, \"duration_s\": %.3f,\n",
+           options.connections, options.threads, options.depth, options.rate, seconds);
+    printf("  \"responses\": %llu, \"non_2xx\": %llu, \"errors\": %llu, \"requests_per_second\": %.1f, "
+           "\"bytes_per_second\": %.0f,\n",
+           static_cast<unsigned long long>(total.responses), static_cast<unsigned long long>(total.non_2xx),
+           static_cast<unsigned long long>(total.errors), static_cast<double>(total.responses) / seconds,
+           static_cast<double>(total.bytes) / seconds);
+    PrintLatencyJson("latency", total.latency, false);
+    PrintLatencyJson("service", total.service, true);
+    printf("}\n");
+    return 0;
+  }
+
+  printf("  %llu responses in %.1fs, %.1f requests/s, %.2f MB/s received\n",
+         static_cast<unsigned long long>(total.responses), seconds, static_cast<double>(total.responses) / seconds,
+         static_cast<double>(total.bytes) / seconds / 1e6);
+  printf("  %llu non-2xx responses, %llu errors\n", static_cast<unsigned long long>(total.non_2xx),
+         static_cast<unsigned long long>(total.errors));
+  PrintLatency("latency", total.latency);
+  if (options.rate > 0) {
+    // Without queueing behind slow responses, what a closed loop tool would have reported.
+    PrintLatency("service", total.service);
+  }
+  return 0;
+}
@@ -0,0 +1,565 @@
+/**
+ * @file replay.cpp
+ * @author Qirui Wang (qirui.wang@moegi.waseda.jp)
+ * @brief Plays a traffic capture back against a server and reports how it kept up
+ * @version 0.1
+ * @date 2023-03-06
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <exception>
+#include <future>
+#include <limits>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+#include "net/event_loop_group.hpp"
+#include "net/http/response_parser.hpp"
+#include "net/inet_addr.hpp"
+#include "net/tcp_client.hpp"
+#include "net/traffic_capture.hpp"
+#include "utils/latency_histogram.hpp"
+#include "utils/msg_buffer.hpp"
+#include "utils/perfect_hash.hpp"
+
+using namespace std;
+using namespace simple_http;
+using namespace simple_http::net;
+
+namespace {
+using Clock     = chrono::steady_clock;
+using Timepoint = Clock::time_point;
+
+constexpr std::size_t kMaxResponseSize = 64 * 1024 * 1024;
+
+struct Options {
+  string   host{"127.0.0.1"};
+  uint16_t port{12345};
+  int      threads{2};
+  double   speed{1};  // 0 sends everything as fast as possible
+  double   grace{5};  // seconds to wait for responses after the last send
+  bool     pipeline{false};
+  bool     json{false};
+};
+
+// What one captured connection sent, and where its HTTP/1.1 requests end in it.
+struct Session {
+  struct Chunk {
+    uint64_t time_ns;
+    string   data;
+  };
+  struct Request {
+    std::size_t end;  // offset in the stream just past the request
+    bool        head;
+  };
+
+  uint64_t        open_ns{0};
+  uint64_t        close_ns{0};
+  uint32_t        next_sequence{0};
+  bool            truncated{false};  // records were dropped, what follows the gap is left out
+  vector<Chunk>   chunks;
+  vector<Request> requests;
+};
+
+// Find the requests of a stream so that responses can be matched to them. Framing stops at what
+// it can't follow: HTTP/2, upgrades and chunked request bodies. Bytes after that are still sent.
+void FrameRequests(Session& session) {
+  string stream;
+  for (auto const& chunk : session.chunks) {
+    stream += chunk.data;
+  }
+  std::size_t offset = 0;
+  while (offset < stream.size()) {
+    string_view rest{stream.data() + offset, stream.size() - offset};
+    auto        fields_end = rest.find("\r\n\r\n");
+    if (rest.starts_with("PRI * HTTP/2.0") || fields_end == string_view::npos) {
+      return;
+    }
+    auto        head    = rest.substr(0, fields_end);
+    auto        method  = head.substr(0, head.find(' '));
+    std::size_t content = 0;
+    for (auto line_end = head.find("\r\n"); line_end != string_view::npos;) {
+      auto line  = head.substr(line_end + 2);
+      auto next  = line.find("\r\n");
+      line       = line.substr(0, next);
+      line_end   = next == string_view::npos ? next : line_end + 2 + next;
+      auto colon = line.find(':');
+      if (colon == string_view::npos) {
+        continue;
+      }
+      auto name  = line.substr(0, colon);
+      auto value = line.substr(colon + 1);
+      value.remove_prefix(min(value.find_first_not_of(' '), value.size()));
+      if (util::EqualsIgnoreCase(name, "Content-Length")) {
+        content = strtoull(string{value}.c_str(), nullptr, 10);
+      } else if (util::EqualsIgnoreCase(name, "Transfer-Encoding") || util::EqualsIgnoreCase(name, "Upgrade")) {
+        return;
+      }
+    }
+    auto end = offset + fields_end + 4 + content;
+    if (end > stream.size()) {
+      return;
+    }
+    session.requests.push_back({end, method == "HEAD"});
+    offset = end;
+  }
+}
+
+// Sessions by connection, in the order they opened.
+vector<Session> LoadCapture(string const& path, uint64_t& dropped) {
+  TrafficCaptureReader   reader{path};
+  map<uint32_t, Session> sessions;
+  CaptureRecord          record;
+  while (reader.Next(record)) {
+    auto& session = sessions[record.connection];
+    if (session.truncated) {
+      continue;
+    }
+    if (record.sequence != session.next_sequence) {
+      session.truncated = true;
+      ++dropped;
+      continue;
+    }
+    ++session.next_sequence;
+    session.close_ns = record.time_ns;
+    if (record.event == CaptureEvent::kOpen) {
+      session.open_ns = record.time_ns;
+    } else if (record.event == CaptureEvent::kData) {
+      session.chunks.push_back({record.time_ns, std::move(record.data)});
+    }
+  }
+
+  vector<Session> result;
+  for (auto& [id, session] : sessions) {
+    // Without its opening the connection was dropped from the start.
+    if (session.next_sequence > 0) {
+      FrameRequests(session);
+      result.push_back(std::move(session));
+    }
+  }
+  sort(result.begin(), result.end(), [](auto const& a, auto const& b) { return a.open_ns < b.open_ns; });
+  return result;
+}
+
+struct Stats {
+  util::LatencyHistogram latency;  // from the time the request was due by the capture
+  util::LatencyHistogram service;  // from the time it was actually sent
+  util::LatencyHistogram lag;      // how late chunks were sent compared with the capture
+  uint64_t               responses{0};
+  uint64_t               non_2xx{0};
+  uint64_t               errors{0};  // failed connects, unanswered requests and malformed responses
+  uint64_t               unsent{0};  // chunks left when the connection was lost
+  uint64_t               bytes{0};   // received
+
+  void Merge(Stats const& other) {
+    latency.Merge(other.latency);
+    service.Merge(other.service);
+    lag.Merge(other.lag);
+    responses += other.responses;
+    non_2xx   += other.non_2xx;
+    errors    += other.errors;
+    unsent    += other.unsent;
+    bytes     += other.bytes;
+  }
+};
+
+// A captured connection being played back.
+struct Connection {
+  struct Request {
+    Timepoint intended;
+    Timepoint sent;
+    bool      head;
+  };
+
+  Session const*        session{nullptr};
+  unique_ptr<TcpClient> client;
+  http::ResponseParser  parser;
+  deque<Request>        in_flight;
+  std::size_t           next_chunk{0};
+  std::size_t           next_request{0};
+  std::size_t           sent_bytes{0};
+  bool                  closing{false};
+  bool                  done{false};
+};
+
+/**
+ * @brief The connections replayed on one loop. Everything is touched on the loop thread only,
+ * the stats are read once the run ended.
+ *
+ */
+struct Worker {
+ public:
+  Worker(EventLoop* loop, Options const& options, atomic<size_t>& remaining)
+      : loop_(loop), options_(options), remaining_(remaining) {}
+
+  void Add(Session const& session, InetAddr const& addr) {
+    auto conn     = make_unique<Connection>();
+    conn->session = &session;
+    conn->client  = make_unique<TcpClient>(loop_, addr);
+    connections_.push_back(std::move(conn));
+  }
+
+  void Start(Timepoint begin, uint64_t base_ns) {
+    begin_   = begin;
+    base_ns_ = base_ns;
+    for (auto& conn : connections_) {
+      auto* raw = conn.get();
+      raw->client->OnConnection([this, raw](auto const& tcp) {
+        if (tcp->IsConnected()) {
+          Pump(*raw);
+        } else {
+          Lost(*raw);
+        }
+      });
+      raw->client->OnReceiveMessage([this, raw](auto const& /*unused*/, util::MsgBuffer& buf) { Receive(*raw, buf); });
+      raw->client->OnConnectError([this, raw](int /*unused*/) {
+        ++stats_.errors;
+        Lost(*raw);
+      });
+      loop_->RunAt(At(raw->session->open_ns), [this, raw] {
+        if (!stopped_) {
+          raw->client->Connect();
+        }
+      });
+    }
+  }
+
+  // Close every connection, on the loop thread.
+  void Stop() {
+    stopped_ = true;
+    for (auto& conn : connections_) {
+      if (!conn->done) {
+        stats_.errors += conn->in_flight.size();
+        stats_.unsent += conn->session->chunks.size() - conn->next_chunk;
+      }
+    }
+    connections_.clear();
+  }
+
+  [[nodiscard]] Stats const& GetStats() const { return stats_; }
+
+ private:
+  EventLoop*                     loop_;
+  Options const&                 options_;
+  atomic<size_t>&                remaining_;
+  vector<unique_ptr<Connection>> connections_;
+  Stats                          stats_;
+  Timepoint                      begin_;
+  uint64_t                       base_ns_{0};
+  bool                           stopped_{false};
+
+  // When an event of the capture is due in the replay.
+  [[nodiscard]] Timepoint At(uint64_t time_ns) const {
+    if (options_.speed <= 0) {
+      return begin_;
+    }
+    auto offset = chrono::duration<double, nano>(static_cast<double>(time_ns - base_ns_) / options_.speed);
+    return begin_ + chrono::duration_cast<Clock::duration>(offset);
+  }
+
+  // Send the chunks that are due, in order, and wake up again for the next one.
+  void Pump(Connection& conn) {
+    auto const& tcp = conn.client->GetConnection();
+    if (stopped_ || conn.done || !tcp || !tcp->IsConnected()) {
+      return;
+    }
+    auto const& session = *conn.session;
+    auto        now     = Clock::now();
+    for (; conn.next_chunk < session.chunks.size(); ++conn.next_chunk) {
+      // Clients wait for the response before the next request, unless the server is to be
+      // driven at the captured pace whatever it answers.
+      if (!options_.pipeline && !conn.in_flight.empty()) {
+        return;
+      }
+      auto const& chunk    = session.chunks[conn.next_chunk];
+      auto        intended = options_.speed > 0 ? At(chunk.time_ns) : now;  // at max speed nothing is late
+      if (intended > now) {
+        loop_->RunAt(intended, [this, &conn] {
+          if (!stopped_) {
+            Pump(conn);
+          }
+        });
+        return;
+      }
+      stats_.lag.Record(chrono::duration_cast<chrono::nanoseconds>(now - intended).count());
+      tcp->Send(chunk.data);
+      conn.sent_bytes += chunk.data.size();
+      for (; conn.next_request < session.requests.size() && session.requests[conn.next_request].end <= conn.sent_bytes;
+           ++conn.next_request) {
+        bool head = session.requests[conn.next_request].head;
+        if (conn.in_flight.empty()) {
+          conn.parser.Reset(head, kMaxResponseSize, numeric_limits<size_t>::max());
+        }
+        conn.in_flight.push_back({intended, now, head});
+      }
+    }
+    MaybeClose(conn);
+  }
+
+  // Half close like the client did, once everything was sent and answered.
+  void MaybeClose(Connection& conn) {
+    auto const& tcp = conn.client->GetConnection();
+    if (conn.closing || conn.next_chunk < conn.session->chunks.size() || !conn.in_flight.empty() || !tcp) {
+      return;
+    }
+    auto at = At(conn.session->close_ns);
+    if (at > Clock::now()) {
+      conn.closing = true;
+      loop_->RunAt(at, [this, &conn] {
+        if (!stopped_) {
+          conn.closing = false;
+          MaybeClose(conn);
+        }
+      });
+      return;
+    }
+    conn.closing = true;
+    tcp->Shutdown();
+  }
+
+  void Receive(Connection& conn, util::MsgBuffer& buf) {
+    stats_.bytes += buf.ReadableSize();
+    while (buf.ReadableSize() > 0) {
+      if (conn.in_flight.empty()) {
+        // Answers to what could not be framed.
+        buf.RetrieveAll();
+        break;
+      }
+      if (!conn.parser.Parse(buf)) {
+        ++stats_.errors;
+        conn.in_flight.clear();
+        conn.client->GetConnection()->Shutdown();
+        return;
+      }
+      if (!conn.parser.Complete()) {
+        return;
+      }
+      Completed(conn);
+    }
+    Pump(conn);
+  }
+
+  void Completed(Connection& conn) {
+    auto now     = Clock::now();
+    auto request = conn.in_flight.front();
+    conn.in_flight.pop_front();
+    auto code = static_cast<int>(conn.parser.GetResponse().GetStatusCode());
+    ++stats_.responses;
+    stats_.non_2xx += code / 100 != 2 ? 1 : 0;
+    stats_.latency.Record(chrono::duration_cast<chrono::nanoseconds>(now - request.intended).count());
+    stats_.service.Record(chrono::duration_cast<chrono::nanoseconds>(now - request.sent).count());
+    if (!conn.in_flight.empty()) {
+      conn.parser.Reset(conn.in_flight.front().head, kMaxResponseSize, numeric_limits<size_t>::max());
+    }
+  }
+
+  // A replayed connection is not opened again, what it did not send is counted.
+  void Lost(Connection& conn) {
+    if (conn.done) {
+      return;
+    }
+    if (!conn.in_flight.empty() && conn.parser.FinishAtClose()) {
+      Completed(conn);
+    }
+    conn.done      = true;
+    stats_.errors += conn.in_flight.size();
+    stats_.unsent += conn.session->chunks.size() - conn.next_chunk;
+    conn.in_flight.clear();
+    remaining_.fetch_sub(1, memory_order_relaxed);
+  }
+};
+
+bool ParseTarget(string_view target, Options& options) {
+  auto colon = target.rfind(':');
+  if (colon == string_view::npos) {
+    return false;
+  }
+  options.host = string{target.substr(0, colon)};
+  options.port = static_cast<uint16_t>(atoi(string{target.substr(colon + 1)}.c_str()));
+  return options.port != 0;
+}
+
+void PrintLatency(char const* name, util::LatencyHistogram const& histogram) {
+  auto ms = [&](double quantile) { return static_cast<double>(histogram.ValueAtQuantile(quantile)) / 1e6; };
+  printf("  %-8s mean %8.3fms  p50 %8.3fms  p90 %8.3fms  p99 %8.3fms  p99.9 %8.3fms  max %8.3fms\n", name,
+         histogram.GetMean() / 1e6, ms(0.5), ms(0.9), ms(0.99), ms(0.999),
+         static_cast<double>(histogram.GetMax()) / 1e6);
+}
+
+void PrintLatencyJson(char const* name, util::LatencyHistogram const& histogram, bool last) {
+  printf("  \"%s_ns\": {\"mean\": %.0f, \"p50\": %llu, \"p90\": %llu, \"p99\": %llu, \"p999\": %llu, "
+         "\"max\": %llu}%s\n",
+         name, histogram.GetMean(), static_cast<unsigned long long>(histogram.ValueAtQuantile(0.5)),
+         static_cast<unsigned long long>(histogram.ValueAtQuantile(0.9)),
+         static_cast<unsigned long long>(histogram.ValueAtQuantile(0.99)),
+         static_cast<unsigned long long>(histogram.ValueAtQuantile(0.999)),
+         static_cast<unsigned long long>(histogram.GetMax()), last ? "" : ",");
+}
+
+void Usage(char const* name) {
+  fprintf(stderr,
+          "Usage: %s [options] CAPTURE [host:port]\n"
+          "  -s SPEED    1 replays at the captured pace, 2 twice as fast, max as fast as possible; default 1\n"
+          "  -t N        loop threads, default 2\n"
+          "  -g SECONDS  wait for responses after the last send, default 5\n"
+          "  -p          send requests at their captured times even while earlier ones are unanswered;\n"
+          "              without it a request waits for the response to the one before, as clients do\n"
+          "  -j          print the results as JSON\n"
+          "CAPTURE is written by HttpServer::EnableTrafficCapture. Every captured connection is opened,\n"
+          "sends its bytes and closes at the captured times, scaled by SPEED. The target defaults to\n"
+          "127.0.0.1:12345, example_http_server.\n",
+          name);
+}
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  Options options;
+
+  int opt;
+  while ((opt = ::getopt(argc, argv, "s:t:g:pj")) != -1) {
+    switch (opt) {
+      case 's':
+        options.speed = string_view{optarg} == "max" ? 0 : atof(optarg);
+        break;
+      case 't':
+        options.threads = atoi(optarg);
+        break;
+      case 'g':
+        options.grace = atof(optarg);
+        break;
+      case 'p':
+        options.pipeline = true;
+        break;
+      case 'j':
+        options.json = true;
+        break;
+      default:
+        Usage(argv[0]);
+        return 1;
+    }
+  }
+  if (optind >= argc || (optind + 1 < argc && !ParseTarget(argv[optind + 1], options)) || options.threads < 1 ||
+      options.speed < 0 || options.grace < 0) {
+    Usage(argv[0]);
+    return 1;
+  }
+
+  uint64_t        gaps = 0;
+  vector<Session> sessions;
+  try {
+    sessions = LoadCapture(argv[optind], gaps);
+  } catch (exception const& e) {
+    fprintf(stderr, "%s\n", e.what());
+    return 1;
+  }
+  if (sessions.empty()) {
+    fprintf(stderr, "No connections in %s\n", argv[optind]);
+    return 1;
+  }
+
+  uint64_t base_ns = sessions.front().open_ns;
+  uint64_t last_ns = 0;
+  uint64_t chunks  = 0;
+  uint64_t sent    = 0;
+  uint64_t framed  = 0;
+  for (auto const& session : sessions) {
+    last_ns  = max(last_ns, session.close_ns);
+    chunks  += session.chunks.size();
+    framed  += session.requests.size();
+    for (auto const& chunk : session.chunks) {
+      sent += chunk.data.size();
+    }
+  }
+  double captured = static_cast<double>(last_ns - base_ns) / 1e9;
+
+  InetAddr addr{options.host, options.port};
+  options.threads = min<int>(options.threads, static_cast<int>(sessions.size()));
+  auto group      = make_unique<EventLoopGroup>(options.threads);
+  group->Start();
+
+  atomic<size_t>             remaining{sessions.size()};
+  vector<unique_ptr<Worker>> workers;
+  for (int i = 0; i < options.threads; ++i) {
+    workers.push_back(make_unique<Worker>(group->GetEventLoop(i), options, remaining));
+  }
+  for (size_t i = 0; i < sessions.size(); ++i) {
+    workers[i % workers.size()]->Add(sessions[i], addr);
+  }
+
+  if (!options.json) {
+    printf("Replaying %zu connections, %llu requests, %.2f MB over %.1fs @ %s:%u, ", sessions.size(),
+           static_cast<unsigned long long>(framed), static_cast<double>(sent) / 1e6, captured, options.host.c_str(),
+           options.port);
+    if (options.speed > 0) {
+      printf("speed %gx\n", options.speed);
+    } else {
+      printf("max speed\n");
+    }
+    fflush(stdout);
+  }
+
+  auto begin = Clock::now() + chrono::milliseconds(10);
+  for (int i = 0; i < options.threads; ++i) {
+    group->GetEventLoop(i)->RunInLoop([worker = workers[i].get(), begin, base_ns] { worker->Start(begin, base_ns); });
+  }
+  auto span     = options.speed > 0 ? captured / options.speed : 0;
+  auto deadline = begin + chrono::duration_cast<Clock::duration>(chrono::duration<double>(span + options.grace));
+  while (remaining.load(memory_order_relaxed) > 0 && Clock::now() < deadline) {
+    this_thread::sleep_for(chrono::milliseconds(10));
+  }
+  double seconds = chrono::duration<double>(Clock::now() - begin).count();
+
+  Stats total;
+  for (int i = 0; i < options.threads; ++i) {
+    promise<void> stopped;
+    group->GetEventLoop(i)->RunInLoop([&, worker = workers[i].get()] {
+      worker->Stop();
+      total.Merge(worker->GetStats());
+      stopped.set_value();
+    });
+    stopped.get_future().wait();
+  }
+  group.reset();
+
+  if (options.json) {
+    printf("{\n  \"connections\": %zu, \"chunks\": %llu, \"requests\": %llu, \"gaps\": %llu, \"speed\": %g,\n",
+           sessions.size(), static_cast<unsigned long long>(chunks), static_cast<unsigned long long>(framed),
+           static_cast<unsigned long long>(gaps), options.speed);
+    printf("  \"captured_s\": %.3f, \"replayed_s\": %.3f, \"responses\": %llu, \"non_2xx\": %llu, \"errors\": %llu, "
+           "\"unsent_chunks\": %llu, \"bytes_received\": %llu,\n",
+           captured, seconds, static_cast<unsigned long long>(total.responses),
+           static_cast<unsigned long long>(total.non_2xx), static_cast<unsigned long long>(total.errors),
+           static_cast<unsigned long long>(total.unsent), static_cast<unsigned long long>(total.bytes));
+    PrintLatencyJson("latency", total.latency, false);
+    PrintLatencyJson("service", total.service, false);
+    PrintLatencyJson("lag", total.lag, true);
+    printf("}\n");
+    return 0;
+  }
+
+  printf("  %llu responses in %.1fs (captured %.1fs), %.1f requests/s\n",
+         static_cast<unsigned long long>(total.responses), seconds, captured,
+         static_cast<double>(total.responses) / seconds);
+  printf("  %llu non-2xx responses, %llu errors, %llu chunks unsent, %llu connections with dropped records\n",
+         static_cast<unsigned long long>(total.non_2xx), static_cast<unsigned long long>(total.errors),
+         static_cast<unsigned long long>(total.unsent), static_cast<unsigned long long>(gaps));
+  // latency counts from when the capture says the request was sent, lag is how far sending fell behind.
+  PrintLatency("latency", total.latency);
+  PrintLatency("service", total.service);
+  PrintLatency("lag", total.lag);
+  return 0;
+}
@@ -0,0 +1,95 @@
+/**
+ * @file shm_log_reader.cpp
+ * @author Qirui Wang (qirui.wang@moegi.waseda.jp)
+ * @brief Print the records of a ring file written by ShmRingSink
+ * @version 0.1
+ * @date 2023-02-16
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include <unistd.h>
+
+#include "utils/shm_ring.hpp"
+
+namespace {
+void Usage(char const* name) {
+  std::cerr << "Usage: " << name << " [-f] [-n] [-c channel] <ring file>\n"
+            << "  -f          keep reading records as they are appended\n"
+            << "  -n          start with new records instead of the oldest one in the ring\n"
+            << "  -c channel  only print records of this channel\n";
+}
+
+void WriteAll(std::string_view data) {
+  while (!data.empty()) {
+    auto n = ::write(STDOUT_FILENO, data.data(), data.size());
+    if (n < 0) {
+      std::exit(1);
+    }
+    data.remove_prefix(n);
+  }
+}
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  bool                    follow      = false;
+  bool                    from_oldest = true;
+  std::optional<uint32_t> channel;
+
+  int opt;
+  while ((opt = ::getopt(argc, argv, "fnc:")) != -1) {
+    switch (opt) {
+      case 'f':
+        follow = true;
+        break;
+      case 'n':
+        from_oldest = false;
+        break;
+      case 'c':
+        channel = static_cast<uint32_t>(std::strtoul(optarg, nullptr, 10));
+        break;
+      default:
+        Usage(argv[0]);
+        return 1;
+    }
+  }
+  if (optind + 1 != argc) {
+    Usage(argv[0]);
+    return 1;
+  }
+
+  try {
+    simple_http::util::ShmRingReader reader{argv[optind], from_oldest};
+    simple_http::util::ShmRingRecord record;
+    uint64_t                         lost = 0;
+    while (true) {
+      if (reader.Next(record)) {
+        if (!channel || record.channel == *channel) {
+          WriteAll(record.payload);
+        }
+        continue;
+      }
+      if (reader.GetLost() != lost) {
+        std::cerr << "shm_log_reader: " << reader.GetLost() - lost << " bytes overwritten before they were read\n";
+        lost = reader.GetLost();
+      }
+      if (!follow) {
+        return 0;
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+  } catch (std::exception const& e) {
+    std::cerr << "shm_log_reader: " << e.what() << '\n';
+    return 1;
+  }
+}
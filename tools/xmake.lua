@@ -0,0 +1,14 @@
+set_kind("binary")
+add_syslinks("pthread")
+
+target("shm_log_reader")
+  add_deps("simple_http_static")
+  add_files("shm_log_reader.cpp")
+
+target("load_gen")
+  add_deps("simple_http_static")
+  add_files("load_gen.cpp")
+
+target("replay")
+  add_deps("simple_http_static")
+  add_files("replay.cpp")
\ No newline at end of file
@@ -12,4 +12,6 @@ set_plat("linux")
 
 includes("test")
 includes("src")
-includes("example")
\ No newline at end of file
+includes("example")
+includes("tools")
+includes("bench")
\ No newline at end of file